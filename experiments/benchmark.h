@@ -313,7 +313,8 @@ size_t Evaluate(typename IndexType::DataVev_& data,
   }
   std::cout << ", build_time/ms:," << build_time << ", #model:,"
             << index.GetModelNum() << ", space/MiB:,"
-            << index.GetInMemorySize() / 1024.0 / 1024.0 << "\n"
+            << index.GetInMemorySize() / 1024.0 / 1024.0 << ", sample/MiB:,"
+            << index.GetSampleSize() / 1024.0 / 1024.0 << "\n"
             << std::endl;
 
 #ifdef PRINT_PAGE_STATS
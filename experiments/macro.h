@@ -23,6 +23,10 @@
 
 #define LAST_MILE_SEARCH 0  // 0: binary search, 1: linear search
 
+// sample every k-th compressed model key of DI-V4 and LecoZonemap to narrow
+// the search before decoding, 0: no sample
+#define MODEL_KEY_SAMPLE_STRIDE 0
+
 #define MAX_NUM_QUALIFYING 100  // Consistent with SOSD.
 
 /**
@@ -58,6 +62,11 @@ void PrintMacro() {
   std::cout << "Use [linear search] to perform last-mile search." << std::endl;
 #endif  // LAST_MILE_SEARCH
 
+#if MODEL_KEY_SAMPLE_STRIDE > 0
+  std::cout << "Use [a sample of every " << MODEL_KEY_SAMPLE_STRIDE
+            << "-th model key] over the compressed model keys." << std::endl;
+#endif  // MODEL_KEY_SAMPLE_STRIDE
+
 #ifdef TEST_SEARCH
   std::cout << "[Test the lookup function] before evaluation." << std::endl;
 #else
@@ -31,6 +31,11 @@ static void* DoCoreLookups(void* thread_params) {
   const uint64_t kGapCnt = tmp_params.params.record_bytes_ / sizeof(K);
   ResultInfo<K>* res_info = new ResultInfo<K>;
   auto size = tmp_params.lookups.size();
+  if (tmp_params.params.is_on_disk_) {
+    // each thread reads into its own buffer through its own ring
+    RegisterIOBuffer(tmp_params.params.read_buf_,
+                     tmp_params.params.page_bytes_ * ALLOCATED_BUF_SIZE);
+  }
 
   res_info->latency_sum = GetNsTime([&] {
     for (uint64_t i = 0; i < size; i++) {
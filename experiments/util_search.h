@@ -11,6 +11,8 @@
 #include <chrono>
 #include <iostream>
 
+#include "../io_backend.h"
+#include "../last_mile_search.h"
 #include "structures.h"
 
 template <typename K>
@@ -46,30 +48,34 @@ static void DirectIORead(int fd, size_t page_bytes, size_t page_num,
 #ifdef PROF_CPU_IO
   auto prof_start = std::chrono::high_resolution_clock::now();
 #endif  // PROF_CPU_IO
-  if (lseek(fd, offset, SEEK_SET) == -1) {
-    throw std::runtime_error("lseek file error in DirectIORead");
-  }
+  if (io_backend_ == kIOUring) {
+    // no seek, the offset is in the request
+    GetIOUring().Read(fd, read_buf, page_bytes * page_num, offset);
+  } else {
+    if (lseek(fd, offset, SEEK_SET) == -1) {
+      throw std::runtime_error("lseek file error in DirectIORead");
+    }
 #ifdef PROF_CPU_IO
-  auto prof_end = std::chrono::high_resolution_clock::now();
-  uint64_t prof_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                         prof_end - prof_start)
-                         .count();
-  prof_file_cpu_time += prof_ns;
+    auto prof_end = std::chrono::high_resolution_clock::now();
+    prof_file_cpu_time +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(prof_end -
+                                                             prof_start)
+            .count();
 
-  prof_start = std::chrono::high_resolution_clock::now();
+    prof_start = std::chrono::high_resolution_clock::now();
 #endif  // PROF_CPU_IO
 
-  int ret = read(fd, read_buf, page_bytes * page_num);
-  if (ret == -1) {
-    throw std::runtime_error("read error in DirectIORead");
+    int ret = read(fd, read_buf, page_bytes * page_num);
+    if (ret == -1) {
+      throw std::runtime_error("read error in DirectIORead");
+    }
   }
 
 #ifdef PROF_CPU_IO
-  prof_end = std::chrono::high_resolution_clock::now();
-  prof_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(prof_end -
-                                                                 prof_start)
-                .count();
-  prof_io_time += prof_ns;
+  auto prof_end = std::chrono::high_resolution_clock::now();
+  prof_io_time += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      prof_end - prof_start)
+                      .count();
 #endif  // PROF_CPU_IO
 }
 
@@ -77,30 +83,18 @@ template <typename K>
 inline uint64_t LastMileSearch(const K* data, uint64_t record_num,
                                uint64_t gap_cnt, K key) {
   // Here assuming that each location has a meaningful value
-  uint64_t s = 0, e = record_num;
+  uint64_t e = record_num;
   if (*(data + (e - 1) * gap_cnt) < key) {
     return e - 1;
   }
 
 #if LAST_MILE_SEARCH == 0
   // binary search
-  while (s < e) {
-    uint64_t mid = (s + e) >> 1;
-    if (*(data + mid * gap_cnt) < key)
-      s = mid + 1;
-    else
-      e = mid;
-  }
-  return s;
+  return BinaryLowerBound(data, e, gap_cnt, key);
 #else
   // linear search
-  while (s < e) {
-    if (*(data + s * gap_cnt) == key)
-      return s;
-    else
-      s++;
-  }
-  return s;
+  uint64_t s = LinearLowerBound(data, e, gap_cnt, key);
+  return *(data + s * gap_cnt) == key ? s : e;
 #endif
 }
 
@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <map>
 #include <vector>
 
 #include "../../libraries/LeCo/headers/codecfactory.h"
@@ -13,6 +14,7 @@
 #include "../../libraries/LeCo/headers/piecewise_fix_integer_template_float.h"
 #include "../PGM-index-disk/pgm_index_page.hpp"
 #include "../PGM-index/include/pgm/sdsl.hpp"
+#include "../key_sample.h"
 
 namespace compressed_disk_index {
 
@@ -55,6 +57,34 @@ class Segments {
 class CompressedIntercepts {
  public:
   CompressedIntercepts(){};
+  // sel1_ points to compressed_intercepts_, so it is re-initialized over the
+  // copied/moved bitvector instead of pointing to the source object
+  CompressedIntercepts(const CompressedIntercepts& other)
+      : intercept_offset_(other.intercept_offset_),
+        compressed_intercepts_(other.compressed_intercepts_),
+        intercepts_map_(other.intercepts_map_) {
+    sdsl::util::init_support(sel1_, &compressed_intercepts_);
+  }
+  CompressedIntercepts(CompressedIntercepts&& other)
+      : intercept_offset_(other.intercept_offset_),
+        compressed_intercepts_(std::move(other.compressed_intercepts_)),
+        intercepts_map_(std::move(other.intercepts_map_)) {
+    sdsl::util::init_support(sel1_, &compressed_intercepts_);
+  }
+  CompressedIntercepts& operator=(const CompressedIntercepts& other) {
+    intercept_offset_ = other.intercept_offset_;
+    compressed_intercepts_ = other.compressed_intercepts_;
+    intercepts_map_ = other.intercepts_map_;
+    sdsl::util::init_support(sel1_, &compressed_intercepts_);
+    return *this;
+  }
+  CompressedIntercepts& operator=(CompressedIntercepts&& other) {
+    intercept_offset_ = other.intercept_offset_;
+    compressed_intercepts_ = std::move(other.compressed_intercepts_);
+    intercepts_map_ = std::move(other.intercepts_map_);
+    sdsl::util::init_support(sel1_, &compressed_intercepts_);
+    return *this;
+  }
 
   template <typename IterI>
   void Compress(IterI first_intercept, IterI last_intercept) {
@@ -113,9 +143,38 @@ class CompressedIntercepts {
            intercepts_map_.size() * (sizeof(size_t) + sizeof(INTERCEPT_TYPE));
   }
 
+  void Serialize(std::ostream& out) const {
+    out.write(reinterpret_cast<const char*>(&intercept_offset_),
+              sizeof(INTERCEPT_TYPE));
+    compressed_intercepts_.serialize(out);
+    size_t map_size = intercepts_map_.size();
+    out.write(reinterpret_cast<const char*>(&map_size), sizeof(size_t));
+    for (auto& it : intercepts_map_) {
+      out.write(reinterpret_cast<const char*>(&it.first), sizeof(size_t));
+      out.write(reinterpret_cast<const char*>(&it.second),
+                sizeof(INTERCEPT_TYPE));
+    }
+  }
+
+  void Load(std::istream& in) {
+    in.read(reinterpret_cast<char*>(&intercept_offset_),
+            sizeof(INTERCEPT_TYPE));
+    compressed_intercepts_.load(in);
+    sdsl::util::init_support(sel1_, &compressed_intercepts_);
+    size_t map_size;
+    in.read(reinterpret_cast<char*>(&map_size), sizeof(size_t));
+    intercepts_map_.clear();
+    for (size_t i = 0; i < map_size; i++) {
+      std::pair<size_t, INTERCEPT_TYPE> item;
+      in.read(reinterpret_cast<char*>(&item.first), sizeof(size_t));
+      in.read(reinterpret_cast<char*>(&item.second), sizeof(INTERCEPT_TYPE));
+      intercepts_map_.emplace_hint(intercepts_map_.end(), item);
+    }
+  }
+
  private:
-  INTERCEPT_TYPE intercept_offset_;  ///< An offset to make the intercepts start
-                                     ///< from 0 in the bitvector.
+  INTERCEPT_TYPE intercept_offset_ = 0;  ///< An offset to make the intercepts
+                                         ///< start from 0 in the bitvector.
   sdsl::sd_vector<> compressed_intercepts_;  ///< The compressed bitvector
                                              ///< storing the intercepts.
   sdsl::sd_vector<>::select_1_type
@@ -200,6 +259,23 @@ class CompressedSlopes {
     return slopes_map_.bit_size() / 8 + slopes_table_.size() * sizeof(float);
   }
 
+  void Serialize(std::ostream& out) const {
+    size_t table_size = slopes_table_.size();
+    out.write(reinterpret_cast<const char*>(&table_size), sizeof(size_t));
+    out.write(reinterpret_cast<const char*>(slopes_table_.data()),
+              table_size * sizeof(float));
+    slopes_map_.serialize(out);
+  }
+
+  void Load(std::istream& in) {
+    size_t table_size;
+    in.read(reinterpret_cast<char*>(&table_size), sizeof(size_t));
+    slopes_table_.resize(table_size);
+    in.read(reinterpret_cast<char*>(slopes_table_.data()),
+            table_size * sizeof(float));
+    slopes_map_.load(in);
+  }
+
  private:
   std::vector<float> slopes_table_;
   sdsl::int_vector<> slopes_map_;
@@ -292,10 +368,50 @@ class LecoCompression {
       uint32_t segment_size = res - descriptor;
       descriptor = (uint8_t*)realloc(descriptor, segment_size);
       block_start_vec_.push_back(descriptor);
+      block_bytes_.push_back(segment_size);
       memory_size_ += segment_size;
     }
   }
 
+  void Serialize(std::ostream& out) const {
+    out.write(reinterpret_cast<const char*>(&point_num_), sizeof(size_t));
+    if (point_num_ <= 100) {
+      out.write(reinterpret_cast<const char*>(points_.data()),
+                point_num_ * sizeof(K));
+      return;
+    }
+    out.write(reinterpret_cast<const char*>(&block_num_), sizeof(size_t));
+    out.write(reinterpret_cast<const char*>(&block_width_), sizeof(size_t));
+    out.write(reinterpret_cast<const char*>(block_bytes_.data()),
+              block_num_ * sizeof(uint32_t));
+    for (size_t i = 0; i < block_num_; i++) {
+      out.write(reinterpret_cast<const char*>(block_start_vec_[i]),
+                block_bytes_[i]);
+    }
+  }
+
+  void Load(std::istream& in) {
+    in.read(reinterpret_cast<char*>(&point_num_), sizeof(size_t));
+    if (point_num_ <= 100) {
+      points_.resize(point_num_);
+      in.read(reinterpret_cast<char*>(points_.data()), point_num_ * sizeof(K));
+      return;
+    }
+    in.read(reinterpret_cast<char*>(&block_num_), sizeof(size_t));
+    in.read(reinterpret_cast<char*>(&block_width_), sizeof(size_t));
+    codec_.init(block_num_, block_width_);
+    block_bytes_.resize(block_num_);
+    in.read(reinterpret_cast<char*>(block_bytes_.data()),
+            block_num_ * sizeof(uint32_t));
+    block_start_vec_.resize(block_num_);
+    memory_size_ = 0;
+    for (size_t i = 0; i < block_num_; i++) {
+      block_start_vec_[i] = (uint8_t*)malloc(block_bytes_[i]);
+      in.read(reinterpret_cast<char*>(block_start_vec_[i]), block_bytes_[i]);
+      memory_size_ += block_bytes_[i];
+    }
+  }
+
   inline K decompress(size_t i) {
     if (point_num_ <= 100) {
       return points_[i];
@@ -304,12 +420,25 @@ class LecoCompression {
                                      i % block_width_, NULL, point_num_);
   }
 
+  // sample every stride-th compressed key to narrow LecoUpperBound, 0: none
+  inline void BuildSample(size_t stride) {
+    if (point_num_ <= 100) {
+      return;
+    }
+    sample_.Build(point_num_, stride, [&](size_t i) { return decompress(i); });
+  }
+
   inline std::pair<size_t, K> LecoUpperBound(K key) {
     if (point_num_ <= 100) {
       auto it = std::upper_bound(points_.begin(), points_.end(), key);
       return {it - points_.begin(), *(--it)};
     }
     uint64_t s = 0, e = point_num_;
+    if (!sample_.empty()) {
+      auto range = sample_.template Narrow<true>(key);
+      s = range.first;
+      e = range.second;
+    }
     K data_mid = 0, last_data = 0;
     while (s < e) {
       uint64_t mid = (s + e) >> 1;
@@ -327,20 +456,28 @@ class LecoCompression {
     return {s, last_data};
   }
 
-  inline size_t size() const { return memory_size_ + sizeof(size_t) * 4; }
+  inline size_t size() const {
+    return memory_size_ + sizeof(size_t) * 4 + sample_size();
+  }
+
+  inline size_t sample_size() const {
+    return sample_.empty() ? 0 : sample_.size();
+  }
 
   inline size_t keys_num() const { return point_num_; }
 
  private:
   Codecset::Leco_int<K> codec_;
   std::vector<uint8_t*> block_start_vec_;
+  std::vector<uint32_t> block_bytes_;
 
   std::vector<K> points_;
+  KeySample<K> sample_;
 
-  size_t point_num_;
-  size_t block_num_;
+  size_t point_num_ = 0;
+  size_t block_num_ = 0;
   size_t memory_size_ = 0;
-  size_t block_width_;
+  size_t block_width_ = 0;
 };
 
 template <class K>
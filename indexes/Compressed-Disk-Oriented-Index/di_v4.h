@@ -17,8 +17,14 @@ namespace compressed_disk_index {
 template <typename K, typename V>
 class DiskOrientedIndexV4 {
  public:
-  DiskOrientedIndexV4(size_t record_per_page = 256)
-      : min_key_(0), max_key_(0), max_y_(0), record_per_page_(record_per_page) {
+  // sample_stride: sample every sample_stride-th model key to narrow the
+  // search over the compressed keys, 0: no sample
+  DiskOrientedIndexV4(size_t record_per_page = 256, size_t sample_stride = 0)
+      : min_key_(0),
+        max_key_(0),
+        max_y_(0),
+        record_per_page_(record_per_page),
+        sample_stride_(sample_stride) {
 #ifndef HYBRID_BENCHMARK
     std::cout << "use leco to compress the model keys" << std::endl;
 #endif
@@ -144,6 +150,7 @@ class DiskOrientedIndexV4 {
 #endif
     // compress keys
     compressed_keys.Compress(model_keys, 1000);
+    compressed_keys.BuildSample(sample_stride_);
 #ifdef BREAKDOWN
     end = std::chrono::high_resolution_clock::now();
     cpr_key_lat +=
@@ -175,6 +182,39 @@ class DiskOrientedIndexV4 {
 
   size_t GetModelNum() const { return compressed_keys.keys_num(); }
 
+  // write the compressed model, which can be restored by Load
+  void Serialize(std::ostream& out) const {
+    out.write(reinterpret_cast<const char*>(&min_key_), sizeof(K));
+    out.write(reinterpret_cast<const char*>(&max_key_), sizeof(K));
+    out.write(reinterpret_cast<const char*>(&max_y_), sizeof(size_t));
+    out.write(reinterpret_cast<const char*>(&record_per_page_),
+              sizeof(size_t));
+    out.write(reinterpret_cast<const char*>(&error_), sizeof(uint16_t));
+    compressed_slopes.Serialize(out);
+#ifdef INTERCEPT_USE_LECO
+    leco_intercepts_.Serialize(out);
+#else
+    pgm_intercepts_.Serialize(out);
+#endif
+    compressed_keys.Serialize(out);
+  }
+
+  void Load(std::istream& in) {
+    in.read(reinterpret_cast<char*>(&min_key_), sizeof(K));
+    in.read(reinterpret_cast<char*>(&max_key_), sizeof(K));
+    in.read(reinterpret_cast<char*>(&max_y_), sizeof(size_t));
+    in.read(reinterpret_cast<char*>(&record_per_page_), sizeof(size_t));
+    in.read(reinterpret_cast<char*>(&error_), sizeof(uint16_t));
+    compressed_slopes.Load(in);
+#ifdef INTERCEPT_USE_LECO
+    leco_intercepts_.Load(in);
+#else
+    pgm_intercepts_.Load(in);
+#endif
+    compressed_keys.Load(in);
+    compressed_keys.BuildSample(sample_stride_);
+  }
+
   size_t GetSize() const {
 #ifdef INTERCEPT_USE_LECO
     return compressed_slopes.size() + leco_intercepts_.size() +
@@ -184,6 +224,9 @@ class DiskOrientedIndexV4 {
            sizeof(uint16_t) + compressed_keys.size();
 #endif
   }
+
+  // the bytes of the sample of the model keys, included in GetSize
+  size_t GetSampleSize() const { return compressed_keys.sample_size(); }
 #ifdef BREAKDOWN
   void PrintBreakdown() {
     std::cout << "di v4: ," << init_data_size << ",\t" << seg_size << ",\t"
@@ -220,6 +263,7 @@ class DiskOrientedIndexV4 {
   K max_key_;
   size_t max_y_;
   size_t record_per_page_;
+  size_t sample_stride_;
   uint16_t error_;
 
   CompressedSlopes<K> compressed_slopes;
@@ -14,15 +14,18 @@ class DI_V4 : public BaseIndex<K, V> {
   struct param_t {
     float lambda;
     size_t record_per_page;
+    size_t sample_stride = 0;  // see DiskOrientedIndexV4
   };
 
   DI_V4(param_t p = param_t(1.25, 256)) {
     lambda_ = p.lambda;
     record_per_page_ = p.record_per_page;
+    sample_stride_ = p.sample_stride;
   }
 
   void Build(std::vector<std::pair<K, V>>& data) {
-    di_ = compressed_disk_index::DiskOrientedIndexV4<K, V>(record_per_page_);
+    di_ = compressed_disk_index::DiskOrientedIndexV4<K, V>(record_per_page_,
+                                                          sample_stride_);
     di_.Build(data, lambda_);
 
     disk_size_ = (sizeof(K) + sizeof(V)) * data.size();
@@ -46,6 +49,8 @@ class DI_V4 : public BaseIndex<K, V> {
 
   size_t GetInMemorySize() const override { return di_.GetSize(); }
 
+  size_t GetSampleSize() const override { return di_.GetSampleSize(); }
+
   size_t GetIndexSize() const override {
     return GetInMemorySize() + disk_size_;
   }
@@ -56,6 +61,7 @@ class DI_V4 : public BaseIndex<K, V> {
   float lambda_;
   size_t disk_size_ = 0;
   size_t record_per_page_;
+  size_t sample_stride_;
 };
 
 #endif  // INDEXES_DI_V4_H_
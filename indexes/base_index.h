@@ -21,6 +21,15 @@ class BaseIndex {
 
   virtual V Find(const K key) = 0;
 
+  // lookup a batch of keys, the indexes without a batched path lookup the
+  // keys one by one
+  virtual void FindBatch(const std::vector<K>& keys, std::vector<V>& vals) {
+    vals.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      vals[i] = Find(keys[i]);
+    }
+  }
+
   virtual V Scan(const K key, const int range) = 0;
 
   virtual bool Insert(const K key, const V value) = 0;
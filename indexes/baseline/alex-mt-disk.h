@@ -0,0 +1,74 @@
+#ifndef INDEXES_ALEX_MT_DISK_H_
+#define INDEXES_ALEX_MT_DISK_H_
+
+#include "../../libraries/UpdatableLearnedIndexDisk/ALEX/mt_alex.h"
+#include "../base_index.h"
+
+template <typename K, typename V>
+class BaselineAlexMTDisk : public MultiThreadedBaseIndex<K, V> {
+ public:
+  struct param_t {
+    std::string main_file;
+    size_t thread_num;
+  };
+
+  BaselineAlexMTDisk(param_t params)
+      : index_file_(params.main_file),
+        alex_(index_file_.c_str(), params.thread_num) {}
+
+  void Build(typename BaseIndex<K, V>::DataVec_& key_value) {
+    alex_.bulk_load(key_value.data(), key_value.size());
+  }
+
+  V Find(const K key, int thread_id) { return alex_.lookup(key, thread_id); }
+
+  V Scan(const K key, const int range, int thread_id) {
+    std::vector<std::pair<K, V>> res(range);
+    size_t cnt = alex_.scan(key, range, res.data(), thread_id);
+    V sum = 0;
+    for (size_t i = 0; i < cnt; i++) {
+      sum += res[i].second;
+    }
+    return sum;
+  }
+
+  bool Insert(const K key, const V value, int thread_id) {
+    alex_.insert(key, value, thread_id);
+    return true;
+  }
+
+  bool Update(const K key, const V value, int thread_id) {
+    alex_.insert(key, value, thread_id);
+    return true;
+  }
+
+  bool Delete(const K key, int thread_id) { return true; }
+
+  void FreeBuffer(){};
+
+#ifdef BREAKDOWN
+  void PrintBreakdown(){};
+#endif
+
+  size_t GetNodeSize() { return alex_.get_memory_size(); }
+
+  size_t GetTotalSize() { return GetNodeSize() + alex_.get_file_size(); }
+
+  void PrintEachPartSize() {
+    std::cout << "\t\talex node size:" << PRINT_MIB(GetNodeSize())
+              << ",\talex on-disk size:" << PRINT_MIB(alex_.get_file_size())
+              << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
+    alex_.print_stats();
+  }
+
+  std::string GetIndexName() const { return name_; }
+
+  param_t GetIndexParams() const { return {index_file_, 0}; }
+
+ private:
+  std::string name_ = "BASELINE_ALEX_MT_Disk";
+  std::string index_file_;
+  ThreadSafeAlexDisk<K, V> alex_;
+};
+
+#endif  // !INDEXES_ALEX_MT_DISK_H_
@@ -10,6 +10,8 @@ class BaselineBTreeDisk : public BaseIndex<K, V> {
   struct param_t {
     size_t inner_on_disk_num;
     std::string main_file;
+    // the inner nodes in memory and the block cache, 0: no cache
+    size_t memory_budget = 0;
   };
 
   BaselineBTreeDisk(param_t params = param_t(0, ""))
@@ -18,7 +20,10 @@ class BaselineBTreeDisk : public BaseIndex<K, V> {
         // btree_(HYBRID_MODE, true, const_cast<char*>(index_file_.c_str()),
         //        false),
         cnt_(0),
-        inner_on_disk_num_(params.inner_on_disk_num) {}
+        inner_on_disk_num_(params.inner_on_disk_num),
+        memory_budget_(params.memory_budget) {}
+
+  ~BaselineBTreeDisk() { delete cache_; }
 
   void Build(typename BaseIndex<K, V>::DataVec_& key_value) {
     typename BaseIndex<K, V>::DataVec_ dataset(key_value.begin(),
@@ -31,6 +36,14 @@ class BaselineBTreeDisk : public BaseIndex<K, V> {
     btree_.bulk_load(data, key_value.size(), 0.7, inner_on_disk_num_);
     btree_.sync_metanode();
 
+    // the memory left by the in-memory inner nodes caches the disk blocks
+    size_t node_size = btree_.get_inner_size();
+    if (memory_budget_ >= node_size + BlockSize) {
+      cache_ = new BlockCache(
+          BlockCache::GetCapacityFor(memory_budget_ - node_size, BlockSize), BlockSize);
+      btree_.set_block_cache(cache_);
+    }
+
     // auto seed = std::chrono::system_clock::now().time_since_epoch().count();
     // std::shuffle(dataset.begin(), dataset.end(),
     //              std::default_random_engine(seed));
@@ -83,7 +96,9 @@ class BaselineBTreeDisk : public BaseIndex<K, V> {
     return true;
   }
 
-  size_t GetNodeSize() { return btree_.get_inner_size(); }
+  size_t GetNodeSize() {
+    return btree_.get_inner_size() + (cache_ ? cache_->GetNodeSize() : 0);
+  }
 
   size_t GetTotalSize() { return GetNodeSize() + btree_.get_file_size(); }
 
@@ -91,6 +106,9 @@ class BaselineBTreeDisk : public BaseIndex<K, V> {
     std::cout << "\t\tbtree node size:" << PRINT_MIB(GetNodeSize())
               << ",\tbtree on-disk size:" << PRINT_MIB(btree_.get_file_size())
               << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
+    if (cache_) {
+      cache_->PrintBlockCacheInfo();
+    }
   }
 
   std::string GetIndexName() const {
@@ -104,6 +122,8 @@ class BaselineBTreeDisk : public BaseIndex<K, V> {
   std::string index_file_;
   BTree btree_;
   int inner_on_disk_num_;
+  size_t memory_budget_;
+  BlockCache* cache_ = nullptr;
 
   int cnt_;
 };
@@ -14,17 +14,9 @@ class BaselineBTreeMTDisk : public MultiThreadedBaseIndex<K, V> {
   BaselineBTreeMTDisk(param_t params = param_t(""))
       : index_file_(params.main_file), btree_(index_file_.c_str()) {}
 
+  // the records are sorted by key
   void Build(typename BaseIndex<K, V>::DataVec_& key_value) {
-    auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-    auto dataset = key_value;
-    std::shuffle(dataset.begin(), dataset.end(),
-                 std::default_random_engine(seed));
-#pragma omp parallel for num_threads(64)
-    for (int i = 0; i < dataset.size(); i++) {
-      btree_.insert(dataset[i].first, dataset[i].second);
-    }
-
-    btree_.direct_open(index_file_);
+    btree_.bulk_load(key_value.data(), key_value.size());
   }
 
   V Find(const K key, int thread_id) {
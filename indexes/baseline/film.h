@@ -21,7 +21,7 @@ class BaselineFILM : public BaseIndex<K, V> {
   typedef pair<typename filmadatype::Leafpiece *, unsigned short int>
       filmadalrupair;  // lru 中value 的type ，是一个pair，first is
                        // 所属的leaf，second 是slot in leaf
-  typedef adalru::hashLRU<
+  typedef adalru::clockLRU<
       K, typename filmadatype::Leafpiece *,
       typename adalru::Node<K, typename filmadatype::Leafpiece *> *>
       filmadalrutype;
@@ -208,7 +208,8 @@ class BaselineFILM : public BaseIndex<K, V> {
   }
 
   bool Insert(const K key, const V value) {
-    V payload[filmada_.valuesize]{value};
+    // the leaf keeps the payload until it is evicted or deleted
+    V *payload = new V[filmada_.valuesize]{value};
     filmada_.update_random(key, payload, interchain_);
     // }
     filmada_.root = &filmada_.innerlevels.back()->innerpieces[0];
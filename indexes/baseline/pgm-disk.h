@@ -10,6 +10,7 @@ class BaselinePGMDisk : public BaseIndex<K, V> {
   struct param_t {
     std::string main_file;
     size_t memory_budget_;
+    size_t filter_bits_per_key;  // 0: no filter, every level is searched
   };
 
   typedef pgm_baseline_disk::DynamicPGMIndex<K, V> PGM_DISK;
@@ -17,7 +18,12 @@ class BaselinePGMDisk : public BaseIndex<K, V> {
   BaselinePGMDisk(param_t params = param_t(""))
       : index_file_(params.main_file),
         memory_budget_(params.memory_budget_),
-        cnt_(0) {}
+        cnt_(0),
+        lookup_cnt_(0),
+        lookup_block_cnt_(0),
+        avoided_block_cnt_(0) {
+    pgm_.filter_bits_per_key = params.filter_bits_per_key;
+  }
 
   void Build(typename BaseIndex<K, V>::DataVec_ &key_value) {
     max_key_ = key_value.back().first;
@@ -38,8 +44,12 @@ class BaselinePGMDisk : public BaseIndex<K, V> {
     V res = 0;
     int ic = 0;
     int lc = 0;
-    res = pgm_.find_on_disk(key, &c, &ic, &lc);
+    int ac = 0;
+    res = pgm_.find_on_disk(key, &c, &ic, &lc, &ac);
     cnt_ += c;
+    lookup_cnt_++;
+    lookup_block_cnt_ += c;
+    avoided_block_cnt_ += ac;
     return res;
   }
 
@@ -73,8 +83,12 @@ class BaselinePGMDisk : public BaseIndex<K, V> {
     int c = 0;
     int ic = 0;
     int lc = 0;
-    auto succ = pgm_.update_on_disk(key, value, &c, &ic, &lc);
+    int ac = 0;
+    auto succ = pgm_.update_on_disk(key, value, &c, &ic, &lc, &ac);
     cnt_ += c;
+    lookup_cnt_++;
+    lookup_block_cnt_ += c;
+    avoided_block_cnt_ += ac;
     return succ;
   }
   bool Delete(const K key) { return true; }
@@ -88,6 +102,13 @@ class BaselinePGMDisk : public BaseIndex<K, V> {
               << ",\tpgm on-disk size:"
               << PRINT_MIB(pgm_.report_disk_file_size())
               << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
+    if (lookup_cnt_ > 0) {
+      std::cout << "\t\tfilter size:" << PRINT_MIB(pgm_.report_filter_size())
+                << ",\tdata blocks per lookup:"
+                << lookup_block_cnt_ * 1.0 / lookup_cnt_
+                << ",\tavoided blocks per lookup:"
+                << avoided_block_cnt_ * 1.0 / lookup_cnt_ << std::endl;
+    }
   }
 
   std::string GetIndexName() const { return name_; }
@@ -102,6 +123,11 @@ class BaselinePGMDisk : public BaseIndex<K, V> {
   K max_key_;
 
   int cnt_;
+  // the finds and updates, the data blocks they read and the ones that the
+  // filters of the levels saved
+  uint64_t lookup_cnt_;
+  uint64_t lookup_block_cnt_;
+  uint64_t avoided_block_cnt_;
 };
 
 #endif  // !INDEXES_BASELINE_PGM_DISK_H_
\ No newline at end of file
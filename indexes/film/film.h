@@ -1678,8 +1678,8 @@ typedef filminsert::FILMinsert<key_type, key_type *> filmadatype;
 typedef pair<filmadatype::Leafpiece *, unsigned short int>
     filmadalrupair;  // lru 中value 的type ，是一个pair，first is
                      // 所属的leaf，second 是slot in leaf
-typedef adalru::hashLRU<key_type, filmadatype::Leafpiece *,
-                        adalru::Node<key_type, filmadatype::Leafpiece *> *>
+typedef adalru::clockLRU<key_type, filmadatype::Leafpiece *,
+                         adalru::Node<key_type, filmadatype::Leafpiece *> *>
     filmadalrutype;
 typedef adalru::localLRU<unsigned short, key_type *> locallrutype;
 typedef filmstorage::filmdisk<key_type> filmadadisk;
@@ -1990,6 +1990,7 @@ int range_read_from_disk(std::vector<std::pair<key_type, key_type *>> *result,
     gettimeofday(&rdt1, NULL);
     pageid_type firstp = dict->prepass.begin()->first;
     unsigned long aoffset = firstp * fix_buf_size;
+    pagedisk->waitpages(firstp, cross);
     ret = pread(fd, buf, buf_size,
                 static_cast<unsigned long>(
                     aoffset));  // 从 prepass 的第一个页开始，读取所有跨着的页
@@ -2121,6 +2122,7 @@ int range_read_from_disk(std::vector<std::pair<key_type, key_type *>> *result,
       } else {
         unsigned long seekdis = fix_buf_size * (pageid - abslotepageid);
         lseek(fd, seekdis, SEEK_CUR);
+        pagedisk->waitpages(pageid);
         ret = read(fd, buf, fix_buf_size);
         abslotepageid = pageid + 1;
 
@@ -2174,7 +2176,7 @@ int range_read_from_disk(std::vector<std::pair<key_type, key_type *>> *result,
     r_stats->lrutime += ltimeuse;
   }
   //        cout<<"Jesus, You are my refuge! "<<endl;
-  delete[] buf;
+  free(buf);
   close(fd);
 
   return 0;
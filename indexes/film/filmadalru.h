@@ -5,7 +5,9 @@
 #ifndef EXPERIMENTCC12_FILMADALRU_H
 #define EXPERIMENTCC12_FILMADALRU_H
 
+#include <cstdint>
 #include <unordered_map>
+#include <vector>
 #define MAX_INT (((unsigned int)(-1)) >> 1)
 // define the node in doubly-linked list
 using namespace std;
@@ -161,6 +163,122 @@ class hashLRU {
   }
 };
 
+// A CLOCK approximation of hashLRU over the leaves. Each leaf takes a slot,
+// and an access only sets the reference bit of its slot instead of moving a
+// list node to the head. get_tail sweeps the hand over the slots, clearing the
+// set bits, and stops at the first leaf that has not been accessed since the
+// last sweep; the hand stays there until the leaf is accessed or removed.
+template <class Key, class Value,
+          class mapvalue = void>  // mapvalue is kept for the hashLRU typedefs
+class clockLRU {
+ public:
+  int size = 0;
+  int capacity;
+  std::unordered_map<Key, unsigned int> map;  // key -> slot
+  std::vector<Key> keys;
+  std::vector<Value> values;
+  std::vector<uint64_t> refbits;
+  std::vector<uint64_t> usedbits;
+  std::vector<unsigned int> freeslots;
+  unsigned int hand = 0;
+
+  clockLRU(int def_capcity) : capacity(def_capcity) {}
+
+  clockLRU() : capacity(MAX_INT) {}
+
+  // put the k leaf into the clock, or mark it as accessed
+  void put(Key k, Value v) {
+    auto it = map.find(k);
+    if (it != map.end()) {
+      setbit(refbits, it->second);
+      return;
+    }
+    if (size == capacity) {
+      removeslot(victim());
+    }
+    unsigned int slot;
+    if (freeslots.empty()) {
+      slot = keys.size();
+      keys.push_back(k);
+      values.push_back(v);
+      if (slot % 64 == 0) {
+        refbits.push_back(0);
+        usedbits.push_back(0);
+      }
+    } else {
+      slot = freeslots.back();
+      freeslots.pop_back();
+      keys[slot] = k;
+      values[slot] = v;
+    }
+    setbit(usedbits, slot);
+    setbit(refbits, slot);
+    map[k] = slot;
+    size += 1;
+  }
+
+  // remove the k leaf from the clock
+  inline void remove(Key k) {
+    auto it = map.find(k);
+    if (it == map.end()) return;
+    removeslot(it->second);
+  }
+
+  // get the leaf that evicts its least recently used record, which leaves the
+  // clock with its last in-memory record
+  Value get_tail() {
+    if (size == 0) return Value();
+    unsigned int slot = victim();
+    Value leaf = values[slot];
+    if (leaf->intrachain.size == 1) removeslot(slot);
+    return leaf;
+  }
+
+  int deletelru() {
+    std::unordered_map<Key, unsigned int>().swap(map);
+    std::vector<Key>().swap(keys);
+    std::vector<Value>().swap(values);
+    std::vector<uint64_t>().swap(refbits);
+    std::vector<uint64_t>().swap(usedbits);
+    std::vector<unsigned int>().swap(freeslots);
+    size = 0;
+    hand = 0;
+    return 0;
+  }
+
+ private:
+  static inline bool getbit(const std::vector<uint64_t> &bits,
+                            unsigned int i) {
+    return (bits[i / 64] >> (i % 64)) & 1;
+  }
+  static inline void setbit(std::vector<uint64_t> &bits, unsigned int i) {
+    bits[i / 64] |= uint64_t(1) << (i % 64);
+  }
+  static inline void resetbit(std::vector<uint64_t> &bits, unsigned int i) {
+    bits[i / 64] &= ~(uint64_t(1) << (i % 64));
+  }
+
+  // the slot of a used leaf that is not referenced, size > 0
+  unsigned int victim() {
+    while (true) {
+      if (hand >= keys.size()) hand = 0;
+      if (getbit(usedbits, hand)) {
+        if (!getbit(refbits, hand)) return hand;
+        resetbit(refbits, hand);
+      }
+      hand += 1;
+    }
+  }
+
+  inline void removeslot(unsigned int slot) {
+    map.erase(keys[slot]);
+    resetbit(usedbits, slot);
+    resetbit(refbits, slot);
+    freeslots.push_back(slot);
+    size -= 1;
+  }
+};
+
 template <class Key, class Value>
 class localLRU {
  public:
@@ -11,6 +11,14 @@
 #include <unistd.h>
 #include <memory.h>
 //#define _GNU_SOURCE
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 #include "filmadalru.h"
 #include "film.h"
@@ -232,45 +240,20 @@ namespace filmstorage {
         }
 
 
+        // copy the evicted pages into one aligned buffer, which is written back
+        // by the background writer of diskpage as one large o_direct write
         unsigned short int runtimeevictpagestodisk(disk_type *diskpage){
-            unsigned short int pnum = inmempages.size();
             unsigned short int num = inmempages.size();  // 此次要写入磁盘的页的数目
-            int fd = open(diskpage->filename.c_str(), O_RDWR | O_DIRECT, 0755);
+            if (num == 0)
+                return 0;
             unsigned long int fixed_buf_size = diskpage->pagesize * sizeof(key_type);  // 磁盘页固定的大小
-            unsigned long seekdis =  fixed_buf_size * diskpage->nextpageid;
-            lseek(fd, seekdis, SEEK_SET);
-            int i = 0;
-            while (pnum > diskpage->blocknum) {
-                pnum -= diskpage->blocknum;    //diskpage->blocknum 表示 写出block 包含多少个page
-                key_type *buf = new key_type[diskpage->pagesize* diskpage->blocknum];
-
-                unsigned long buf_size = fixed_buf_size * diskpage->blocknum;
-                int ret = posix_memalign((void **) &buf, 512, buf_size);
-
-                int offset = 0;
-                for(int k = 0;k<diskpage->blocknum;k++){
-                    memcpy(buf + offset * diskpage->pagesize, &inmempages[i*diskpage->blocknum+k]->inmemdata[0], fixed_buf_size);
-                    ++offset;
-                }
-                i += 1;
-                ret = write(fd, buf, buf_size);
-//                free(buf);
-                delete [] buf;
-            }
-
-            key_type *buf = new key_type[diskpage->pagesize*pnum];
-            unsigned long int buf_size = diskpage->pagesize * sizeof(key_type) * pnum;
-            int ret = posix_memalign((void **) &buf, 512, buf_size);
-            unsigned int offset = 0;
-            for(int k = 0;k<pnum;k++){
-                memcpy(buf + offset * diskpage->pagesize, &inmempages[i*diskpage->blocknum+k]->inmemdata[0], fixed_buf_size);
-                ++offset;
-            }
-            ret = write(fd, buf, buf_size);
-//            free(buf);
-            delete[] buf;
-            diskpage->nextpageid += num;
-            close(fd);
+            key_type *buf;
+            if (posix_memalign((void **) &buf, 4096, fixed_buf_size * num) != 0)
+                throw std::bad_alloc();
+            for (int k = 0; k < num; k++) {
+                memcpy(buf + k * diskpage->pagesize, &inmempages[k]->inmemdata[0], fixed_buf_size);
+            }
+            diskpage->asyncwritepages(buf, num);
 
             for (int mi = 0;mi < inmempages.size();mi++){
                 delete inmempages[mi];
@@ -597,6 +580,128 @@ namespace filmstorage {
         }
     };
 
+    // writes the batches of evicted pages in the background, in the order they
+    // are queued, so that the eviction does not wait for the disk. a batch
+    // stays in the queue until it is on disk, and the reads of its pages wait
+    // for it. if a write fails, the writer stops with the batch still queued
+    // and the later pushes and waits for its pages throw.
+    class pagewriter{
+    public:
+        pagewriter(const std::string &fn, unsigned long sizepage) : pagebytes(sizepage) {
+            fd = open(fn.c_str(), O_RDWR | O_DIRECT, 0755);
+            if (fd == -1)
+                throw std::runtime_error("open file error in pagewriter: " + fn);
+            worker = std::thread([this] { run(); });
+        }
+
+        ~pagewriter() {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                stop = true;
+            }
+            queuecv.notify_all();
+            worker.join();
+            // the batches left by a failed write
+            for (auto &j : jobs)
+                free(j.buf);
+            close(fd);
+        }
+
+        // buf is allocated by posix_memalign and freed once it is written
+        void push(pageid_type firstpage, void *buf, unsigned int num) {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                checkerror();
+                jobs.push_back({firstpage, num, buf});
+                pending.store(jobs.size(), std::memory_order_release);
+            }
+            queuecv.notify_all();
+        }
+
+        // wait until the pages [firstpage, firstpage + num) are on disk
+        void wait(pageid_type firstpage, unsigned int num) {
+            if (pending.load(std::memory_order_acquire) == 0)
+                return;
+            std::unique_lock<std::mutex> lock(mtx);
+            donecv.wait(lock, [&] {
+                if (error != 0)
+                    return true;
+                for (auto &j : jobs) {
+                    if (j.firstpage < firstpage + num && firstpage < j.firstpage + j.num)
+                        return false;
+                }
+                return true;
+            });
+            for (auto &j : jobs) {
+                if (j.firstpage < firstpage + num && firstpage < j.firstpage + j.num)
+                    checkerror();
+            }
+        }
+
+        uint64_t writtenpages() const { return written.load(std::memory_order_relaxed); }
+
+    private:
+        struct job {
+            pageid_type firstpage;
+            unsigned int num;
+            void *buf;
+        };
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mtx);
+            while (true) {
+                queuecv.wait(lock, [&] { return stop || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job j = jobs.front();
+                lock.unlock();
+                unsigned long bytes = pagebytes * j.num;
+                unsigned long done = 0;
+                int err = 0;
+                while (done < bytes) {
+                    ssize_t ret = pwrite(fd, (char *) j.buf + done, bytes - done, pagebytes * j.firstpage + done);
+                    if (ret < 0 && (errno == EINTR || errno == EAGAIN))
+                        continue;
+                    if (ret <= 0) {
+                        err = ret < 0 ? errno : EIO;
+                        break;
+                    }
+                    done += ret;
+                }
+                lock.lock();
+                if (err != 0) {
+                    // keep the batch, its pages are not on disk
+                    error = err;
+                    donecv.notify_all();
+                    return;
+                }
+                free(j.buf);
+                written.fetch_add(j.num, std::memory_order_relaxed);
+                jobs.pop_front();
+                pending.store(jobs.size(), std::memory_order_release);
+                donecv.notify_all();
+            }
+        }
+
+        // called with mtx held
+        void checkerror() const {
+            if (error != 0)
+                throw std::runtime_error(std::string("write error in pagewriter: ") + strerror(error));
+        }
+
+        unsigned long pagebytes;
+        int fd;
+        int error = 0;  // the errno of the failed write, 0: none
+        std::deque<job> jobs;
+        std::atomic<size_t> pending{0};
+        std::atomic<uint64_t> written{0};
+        bool stop = false;
+        std::mutex mtx;
+        std::condition_variable queuecv;
+        std::condition_variable donecv;
+        std::thread worker;
+    };
+
     typedef std::map<std::string,double> infomap;
     template <class key_type>
     class filmdisk{
@@ -609,6 +714,7 @@ namespace filmstorage {
         int recordsize;
         int blocknum;
         unsigned long initwtime;
+        std::shared_ptr<pagewriter> writer;  // created by the first asynchronous write
         filmdisk()=default;
 
         filmdisk(std::string fn, int sizepage,int numrecord,int sizerecord) {
@@ -631,10 +737,28 @@ namespace filmstorage {
             nextpageid = other.nextpageid;
             initwtime = other.initwtime;
             recordsize = other.recordsize;
+            // the background writer belongs to the file of other
+            writer.reset();
             return *this;
         }
 
+        // write num pages from buf to the end of the file in the background,
+        // buf is allocated by posix_memalign and freed by the writer
+        void asyncwritepages(key_type *buf, unsigned int num) {
+            if (!writer)
+                writer = std::make_shared<pagewriter>(filename, pagesize * sizeof(key_type));
+            writer->push(nextpageid, buf, num);
+            nextpageid += num;
+        }
+
+        // wait until the pages [firstpage, firstpage + num) are on disk
+        void waitpages(pageid_type firstpage, unsigned int num = 1) {
+            if (writer)
+                writer->wait(firstpage, num);
+        }
+
         vector<key_type> readfromdisk(pair<pageid_type ,pageOff_type> diskpos ,int sizerecord){   // use the buffer of memory
+            waitpages(diskpos.first);
             FILE *fdisk;// 读取磁盘文件
             fdisk = fopen(filename.c_str(),"rb+");
             fseek(fdisk,static_cast<unsigned long>(diskpos.first*pagesize*8),SEEK_SET);
@@ -676,6 +800,7 @@ namespace filmstorage {
             }
              */
             unsigned long seekdis = buf_size * diskpos.first;
+            waitpages(diskpos.first);
             ret = pread(fd, buf, buf_size,seekdis);
             if (ret <= 0){
                 cout << "Jesus, i need You!" << endl;
@@ -684,8 +809,7 @@ namespace filmstorage {
                 res.push_back(buf[diskpos.second+i]);
             }
 //            cout<<"Jesus, You are my refuge! "<<endl;
-//            free(buf);
-            delete[] buf;
+            free(buf);
             close(fd);
             return res;
         }
@@ -702,6 +826,7 @@ namespace filmstorage {
 
             fd = open(filename.c_str(), O_RDWR | O_DIRECT , 0755);
             uint64_t aoff = diskpos->first*buf_size;
+            waitpages(diskpos->first);
             ret = pread(fd, buf, buf_size,aoff);
             if (ret <= 0){
                 cout << "Jesus, i need You!" << endl;
@@ -714,7 +839,7 @@ namespace filmstorage {
             }
 //            cout<<"Jesus, You are my refuge! "<<endl;
 
-            delete[] buf;
+            free(buf);
             close(fd);
             return res;
         }
@@ -754,7 +879,7 @@ namespace filmstorage {
         {
 
             int fd;
-            key_type *buf = new key_type[pagesize];
+            key_type *buf;
 
             unsigned long int buf_size = pagesize*sizeof(key_type);
             int ret = posix_memalign((void **)&buf, 512, buf_size);
@@ -779,8 +904,7 @@ namespace filmstorage {
 
 //            cout<<"Jesus, You are my refuge! odirect write "<<endl;
 
-//            free(buf);
-            delete[] buf;
+            free(buf);
             close(fd);
 
 //            cout<< "*********************** Jesus, finished one transfer*************************"<<endl;
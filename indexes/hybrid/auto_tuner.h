@@ -0,0 +1,321 @@
+#ifndef INDEXES_HYBRID_AUTO_TUNER_H_
+#define INDEXES_HYBRID_AUTO_TUNER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+#include "./hybrid_index.h"
+
+// the number of ops sampled from the workload to predict the I/Os
+#define TUNE_SAMPLE_OPS 100000
+// the number of records inserted to measure the dynamic index
+#define TUNE_SAMPLE_RECORDS 100000
+// the number of records each candidate static index is built over
+#define TUNE_SAMPLE_DATA (1 << 20)
+// the number of slices of the data the sample is made of
+#define TUNE_SAMPLE_SLICES 16
+// the buffer pool may take i / TUNE_BUFFER_STEPS of the memory budget
+#define TUNE_BUFFER_STEPS 10
+// the fraction of the memory budget that is always left to the dynamic index
+#define TUNE_MIN_DYNAMIC_RATIO 0.05
+// the suffix of the data file of a candidate static index
+#define TUNE_FILE_SUFFIX ".tune"
+
+// Split the memory budget of a HybridIndex between the static model, the
+// buffer pool and the dynamic index for a given workload. Every candidate
+// error bound of the static model (StaticType::GetTuningParams) is built on
+// disk over a sample of the data, a few slices that start at partition
+// boundaries around the sampled lookups, and the sampled lookups and scans
+// that fall into the slices are run against it. The model size is scaled up
+// from the sample, and the pages it actually fetches are traced. For every
+// buffer pool size, the traced pages are replayed on a CLOCK cache to count
+// the misses, and the merges are charged to the inserts according to the
+// remaining dynamic budget. The configuration with the fewest predicted I/Os
+// per op is chosen.
+template <typename K, typename V, typename DynamicType, typename StaticType>
+class HybridTuner {
+ public:
+  typedef HybridIndex<K, V, DynamicType, StaticType> Index_;
+  typedef typename Index_::param_t param_t;
+  typedef typename BaseIndex<K, V>::DataVec_ DataVec_;
+
+  HybridTuner(DataVec_& data, const std::vector<int>& ops,
+              const std::vector<K>& ops_key, const std::vector<int>& len)
+      : data_(data), ops_(ops), ops_key_(ops_key), len_(len) {}
+
+  // return params with the chosen static model and buffer pool ratio
+  param_t Tune(param_t params) {
+    const size_t budget = params.memory_budget_;
+    const uint64_t page_bytes = params.s_params_.disk_params.page_bytes;
+    const uint64_t record_per_page = page_bytes / sizeof(std::pair<K, V>);
+    const uint64_t data_pages =
+        std::ceil(data_.size() * 1.0 / record_per_page);
+    const uint64_t partition_pages =
+        params.s_params_.disk_params.partition_pages;
+    const double partition_num =
+        partition_pages ? std::ceil(data_pages * 1.0 / partition_pages) : 1;
+
+    // sample the ops evenly so that the op mix and the locality are kept
+    size_t step = std::max<size_t>(1, ops_.size() / TUNE_SAMPLE_OPS);
+    std::vector<size_t> lookups;
+    uint64_t sample_num = 0, update_num = 0, insert_num = 0;
+    for (size_t i = 0; i < ops_.size(); i += step) {
+      sample_num++;
+      if (ops_[i] == INSERT) {
+        insert_num++;
+        continue;
+      }
+      update_num += ops_[i] == UPDATE;
+      lookups.push_back(i);
+    }
+    if (sample_num == 0 || data_.empty()) {
+      return params;
+    }
+    DataVec_ sample;
+    std::vector<size_t> sample_lookups;
+    SampleData(lookups, partition_pages * record_per_page, sample,
+               sample_lookups);
+    const double data_scale = data_.size() * 1.0 / sample.size();
+    // the share of the lookups of the whole workload that are replayed
+    const double lookup_rate = sample_num * 1.0 / ops_.size() *
+                               sample_lookups.size() /
+                               std::max<size_t>(1, lookups.size());
+    double record_bytes = GetDynamicRecordBytes(params.d_params_);
+
+#ifdef PRINT_PROCESSING_INFO
+    std::cout << "auto-tune over " << sample_num << " ops (" << lookups.size()
+              << " lookups, " << insert_num << " inserts), "
+              << sample_lookups.size() << " lookups into " << sample.size()
+              << " sampled records, dynamic bytes per record:" << record_bytes
+              << std::endl;
+#endif
+    double best_cost = std::numeric_limits<double>::max();
+    size_t best_model_size = 0;
+    param_t best = params;
+    for (auto& s_params : StaticType::GetTuningParams(params.s_params_)) {
+      std::vector<uint64_t> pages;
+      size_t model_size =
+          MeasureSample(s_params, sample, sample_lookups, pages) * data_scale;
+      if (model_size >= budget) {
+        continue;
+      }
+      // the sampled lookups stand for all the lookups of the sampled ops
+      const double page_scale =
+          sample_lookups.empty()
+              ? 0
+              : lookups.size() * 1.0 / sample_lookups.size();
+
+      for (int s = 0; s < TUNE_BUFFER_STEPS; s++) {
+        double ratio = s * 1.0 / TUNE_BUFFER_STEPS;
+        size_t pool_bytes = budget * ratio;
+        size_t pool_size =
+            ratio > 0 ? BufferPool::EstimateNodeSize(pool_bytes, page_bytes)
+                      : 0;
+        if (model_size + pool_size + budget * TUNE_MIN_DYNAMIC_RATIO >=
+            budget) {
+          break;
+        }
+        // the replayed lookups reuse the pages lookup_rate times as often,
+        // so the cache is scaled down accordingly
+        uint64_t miss_num =
+            SimulateClock(pages, pool_bytes / page_bytes * lookup_rate);
+
+        // each merge reads and writes the partitions receiving new records
+        double merge_records =
+            std::max(1.0, (budget - model_size - pool_size) / record_bytes);
+        double touched =
+            1 - std::pow(1 - 1.0 / partition_num, merge_records);
+        double merge_io = 2.0 * data_pages * touched / merge_records;
+
+        double cost = (miss_num * page_scale + update_num +
+                       insert_num * merge_io) /
+                      sample_num;
+#ifdef PRINT_PROCESSING_INFO
+        std::cout << "\tmodel:" << PRINT_MIB(model_size)
+                  << " MiB,\tavg fetch pages:"
+                  << pages.size() * 1.0 /
+                         std::max<size_t>(1, sample_lookups.size())
+                  << ",\tbuffer ratio:" << ratio
+                  << ",\tmiss pages:" << miss_num
+                  << ",\tmerge I/O per insert:" << merge_io
+                  << ",\tI/O per op:" << cost << std::endl;
+#endif
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_model_size = model_size;
+          best.s_params_ = s_params;
+          best.buffer_pool_ratio_ = ratio;
+        }
+      }
+    }
+    if (best_cost == std::numeric_limits<double>::max()) {
+      throw std::runtime_error("Need more memory budget!");
+    }
+    std::cout << "auto-tune: static model:" << PRINT_MIB(best_model_size)
+              << " MiB,\tbuffer ratio:" << best.buffer_pool_ratio_
+              << ",\tpredicted I/O per op:" << best_cost << std::endl;
+    return best;
+  }
+
+ private:
+  // Copy up to TUNE_SAMPLE_DATA records of data_ into sample, in
+  // TUNE_SAMPLE_SLICES slices around the quantiles of the looked up keys, or
+  // spread evenly without lookups. The slices start at partition boundaries
+  // so that the sample is cut into the same partitions as the data. The
+  // sampled lookups whose keys fall into a slice are kept in sample_lookups.
+  void SampleData(const std::vector<size_t>& lookups,
+                  uint64_t partition_records, DataVec_& sample,
+                  std::vector<size_t>& sample_lookups) const {
+    const size_t n = data_.size();
+    const size_t unit = std::max<uint64_t>(1, partition_records);
+    size_t slice =
+        (TUNE_SAMPLE_DATA / TUNE_SAMPLE_SLICES + unit - 1) / unit * unit;
+    std::vector<std::pair<size_t, size_t>> slices;  // [begin, end)
+    if (slice * TUNE_SAMPLE_SLICES >= n) {
+      slices.push_back({0, n});
+    } else {
+      std::vector<size_t> pos;
+      for (auto i : lookups) {
+        pos.push_back(LowerBoundPos(ops_key_[i]));
+      }
+      std::sort(pos.begin(), pos.end());
+      size_t end = 0;
+      for (size_t j = 0; j < TUNE_SAMPLE_SLICES; j++) {
+        size_t center = pos.empty()
+                            ? (2 * j + 1) * n / (2 * TUNE_SAMPLE_SLICES)
+                            : pos[(2 * j + 1) * pos.size() /
+                                  (2 * TUNE_SAMPLE_SLICES)];
+        size_t begin = center > slice / 2 ? center - slice / 2 : 0;
+        begin = std::max(begin / unit * unit, end);
+        if (begin >= n) {
+          break;
+        }
+        end = std::min(begin + slice, n);
+        if (!slices.empty() && slices.back().second == begin) {
+          slices.back().second = end;
+        } else {
+          slices.push_back({begin, end});
+        }
+      }
+    }
+    for (auto& range : slices) {
+      sample.insert(sample.end(), data_.begin() + range.first,
+                    data_.begin() + range.second);
+    }
+    for (auto i : lookups) {
+      size_t pos = LowerBoundPos(ops_key_[i]);
+      for (auto& range : slices) {
+        if (pos >= range.first && pos < range.second) {
+          sample_lookups.push_back(i);
+          break;
+        }
+      }
+    }
+  }
+
+  // Build the candidate static index over sample in a scratch file, run the
+  // lookups and scans against it and return its model size. The keys of the
+  // pages it fetches from disk are appended to pages, in order.
+  size_t MeasureSample(typename StaticType::param_t s_params,
+                       DataVec_& sample, const std::vector<size_t>& lookups,
+                       std::vector<uint64_t>& pages) {
+    s_params.disk_params.filename += TUNE_FILE_SUFFIX;
+    s_params.disk_params.persist = false;
+    // a pool without frames reads every page from disk and traces it
+    BufferPool tracer(0, s_params.disk_params.page_bytes);
+    StaticType index(s_params);
+    index.Build(sample);
+    index.SetBufferPool(&tracer);
+    tracer.TraceReads(&pages);
+    typename StaticType::DataVec_ out;
+    for (auto i : lookups) {
+      if (ops_[i] == SCAN && !len_.empty()) {
+        out.clear();
+        index.Scan(ops_key_[i], len_[i], out);
+      } else {
+        index.Find(ops_key_[i]);
+      }
+    }
+    tracer.TraceReads(nullptr);
+    size_t model_size = index.GetNodeSize();
+    index.DeleteFile();
+    return model_size;
+  }
+
+  size_t LowerBoundPos(const K& key) const {
+    auto it = std::lower_bound(
+        data_.begin(), data_.end(), key,
+        [](const auto& lhs, const K& key) { return lhs.first < key; });
+    return std::min<size_t>(it - data_.begin(), data_.size() - 1);
+  }
+
+  // the memory used by each record inserted into the dynamic index
+  double GetDynamicRecordBytes(typename DynamicType::param_t d_params) const {
+    size_t num = std::min<size_t>(TUNE_SAMPLE_RECORDS, data_.size());
+    if (num == 0) {
+      return sizeof(std::pair<K, V>);
+    }
+    size_t step = data_.size() / num;
+    DataVec_ init_data, insert_data;
+    for (size_t i = 0; i < num; i++) {
+      if (i % (num / INIT_SIZE + 1) == 0) {
+        init_data.push_back(data_[i * step]);
+      } else {
+        insert_data.push_back(data_[i * step]);
+      }
+    }
+    DynamicType dynamic_index(d_params);
+    dynamic_index.Build(init_data);
+    size_t init_size = dynamic_index.GetTotalSize();
+    for (auto& record : insert_data) {
+      dynamic_index.Insert(record.first, record.second);
+    }
+    return std::max<double>(
+        sizeof(std::pair<K, V>),
+        (dynamic_index.GetTotalSize() * 1.0 - init_size) /
+            std::max<size_t>(1, insert_data.size()));
+  }
+
+  // the page misses of a CLOCK cache of frame_num pages
+  static uint64_t SimulateClock(const std::vector<uint64_t>& pages,
+                                size_t frame_num) {
+    if (frame_num == 0) {
+      return pages.size();
+    }
+    std::vector<uint64_t> frame_pid(frame_num);
+    std::vector<bool> frame_ref(frame_num, false);
+    std::unordered_map<uint64_t, size_t> page_map;
+    size_t hand = 0, used = 0;
+    uint64_t miss_num = 0;
+    for (auto pid : pages) {
+      auto it = page_map.find(pid);
+      if (it != page_map.end()) {
+        frame_ref[it->second] = true;
+        continue;
+      }
+      miss_num++;
+      if (used < frame_num) {
+        hand = used++;
+      } else {
+        while (frame_ref[hand]) {
+          frame_ref[hand] = false;
+          hand = (hand + 1) % frame_num;
+        }
+        page_map.erase(frame_pid[hand]);
+      }
+      frame_pid[hand] = pid;
+      page_map[pid] = hand;
+      hand = (hand + 1) % frame_num;
+    }
+    return miss_num;
+  }
+
+  DataVec_& data_;
+  const std::vector<int>& ops_;
+  const std::vector<K>& ops_key_;
+  const std::vector<int>& len_;
+};
+
+#endif  // !INDEXES_HYBRID_AUTO_TUNER_H_
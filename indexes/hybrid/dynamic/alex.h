@@ -54,6 +54,14 @@ class AlexIndex : public DynamicIndex<K, V> {
     return sum;
   }
 
+  // append the first range records from key on to out
+  void Scan(const K key, const int range, DataVev_& out) const {
+    auto it = alex_.lower_bound(key);
+    for (int i = 0; i < range && it != alex_.cend(); i++, it++) {
+      out.push_back({it.key(), it.payload()});
+    }
+  }
+
   bool Insert(const K key, const V value) {
     auto it = alex_.find(key);
     if (it != alex_.end()) {
@@ -62,6 +62,14 @@ class BTreeIndex : public DynamicIndex<K, V> {
     return sum;
   }
 
+  // append the first range records from key on to out
+  void Scan(const K key, const int range, DataVev_& out) const {
+    auto it = btree_.lower_bound(key);
+    for (int i = 0; i < range && it != btree_.end(); i++, it++) {
+      out.push_back({it.key(), it.data()});
+    }
+  }
+
   bool Insert(const K key, const V value) {
     auto it = btree_.find(key);
     if (it != btree_.end()) {
@@ -21,6 +21,7 @@ class DynamicIndex {
 
   virtual V Find(const K key) const = 0;
   virtual V Scan(const K key, const int range) const = 0;
+  virtual void Scan(const K key, const int range, DataVev_& out) const = 0;
 
   virtual bool Insert(const K key, const V value) = 0;
   // virtual bool Update(const K key, const V value) = 0;
@@ -55,6 +55,14 @@ class DynamicPGMIndex : public DynamicIndex<K, V> {
     return sum;
   }
 
+  // append the first range records from key on to out
+  void Scan(const K key, const int range, DataVev_& out) const {
+    auto it = pgm_.lower_bound(key);
+    for (int i = 0; i < range && it != pgm_.end(); i++, ++it) {
+      out.push_back({it->first, it->second});
+    }
+  }
+
   bool Insert(const K key, const V value) {
     pgm_.insert_or_assign(key, value);
     return true;
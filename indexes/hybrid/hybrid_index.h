@@ -3,7 +3,12 @@
 
 #include <assert.h>
 
+#include <atomic>
+#include <thread>
+
+#include "../../ycsb_utils/buffer_pool.h"
 #include "../base_index.h"
+#include "../tombstone.h"
 
 #define INIT_SIZE 100
 
@@ -14,11 +19,18 @@ class HybridIndex : public BaseIndex<K, V> {
     typename DynamicType::param_t d_params_;
     typename StaticType::param_t s_params_;
     size_t memory_budget_;
+    // build the merged static index in a background thread instead of
+    // blocking the insert that triggers the merge
+    bool background_merge_ = false;
+    // the fraction of memory_budget_ used to cache the pages of the static
+    // index, 0: no buffer pool
+    double buffer_pool_ratio_ = 0;
   };
 
   HybridIndex(param_t params)
-      : dynamic_index_(params.d_params_),
-        static_index_(params.s_params_),
+      : index_params_(params),
+        dynamic_index_(params.d_params_),
+        static_index_(new StaticType(params.s_params_)),
         merge_cnt_(0),
         mem_find_cnt_(0),
         disk_find_cnt_(0),
@@ -30,49 +42,87 @@ class HybridIndex : public BaseIndex<K, V> {
         max_memory_usage_(0),
         max_buffer_size_(0),
         memory_budget_(params.memory_budget_),
-        dynamic_budget_(0) {}
+        dynamic_budget_(0),
+        background_merge_(params.background_merge_) {}
+
+  ~HybridIndex() {
+    if (merge_thread_.joinable()) {
+      merge_thread_.join();
+    }
+    if (merging_static_index_ != NULL) {
+      merging_static_index_->DeleteFile();
+      delete merging_static_index_;
+    }
+    delete static_index_;
+    delete buffer_pool_;
+    free(merge_buf_);
+  }
 
   typedef typename BaseIndex<K, V>::DataVec_ BaseVec;
   void Build(BaseVec& data) {
-    // collect some data for learned indexes to train models
+    // collect some data for learned indexes to train models, every seg-th
+    // record goes to the dynamic index until it has init_size records
     size_t init_size = INIT_SIZE;
-    BaseVec dynamic_data(init_size);
-    BaseVec static_data(data.size());
-    assert(static_data.size() > init_size);
-    uint64_t seg = static_data.size() / init_size;
-    uint64_t dynamic_cnt = 0, static_cnt = 0, total_cnt = 0;
-
-    auto it = data.begin();
-    while (it != data.end()) {
-      if (total_cnt % seg == 0 && dynamic_cnt < init_size) {
-        dynamic_data[dynamic_cnt++] = {it->first, it->second};
-      } else {
-        static_data[static_cnt++] = {it->first, it->second};
+    assert(data.size() > init_size);
+    uint64_t seg = data.size() / init_size;
+    auto is_dynamic = [&](size_t i) {
+      return i % seg == 0 && i / seg < init_size;
+    };
+    BaseVec dynamic_data;
+    dynamic_data.reserve(init_size);
+    for (size_t i = 0; i < data.size(); i += seg) {
+      if (is_dynamic(i)) {
+        dynamic_data.push_back(data[i]);
       }
-      it++;
-      total_cnt++;
     }
-    dynamic_data.resize(dynamic_cnt);
-    static_data.resize(static_cnt);
 #ifdef PRINT_PROCESSING_INFO
-    std::cout << "#init_records in dynamic_index_:" << dynamic_data.size()
+    size_t dynamic_cnt = dynamic_data.size();
+    std::cout << "#init_records in dynamic_index_:" << dynamic_cnt
               << std::endl;
-    std::cout << "#init_records in static_index_:" << static_data.size()
+    std::cout << "#init_records in static_index_:" << data.size() - dynamic_cnt
               << std::endl;
 #endif
 
+    // restart from the stored models instead of rebuilding the static index.
+    // The stored records may be newer than data, so the dynamic index starts
+    // empty instead of shadowing them with the sample.
+    if (static_index_->LoadModel()) {
+      BaseVec().swap(dynamic_data);
+    } else {
+      // stream the remaining records into the static index without copying.
+      // A persisted static index also keeps the sample, so that it holds all
+      // the records after a restart.
+      bool persist = index_params_.s_params_.disk_params.persist;
+      size_t pos = 0;
+      static_index_->BuildStream([&](auto& r) {
+        while (pos < data.size() && !persist && is_dynamic(pos)) {
+          pos++;
+        }
+        if (pos == data.size()) {
+          return false;
+        }
+        r = data[pos++];
+        return true;
+      });
+    }
     dynamic_index_.Build(dynamic_data);
-    static_index_.Build(static_data);
+    if (index_params_.buffer_pool_ratio_ > 0) {
+      buffer_pool_ = new BufferPool(
+          memory_budget_ * index_params_.buffer_pool_ratio_,
+          index_params_.s_params_.disk_params.page_bytes);
+      static_index_->SetBufferPool(buffer_pool_);
+    }
 
     // get the remaining memory budget for the dynamic index
-    size_t static_memory = static_index_.GetNodeSize();
+    size_t static_memory = static_index_->GetNodeSize();
     std::cout << "memory_budget:" << PRINT_MIB(memory_budget_)
-              << " MiB,\tstatic_memory:" << PRINT_MIB(static_memory) << " MiB"
-              << std::endl;
-    if (memory_budget_ <= static_memory) {
+              << " MiB,\tstatic_memory:" << PRINT_MIB(static_memory)
+              << " MiB,\tbuffer_pool:" << PRINT_MIB(GetBufferPoolSize())
+              << " MiB" << std::endl;
+    if (memory_budget_ <= static_memory + GetBufferPoolSize()) {
       throw std::runtime_error("Need more memory budget!");
     }
-    dynamic_budget_ = memory_budget_ - static_memory;
+    dynamic_budget_ = memory_budget_ - static_memory - GetBufferPoolSize();
     std::cout << "\tdynamic_budget_:" << PRINT_MIB(dynamic_budget_)
               << std::endl;
 
@@ -80,7 +130,7 @@ class HybridIndex : public BaseIndex<K, V> {
     max_dynamic_usage_ = dynamic_index_.GetTotalSize();
     max_dynamic_index_usage_ = dynamic_index_.GetNodeSize();
 #ifdef CHECK_CORRECTION
-    for (int i = 0; i < dynamic_cnt; i++) {
+    for (size_t i = 0; i < dynamic_data.size(); i++) {
       auto res = dynamic_index_.Find(dynamic_data[i].first);
       if (dynamic_data[i].second != res) {
         std::cout << "find dynamic " << i << ",\tk:" << dynamic_data[i].first
@@ -93,43 +143,85 @@ class HybridIndex : public BaseIndex<K, V> {
   }
 
   V Find(const K key) {
+    TryFinishMerge();
     // lookup in the dynamic index
     V res = dynamic_index_.Find(key);
     mem_find_cnt_++;
+    if (res == std::numeric_limits<V>::max()) {
+      // lookup in the frozen records that are being merged
+      res = FindFrozen(key);
+    }
     if (res == std::numeric_limits<V>::max()) {
       // lookup in the static index
-      res = static_index_.Find(key);
+      res = static_index_->Find(key);
       disk_find_cnt_++;
     }
+    if (res == GetTombstone<V>()) {
+      return std::numeric_limits<V>::max();
+    }
     return res;
   }
 
+  // The keys found in memory are answered directly, the others are looked up
+  // in the static index as a single batch.
+  void FindBatch(const std::vector<K>& keys, std::vector<V>& vals) {
+    TryFinishMerge();
+    vals.resize(keys.size());
+    std::vector<K> disk_keys;
+    std::vector<size_t> disk_idx;
+    for (size_t i = 0; i < keys.size(); i++) {
+      vals[i] = dynamic_index_.Find(keys[i]);
+      if (vals[i] == std::numeric_limits<V>::max()) {
+        vals[i] = FindFrozen(keys[i]);
+      }
+      if (vals[i] == std::numeric_limits<V>::max()) {
+        disk_keys.push_back(keys[i]);
+        disk_idx.push_back(i);
+      } else if (vals[i] == GetTombstone<V>()) {
+        vals[i] = std::numeric_limits<V>::max();
+      }
+    }
+    mem_find_cnt_ += keys.size();
+    if (disk_keys.empty()) {
+      return;
+    }
+    std::vector<V> disk_vals;
+    static_index_->FindBatch(disk_keys, disk_vals);
+    for (size_t i = 0; i < disk_idx.size(); i++) {
+      vals[disk_idx[i]] = disk_vals[i] == GetTombstone<V>()
+                              ? std::numeric_limits<V>::max()
+                              : disk_vals[i];
+    }
+    disk_find_cnt_ += disk_keys.size();
+  }
+
+  // Merge the first range live records from key of the dynamic index, the
+  // frozen records and the static index. Each part is asked for range
+  // records at first; if the tombstones hide too many of them, the parts are
+  // read again for twice as many.
   V Scan(const K key, const int range) {
-    V res = dynamic_index_.Scan(key, range);
-    mem_find_cnt_++;
-    disk_find_cnt_++;
-    if (res == std::numeric_limits<V>::max()) {
-      res = static_index_.Scan(key, range);
-    } else {
-      res += static_index_.Scan(key, range);
+    TryFinishMerge();
+    V res = 0;
+    BaseVec parts[3];
+    for (size_t fetch_num = range;; fetch_num *= 2) {
+      for (auto& part : parts) {
+        part.clear();
+      }
+      dynamic_index_.Scan(key, fetch_num, parts[0]);
+      ScanFrozen(key, fetch_num, parts[1]);
+      static_index_->Scan(key, fetch_num, parts[2]);
+      mem_find_cnt_++;
+      disk_find_cnt_++;
+      if (MergeScanParts(parts, 3, range, fetch_num, res)) {
+        return res;
+      }
     }
-    return res;
   }
 
   bool Insert(const K key, const V value) {
+    TryFinishMerge();
     mem_insert_cnt_++;
-    if (dynamic_index_.GetTotalSize() > dynamic_budget_) {
-#ifdef PRINT_PROCESSING_INFO
-      auto static_size = static_index_.size();
-      std::cout << "need to merge! dynamic_size:"
-                << dynamic_index_.GetTotalSize()
-                << ",\tstatic_size:" << static_size
-                << ",\tmax_buffer_size_:" << max_buffer_size_ << std::endl;
-#endif
-      merge_cnt_++;
-      Merge();
-      dynamic_budget_ = memory_budget_ - static_index_.GetNodeSize();
-    }
+    MergeIfFull();
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
@@ -152,6 +244,12 @@ class HybridIndex : public BaseIndex<K, V> {
   }
 
   bool Update(const K key, const V value) {
+    TryFinishMerge();
+    if (delete_cnt_ > 0 && (dynamic_index_.Find(key) == GetTombstone<V>() ||
+                            FindFrozen(key) == GetTombstone<V>())) {
+      // a deleted key is not brought back by an update
+      return false;
+    }
     // update in the dynamic index
     bool success = dynamic_index_.Update(key, value);
     if (success) {
@@ -164,38 +262,59 @@ class HybridIndex : public BaseIndex<K, V> {
         dynamic_index_.Find(key);
       }
 #endif
+    } else if (merge_thread_.joinable() || static_index_->IsCompressed()) {
+      // the static file is being rewritten in the background, or its blocks
+      // cannot be rewritten in place, so the new value is buffered in the
+      // dynamic index, which shadows older versions. A tombstone left in the
+      // static file by DropTombstones is a missing key as well.
+      V stored = FindFrozen(key);
+      if (stored == std::numeric_limits<V>::max()) {
+        stored = static_index_->Find(key);
+      }
+      if (stored != std::numeric_limits<V>::max() &&
+          stored != GetTombstone<V>()) {
+        success = dynamic_index_.Insert(key, value);
+        mem_update_cnt_++;
+      }
     } else {
-      // update in the static index
-      success = static_index_.Update(key, value);
+      // update in the static index, which skips a stored tombstone
+      success = static_index_->Update(key, value);
       disk_update_cnt_++;
 #ifdef CHECK_CORRECTION
-      V new_val = static_index_.Find(key);
+      V new_val = static_index_->Find(key);
       if (new_val != value) {
         std::cout << "static update wrong! key:" << key << ",\tval:" << value
                   << ",\tnew_val:" << new_val << std::endl;
-        static_index_.Find(key);
+        static_index_->Find(key);
       }
 #endif
     }
     return success;
   }
 
+  // The tombstone is inserted like a record, so it is charged against the
+  // memory budget and the merge drops it together with the deleted record.
   bool Delete(const K key) {
-    dynamic_index_.Delete(key);
-    // static_index_.Delete(key);
-    return true;
+    TryFinishMerge();
+    delete_cnt_++;
+    MergeIfFull();
+    return dynamic_index_.Insert(key, GetTombstone<V>());
   }
 
   size_t GetCurrMemoryUsage() const {
-    return dynamic_index_.GetTotalSize() + static_index_.GetNodeSize();
+    return dynamic_index_.GetTotalSize() + static_index_->GetNodeSize() +
+           frozen_data_.size() * sizeof(std::pair<K, V>) + merge_buf_bytes_ +
+           merging_memory_ + GetBufferPoolSize();
   }
   size_t GetNodeSize() const {
-    // return dynamic_index_.GetTotalSize() + static_index_.GetNodeSize();
+    // return dynamic_index_.GetTotalSize() + static_index_->GetNodeSize();
     return max_memory_usage_;
   }
   size_t GetTotalSize() const {
-    return dynamic_index_.GetTotalSize() + static_index_.GetTotalSize();
+    return dynamic_index_.GetTotalSize() + static_index_->GetTotalSize();
   }
+  // every merge is triggered by the insert or delete exceeding the budget
+  inline size_t GetMergeInsertCnt() const { return merge_cnt_; }
   void PrintEachPartSize() {
     max_memory_usage_ = std::max(max_memory_usage_, GetCurrMemoryUsage());
     max_dynamic_usage_ =
@@ -206,12 +325,21 @@ class HybridIndex : public BaseIndex<K, V> {
     std::cout << "-------------dynamic info-------------" << std::endl;
     dynamic_index_.PrintEachPartSize();
     std::cout << "-------------static info---------------" << std::endl;
-    static_index_.PrintEachPartSize();
+    static_index_->PrintEachPartSize();
+    if (buffer_pool_ != NULL) {
+      buffer_pool_->PrintBufferPoolInfo();
+    }
     std::cout << "-------------processing info-------------" << std::endl;
     std::cout << "\t\tmerge cnt:" << merge_cnt_
               << ",\tin-memory find cnt:" << mem_find_cnt_
               << ",\ton-disk find cnt:" << disk_find_cnt_
-              << ",\tin-memory insert:" << mem_insert_cnt_ << std::endl;
+              << ",\tin-memory insert:" << mem_insert_cnt_
+              << ",\tdelete cnt:" << delete_cnt_ << std::endl;
+    if (background_merge_) {
+      std::cout << "\t\tbackground merge cnt:" << bg_merge_cnt_
+                << ",\tblocked merge cnt:" << bg_merge_wait_cnt_
+                << ",\tfrozen data num:" << frozen_data_.size() << std::endl;
+    }
     std::cout << "-------------memory usage---------------" << std::endl;
     std::cout << "\tmemory_budget:" << PRINT_MIB(memory_budget_)
               << " MiB,\tdynamic_budget:" << PRINT_MIB(dynamic_budget_)
@@ -225,7 +353,7 @@ class HybridIndex : public BaseIndex<K, V> {
               << " MiB,\tmax_dynamic_data_node_usage:"
               << PRINT_MIB(max_dynamic_usage_ - max_dynamic_index_usage_)
               << " MiB,\tmax_static_usage_:"
-              << PRINT_MIB(static_index_.GetNodeSize())
+              << PRINT_MIB(static_index_->GetNodeSize())
               << " MiB,\tmax_memory_usage_:" << PRINT_MIB(max_memory_usage_)
               << " MiB" << std::endl;
     std::cout << "-------------print over---------------" << std::endl;
@@ -249,7 +377,7 @@ class HybridIndex : public BaseIndex<K, V> {
     return dynamic_index_.GetIndexParams();
   }
   typename StaticType::param_t GetStaticParams() const {
-    return static_index_.GetIndexParams();
+    return static_index_->GetIndexParams();
   }
 
  private:
@@ -274,7 +402,7 @@ class HybridIndex : public BaseIndex<K, V> {
     start = std::chrono::high_resolution_clock::now();
 #endif
 
-    static_index_.Build(dynamic_data);
+    static_index_->Build(dynamic_data);
 #ifdef BREAKDOWN
     end = std::chrono::high_resolution_clock::now();
     static_merge_lat +=
@@ -283,11 +411,198 @@ class HybridIndex : public BaseIndex<K, V> {
 #endif
   }
 
+  // Freeze the records of the dynamic index and rebuild the static index from
+  // them in a background thread. Lookups consult the new dynamic index, the
+  // frozen records and the old static index until TryFinishMerge swaps in the
+  // new static index.
+  void BackgroundMerge() {
+    max_memory_usage_ = std::max(max_memory_usage_, GetCurrMemoryUsage());
+    max_dynamic_usage_ =
+        std::max(max_dynamic_usage_, dynamic_index_.GetTotalSize());
+    max_dynamic_index_usage_ =
+        std::max(max_dynamic_index_usage_, dynamic_index_.GetNodeSize());
+    max_buffer_size_ = std::max(max_buffer_size_, dynamic_index_.size());
+
+    frozen_data_.clear();
+    dynamic_index_.Merge(frozen_data_, INIT_SIZE);
+    // the old static records are read and the merged ones are written a
+    // chunk at a time through the buffer
+    uint64_t merged_num = static_index_->size() + frozen_data_.size();
+    auto page_bytes = index_params_.s_params_.disk_params.page_bytes;
+    merge_buf_pages_ = static_index_->GetBufferPages(merged_num);
+    merge_buf_bytes_ = page_bytes * merge_buf_pages_;
+    merge_buf_ =
+        reinterpret_cast<K*>(aligned_alloc(page_bytes, merge_buf_bytes_));
+
+    typename StaticType::param_t s_params = index_params_.s_params_;
+    // a restarted index may already use the next version as its data file
+    const std::string& filename = index_params_.s_params_.disk_params.filename;
+    do {
+      s_params.disk_params.filename =
+          filename + "_v" + std::to_string(++static_version_);
+    } while (s_params.disk_params.filename == static_index_->GetDataFile());
+    merging_static_index_ = new StaticType(s_params);
+    merging_static_index_->SetBuffer(merge_buf_, merge_buf_pages_);
+    merging_static_index_->SetBufferPool(buffer_pool_);
+    // charge what the merge holds: the models of the merged index, as large
+    // as the current ones scaled to the merged records, a chunk of the old
+    // static records as large as the buffer, and the records buffered by the
+    // merged index before they are written
+    merging_memory_ = static_index_->GetNodeSize() * merged_num /
+                          std::max<size_t>(1, static_index_->size()) +
+                      merge_buf_bytes_ +
+                      merging_static_index_->GetStreamBytes(merged_num);
+    // until the merged index is installed, the dynamic index only gets the
+    // memory left by the frozen records, the merge buffer and the merge
+    dynamic_budget_ = GetDynamicBudget();
+    merge_finished_.store(false);
+    bg_merge_cnt_++;
+    merge_thread_ = std::thread([this] {
+      RegisterIOBuffer(merge_buf_, merge_buf_bytes_);
+      // stream the old static records a chunk at a time, merged with the
+      // frozen ones, which shadow the static ones updated during the merge
+      BaseVec part;
+      part.reserve(merge_buf_bytes_ / sizeof(std::pair<K, V>));
+      size_t p = 0, i = 0, j = 0;
+      uint64_t pos = 0;
+      merging_static_index_->BuildStream([&](auto& r) {
+        while (i == part.size() && p < static_index_->GetPartitionNum()) {
+          pos = static_index_->ExportPartition(p, pos, merge_buf_pages_,
+                                               merge_buf_, part);
+          if (part.empty()) {
+            p++;
+            pos = 0;
+          }
+          i = 0;
+        }
+        bool has_static = i < part.size();
+        bool has_frozen = j < frozen_data_.size();
+        if (has_frozen &&
+            (!has_static || frozen_data_[j].first <= part[i].first)) {
+          if (has_static && part[i].first == frozen_data_[j].first) {
+            i++;
+          }
+          r = frozen_data_[j++];
+        } else if (has_static) {
+          r = part[i++];
+        } else {
+          return false;
+        }
+        return true;
+      });
+      merge_finished_.store(true, std::memory_order_release);
+    });
+  }
+
+  // merge the dynamic index into the static one once it exceeds its budget
+  inline void MergeIfFull() {
+    if (dynamic_index_.GetTotalSize() > dynamic_budget_ &&
+        merge_thread_.joinable()) {
+      // the previous merge has not finished, block until it is installed,
+      // which gives its memory back to the dynamic index
+      bg_merge_wait_cnt_++;
+      WaitForMerge();
+    }
+    if (dynamic_index_.GetTotalSize() > dynamic_budget_) {
+#ifdef PRINT_PROCESSING_INFO
+      auto static_size = static_index_->size();
+      std::cout << "need to merge! dynamic_size:"
+                << dynamic_index_.GetTotalSize()
+                << ",\tstatic_size:" << static_size
+                << ",\tmax_buffer_size_:" << max_buffer_size_ << std::endl;
+#endif
+      merge_cnt_++;
+      if (background_merge_) {
+        BackgroundMerge();
+      } else {
+        Merge();
+        dynamic_budget_ = GetDynamicBudget();
+      }
+    }
+  }
+
+  // install the static index built by the background thread if it is ready
+  inline void TryFinishMerge() {
+    if (merge_thread_.joinable() &&
+        merge_finished_.load(std::memory_order_acquire)) {
+      WaitForMerge();
+    }
+  }
+
+  void WaitForMerge() {
+    merge_thread_.join();
+    StaticType* old_static = static_index_;
+    merging_static_index_->SetBuffer(nullptr);
+    static_index_ = merging_static_index_;
+    merging_static_index_ = NULL;
+    if (index_params_.s_params_.disk_params.persist) {
+      // the model file under the configured name switches to the new data
+      // file for restarts, only then is the old data file removed
+      static_index_->SaveModelAs(index_params_.s_params_.disk_params.filename);
+      old_static->DeleteDataFile();
+    } else {
+      old_static->DeleteFile();
+    }
+    delete old_static;
+    BaseVec().swap(frozen_data_);
+    free(merge_buf_);
+    merge_buf_ = NULL;
+    merge_buf_pages_ = 0;
+    merge_buf_bytes_ = 0;
+    merging_memory_ = 0;
+    dynamic_budget_ = GetDynamicBudget();
+  }
+
+  inline V FindFrozen(const K key) const {
+    auto it = std::lower_bound(
+        frozen_data_.begin(), frozen_data_.end(), key,
+        [](const auto& lhs, const K& key) { return lhs.first < key; });
+    if (it == frozen_data_.end() || it->first != key) {
+      return std::numeric_limits<V>::max();
+    }
+    return it->second;
+  }
+
+  inline void ScanFrozen(const K key, const int range, BaseVec& out) const {
+    auto it = std::lower_bound(
+        frozen_data_.begin(), frozen_data_.end(), key,
+        [](const auto& lhs, const K& key) { return lhs.first < key; });
+    for (int i = 0; i < range && it != frozen_data_.end(); i++, it++) {
+      out.push_back(*it);
+    }
+  }
+
+  // the memory budget left for the dynamic index
+  inline size_t GetDynamicBudget() const {
+    size_t used = GetCurrMemoryUsage() - dynamic_index_.GetTotalSize();
+    return memory_budget_ > used ? memory_budget_ - used : 0;
+  }
+
+  inline size_t GetBufferPoolSize() const {
+    return buffer_pool_ == NULL ? 0 : buffer_pool_->GetNodeSize();
+  }
+
   std::string GetDynamicName() const { return dynamic_index_.GetIndexName(); }
-  std::string GetStaticName() const { return static_index_.GetIndexName(); }
+  std::string GetStaticName() const { return static_index_->GetIndexName(); }
 
+  param_t index_params_;
   DynamicType dynamic_index_;
-  StaticType static_index_;
+  StaticType* static_index_;
+  BufferPool* buffer_pool_ = NULL;
+
+  // background merge
+  StaticType* merging_static_index_ = NULL;
+  BaseVec frozen_data_;
+  std::thread merge_thread_;
+  std::atomic<bool> merge_finished_{false};
+  K* merge_buf_ = NULL;
+  uint64_t merge_buf_pages_ = 0;
+  size_t merge_buf_bytes_ = 0;
+  // the estimated models and records held by the merge besides the buffer
+  size_t merging_memory_ = 0;
+  uint64_t static_version_ = 0;
+  size_t bg_merge_cnt_ = 0;
+  size_t bg_merge_wait_cnt_ = 0;
 #ifdef BREAKDOWN
   double dynamic_merge_lat = 0.0;
   double static_merge_lat = 0.0;
@@ -300,6 +615,7 @@ class HybridIndex : public BaseIndex<K, V> {
   size_t mem_update_cnt_;
   size_t disk_update_cnt_;
   size_t mem_insert_cnt_;
+  size_t delete_cnt_ = 0;
 
   size_t max_dynamic_usage_;
   size_t max_dynamic_index_usage_;
@@ -308,6 +624,7 @@ class HybridIndex : public BaseIndex<K, V> {
 
   size_t memory_budget_;
   size_t dynamic_budget_;
+  bool background_merge_;
 };
 
 #endif  // !INDEXES_HYBRID_INDEX_H_
\ No newline at end of file
@@ -0,0 +1,180 @@
+#ifndef INDEXES_HYBRID_STATIC_COMPRESSED_BLOCK_H_
+#define INDEXES_HYBRID_STATIC_COMPRESSED_BLOCK_H_
+
+#include <snappy.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// A block of sorted records in a compressed data file:
+//   CompressedBlockHeader | key residuals | Snappy-compressed payloads
+// The keys are encoded as in LeCo: the line through the first and the last
+// key predicts each key from its position, and only the distances to the
+// line are bit-packed with a fixed width. A key is decoded on its own, so the
+// last-mile search only decodes the keys it probes. The payloads are
+// compressed together and only decompressed for a hit or a scan.
+struct CompressedBlockHeader {
+  uint64_t first_key;
+  double slope;
+  int64_t min_residual;
+  uint32_t payload_bytes;
+  uint16_t num;
+  uint8_t key_bits;
+  uint8_t unused;
+};
+
+// the residuals are read 16 bytes at a time
+#define COMPRESSED_BLOCK_PADDING 16
+
+template <typename K, typename V>
+class CompressedBlock {
+ public:
+  typedef std::pair<K, V> Record_;
+
+  // the block starting at data, which must be readable up to its end
+  explicit CompressedBlock(const char* data) {
+    memcpy(&header_, data, sizeof(header_));
+    residuals_ = reinterpret_cast<const uint8_t*>(data + sizeof(header_));
+    payloads_ = data + sizeof(header_) + GetResidualBytes(header_);
+  }
+
+  // append the encoded records [first, first + num) to out, return the bytes
+  // of the block
+  static size_t Encode(const Record_* first, size_t num,
+                       std::vector<char>& out) {
+    if (num == 0 || num > UINT16_MAX) {
+      throw std::runtime_error("invalid record number in CompressedBlock");
+    }
+    CompressedBlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.first_key = first[0].first;
+    header.num = num;
+    header.slope =
+        num > 1 ? static_cast<double>(first[num - 1].first - first[0].first) /
+                      (num - 1)
+                : 0;
+    std::vector<int64_t> residuals(num);
+    int64_t min_res = 0, max_res = 0;
+    for (size_t i = 0; i < num; i++) {
+      residuals[i] = static_cast<int64_t>(first[i].first - header.first_key) -
+                     Predict(header.slope, i);
+      min_res = i == 0 ? residuals[i] : std::min(min_res, residuals[i]);
+      max_res = i == 0 ? residuals[i] : std::max(max_res, residuals[i]);
+    }
+    header.min_residual = min_res;
+    uint64_t range = static_cast<uint64_t>(max_res - min_res);
+    header.key_bits = range == 0 ? 0 : 64 - __builtin_clzll(range);
+
+    std::vector<V> payloads(num);
+    for (size_t i = 0; i < num; i++) {
+      payloads[i] = first[i].second;
+    }
+    std::vector<char> compressed(snappy::MaxCompressedLength(num * sizeof(V)));
+    size_t payload_bytes = 0;
+    snappy::RawCompress(reinterpret_cast<const char*>(payloads.data()),
+                        num * sizeof(V), compressed.data(), &payload_bytes);
+    header.payload_bytes = payload_bytes;
+
+    size_t start = out.size();
+    size_t residual_bytes = GetResidualBytes(header);
+    out.resize(start + sizeof(header) + residual_bytes + payload_bytes, 0);
+    memcpy(&out[start], &header, sizeof(header));
+    uint8_t* bits = reinterpret_cast<uint8_t*>(&out[start + sizeof(header)]);
+    for (size_t i = 0; i < num && header.key_bits > 0; i++) {
+      WriteBits(bits, i * header.key_bits, header.key_bits,
+                static_cast<uint64_t>(residuals[i] - min_res));
+    }
+    memcpy(&out[start + sizeof(header) + residual_bytes], compressed.data(),
+           payload_bytes);
+    return out.size() - start;
+  }
+
+  // the largest block that Encode may produce for num records
+  static inline size_t GetMaxBytes(size_t num) {
+    return sizeof(CompressedBlockHeader) + num * sizeof(K) +
+           COMPRESSED_BLOCK_PADDING +
+           snappy::MaxCompressedLength(num * sizeof(V));
+  }
+
+  inline size_t size() const { return header_.num; }
+
+  inline K GetKey(size_t i) const {
+    uint64_t residual =
+        header_.key_bits == 0
+            ? 0
+            : ReadBits(residuals_, i * header_.key_bits, header_.key_bits);
+    return header_.first_key + Predict(header_.slope, i) +
+           header_.min_residual + residual;
+  }
+
+  // the position of the first key not less than key, size() if none
+  inline size_t LowerBound(const K key) const {
+    size_t s = 0, e = header_.num;
+    while (s < e) {
+      size_t mid = (s + e) >> 1;
+      if (GetKey(mid) < key) {
+        s = mid + 1;
+      } else {
+        e = mid;
+      }
+    }
+    return s;
+  }
+
+  inline void DecodePayloads(std::vector<V>& payloads) const {
+    payloads.resize(header_.num);
+    if (!snappy::RawUncompress(payloads_, header_.payload_bytes,
+                               reinterpret_cast<char*>(payloads.data()))) {
+      throw std::runtime_error("corrupted payloads in CompressedBlock");
+    }
+  }
+
+  // append the records from the pos-th one on to out, at most num of them
+  inline void Decode(size_t pos, size_t num, std::vector<Record_>& out) const {
+    std::vector<V> payloads;
+    DecodePayloads(payloads);
+    size_t end = std::min<size_t>(header_.num, pos + num);
+    for (size_t i = pos; i < end; i++) {
+      out.push_back({GetKey(i), payloads[i]});
+    }
+  }
+
+ private:
+  static inline int64_t Predict(double slope, size_t i) {
+    return static_cast<int64_t>(slope * i);
+  }
+
+  static inline size_t GetResidualBytes(const CompressedBlockHeader& header) {
+    return (static_cast<size_t>(header.num) * header.key_bits + 7) / 8 +
+           COMPRESSED_BLOCK_PADDING;
+  }
+
+  static inline void WriteBits(uint8_t* data, size_t pos, uint8_t bits,
+                               uint64_t value) {
+    for (uint8_t done = 0; done < bits;) {
+      uint8_t off = pos & 7;
+      uint8_t n = std::min<uint8_t>(8 - off, bits - done);
+      data[pos >> 3] |= ((value >> done) & ((1u << n) - 1)) << off;
+      pos += n;
+      done += n;
+    }
+  }
+
+  static inline uint64_t ReadBits(const uint8_t* data, size_t pos,
+                                  uint8_t bits) {
+    unsigned __int128 word;
+    memcpy(&word, data + (pos >> 3), sizeof(word));
+    uint64_t value = static_cast<uint64_t>(word >> (pos & 7));
+    return bits == 64 ? value : value & ((1ULL << bits) - 1);
+  }
+
+  CompressedBlockHeader header_;
+  const uint8_t* residuals_;
+  const char* payloads_;
+};
+
+#endif  // !INDEXES_HYBRID_STATIC_COMPRESSED_BLOCK_H_
@@ -28,18 +28,21 @@ class StaticCprDI : public StaticIndex<K, V> {
     return di.GetSize();
   }
 
+  // the expected page numbers tried by the auto-tuner
+  static std::vector<param_t> GetTuningParams(const param_t& p) {
+    std::vector<param_t> params;
+    for (float lambda : {1.25f, 1.5f, 2.0f, 2.5f, 3.0f, 4.0f, 6.0f, 8.0f}) {
+      params.push_back({lambda, p.record_per_page, p.disk_params});
+    }
+    return params;
+  }
+
   void Build(typename StaticIndex<K, V>::DataVec_& data) {
-    // merge data
+    // merge data and retrain the models of the updated partitions
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-
-    typename StaticIndex<K, V>::DataVec_ train_data;
-    StaticIndex<K, V>::MergeData(data, train_data);
-    for (size_t j = 0; j < train_data.size(); j++) {
-      train_data[j].second = j;
-    }
-
+    StaticIndex<K, V>::MergeData(data);
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
     if (merge_cnt >= 0) {
@@ -47,45 +50,55 @@ class StaticCprDI : public StaticIndex<K, V> {
           std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
               .count();
     }
-#endif
-
-    // rebuild the static index
-    di_ = compressed_disk_index::DiskOrientedIndexV4<K, V>(record_per_page_);
-#ifdef BREAKDOWN
-    start = std::chrono::high_resolution_clock::now();
-#endif
-    di_.Build(train_data, lambda_);
-#ifdef BREAKDOWN
-    end = std::chrono::high_resolution_clock::now();
-    if (merge_cnt >= 0) {
-      train_lat +=
-          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-              .count();
-    }
     merge_cnt++;
 #endif
-    total_index_size_ = di_.GetSize();
-    disk_size_ = sizeof(typename StaticIndex<K, V>::Record_) * size();
+    disk_size_ = StaticIndex<K, V>::GetDiskBytes();
 #ifdef PRINT_PROCESSING_INFO
-    std::cout << "\nCompressed DI use " << di_.GetModelNum() << " models for "
-              << train_data.size() << " records"
+    std::cout << "\nCompressed DI use " << di_.size() << " partitions for "
+              << size() << " records"
               << ",\t" << PRINT_MIB(GetNodeSize()) << " MiB" << std::endl;
 #endif  // PRINT_PROCESSING_INFO
   }
 
+  // build from the sorted records returned by next, see StreamData
+  template <typename NextFn>
+  void BuildStream(NextFn next) {
+    StaticIndex<K, V>::StreamData(next);
+    disk_size_ = StaticIndex<K, V>::GetDiskBytes();
+  }
+
   V Find(const K key) {
-    auto range = di_.GetSearchBound(key);
-    return StaticIndex<K, V>::FindData({range.begin, range.end}, key);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = di_[pid].GetSearchBound(key);
+    return StaticIndex<K, V>::FindData({range.begin, range.end}, key, pid);
   }
 
-  V Scan(const K key, const int length) {
-    auto range = di_.GetSearchBound(key);
-    return StaticIndex<K, V>::ScanData({range.begin, range.end}, key, length);
+  void FindBatch(const std::vector<K>& keys, std::vector<V>& vals) {
+    // predict all the search ranges before fetching any page
+    std::vector<SearchRange> ranges(keys.size());
+    std::vector<size_t> pids(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      pids[i] = StaticIndex<K, V>::GetPartitionID(keys[i]);
+      auto range = di_[pids[i]].GetSearchBound(keys[i]);
+      ranges[i] = {range.begin, range.end};
+    }
+    StaticIndex<K, V>::FindDataBatch(keys, ranges, pids, vals);
+  }
+
+  // append the first length records from the lower bound of key on to out
+  void Scan(const K key, const int length,
+            typename StaticIndex<K, V>::DataVec_& out) {
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = di_[pid].GetSearchBound(key);
+    StaticIndex<K, V>::ScanData({range.begin, range.end}, key, length, pid,
+                                out);
   }
 
   bool Update(const K key, const V value) {
-    auto range = di_.GetSearchBound(key);
-    return StaticIndex<K, V>::UpdateData({range.begin, range.end}, key, value);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = di_[pid].GetSearchBound(key);
+    return StaticIndex<K, V>::UpdateData({range.begin, range.end}, key, value,
+                                         pid);
   }
 
   inline size_t size() const { return StaticIndex<K, V>::size(); }
@@ -97,7 +110,7 @@ class StaticCprDI : public StaticIndex<K, V> {
   void PrintEachPartSize() {
     std::cout << "\t\tdi:" << PRINT_MIB(GetNodeSize())
               << ",\ton-disk data num:" << size() << ",\ton-disk MiB:"
-              << PRINT_MIB(sizeof(typename StaticIndex<K, V>::Record_) * size())
+              << PRINT_MIB(disk_size_)
               << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
 #ifdef BREAKDOWN
     if (merge_cnt > 0) {
@@ -110,6 +123,7 @@ class StaticCprDI : public StaticIndex<K, V> {
     }
     StaticIndex<K, V>::Breakdown();
 #endif
+    StaticIndex<K, V>::PrintMergeInfo();
   }
 
   param_t GetIndexParams() const { return lambda_; }
@@ -119,8 +133,55 @@ class StaticCprDI : public StaticIndex<K, V> {
     return "StaticCprDI-" + str0.substr(0, str0.find(".") + 3);
   }
 
+  std::vector<double> GetModelParams() const {
+    return {lambda_, static_cast<double>(record_per_page_)};
+  }
+
+ protected:
+  void TrainPartition(size_t partition_id,
+                      typename StaticIndex<K, V>::DataVec_& data) {
+#ifdef BREAKDOWN
+    auto start = std::chrono::high_resolution_clock::now();
+#endif
+    for (size_t j = 0; j < data.size(); j++) {
+      data[j].second = j;
+    }
+    size_t old_size = di_[partition_id].GetSize();
+    di_[partition_id] =
+        compressed_disk_index::DiskOrientedIndexV4<K, V>(record_per_page_);
+    di_[partition_id].Build(data, lambda_);
+#pragma omp atomic
+    total_index_size_ += di_[partition_id].GetSize() - old_size;
+#ifdef BREAKDOWN
+    auto end = std::chrono::high_resolution_clock::now();
+    if (merge_cnt >= 0) {
+#pragma omp atomic
+      train_lat +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count();
+    }
+#endif
+  }
+
+  void InsertPartitions(size_t pos, size_t num) {
+    compressed_disk_index::DiskOrientedIndexV4<K, V> di(record_per_page_);
+    di_.insert(di_.begin() + pos, num, di);
+    total_index_size_ += num * di.GetSize();
+  }
+
+  void SavePartition(size_t partition_id, std::ostream& out) const {
+    di_[partition_id].Serialize(out);
+  }
+
+  void LoadPartition(size_t partition_id, std::istream& in) {
+    total_index_size_ -= di_[partition_id].GetSize();
+    di_[partition_id].Load(in);
+    total_index_size_ += di_[partition_id].GetSize();
+    disk_size_ = StaticIndex<K, V>::GetDiskBytes();
+  }
+
  private:
-  compressed_disk_index::DiskOrientedIndexV4<K, V> di_;
+  std::vector<compressed_disk_index::DiskOrientedIndexV4<K, V>> di_;
 
 #ifdef BREAKDOWN
   double merge_lat = 0.0;
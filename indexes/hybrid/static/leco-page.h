@@ -23,208 +23,281 @@ class StaticLecoPage : public StaticIndex<K, V> {
 
   StaticLecoPage(param_t p)
       : StaticIndex<K, V>(p.disk_params),
+        params_(p),
         record_per_page_(p.record_per_page_),
         fixed_pages_(p.fix_page_),
         slide_pages_(p.slide_page_),
-        block_num_(p.block_num_),
         memory_size_(0),
         disk_size_(0) {}
 
-  size_t GetStaticInitSize(typename StaticIndex<K, V>::DataVec_& data) const {
-    Leco_int<K> codec;
-    std::vector<uint8_t*> block_start_vec;
-    std::vector<K> upper_bounds, lower_bounds, training;
-    int group_width = record_per_page_ * (fixed_pages_ + slide_pages_);
-    int slide_width = record_per_page_ * slide_pages_;
-    if (fixed_pages_) {
-      slide_width += 1;
+  ~StaticLecoPage() {
+    for (auto& leco : leco_) {
+      leco.Clear();
     }
+  }
 
-    for (int i = group_width; i < data.size(); i += group_width) {
-      if (i < slide_width) {
-        lower_bounds.push_back(data[0].first);
-      } else {
-        lower_bounds.push_back(data[i - slide_width].first);
+  // the LeCo-compressed zonemap of a single partition
+  class LeCoZonemap {
+   public:
+    LeCoZonemap(){};
+    LeCoZonemap(param_t p)
+        : record_per_page_(p.record_per_page_),
+          fixed_pages_(p.fix_page_),
+          slide_pages_(p.slide_page_),
+          param_block_num_(p.block_num_) {}
+
+    void Build(typename StaticIndex<K, V>::DataVec_& train_data) {
+      // rebuild the static index
+      Clear();
+      codec_ = Leco_int<K>();
+      max_y_ = train_data.size() - 1;
+      if (train_data.empty()) {
+        return;
       }
-      K upper_key = data[i - 1].first;
-      if (data[i].first >= 1) {
-        upper_key = std::max(data[i].first - 1, upper_key);
+      std::vector<K> upper_bounds, lower_bounds, training;
+      int group_width = record_per_page_ * (fixed_pages_ + slide_pages_);
+      int slide_width = record_per_page_ * slide_pages_;
+      if (fixed_pages_) {
+        slide_width += 1;
       }
-      upper_bounds.push_back(upper_key);
-      training.push_back((upper_key + lower_bounds.back()) / 2);
-    }
-    if (upper_bounds.back() < data.back().first) {
-      lower_bounds.push_back(data.back().first);
-      upper_bounds.push_back(std::numeric_limits<K>::max());
-      training.push_back(lower_bounds.back());
-    }
-    auto point_num = lower_bounds.size();
-    auto block_width = point_num / block_num_;
-    auto block_num = point_num / block_width;
-    if (block_num * block_width < point_num) {
-      block_num++;
-    }
-    codec.init(block_num, block_width);
 
-    size_t memory_size = 0;
-    for (size_t i = 0; i < block_num; i++) {
-      int block_length = block_width;
-      if (i == block_num - 1) {
-        block_length = point_num - (block_num - 1) * block_width;
+      for (int i = group_width; i < train_data.size(); i += group_width) {
+        if (i < slide_width) {
+          lower_bounds.push_back(train_data[0].first);
+        } else {
+          lower_bounds.push_back(train_data[i - slide_width].first);
+        }
+        K upper_key = train_data[i - 1].first;
+        if (train_data[i].first >= 1) {
+          upper_key = std::max(train_data[i].first - 1, upper_key);
+        }
+        upper_bounds.push_back(upper_key);
+        training.push_back((upper_key + lower_bounds.back()) / 2);
+      }
+      // a small partition may not fill a single group
+      if (upper_bounds.empty() ||
+          upper_bounds.back() < train_data.back().first) {
+        lower_bounds.push_back(train_data.back().first);
+        upper_bounds.push_back(std::numeric_limits<K>::max());
+        training.push_back(lower_bounds.back());
+      }
+      point_num_ = lower_bounds.size();
+      // the blocks of this build, the configured number is kept for the
+      // next, possibly larger, partition
+      size_t block_num = param_block_num_;
+      if (point_num_ < block_num) {
+        block_num = std::min<size_t>(10, point_num_);
       }
 
-      uint8_t* descriptor = (uint8_t*)malloc(block_length * sizeof(K) * 4);
-      uint8_t* res = descriptor;
-      res = codec.encodeArray8_int(lower_bounds.data() + (i * block_width),
-                                   upper_bounds.data() + (i * block_width),
-                                   training.data() + (i * block_width),
-                                   block_length, descriptor, i);
-      uint32_t segment_size = res - descriptor;
-      descriptor = (uint8_t*)realloc(descriptor, segment_size);
-      block_start_vec.push_back(descriptor);
-      memory_size += segment_size;
+      block_width_ = point_num_ / block_num;
+      block_num_ = point_num_ / block_width_;
+      if (block_num_ * block_width_ < point_num_) {
+        block_num_++;
+      }  // handle with the last block, maybe < block_width_
+      codec_.init(block_num_, block_width_);
+
+      for (size_t i = 0; i < block_num_; i++) {
+        int block_length = block_width_;
+        if (i == block_num_ - 1) {
+          block_length = point_num_ - (block_num_ - 1) * block_width_;
+        }
+
+        uint8_t* descriptor = (uint8_t*)malloc(block_length * sizeof(K) * 4);
+        uint8_t* res = descriptor;
+        res = codec_.encodeArray8_int(lower_bounds.data() + (i * block_width_),
+                                      upper_bounds.data() + (i * block_width_),
+                                      training.data() + (i * block_width_),
+                                      block_length, descriptor, i);
+        uint32_t segment_size = res - descriptor;
+        descriptor = (uint8_t*)realloc(descriptor, segment_size);
+        block_start_vec_.push_back(descriptor);
+        block_bytes_.push_back(segment_size);
+        memory_size_ += segment_size;
+      }
     }
-    return memory_size;
-  }
 
-  void Build(typename StaticIndex<K, V>::DataVec_& data) {
-    // merge data
-
-#ifdef BREAKDOWN
-    auto start = std::chrono::high_resolution_clock::now();
-#endif
-    typename StaticIndex<K, V>::DataVec_ train_data;
-    StaticIndex<K, V>::MergeData(data, train_data);
-#ifdef BREAKDOWN
-    auto end = std::chrono::high_resolution_clock::now();
-    if (merge_cnt >= 0) {
-      merge_lat +=
-          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-              .count();
+    void Serialize(std::ostream& out) const {
+      out.write(reinterpret_cast<const char*>(&point_num_), sizeof(size_t));
+      out.write(reinterpret_cast<const char*>(&max_y_), sizeof(size_t));
+      if (point_num_ == 0) {
+        return;
+      }
+      out.write(reinterpret_cast<const char*>(&block_num_), sizeof(size_t));
+      out.write(reinterpret_cast<const char*>(&block_width_), sizeof(int));
+      out.write(reinterpret_cast<const char*>(block_bytes_.data()),
+                block_num_ * sizeof(uint32_t));
+      for (size_t i = 0; i < block_num_; i++) {
+        out.write(reinterpret_cast<const char*>(block_start_vec_[i]),
+                  block_bytes_[i]);
+      }
     }
-    start = std::chrono::high_resolution_clock::now();
-#endif
 
-    // rebuild the static index
-    codec_ = Leco_int<K>();
-    block_start_vec_ = std::vector<uint8_t*>();
-    max_y_ = train_data.size() - 1;
-    std::vector<K> upper_bounds, lower_bounds, training;
-    int group_width = record_per_page_ * (fixed_pages_ + slide_pages_);
-    int slide_width = record_per_page_ * slide_pages_;
-    if (fixed_pages_) {
-      slide_width += 1;
+    void Load(std::istream& in) {
+      Clear();
+      codec_ = Leco_int<K>();
+      in.read(reinterpret_cast<char*>(&point_num_), sizeof(size_t));
+      in.read(reinterpret_cast<char*>(&max_y_), sizeof(size_t));
+      if (point_num_ == 0) {
+        return;
+      }
+      in.read(reinterpret_cast<char*>(&block_num_), sizeof(size_t));
+      in.read(reinterpret_cast<char*>(&block_width_), sizeof(int));
+      codec_.init(block_num_, block_width_);
+      block_bytes_.resize(block_num_);
+      in.read(reinterpret_cast<char*>(block_bytes_.data()),
+              block_num_ * sizeof(uint32_t));
+      for (size_t i = 0; i < block_num_; i++) {
+        uint8_t* block = (uint8_t*)malloc(block_bytes_[i]);
+        in.read(reinterpret_cast<char*>(block), block_bytes_[i]);
+        block_start_vec_.push_back(block);
+        memory_size_ += block_bytes_[i];
+      }
     }
 
-#ifdef PRINT_PROCESSING_INFO
-    std::cout << "fixed_pages_:" << fixed_pages_
-              << ",\tslide_pages_:" << slide_pages_
-              << ",\tslide_width:" << slide_width << std::endl;
-#endif  // PRINT_PROCESSING_INFO
-
-    for (int i = group_width; i < train_data.size(); i += group_width) {
-      if (i < slide_width) {
-        lower_bounds.push_back(train_data[0].first);
-      } else {
-        lower_bounds.push_back(train_data[i - slide_width].first);
+    SearchRange FindRange(const K key) {
+      if (point_num_ == 0) {
+        return {0, 0};
       }
-      K upper_key = train_data[i - 1].first;
-      if (train_data[i].first >= 1) {
-        upper_key = std::max(train_data[i].first - 1, upper_key);
+      size_t pos = LecoBinarySearch(key);
+      size_t start = pos * (fixed_pages_ + slide_pages_);
+      if (pos >= slide_pages_) {
+        start -= slide_pages_;
       }
-      upper_bounds.push_back(upper_key);
-      training.push_back((upper_key + lower_bounds.back()) / 2);
+      size_t end = start + fixed_pages_ + 2 * slide_pages_;
+      return {start * record_per_page_,
+              std::min(max_y_ + 1, end * record_per_page_)};
     }
-    if (upper_bounds.back() < train_data.back().first) {
-      lower_bounds.push_back(train_data.back().first);
-      upper_bounds.push_back(std::numeric_limits<K>::max());
-      training.push_back(lower_bounds.back());
-    }
-    point_num_ = lower_bounds.size();
-    if (point_num_ < block_num_) {
-      block_num_ = 10;
+
+    // release the encoded blocks, the copies of this model share them
+    void Clear() {
+      for (auto block : block_start_vec_) {
+        free(block);
+      }
+      block_start_vec_.clear();
+      block_bytes_.clear();
+      point_num_ = 0;
+      memory_size_ = 0;
     }
 
-    block_width_ = point_num_ / block_num_;
-    block_num_ = point_num_ / block_width_;
-    if (block_num_ * block_width_ < point_num_) {
-      block_num_++;
-    }  // handle with the last block, maybe < block_width_
-    codec_.init(block_num_, block_width_);
-
-    memory_size_ = 0;
-    for (size_t i = 0; i < block_num_; i++) {
-      int block_length = block_width_;
-      if (i == block_num_ - 1) {
-        block_length = point_num_ - (block_num_ - 1) * block_width_;
+    size_t GetNodeSize() const { return memory_size_; }
+
+   private:
+    size_t LecoBinarySearch(K key) {
+      uint64_t s = 0, e = point_num_;
+      while (s < e) {
+        uint64_t mid = (s + e) >> 1;
+        K data_mid =
+            codec_.randomdecodeArray8Page(block_start_vec_[mid / block_width_],
+                                          mid % block_width_, NULL, point_num_);
+        if (data_mid < key)
+          s = mid + 1;
+        else
+          e = mid;
       }
+      return s;
+    }
+
+   private:
+    Leco_int<K> codec_;
+    std::vector<uint8_t*> block_start_vec_;
+    std::vector<uint32_t> block_bytes_;
+    int block_width_ = 0;
+    size_t point_num_ = 0;
+    size_t max_y_ = 0;
+
+    size_t record_per_page_;
+    size_t fixed_pages_;
+    size_t slide_pages_;
+
+    size_t param_block_num_;
+    size_t block_num_ = 0;  // the blocks of the built zonemap
+    size_t memory_size_ = 0;
+  };
+
+  size_t GetStaticInitSize(typename StaticIndex<K, V>::DataVec_& data) const {
+    LeCoZonemap leco(params_);
+    leco.Build(data);
+    size_t memory_size = leco.GetNodeSize();
+    leco.Clear();
+    return memory_size;
+  }
 
-      uint8_t* descriptor = (uint8_t*)malloc(block_length * sizeof(K) * 4);
-      uint8_t* res = descriptor;
-      res = codec_.encodeArray8_int(lower_bounds.data() + (i * block_width_),
-                                    upper_bounds.data() + (i * block_width_),
-                                    training.data() + (i * block_width_),
-                                    block_length, descriptor, i);
-      uint32_t segment_size = res - descriptor;
-      descriptor = (uint8_t*)realloc(descriptor, segment_size);
-      block_start_vec_.push_back(descriptor);
-      memory_size_ += segment_size;
+  // the page layouts and block numbers tried by the auto-tuner, cf. the
+  // hand-tuned tables in GetLecoPageParams
+  static std::vector<param_t> GetTuningParams(const param_t& p) {
+    std::vector<param_t> params;
+    const std::pair<size_t, size_t> layouts[] = {
+        {1, 0}, {0, 1}, {1, 1}, {0, 2}, {1, 2}};
+    for (auto& layout : layouts) {
+      for (size_t block_num : {500, 1000, 2000, 4000, 8000}) {
+        params.push_back({p.record_per_page_, layout.first, layout.second,
+                          block_num, p.disk_params});
+      }
     }
-    disk_size_ = sizeof(typename StaticIndex<K, V>::Record_) * size();
+    return params;
+  }
+
+  void Build(typename StaticIndex<K, V>::DataVec_& data) {
+    // merge data and retrain the models of the updated partitions
+#ifdef BREAKDOWN
+    auto start = std::chrono::high_resolution_clock::now();
+#endif
+    StaticIndex<K, V>::MergeData(data);
 #ifdef BREAKDOWN
-    end = std::chrono::high_resolution_clock::now();
+    auto end = std::chrono::high_resolution_clock::now();
     if (merge_cnt >= 0) {
-      train_lat +=
+      merge_lat +=
           std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
               .count();
     }
     merge_cnt++;
 #endif
+    disk_size_ = StaticIndex<K, V>::GetDiskBytes();
 
 #ifdef PRINT_PROCESSING_INFO
-    std::cout << "\nLeco-page use " << block_num_ << " models for "
-              << train_data.size() << " records"
+    std::cout << "fixed_pages_:" << fixed_pages_
+              << ",\tslide_pages_:" << slide_pages_ << std::endl;
+    std::cout << "\nLeco-page use " << leco_.size() << " partitions for "
+              << size() << " records"
               << ",\t" << PRINT_MIB(GetNodeSize()) << " MiB" << std::endl;
 #endif  // PRINT_PROCESSING_INFO
   }
 
+  // build from the sorted records returned by next, see StreamData
+  template <typename NextFn>
+  void BuildStream(NextFn next) {
+    StaticIndex<K, V>::StreamData(next);
+    disk_size_ = StaticIndex<K, V>::GetDiskBytes();
+  }
+
   V Find(const K key) {
-    size_t pos = LecoBinarySearch(key);
-    size_t start = pos * (fixed_pages_ + slide_pages_);
-    if (pos >= slide_pages_) {
-      start -= slide_pages_;
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    return StaticIndex<K, V>::FindData(leco_[pid].FindRange(key), key, pid);
+  }
+
+  void FindBatch(const std::vector<K>& keys, std::vector<V>& vals) {
+    // predict all the search ranges before fetching any page
+    std::vector<SearchRange> ranges(keys.size());
+    std::vector<size_t> pids(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      pids[i] = StaticIndex<K, V>::GetPartitionID(keys[i]);
+      ranges[i] = leco_[pids[i]].FindRange(keys[i]);
     }
-    size_t end = start + fixed_pages_ + 2 * slide_pages_;
-    return StaticIndex<K, V>::FindData(
-        {start * record_per_page_,
-         std::min(max_y_ + 1, end * record_per_page_)},
-        key);
+    StaticIndex<K, V>::FindDataBatch(keys, ranges, pids, vals);
   }
 
   bool Update(const K key, const V value) {
-    size_t pos = LecoBinarySearch(key);
-    size_t start = pos * (fixed_pages_ + slide_pages_);
-    if (pos >= slide_pages_) {
-      start -= slide_pages_;
-    }
-    size_t end = start + fixed_pages_ + 2 * slide_pages_;
-    return StaticIndex<K, V>::UpdateData(
-        {start * record_per_page_,
-         std::min(max_y_ + 1, end * record_per_page_)},
-        key, value);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    return StaticIndex<K, V>::UpdateData(leco_[pid].FindRange(key), key, value,
+                                         pid);
   }
 
-  V Scan(const K key, const int length) {
-    size_t pos = LecoBinarySearch(key);
-    size_t start = pos * (fixed_pages_ + slide_pages_);
-    if (pos >= slide_pages_) {
-      start -= slide_pages_;
-    }
-    size_t end = start + fixed_pages_ + 2 * slide_pages_;
-    return StaticIndex<K, V>::ScanData(
-        {start * record_per_page_,
-         std::min(max_y_ + 1, end * record_per_page_)},
-        key, length);
+  // append the first length records from the lower bound of key on to out
+  void Scan(const K key, const int length,
+            typename StaticIndex<K, V>::DataVec_& out) {
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    StaticIndex<K, V>::ScanData(leco_[pid].FindRange(key), key, length, pid,
+                                out);
   }
 
   inline size_t size() const { return StaticIndex<K, V>::size(); }
@@ -236,7 +309,7 @@ class StaticLecoPage : public StaticIndex<K, V> {
   void PrintEachPartSize() {
     std::cout << "\t\tleco-page:" << PRINT_MIB(GetNodeSize())
               << ",\ton-disk data num:" << size() << ",\ton-disk MiB:"
-              << PRINT_MIB(sizeof(typename StaticIndex<K, V>::Record_) * size())
+              << PRINT_MIB(disk_size_)
               << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
 #ifdef BREAKDOWN
     if (merge_cnt > 0) {
@@ -249,6 +322,7 @@ class StaticLecoPage : public StaticIndex<K, V> {
     }
     StaticIndex<K, V>::Breakdown();
 #endif
+    StaticIndex<K, V>::PrintMergeInfo();
   }
 
   param_t GetIndexParams() const {
@@ -260,28 +334,52 @@ class StaticLecoPage : public StaticIndex<K, V> {
            std::to_string((fixed_pages_ + 2 * slide_pages_) * record_per_page_);
   }
 
- private:
-  size_t LecoBinarySearch(K key) {
-    uint64_t s = 0, e = point_num_;
-    while (s < e) {
-      uint64_t mid = (s + e) >> 1;
-      K data_mid =
-          codec_.randomdecodeArray8Page(block_start_vec_[mid / block_width_],
-                                        mid % block_width_, NULL, point_num_);
-      if (data_mid < key)
-        s = mid + 1;
-      else
-        e = mid;
+  std::vector<double> GetModelParams() const {
+    return {static_cast<double>(record_per_page_),
+            static_cast<double>(fixed_pages_),
+            static_cast<double>(slide_pages_),
+            static_cast<double>(params_.block_num_)};
+  }
+
+ protected:
+  void TrainPartition(size_t partition_id,
+                      typename StaticIndex<K, V>::DataVec_& data) {
+#ifdef BREAKDOWN
+    auto start = std::chrono::high_resolution_clock::now();
+#endif
+    size_t old_size = leco_[partition_id].GetNodeSize();
+    leco_[partition_id].Build(data);
+#pragma omp atomic
+    memory_size_ += leco_[partition_id].GetNodeSize() - old_size;
+#ifdef BREAKDOWN
+    auto end = std::chrono::high_resolution_clock::now();
+    if (merge_cnt >= 0) {
+#pragma omp atomic
+      train_lat +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count();
     }
-    return s;
+#endif
+  }
+
+  void InsertPartitions(size_t pos, size_t num) {
+    leco_.insert(leco_.begin() + pos, num, LeCoZonemap(params_));
+  }
+
+  void SavePartition(size_t partition_id, std::ostream& out) const {
+    leco_[partition_id].Serialize(out);
+  }
+
+  void LoadPartition(size_t partition_id, std::istream& in) {
+    memory_size_ -= leco_[partition_id].GetNodeSize();
+    leco_[partition_id].Load(in);
+    memory_size_ += leco_[partition_id].GetNodeSize();
+    disk_size_ = StaticIndex<K, V>::GetDiskBytes();
   }
 
  private:
-  Leco_int<K> codec_;
-  std::vector<uint8_t*> block_start_vec_;
-  int block_width_;
-  size_t point_num_;
-  V max_y_;
+  param_t params_;
+  std::vector<LeCoZonemap> leco_;
 
 #ifdef BREAKDOWN
   double merge_lat = 0.0;
@@ -293,9 +391,8 @@ class StaticLecoPage : public StaticIndex<K, V> {
   size_t fixed_pages_;
   size_t slide_pages_;
 
-  size_t block_num_;
   size_t memory_size_ = 0;
   size_t disk_size_ = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
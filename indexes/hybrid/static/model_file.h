@@ -0,0 +1,60 @@
+#ifndef INDEXES_HYBRID_STATIC_MODEL_FILE_H_
+#define INDEXES_HYBRID_STATIC_MODEL_FILE_H_
+
+#include <string.h>
+
+#include <cstdint>
+#include <streambuf>
+
+// The models of a static index are stored in <filename>.model:
+//   ModelFileHeader | payload
+// The payload holds the name of the data file, which may be one written by a
+// merge, and the partitions followed by the models serialized by the static
+// index, it is covered by the checksum in the header.
+#define MODEL_FILE_MAGIC 0x4c45444f4d444948ULL  // "HIDMODEL"
+#define MODEL_FILE_VERSION 4
+#define MODEL_FILE_SUFFIX ".model"
+// the data file holds compressed blocks
+#define MODEL_FILE_COMPRESSED 0x1
+#define MODEL_FILE_MAX_PARAMS 4
+
+struct ModelFileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t record_bytes;
+  uint64_t page_bytes;
+  uint64_t payload_bytes;
+  uint64_t checksum;
+  uint64_t flags;  // MODEL_FILE_* bits
+  // the models are only valid for the same parameters
+  char index_name[64];
+  uint64_t partition_records;
+  double model_params[MODEL_FILE_MAX_PARAMS];  // e.g., the error bound
+};
+
+// a 64-bit hash over the payload, one word at a time
+static inline uint64_t ModelChecksum(const char* data, size_t bytes) {
+  uint64_t hash = 0xcbf29ce484222325ULL ^ bytes;
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data + i, sizeof(uint64_t));
+    hash = (hash ^ word) * 0x100000001b3ULL;
+    hash ^= hash >> 29;
+  }
+  for (; i < bytes; i++) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// read a mapped region through std::istream without copying it first
+class MemoryStreamBuf : public std::streambuf {
+ public:
+  MemoryStreamBuf(const char* data, size_t bytes) {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + bytes);
+  }
+};
+
+#endif  // !INDEXES_HYBRID_STATIC_MODEL_FILE_H_
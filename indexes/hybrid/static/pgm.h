@@ -21,50 +21,78 @@ class StaticPGMIndex : public StaticIndex<K, V> {
     return pgm.size_in_bytes();
   }
 
-  void Build(typename StaticIndex<K, V>::DataVec_& data) {
-    // merge data
-    typename StaticIndex<K, V>::DataVec_ train_data;
-    StaticIndex<K, V>::MergeData(data, train_data);
+  // the error bounds tried by the auto-tuner
+  static std::vector<param_t> GetTuningParams(const param_t& p) {
+    std::vector<param_t> params;
+    for (uint64_t epsilon = 4; epsilon <= 1024; epsilon *= 2) {
+      params.push_back({epsilon, p.disk_params});
+    }
+    return params;
+  }
 
-    // rebuild the static index
-    pgm_ = pgm::CompressedPGMIndex<K>(train_data.begin(), train_data.end(),
-                                      epsilon_);
+  void Build(typename StaticIndex<K, V>::DataVec_& data) {
+    // merge data and retrain the models of the updated partitions
+    StaticIndex<K, V>::MergeData(data);
 #ifdef PRINT_PROCESSING_INFO
-    std::cout << "\nPGM use " << pgm_.segments_count() << " models for "
-              << train_data.size() << " records"
+    std::cout << "\nPGM use " << pgm_.size() << " partitions for " << size()
+              << " records"
               << ",\t" << PRINT_MIB(GetNodeSize()) << " MiB" << std::endl;
 #endif  // PRINT_PROCESSING_INFO
   }
 
+  // build from the sorted records returned by next, see StreamData
+  template <typename NextFn>
+  void BuildStream(NextFn next) {
+    StaticIndex<K, V>::StreamData(next);
+  }
+
   V Find(const K key) {
-    auto range = pgm_.search(key);
-    return StaticIndex<K, V>::FindData({range.lo, range.hi}, key);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = pgm_[pid].search(key);
+    return StaticIndex<K, V>::FindData({range.lo, range.hi}, key, pid);
   }
 
-  V Scan(const K key, const int length) {
-    auto range = pgm_.search(key);
-    return StaticIndex<K, V>::ScanData({range.lo, range.hi}, key, length);
+  void FindBatch(const std::vector<K>& keys, std::vector<V>& vals) {
+    // predict all the search ranges before fetching any page
+    std::vector<SearchRange> ranges(keys.size());
+    std::vector<size_t> pids(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      pids[i] = StaticIndex<K, V>::GetPartitionID(keys[i]);
+      auto range = pgm_[pids[i]].search(keys[i]);
+      ranges[i] = {range.lo, range.hi};
+    }
+    StaticIndex<K, V>::FindDataBatch(keys, ranges, pids, vals);
+  }
+
+  // append the first length records from the lower bound of key on to out
+  void Scan(const K key, const int length,
+            typename StaticIndex<K, V>::DataVec_& out) {
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = pgm_[pid].search(key);
+    StaticIndex<K, V>::ScanData({range.lo, range.hi}, key, length, pid, out);
   }
 
   bool Update(const K key, const V value) {
-    auto range = pgm_.search(key);
-    return StaticIndex<K, V>::UpdateData({range.lo, range.hi}, key, value);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = pgm_[pid].search(key);
+    return StaticIndex<K, V>::UpdateData({range.lo, range.hi}, key, value,
+                                         pid);
   }
 
   size_t size() const { return StaticIndex<K, V>::size(); }
 
-  size_t GetNodeSize() const { return pgm_.size_in_bytes(); }
+  size_t GetNodeSize() const { return total_index_size_; }
 
   size_t GetTotalSize() const {
-    return pgm_.size_in_bytes() +
-           sizeof(typename StaticIndex<K, V>::Record_) * size();
+    return total_index_size_ + StaticIndex<K, V>::GetDiskBytes();
   }
 
   void PrintEachPartSize() {
-    std::cout << "\t\tpgm:" << PRINT_MIB(pgm_.size_in_bytes())
+    std::cout << "\t\tpgm:" << PRINT_MIB(GetNodeSize())
               << ",\ton-disk data num:" << size() << ",\ton-disk MiB:"
-              << PRINT_MIB(sizeof(typename StaticIndex<K, V>::Record_) * size())
+              << PRINT_MIB((StaticIndex<K, V>::GetDiskBytes()))
               << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
+    StaticIndex<K, V>::PrintMergeInfo();
   }
 
   param_t GetIndexParams() const { return epsilon_; }
@@ -73,8 +101,37 @@ class StaticPGMIndex : public StaticIndex<K, V> {
     return "StaticPGM-" + std::to_string(epsilon_);
   }
 
+  std::vector<double> GetModelParams() const {
+    return {static_cast<double>(epsilon_)};
+  }
+
+ protected:
+  void TrainPartition(size_t partition_id,
+                      typename StaticIndex<K, V>::DataVec_& data) {
+    size_t old_size = pgm_[partition_id].size_in_bytes();
+    pgm_[partition_id] =
+        pgm::CompressedPGMIndex<K>(data.begin(), data.end(), epsilon_);
+#pragma omp atomic
+    total_index_size_ += pgm_[partition_id].size_in_bytes() - old_size;
+  }
+
+  void InsertPartitions(size_t pos, size_t num) {
+    pgm_.insert(pgm_.begin() + pos, num, pgm::CompressedPGMIndex<K>());
+  }
+
+  void SavePartition(size_t partition_id, std::ostream& out) const {
+    pgm_[partition_id].serialize(out);
+  }
+
+  void LoadPartition(size_t partition_id, std::istream& in) {
+    total_index_size_ -= pgm_[partition_id].size_in_bytes();
+    pgm_[partition_id].load(in);
+    total_index_size_ += pgm_[partition_id].size_in_bytes();
+  }
+
  private:
-  pgm::CompressedPGMIndex<K> pgm_;
+  std::vector<pgm::CompressedPGMIndex<K>> pgm_;
+  size_t total_index_size_ = 0;
 
   size_t epsilon_;
 };
@@ -218,6 +218,48 @@ public:
         return levels.back().size();
     }
 
+    /**
+     * Writes the index to the given stream, it can be restored with @ref load.
+     * @param out the output stream
+     */
+    void serialize(std::ostream &out) const {
+        size_t slopes_num = slopes_table.size();
+        size_t levels_num = levels.size();
+        out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+        out.write(reinterpret_cast<const char *>(&first_key), sizeof(K));
+        out.write(reinterpret_cast<const char *>(&root_slope), sizeof(Floating));
+        out.write(reinterpret_cast<const char *>(&root_intercept), sizeof(int64_t));
+        out.write(reinterpret_cast<const char *>(&root_range), sizeof(size_t));
+        out.write(reinterpret_cast<const char *>(&epsilon_value), sizeof(size_t));
+        out.write(reinterpret_cast<const char *>(&slopes_num), sizeof(size_t));
+        out.write(reinterpret_cast<const char *>(slopes_table.data()), slopes_num * sizeof(Floating));
+        out.write(reinterpret_cast<const char *>(&levels_num), sizeof(size_t));
+        for (auto &l : levels)
+            l.serialize(out);
+    }
+
+    /**
+     * Restores an index written by @ref serialize, the index must not be moved afterwards.
+     * @param in the input stream
+     */
+    void load(std::istream &in) {
+        size_t slopes_num, levels_num;
+        in.read(reinterpret_cast<char *>(&n), sizeof(n));
+        in.read(reinterpret_cast<char *>(&first_key), sizeof(K));
+        in.read(reinterpret_cast<char *>(&root_slope), sizeof(Floating));
+        in.read(reinterpret_cast<char *>(&root_intercept), sizeof(int64_t));
+        in.read(reinterpret_cast<char *>(&root_range), sizeof(size_t));
+        in.read(reinterpret_cast<char *>(&epsilon_value), sizeof(size_t));
+        in.read(reinterpret_cast<char *>(&slopes_num), sizeof(size_t));
+        slopes_table.resize(slopes_num);
+        in.read(reinterpret_cast<char *>(slopes_table.data()), slopes_num * sizeof(Floating));
+        in.read(reinterpret_cast<char *>(&levels_num), sizeof(size_t));
+        levels.clear();
+        levels.resize(levels_num);
+        for (auto &l : levels)
+            l.load(in);
+    }
+
     /**
      * Returns the number of levels of the index.
      * @return the number of levels of the index
@@ -290,6 +332,8 @@ struct CompressedPGMIndex<K, EpsilonRecursive, Floating>::CompressedLevel {
     sdsl::sd_vector<> compressed_intercepts;   ///< The compressed bitvector storing the intercepts.
     sdsl::sd_vector<>::select_1_type sel1;     ///< The select1 succinct data structure on compressed_intercepts.
 
+    CompressedLevel() = default;
+
     template<typename IterK, typename IterI, typename IterM>
     CompressedLevel(IterK first_segment, IterK last_segment,
                     IterI first_intercept, IterI last_intercept,
@@ -351,6 +395,26 @@ struct CompressedPGMIndex<K, EpsilonRecursive, Floating>::CompressedLevel {
     inline size_t size_in_bytes() const {
         return keys.size() * sizeof(K) + slopes_map.bit_size() / 8 + sdsl::size_in_bytes(compressed_intercepts);
     }
+
+    void serialize(std::ostream &out) const {
+        size_t keys_num = keys.size();
+        out.write(reinterpret_cast<const char *>(&keys_num), sizeof(size_t));
+        out.write(reinterpret_cast<const char *>(keys.data()), keys_num * sizeof(K));
+        out.write(reinterpret_cast<const char *>(&intercept_offset), sizeof(int64_t));
+        slopes_map.serialize(out);
+        compressed_intercepts.serialize(out);
+    }
+
+    void load(std::istream &in) {
+        size_t keys_num;
+        in.read(reinterpret_cast<char *>(&keys_num), sizeof(size_t));
+        keys.resize(keys_num);
+        in.read(reinterpret_cast<char *>(keys.data()), keys_num * sizeof(K));
+        in.read(reinterpret_cast<char *>(&intercept_offset), sizeof(int64_t));
+        slopes_map.load(in);
+        compressed_intercepts.load(in);
+        sdsl::util::init_support(sel1, &compressed_intercepts);
+    }
 };
 
 /**
@@ -3,6 +3,7 @@
 
 #include "./rs/builder.h"
 #include "./rs/radix_spline.h"
+#include "./rs/serializer.h"
 #include "./static_base.h"
 
 template <typename K, typename V>
@@ -37,59 +38,83 @@ class RSIndex : public StaticIndex<K, V> {
     return rs.GetSize();
   }
 
-  void Build(typename StaticIndex<K, V>::DataVec_& data) {
-    // merge data
-    typename StaticIndex<K, V>::DataVec_ train_data;
-    StaticIndex<K, V>::MergeData(data, train_data);
-
-    // rebuild the static index
-    auto min = std::numeric_limits<K>::min();
-    auto max = std::numeric_limits<K>::max();
-    if (train_data.size() > 0) {
-      min = train_data.front().first;
-      max = train_data.back().first;
+  // the radix tables and error bounds tried by the auto-tuner, a large radix
+  // table is costly when every partition has its own
+  static std::vector<param_t> GetTuningParams(const param_t& p) {
+    std::vector<param_t> params;
+    for (size_t num_radix_bits : {8, 12, 16}) {
+      for (size_t max_error = 4; max_error <= 1024; max_error *= 2) {
+        params.push_back({num_radix_bits, max_error, p.disk_params});
+      }
     }
-    rs::Builder<K> rsb(min, max, num_radix_bits_, max_error_);
-    for (const auto& kv : train_data) {
-      rsb.AddKey(kv.first);
-    }
-    rs_ = rsb.Finalize();
+    return params;
+  }
+
+  void Build(typename StaticIndex<K, V>::DataVec_& data) {
+    // merge data and retrain the models of the updated partitions
+    StaticIndex<K, V>::MergeData(data);
 #ifdef PRINT_PROCESSING_INFO
-    std::cout << "\nRS use " << rs_.GetSegmentNum() << " models for "
-              << train_data.size() << " records"
+    std::cout << "\nRS use " << rs_.size() << " partitions for " << size()
+              << " records"
               << ",\t" << PRINT_MIB(GetNodeSize()) << " MiB" << std::endl;
 #endif  // PRINT_PROCESSING_INFO
   }
 
+  // build from the sorted records returned by next, see StreamData
+  template <typename NextFn>
+  void BuildStream(NextFn next) {
+    StaticIndex<K, V>::StreamData(next);
+  }
+
   V Find(const K key) {
     // Already exclusive in the internal algorithm
-    auto range = rs_.GetSearchBound(key);
-    return StaticIndex<K, V>::FindData({range.begin, range.end}, key);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = rs_[pid].GetSearchBound(key);
+    return StaticIndex<K, V>::FindData({range.begin, range.end}, key, pid);
+  }
+
+  void FindBatch(const std::vector<K>& keys, std::vector<V>& vals) {
+    // predict all the search ranges before fetching any page
+    std::vector<SearchRange> ranges(keys.size());
+    std::vector<size_t> pids(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+      pids[i] = StaticIndex<K, V>::GetPartitionID(keys[i]);
+      auto range = rs_[pids[i]].GetSearchBound(keys[i]);
+      ranges[i] = {range.begin, range.end};
+    }
+    StaticIndex<K, V>::FindDataBatch(keys, ranges, pids, vals);
   }
 
   bool Update(const K key, const V value) {
-    auto range = rs_.GetSearchBound(key);
-    return StaticIndex<K, V>::UpdateData({range.begin, range.end}, key, value);
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = rs_[pid].GetSearchBound(key);
+    return StaticIndex<K, V>::UpdateData({range.begin, range.end}, key, value,
+                                         pid);
   }
 
-  V Scan(const K key, const int length) {
-    auto range = rs_.GetSearchBound(key);
-    return StaticIndex<K, V>::ScanData({range.begin, range.end}, key, length);
+  // append the first length records from the lower bound of key on to out
+  void Scan(const K key, const int length,
+            typename StaticIndex<K, V>::DataVec_& out) {
+    auto pid = StaticIndex<K, V>::GetPartitionID(key);
+    auto range = rs_[pid].GetSearchBound(key);
+    StaticIndex<K, V>::ScanData({range.begin, range.end}, key, length, pid,
+                                out);
   }
 
   size_t size() const { return StaticIndex<K, V>::size(); }
 
-  size_t GetNodeSize() const { return rs_.GetSize(); }
+  size_t GetNodeSize() const { return total_index_size_; }
 
   size_t GetTotalSize() const {
-    return rs_.GetSize() + sizeof(typename StaticIndex<K, V>::Record_) * size();
+    return total_index_size_ + StaticIndex<K, V>::GetDiskBytes();
   }
 
   void PrintEachPartSize() {
-    std::cout << "\t\trs:" << PRINT_MIB(rs_.GetSize())
+    std::cout << "\t\trs:" << PRINT_MIB(GetNodeSize())
               << ",\ton-disk data num:" << size() << ",\ton-disk MiB:"
-              << PRINT_MIB(sizeof(typename StaticIndex<K, V>::Record_) * size())
+              << PRINT_MIB((StaticIndex<K, V>::GetDiskBytes()))
               << ",\ttotal MiB:" << PRINT_MIB(GetTotalSize()) << std::endl;
+    StaticIndex<K, V>::PrintMergeInfo();
   }
 
   param_t GetIndexParams() const { return {num_radix_bits_, max_error_}; }
@@ -99,8 +124,49 @@ class RSIndex : public StaticIndex<K, V> {
            std::to_string(max_error_);
   }
 
+  std::vector<double> GetModelParams() const {
+    return {static_cast<double>(num_radix_bits_),
+            static_cast<double>(max_error_)};
+  }
+
+ protected:
+  void TrainPartition(size_t partition_id,
+                      typename StaticIndex<K, V>::DataVec_& data) {
+    auto min = std::numeric_limits<K>::min();
+    auto max = std::numeric_limits<K>::max();
+    if (data.size() > 0) {
+      min = data.front().first;
+      max = data.back().first;
+    }
+    rs::Builder<K> rsb(min, max, num_radix_bits_, max_error_);
+    for (const auto& kv : data) {
+      rsb.AddKey(kv.first);
+    }
+    size_t old_size = rs_[partition_id].GetSize();
+    rs_[partition_id] = rsb.Finalize();
+#pragma omp atomic
+    total_index_size_ += rs_[partition_id].GetSize() - old_size;
+  }
+
+  void InsertPartitions(size_t pos, size_t num) {
+    rs::RadixSpline<K> rs;
+    rs_.insert(rs_.begin() + pos, num, rs);
+    total_index_size_ += num * rs.GetSize();
+  }
+
+  void SavePartition(size_t partition_id, std::ostream& out) const {
+    rs::Serializer<K>::ToStream(rs_[partition_id], out);
+  }
+
+  void LoadPartition(size_t partition_id, std::istream& in) {
+    total_index_size_ -= rs_[partition_id].GetSize();
+    rs_[partition_id] = rs::Serializer<K>::FromStream(in);
+    total_index_size_ += rs_[partition_id].GetSize();
+  }
+
  private:
-  rs::RadixSpline<K> rs_;
+  std::vector<rs::RadixSpline<K>> rs_;
+  size_t total_index_size_ = 0;
 
   size_t num_radix_bits_;
   size_t max_error_;
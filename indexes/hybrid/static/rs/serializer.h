@@ -8,11 +8,25 @@ namespace rs {
 
 template <class KeyType>
 class Serializer {
+  // the spline points can be copied as a whole if they are not padded
+  static constexpr bool kPackedCoord =
+      sizeof(Coord<KeyType>) == sizeof(KeyType) + sizeof(double);
+
  public:
   // Serializes the `rs` model and appends it to `bytes`.
   static void ToBytes(const RadixSpline<KeyType>& rs, std::string* bytes) {
     std::stringstream buffer;
+    ToStream(rs, buffer);
+    bytes->append(buffer.str());
+  }
+
+  static RadixSpline<KeyType> FromBytes(const std::string& bytes) {
+    std::istringstream in(bytes);
+    return FromStream(in);
+  }
 
+  // Writes the `rs` model to `buffer`, the radix table in a single write.
+  static void ToStream(const RadixSpline<KeyType>& rs, std::ostream& buffer) {
     // Scalar members.
     buffer.write(reinterpret_cast<const char*>(&rs.min_key_), sizeof(KeyType));
     buffer.write(reinterpret_cast<const char*>(&rs.max_key_), sizeof(KeyType));
@@ -27,28 +41,28 @@ class Serializer {
     const size_t radix_table_size = rs.radix_table_.size();
     buffer.write(reinterpret_cast<const char*>(&radix_table_size),
                  sizeof(size_t));
-    for (size_t i = 0; i < rs.radix_table_.size(); ++i) {
-      buffer.write(reinterpret_cast<const char*>(&rs.radix_table_[i]),
-                   sizeof(uint32_t));
-    }
+    buffer.write(reinterpret_cast<const char*>(rs.radix_table_.data()),
+                 radix_table_size * sizeof(uint32_t));
 
     // Spline points.
     const size_t spline_points_size = rs.spline_points_.size();
     buffer.write(reinterpret_cast<const char*>(&spline_points_size),
                  sizeof(size_t));
+    if constexpr (kPackedCoord) {
+      buffer.write(reinterpret_cast<const char*>(rs.spline_points_.data()),
+                   spline_points_size * sizeof(Coord<KeyType>));
+      return;
+    }
     for (size_t i = 0; i < rs.spline_points_.size(); ++i) {
       buffer.write(reinterpret_cast<const char*>(&rs.spline_points_[i].x),
                    sizeof(KeyType));
       buffer.write(reinterpret_cast<const char*>(&rs.spline_points_[i].y),
                    sizeof(double));
     }
-
-    bytes->append(buffer.str());
   }
 
-  static RadixSpline<KeyType> FromBytes(const std::string& bytes) {
-    std::istringstream in(bytes);
-
+  // Reads a model written by ToStream.
+  static RadixSpline<KeyType> FromStream(std::istream& in) {
     RadixSpline<KeyType> rs;
 
     // Scalar members.
@@ -63,14 +77,18 @@ class Serializer {
     size_t radix_table_size;
     in.read(reinterpret_cast<char*>(&radix_table_size), sizeof(size_t));
     rs.radix_table_.resize(radix_table_size);
-    for (int i = 0; i < rs.radix_table_.size(); ++i) {
-      in.read(reinterpret_cast<char*>(&rs.radix_table_[i]), sizeof(uint32_t));
-    }
+    in.read(reinterpret_cast<char*>(rs.radix_table_.data()),
+            radix_table_size * sizeof(uint32_t));
 
     // Spline points.
     size_t spline_points_size;
     in.read(reinterpret_cast<char*>(&spline_points_size), sizeof(size_t));
     rs.spline_points_.resize(spline_points_size);
+    if constexpr (kPackedCoord) {
+      in.read(reinterpret_cast<char*>(rs.spline_points_.data()),
+              spline_points_size * sizeof(Coord<KeyType>));
+      return rs;
+    }
     for (int i = 0; i < rs.spline_points_.size(); ++i) {
       in.read(reinterpret_cast<char*>(&rs.spline_points_[i].x),
               sizeof(KeyType));
@@ -1,12 +1,30 @@
 #ifndef INDEXES_HYBRID_STATIC_STATIC_INDEX_H_
 #define INDEXES_HYBRID_STATIC_STATIC_INDEX_H_
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include <algorithm>
+#include <cerrno>
+#include <cstdio>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <vector>
 
 #include "../../../ycsb_utils/structures.h"
 #include "../../../ycsb_utils/util_search.h"
+#include "../../tombstone.h"
+#include "./compressed_block.h"
+#include "./model_file.h"
 
+// The on-disk records are split into key-range partitions, each of which is
+// stored in a contiguous run of pages and indexed by its own model. A merge
+// only rewrites (and retrains) the partitions that receive new records.
+// A compressed partition is stored as CompressedBlocks of record_per_page_
+// records each, so the models still predict positions of fixed-size logical
+// pages; the byte offsets of its blocks are kept in memory.
 template <typename K, typename V>
 class StaticIndex {
  public:
@@ -20,96 +38,912 @@ class StaticIndex {
   struct param_t {
     std::string filename;
     uint64_t page_bytes;
+    // the number of pages per partition, 0: one partition for all records,
+    // i.e., every merge rewrites the whole file
+    uint64_t partition_pages = 0;
+    // store the models in <filename>.model after every merge and restore them
+    // instead of building the index if the file is valid
+    bool persist = false;
+    // store the partitions as CompressedBlocks, the records are decoded when
+    // they are fetched and updated out of place
+    bool compress = false;
+    // the partitions encoded and trained at the same time by StreamData,
+    // which only buffers their records
+    uint64_t build_threads = 1;
+  };
+
+  struct Partition {
+    uint64_t start_pid;
+    uint64_t page_num;  // also the capacity of the extent on disk
+    uint64_t data_num;
   };
 
   StaticIndex(param_t p) {
     data_file_ = p.filename;
+    model_file_ = p.filename + MODEL_FILE_SUFFIX;
     record_per_page_ = p.page_bytes / sizeof(Record_);
+    partition_records_ = p.partition_pages * record_per_page_;
+    persist_ = p.persist;
+    compress_ = p.compress;
+    build_threads_ = std::max<uint64_t>(1, p.build_threads);
     data_number_ = 0;
     fd = DirectIOOpen(p.filename);
   }
-  ~StaticIndex() { DirectIOClose(fd); }
+  virtual ~StaticIndex() {
+    if (pool_ != nullptr) {
+      pool_->InvalidateFile(fd);
+    }
+    DirectIOClose(fd);
+  }
 
-  inline ResultInfo<K, V> LowerBound(const SearchRange& range, const K key,
-                                     uint64_t length) {
+  inline ResultInfo<K, V> LowerBound(const SearchRange& search_range,
+                                     const K key, size_t partition_id) {
+    const Partition& part = partitions_[partition_id];
+    SearchRange range = {search_range.start,
+                         std::min(search_range.stop, part.data_num)};
 #ifdef CHECK_CORRECTION
-    FetchRange fetch_range =
-        GetFetchRange(range, record_per_page_, page_number_);
+    FetchRange fetch_range = GetFetchRange(range, record_per_page_,
+                                           GetPageNum(part.data_num) - 1);
     size_t s = fetch_range.pid_start * record_per_page_;
     size_t e = std::min((fetch_range.pid_end + 1) * record_per_page_ - 1,
-                        data_.size() - 1);
+                        data_[partition_id].size() - 1);
     auto it = std::lower_bound(
-        data_.begin() + s, data_.begin() + e + 1, key,
-        [](const auto& lhs, const K& key) { return lhs.first < key; });
-    if (data_[s].first > key || data_[e].first < key || it->first != key) {
+        data_[partition_id].begin() + s, data_[partition_id].begin() + e + 1,
+        key, [](const auto& lhs, const K& key) { return lhs.first < key; });
+    if (data_[partition_id][s].first > key ||
+        data_[partition_id][e].first < key || it->first != key) {
       std::cout << "the range given by the static index is wrong!\tlookup:"
-                << key << ",\tdata_[s].first:" << data_[s].first
-                << ",\tdata_[e].first:" << data_[e].first << std::endl;
-      std::cout << "s:" << s << ",\te:" << e << std::endl;
-      std::cout << "it->first:" << it->first << ",\tit->second:" << it->second
+                << key << ",\tpartition:" << partition_id
+                << ",\tdata_[s].first:" << data_[partition_id][s].first
+                << ",\tdata_[e].first:" << data_[partition_id][e].first
                 << std::endl;
+      std::cout << "s:" << s << ",\te:" << e << std::endl;
       std::cout << "range.start:" << range.start << ",\tstop:" << range.stop
                 << std::endl;
     }
 #endif
+    if (compress_) {
+      return BlockLowerBound(range, key, partition_id);
+    }
     int last_id = record_per_page_;
-    if ((range.stop - 1) / record_per_page_ == page_number_ - 1) {
-      last_id = last_page_id_;
+    if ((range.stop - 1) / record_per_page_ >= part.page_num - 1) {
+      last_id = part.data_num - record_per_page_ * (part.page_num - 1);
+    }
+    return NormalCoreLookup<K_, V_>(
+        fd, range, key, kWorstCase, record_per_page_,
+        part.start_pid + part.page_num - 1, GetBuffer(), last_id,
+        part.start_pid, pool_);
+  }
+
+  // Merge the sorted dy_data into the partitions they fall into. Only those
+  // partitions are read, rewritten and retrained through TrainPartition.
+  inline void MergeData(DataVec_& dy_data) {
+    if (partitions_.empty()) {
+      InitPartitions(dy_data);
+      if (persist_) {
+        SaveModel();
+      }
+      return;
+    }
+    uint64_t rewritten_pages = 0;
+    size_t dy_start = 0;
+    for (size_t p = 0; p < partitions_.size() && dy_start < dy_data.size();
+         p++) {
+      size_t dy_end = dy_data.size();
+      if (p + 1 < partitions_.size()) {
+        auto it = std::upper_bound(
+            dy_data.begin() + dy_start, dy_data.end(), partition_keys_[p],
+            [](const K& key, const auto& rhs) { return key < rhs.first; });
+        dy_end = it - dy_data.begin();
+      }
+      if (dy_end == dy_start) {
+        continue;
+      }
+      auto new_parts = MergePartition(p, dy_data, dy_start, dy_end);
+      for (size_t i = 0; i <= new_parts; i++) {
+        rewritten_pages += partitions_[p + i].page_num;
+      }
+      p += new_parts;
+      dy_start = dy_end;
+    }
+
+    // the replaced records and the dropped tombstones are not counted
+    data_number_ = 0;
+    for (auto& part : partitions_) {
+      data_number_ += part.data_num;
+    }
+    merge_num_++;
+    last_rewritten_pages_ = rewritten_pages;
+    total_rewritten_pages_ += rewritten_pages;
+    if (persist_) {
+      SaveModel();
+      ReleaseExtents();
     }
-    return NormalCoreLookup<K_, V_>(fd, range, key, kWorstCase,
-                                    record_per_page_, length, page_number_,
-                                    read_buf_, last_id);
+    ShrinkFile();
+#ifdef PRINT_PROCESSING_INFO
+    std::cout << "merge " << dy_data.size() << " records into "
+              << partitions_.size() << " partitions, rewritten pages:"
+              << rewritten_pages << ",\ttotal pages:" << GetTotalPages()
+              << std::endl;
+#endif
   }
 
-  inline void MergeData(DataVec_& dy_data, DataVec_& merged_data) {
+  // Build the index from the sorted records returned one by one by next,
+  // which returns false after the last one. The records are cut into
+  // partitions of partition_records_ as they arrive and each batch of
+  // build_threads_ partitions is stored and trained before the next one is
+  // read, so only a batch is held in memory. The tombstones are dropped as by
+  // DropTombstones. Without partitions, all the records are collected and
+  // built by MergeData.
+  template <typename NextFn>
+  inline void StreamData(NextFn next) {
+    if (!partitions_.empty()) {
+      throw std::runtime_error("StreamData over a built static index");
+    }
+    Record_ r, last_tombstone;
+    bool has_tombstone = false;
+    auto next_live = [&](Record_& r) {
+      while (next(r)) {
+        if (r.second != GetTombstone<V>()) {
+          return true;
+        }
+        last_tombstone = r;
+        has_tombstone = true;
+      }
+      return false;
+    };
+    if (partition_records_ == 0) {
+      DataVec_ data;
+      while (next_live(r)) {
+        data.push_back(r);
+      }
+      if (data.empty() && has_tombstone) {
+        data.push_back(last_tombstone);
+      }
+      if (!data.empty()) {
+        MergeData(data);
+      }
+      return;
+    }
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-    merged_data = DataVec_(dy_data.size() + size());
+    std::vector<DataVec_> batch(build_threads_);
+    bool more = true;
+    while (more) {
+      size_t num = 0;
+      while (num < build_threads_ && more) {
+        batch[num].clear();
+        while (batch[num].size() < partition_records_ &&
+               (more = next_live(r))) {
+          batch[num].push_back(r);
+        }
+        if (!batch[num].empty()) {
+          num++;
+        }
+      }
+      if (num == 0 && partitions_.empty() && has_tombstone) {
+        // every record has been deleted, keep a partition
+        batch[num++].push_back(last_tombstone);
+      }
+      AppendPartitions(batch, num);
+    }
+    if (!partitions_.empty()) {
+      partition_keys_.back() = std::numeric_limits<K>::max();
+    }
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
     if (merge_cnt >= 0) {
-      init_lat +=
+      store_disk_lat +=
           std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
               .count();
     }
+    merge_cnt++;
 #endif
-    if (size() > 0) {
-#ifdef BREAKDOWN
-      start = std::chrono::high_resolution_clock::now();
+    if (persist_) {
+      SaveModel();
+    }
+#ifdef PRINT_PROCESSING_INFO
+    std::cout << "stream " << data_number_ << " records into "
+              << partitions_.size() << " partitions with " << build_threads_
+              << " threads" << std::endl;
 #endif
-      GetDataVector(merged_data);
+  }
+
+  virtual void Build(DataVec_& new_data) = 0;
+
+  inline V FindData(const SearchRange& range, const K_ key,
+                    size_t partition_id) {
+    ResultInfo<K_, V_> res = LowerBound(range, key, partition_id);
+    if (res.res != key) {
+      // a missing key, e.g., a deleted one
+      return std::numeric_limits<V_>::max();
+    }
+    return res.val;
+  }
+
+  // Lookup a batch of keys whose search ranges have been predicted by the
+  // models. The fetched pages are sorted and deduplicated, the overlapping or
+  // adjacent ones are merged into a single read, and all the reads of a round
+  // are issued together before the last-mile search of each key.
+  inline void FindDataBatch(const std::vector<K>& keys,
+                            const std::vector<SearchRange>& ranges,
+                            const std::vector<size_t>& partition_ids,
+                            std::vector<V>& vals) {
+    if (compress_) {
+      // the blocks are not aligned to the pages, look them up one by one
+      vals.resize(keys.size());
+      for (size_t i = 0; i < keys.size(); i++) {
+        vals[i] = FindData(ranges[i], keys[i], partition_ids[i]);
+      }
+      return;
+    }
+    struct BatchFetch {
+      uint64_t pid_start;
+      uint64_t pid_end;
+      int last_id;
+      size_t key_idx;
+      size_t extent_idx;
+    };
+    size_t num = keys.size();
+    vals.resize(num);
+    std::vector<BatchFetch> fetches(num);
+    for (size_t i = 0; i < num; i++) {
+      const Partition& part = partitions_[partition_ids[i]];
+      SearchRange range = {ranges[i].start,
+                           std::min(ranges[i].stop, part.data_num)};
+      FetchRange fetch_range =
+          GetFetchRange(range, record_per_page_, part.page_num - 1);
+      fetch_range.pid_start =
+          std::min(fetch_range.pid_start, fetch_range.pid_end);
+      int last_id = record_per_page_;
+      if (fetch_range.pid_end >= part.page_num - 1) {
+        last_id = part.data_num - record_per_page_ * (part.page_num - 1);
+      }
+      fetches[i] = {part.start_pid + fetch_range.pid_start,
+                    part.start_pid + fetch_range.pid_end, last_id, i, 0};
+    }
+    std::sort(fetches.begin(), fetches.end(),
+              [](const auto& lhs, const auto& rhs) {
+                return lhs.pid_start < rhs.pid_start ||
+                       (lhs.pid_start == rhs.pid_start &&
+                        lhs.pid_end < rhs.pid_end);
+              });
+
+    size_t page_bytes = record_per_page_ * sizeof(Record_);
+    uint64_t gap_cnt = sizeof(Record_) / sizeof(K);
+    K* buf = GetBuffer();
+    size_t i = 0;
+    while (i < num) {
+      // merge the fetched pages until the buffer is full
+      std::vector<std::pair<uint64_t, uint64_t>> extents;  // {first, last}
+      uint64_t buf_pages = 0;
+      size_t j = i;
+      for (; j < num; j++) {
+        auto& f = fetches[j];
+        if (!extents.empty() && f.pid_start <= extents.back().second + 1) {
+          uint64_t pid_end = std::max(extents.back().second, f.pid_end);
+          if (buf_pages + pid_end - extents.back().second >
+              ALLOCATED_BUF_SIZE) {
+            break;
+          }
+          buf_pages += pid_end - extents.back().second;
+          extents.back().second = pid_end;
+        } else {
+          uint64_t page_num = f.pid_end - f.pid_start + 1;
+          if (!extents.empty() && buf_pages + page_num > ALLOCATED_BUF_SIZE) {
+            break;
+          }
+          extents.push_back({f.pid_start, f.pid_end});
+          buf_pages += page_num;
+        }
+        f.extent_idx = extents.size() - 1;
+      }
+
+      std::vector<IORequest> reqs(extents.size());
+      std::vector<uint64_t> extent_offsets(extents.size());
+      uint64_t offset = 0;
+      for (size_t k = 0; k < extents.size(); k++) {
+        uint64_t page_num = extents[k].second - extents[k].first + 1;
+        extent_offsets[k] = offset;
+        reqs[k] = {fd, buf + offset * record_per_page_ * gap_cnt,
+                   page_num * page_bytes, extents[k].first * page_bytes};
+        offset += page_num;
+      }
+      ReadBatch(reqs);
+
+      for (; i < j; i++) {
+        const auto& f = fetches[i];
+        K* data = buf + (extent_offsets[f.extent_idx] + f.pid_start -
+                         extents[f.extent_idx].first) *
+                            record_per_page_ * gap_cnt;
+        uint64_t idx = LastMileSearch(
+            data, record_per_page_ * (f.pid_end - f.pid_start) + f.last_id,
+            gap_cnt, keys[f.key_idx]);
+        vals[f.key_idx] = *(data + idx * gap_cnt) == keys[f.key_idx]
+                              ? *(data + idx * gap_cnt + 1)
+                              : std::numeric_limits<V>::max();
+      }
+    }
+  }
+
+  inline bool UpdateData(const SearchRange& range, const K_ key,
+                         const V_ value, size_t partition_id) {
+    if (compress_) {
+      // a compressed block cannot be rewritten in place
+      return false;
+    }
+    ResultInfo<K_, V_> res = LowerBound(range, key, partition_id);
+    if (res.res != key || res.val == GetTombstone<V_>()) {
+      // a missing or deleted key is not brought back by an update
+      return false;
+    }
+    return Update1Page(res.fd, res.pid, res.idx, key, value,
+                       record_per_page_ * sizeof(Record_), GetBuffer(), pool_);
+  }
+
+  // append the first length records from the lower bound of key on to out,
+  // the scan continues with the following partitions
+  inline void ScanData(SearchRange range, const K key, const int length,
+                       size_t partition_id, DataVec_& out) {
+    const Partition& part = partitions_[partition_id];
+    // a missing key past the last record may be predicted out of the data
+    range.start = std::min(range.start, part.data_num - 1);
+    if (!compress_) {
+      ScanPages(range, key, length, partition_id, out);
+      return;
+    }
+    ResultInfo<K, V> res = LowerBound(range, key, partition_id);
+    uint64_t pos = (res.pid - part.start_pid) * record_per_page_ + res.idx;
+    uint64_t skip = 0;
+    if (res.res < key) {
+      pos++;
+    } else if (res.res > key && pos > 0 &&
+               pos == range.start / record_per_page_ * record_per_page_) {
+      // the lower bound of a missing key may be just before the predicted
+      // range, also read the page before it
+      skip = std::min<uint64_t>(pos, record_per_page_);
+      pos -= skip;
+    }
+    size_t init_size = out.size();
+    ScanPartitions(partition_id, pos, length + skip, out);
+    auto it = std::lower_bound(
+        out.begin() + init_size, out.end(), key,
+        [](const auto& lhs, const K& key) { return lhs.first < key; });
+    out.erase(out.begin() + init_size, it);
+    if (out.size() > init_size + length) {
+      out.resize(init_size + length);
+    }
+  }
+
+  inline size_t GetPartitionID(const K key) const {
+    auto it =
+        std::lower_bound(partition_keys_.begin(), partition_keys_.end(), key);
+    if (it == partition_keys_.end()) {
+      return partition_keys_.size() - 1;
+    }
+    return it - partition_keys_.begin();
+  }
+
+  inline size_t GetPartitionNum() const { return partitions_.size(); }
+
+  // the pages of a buffer that streams this index into a merged one over
+  // data_num records with the same parameters, at most MERGE_CHUNK_PAGES
+  // pages are read or written at a time through it, and at least those of a
+  // compressed block
+  inline uint64_t GetBufferPages(uint64_t data_num) const {
+    uint64_t pages = 0;
+    for (const auto& part : partitions_) {
+      pages = std::max(pages, part.page_num);
+    }
+    uint64_t num = partition_records_ == 0
+                       ? data_num
+                       : std::min<uint64_t>(data_num, partition_records_);
+    uint64_t new_pages = GetPageNum(num), min_pages = 1;
+    if (compress_) {
+      size_t page_bytes = record_per_page_ * sizeof(Record_);
+      size_t block_bytes = CompressedBlock<K, V>::GetMaxBytes(record_per_page_);
+      new_pages = (new_pages * block_bytes + page_bytes - 1) / page_bytes;
+      // a block may start anywhere in a page
+      min_pages = (block_bytes + page_bytes - 1) / page_bytes + 1;
+    }
+    return std::max(min_pages,
+                    std::min<uint64_t>(std::max(pages, new_pages),
+                                       MERGE_CHUNK_PAGES));
+  }
+
+  // the bytes that StreamData holds to build an index over data_num records
+  // with the same parameters: the records of a batch of partitions, or all
+  // of them without partitions, and their blocks if compressed
+  inline size_t GetStreamBytes(uint64_t data_num) const {
+    uint64_t num =
+        partition_records_ == 0
+            ? data_num
+            : std::min<uint64_t>(data_num, build_threads_ * partition_records_);
+    return num * sizeof(Record_) * (compress_ ? 2 : 1);
+  }
+
+  inline bool IsCompressed() const { return compress_; }
+
+  // the bytes of the records on disk
+  inline size_t GetDiskBytes() const {
+    if (compress_) {
+      return GetTotalPages() * record_per_page_ * sizeof(Record_);
+    }
+    return sizeof(Record_) * size();
+  }
+
+  inline void PrintMergeInfo() const {
+    std::cout << "\t\tpartitions:" << partitions_.size()
+              << ",\tfile pages:" << file_pages_
+              << ",\tdata pages:" << GetTotalPages()
+              << ",\tmerge cnt:" << merge_num_
+              << ",\tlast rewritten pages:" << last_rewritten_pages_
+              << ",\tavg rewritten pages:"
+              << (merge_num_ ? total_rewritten_pages_ * 1.0 / merge_num_ : 0)
+              << std::endl;
+  }
+
 #ifdef BREAKDOWN
-      end = std::chrono::high_resolution_clock::now();
-      if (merge_cnt >= 0) {
-        get_static_data_lat +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-                .count();
+  inline void Breakdown() {
+    if (merge_cnt > 0) {
+      std::cout << "init_lat:" << init_lat / merge_cnt / 1e6 << " ms"
+                << std::endl;
+      std::cout << "get_static_data_lat:"
+                << get_static_data_lat / merge_cnt / 1e6 << " ms" << std::endl;
+      std::cout << "split_data_lat:" << split_data_lat / merge_cnt / 1e6
+                << " ms" << std::endl;
+      std::cout << "store_disk_lat:" << store_disk_lat / merge_cnt / 1e6
+                << " ms" << std::endl;
+    }
+  }
+#endif
+
+  inline size_t size() const { return data_number_; }
+
+  // use a private read/write buffer of buf_pages pages instead of the global
+  // read_buf_, e.g., when the index is built by a background merge thread
+  inline void SetBuffer(K* buf, uint64_t buf_pages = MAX_READ_PAGES) {
+    buf_ = buf;
+    buf_pages_ = buf == nullptr ? MAX_READ_PAGES : buf_pages;
+  }
+
+  // cache the pages read by lookups, nullptr: always read from disk
+  inline void SetBufferPool(BufferPool* pool) { pool_ = pool; }
+
+  // Read the records of a partition from the pos-th one, which starts a
+  // page, into data through buf of buf_pages pages, at most buf_pages pages
+  // of them, e.g., to stream them into a new index a chunk at a time. Return
+  // the position after them, data is empty past the last record.
+  inline uint64_t ExportPartition(size_t partition_id, uint64_t pos,
+                                  uint64_t buf_pages, K* buf,
+                                  DataVec_& data) const {
+    const Partition& part = partitions_[partition_id];
+    data.clear();
+    if (pos >= part.data_num) {
+      return pos;
+    }
+    uint64_t first_page = pos / record_per_page_;
+    if (!compress_) {
+      uint64_t page_num = std::min(buf_pages, part.page_num - first_page);
+      data.resize(std::min(part.data_num - pos, page_num * record_per_page_));
+      GetAllData<K, V>(fd, part.start_pid + first_page, page_num,
+                       record_per_page_, data.size(), buf, data, buf_pages);
+      return pos + data.size();
+    }
+    size_t last = GetLastBlock(partition_id, first_page, buf_pages);
+    const char* blocks = ReadBlocks(partition_id, first_page, last, buf, nullptr);
+    const auto& offsets = block_offsets_[partition_id];
+    for (size_t b = first_page; b <= last; b++) {
+      CompressedBlock<K, V>(blocks + offsets[b] - offsets[first_page])
+          .Decode(0, record_per_page_, data);
+    }
+    return pos + data.size();
+  }
+
+  inline void DeleteFile() const {
+    DeleteDataFile();
+    std::remove(model_file_.c_str());
+  }
+
+  // remove the data file but keep the model file, e.g., after another index
+  // has stored its models in it by SaveModelAs
+  inline void DeleteDataFile() const {
+    if (pool_ != nullptr) {
+      pool_->InvalidateFile(fd);
+    }
+    DirectIORemove(data_file_);
+  }
+
+  inline const std::string& GetDataFile() const { return data_file_; }
+
+  // Store the models in the model file of filename, e.g., to install the
+  // index built by a background merge in place of the replaced one. The model
+  // file names its data file, so its rename is the only commit point: a crash
+  // leaves either the old models with the old data file or the new ones with
+  // this one.
+  inline void SaveModelAs(const std::string& filename) {
+    std::string old_model_file = model_file_;
+    model_file_ = filename + MODEL_FILE_SUFFIX;
+    SaveModel();
+    if (old_model_file != model_file_ &&
+        std::remove(old_model_file.c_str()) != 0 && errno != ENOENT) {
+      throw std::runtime_error("remove error in SaveModelAs");
+    }
+  }
+
+  // Store the name of the data file, the partitions and their models in the
+  // model file, which describes the current content of the data file. The
+  // file is written aside and renamed, and the extents freed by a merge are
+  // not reused before that, so a crash leaves either the old or the new
+  // models with their records.
+  inline void SaveModel() const {
+    // the new models no longer use the pending extents
+    auto free_extents = free_extents_;
+    uint64_t file_pages = file_pages_;
+    for (auto& extent : pending_extents_) {
+      InsertExtent(free_extents, file_pages, extent.first, extent.second);
+    }
+    std::ostringstream out;
+    WriteVector(out, std::vector<char>(data_file_.begin(), data_file_.end()));
+    WriteValue(out, data_number_);
+    WriteValue(out, file_pages);
+    WriteValue(out, partition_records_);
+    WriteVector(out, partitions_);
+    WriteVector(out, partition_keys_);
+    WriteVector(out, free_extents);
+    for (size_t p = 0; p < partitions_.size() && compress_; p++) {
+      WriteVector(out, block_offsets_[p]);
+    }
+    for (size_t p = 0; p < partitions_.size(); p++) {
+      SavePartition(p, out);
+    }
+    std::string payload = out.str();
+
+    ModelFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = MODEL_FILE_MAGIC;
+    header.version = MODEL_FILE_VERSION;
+    header.record_bytes = sizeof(Record_);
+    header.page_bytes = record_per_page_ * sizeof(Record_);
+    header.payload_bytes = payload.size();
+    header.flags = compress_ ? MODEL_FILE_COMPRESSED : 0;
+    header.checksum = ModelChecksum(payload.data(), payload.size());
+    strncpy(header.index_name, GetIndexName().c_str(),
+            sizeof(header.index_name) - 1);
+    header.partition_records = partition_records_;
+    GetHeaderParams(header.model_params);
+
+    // the models must not describe pages that are not on disk yet
+    DirectIOSync(fd);
+    const std::string& model_file = model_file_;
+    std::string tmp_file = model_file + ".tmp";
+    int model_fd = open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (model_fd == -1) {
+      throw std::runtime_error("open file error in SaveModel");
+    }
+    if (write(model_fd, &header, sizeof(header)) != sizeof(header) ||
+        write(model_fd, payload.data(), payload.size()) !=
+            static_cast<ssize_t>(payload.size()) ||
+        fsync(model_fd) != 0) {
+      close(model_fd);
+      throw std::runtime_error("write error in SaveModel");
+    }
+    if (close(model_fd) != 0) {
+      throw std::runtime_error("close error in SaveModel");
+    }
+    if (std::rename(tmp_file.c_str(), model_file.c_str()) != 0) {
+      throw std::runtime_error("rename error in SaveModel");
+    }
+    // make the rename durable before the old extents are reused
+    size_t slash = model_file.rfind('/');
+    std::string dir =
+        slash == std::string::npos ? "." : model_file.substr(0, slash + 1);
+    int dir_fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (dir_fd == -1 || fsync(dir_fd) != 0) {
+      if (dir_fd != -1) {
+        close(dir_fd);
       }
+      throw std::runtime_error("fsync error in SaveModel");
+    }
+    close(dir_fd);
+  }
+
+  // Restore the partitions and models stored by SaveModel. The model file is
+  // mapped read-only and the models are copied out of the mapping in bulk,
+  // nothing is retrained. Return false if persisting is disabled or the file
+  // is missing or invalid, the index must then be built.
+  inline bool LoadModel() {
+    if (!persist_) {
+      return false;
+    }
+    const std::string& model_file = model_file_;
+    int model_fd = open(model_file.c_str(), O_RDONLY);
+    if (model_fd == -1) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(model_fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(ModelFileHeader)) {
+      close(model_fd);
+      std::cout << "invalid model file:" << model_file << std::endl;
+      return false;
+    }
+    size_t bytes = st.st_size;
+    void* addr =
+        mmap(NULL, bytes, PROT_READ, MAP_PRIVATE | MAP_POPULATE, model_fd, 0);
+    close(model_fd);
+    if (addr == MAP_FAILED) {
+      throw std::runtime_error("mmap error in LoadModel");
+    }
+    const char* data = reinterpret_cast<const char*>(addr);
+    const ModelFileHeader* header =
+        reinterpret_cast<const ModelFileHeader*>(data);
+    const char* payload = data + sizeof(ModelFileHeader);
+    std::string reason;
+    double model_params[MODEL_FILE_MAX_PARAMS];
+    GetHeaderParams(model_params);
+    if (header->magic != MODEL_FILE_MAGIC ||
+        header->version != MODEL_FILE_VERSION) {
+      reason = "unknown format";
+    } else if (header->record_bytes != sizeof(Record_) ||
+               header->page_bytes != record_per_page_ * sizeof(Record_) ||
+               header->flags != (compress_ ? MODEL_FILE_COMPRESSED : 0) ||
+               strncmp(header->index_name, GetIndexName().c_str(),
+                       sizeof(header->index_name) - 1) != 0 ||
+               header->partition_records != partition_records_ ||
+               !std::equal(model_params, model_params + MODEL_FILE_MAX_PARAMS,
+                           header->model_params)) {
+      reason = "built with other parameters";
+    } else if (header->payload_bytes != bytes - sizeof(ModelFileHeader) ||
+               header->checksum !=
+                   ModelChecksum(payload, header->payload_bytes)) {
+      reason = "checksum mismatch";
+    }
+    if (!reason.empty()) {
+      munmap(addr, bytes);
+      std::cout << "invalid model file:" << model_file << ", " << reason
+                << std::endl;
+      return false;
+    }
+
+    MemoryStreamBuf buf(payload, header->payload_bytes);
+    std::istream in(&buf);
+    std::vector<char> stored_file;
+    ReadVector(in, stored_file);
+    ReadValue(in, data_number_);
+    ReadValue(in, file_pages_);
+    ReadValue(in, partition_records_);
+    ReadVector(in, partitions_);
+    ReadVector(in, partition_keys_);
+    ReadVector(in, free_extents_);
+    block_offsets_.assign(partitions_.size(), {});
+    for (size_t p = 0; p < partitions_.size() && compress_; p++) {
+      ReadVector(in, block_offsets_[p]);
+    }
+    InsertPartitions(0, partitions_.size());
+    for (size_t p = 0; p < partitions_.size(); p++) {
+      LoadPartition(p, in);
+    }
+    bool valid = in.good();
+    munmap(addr, bytes);
+    if (!valid) {
+      throw std::runtime_error("truncated model file in LoadModel");
+    }
+    std::string data_file(stored_file.begin(), stored_file.end());
+    if (data_file != data_file_) {
+      // the models refer to the data file written by the last merge, the one
+      // under the configured name is left over or has just been created
+      DirectIOClose(fd);
+      DirectIORemove(data_file_);
+      data_file_ = data_file;
+      fd = DirectIOOpen(data_file_);
+    }
+    if (DirectIOFileBytes(fd) <
+        file_pages_ * record_per_page_ * sizeof(Record_)) {
+      throw std::runtime_error("the data file is shorter than its models");
+    }
+#ifdef CHECK_CORRECTION
+    data_ = std::vector<DataVec_>(partitions_.size());
+    for (size_t p = 0; p < partitions_.size(); p++) {
+      data_[p].resize(partitions_[p].data_num);
+      ReadPartition(p, GetBuffer(), data_[p]);
+    }
+#endif
+    std::cout << "load the static index from " << model_file << ", "
+              << partitions_.size() << " partitions, " << data_number_
+              << " records" << std::endl;
+    return true;
+  }
+
+  virtual size_t GetStaticInitSize(DataVec_& data) const = 0;
+
+  virtual size_t GetNodeSize() const = 0;
+  virtual size_t GetTotalSize() const = 0;
+
+  virtual std::string GetIndexName() const { return name_; }
+  // the parameters that the models are trained with, e.g., the error bound
+  virtual std::vector<double> GetModelParams() const = 0;
+
+ protected:
+  // (re)train the model of the given partition over its records, whose
+  // positions start from 0. Different partitions may be trained at the same
+  // time by StreamData.
+  virtual void TrainPartition(size_t partition_id, DataVec_& data) = 0;
+  // insert num empty models before the given position
+  virtual void InsertPartitions(size_t pos, size_t num) = 0;
+  // write/restore the model of the given partition for the model file
+  virtual void SavePartition(size_t partition_id, std::ostream& out) const = 0;
+  virtual void LoadPartition(size_t partition_id, std::istream& in) = 0;
+
+ private:
+  // the model parameters in the fixed-size array of the model file header
+  inline void GetHeaderParams(double* params) const {
+    std::vector<double> model_params = GetModelParams();
+    if (model_params.size() > MODEL_FILE_MAX_PARAMS) {
+      throw std::runtime_error("too many model parameters for the model file");
+    }
+    std::fill(params, params + MODEL_FILE_MAX_PARAMS, 0);
+    std::copy(model_params.begin(), model_params.end(), params);
+  }
+
+  template <typename T>
+  static inline void WriteValue(std::ostream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  static inline void ReadValue(std::istream& in, T& value) {
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+  }
+
+  template <typename T>
+  static inline void WriteVector(std::ostream& out, const std::vector<T>& vec) {
+    WriteValue(out, vec.size());
+    out.write(reinterpret_cast<const char*>(vec.data()), vec.size() * sizeof(T));
+  }
+
+  template <typename T>
+  static inline void ReadVector(std::istream& in, std::vector<T>& vec) {
+    size_t size = 0;
+    ReadValue(in, size);
+    vec.resize(size);
+    in.read(reinterpret_cast<char*>(vec.data()), size * sizeof(T));
+  }
+
+  inline void InitPartitions(DataVec_& data) {
+#ifdef BREAKDOWN
+    auto start = std::chrono::high_resolution_clock::now();
 #endif
+    size_t part_num = GetSplitNum(data.size());
+    size_t sub_items = std::ceil(data.size() * 1.0 / part_num);
+    partitions_.clear();
+    partition_keys_.clear();
+    block_offsets_.assign(part_num, {});
+    InsertPartitions(0, part_num);
+#ifdef CHECK_CORRECTION
+    data_ = std::vector<DataVec_>(part_num);
+#endif
+    for (size_t i = 0; i < part_num; i++) {
+      size_t s = i * sub_items;
+      size_t e = std::min(s + sub_items, data.size());
+      DataVec_ sub_data(data.begin() + s, data.begin() + e);
+      std::vector<char> blocks;
+      uint64_t page_num = EncodePartition(sub_data, blocks, block_offsets_[i]);
+      partitions_.push_back({file_pages_, page_num, sub_data.size()});
+      partition_keys_.push_back(i + 1 == part_num
+                                    ? std::numeric_limits<K>::max()
+                                    : sub_data.back().first);
+      file_pages_ += page_num;
+      StorePartition(i, sub_data, blocks);
+      TrainPartition(i, sub_data);
+    }
+    data_number_ = data.size();
+#ifdef BREAKDOWN
+    auto end = std::chrono::high_resolution_clock::now();
+    if (merge_cnt >= 0) {
+      store_disk_lat +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count();
+    }
+    merge_cnt++;
+#endif
+  }
+
+  // store the first num partitions of batch after the existing ones and train
+  // their models, the encoding and the training run in parallel
+  inline void AppendPartitions(std::vector<DataVec_>& batch, size_t num) {
+    size_t first = partitions_.size();
+    InsertPartitions(first, num);
+    block_offsets_.resize(first + num);
+#ifdef CHECK_CORRECTION
+    data_.resize(first + num);
+#endif
+    std::vector<std::vector<char>> blocks(num);
+    std::vector<uint64_t> page_nums(num);
+#pragma omp parallel for num_threads(build_threads_)
+    for (size_t i = 0; i < num; i++) {
+      page_nums[i] =
+          EncodePartition(batch[i], blocks[i], block_offsets_[first + i]);
+    }
+    // the pages are written through the shared buffer one partition at a time
+    for (size_t i = 0; i < num; i++) {
+      partitions_.push_back({file_pages_, page_nums[i], batch[i].size()});
+      partition_keys_.push_back(batch[i].back().first);
+      file_pages_ += page_nums[i];
+      data_number_ += batch[i].size();
+      StorePartition(first + i, batch[i], blocks[i]);
     }
+    // the models of different partitions are independent
+#pragma omp parallel for num_threads(build_threads_)
+    for (size_t i = 0; i < num; i++) {
+      TrainPartition(first + i, batch[i]);
+    }
+  }
 
+  // merge dy_data[dy_start, dy_end) into partition p, returns the number of
+  // partitions split from p
+  inline size_t MergePartition(size_t p, DataVec_& dy_data, size_t dy_start,
+                               size_t dy_end) {
+#ifdef BREAKDOWN
+    auto start = std::chrono::high_resolution_clock::now();
+#endif
+    Partition part = partitions_[p];
+    DataVec_ merged_data(part.data_num + dy_end - dy_start);
 #ifdef BREAKDOWN
+    auto end = std::chrono::high_resolution_clock::now();
+    if (merge_cnt >= 0) {
+      init_lat +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count();
+    }
+    start = std::chrono::high_resolution_clock::now();
+#endif
+    ReadPartition(p, GetBuffer(), merged_data);
+#ifdef BREAKDOWN
+    end = std::chrono::high_resolution_clock::now();
+    if (merge_cnt >= 0) {
+      get_static_data_lat +=
+          std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+              .count();
+    }
     start = std::chrono::high_resolution_clock::now();
 #endif
-    int cnt = merged_data.size() - 1, i = dy_data.size() - 1, j = size() - 1;
-    while (i >= 0 && j >= 0) {
+    int64_t cnt = merged_data.size() - 1, i = dy_end - 1, j = part.data_num - 1;
+    while (i >= static_cast<int64_t>(dy_start) && j >= 0) {
       if (dy_data[i].first < merged_data[j].first) {
         merged_data[cnt--] = merged_data[j--];
       } else {
+        if (dy_data[i].first == merged_data[j].first) {
+          // the newer record or tombstone replaces the stored one
+          j--;
+        }
         merged_data[cnt--] = dy_data[i--];
       }
     }
-
-    while (i >= 0) {
+    while (i >= static_cast<int64_t>(dy_start)) {
       merged_data[cnt--] = dy_data[i--];
     }
+    // the replaced records leave a gap between the stored records that are
+    // still in place and the merged ones
+    merged_data.erase(merged_data.begin() + j + 1,
+                      merged_data.begin() + cnt + 1);
+    DropTombstones(merged_data);
+    FreeExtent(part.start_pid, part.page_num);
 
-    data_number_ = merged_data.size();
-    page_number_ = std::ceil(data_number_ * 1.0 / record_per_page_);
-    last_page_id_ =
-        record_per_page_ - (page_number_ * record_per_page_ - data_number_);
-
+    // split the partition if it has grown too large
+    size_t split_num = GetSplitNum(merged_data.size());
+    if (split_num > 1) {
+      InsertPartitions(p + 1, split_num - 1);
+      partitions_.insert(partitions_.begin() + p + 1, split_num - 1,
+                         Partition());
+      partition_keys_.insert(partition_keys_.begin() + p, split_num - 1, K());
+      block_offsets_.insert(block_offsets_.begin() + p + 1, split_num - 1,
+                            std::vector<uint64_t>());
+#ifdef CHECK_CORRECTION
+      data_.insert(data_.begin() + p + 1, split_num - 1, DataVec_());
+#endif
+    }
 #ifdef BREAKDOWN
     end = std::chrono::high_resolution_clock::now();
     if (merge_cnt >= 0) {
@@ -119,8 +953,27 @@ class StaticIndex {
     }
     start = std::chrono::high_resolution_clock::now();
 #endif
-    DirectIOWrite(fd, merged_data, record_per_page_ * sizeof(Record_),
-                  page_number_, read_buf_);
+    size_t sub_items = std::ceil(merged_data.size() * 1.0 / split_num);
+    for (size_t k = 0; k < split_num; k++) {
+      size_t s = k * sub_items;
+      size_t e = std::min(s + sub_items, merged_data.size());
+      DataVec_ sub_data;
+      if (split_num > 1) {
+        sub_data = DataVec_(merged_data.begin() + s, merged_data.begin() + e);
+      } else {
+        sub_data.swap(merged_data);
+      }
+      std::vector<char> blocks;
+      uint64_t page_num =
+          EncodePartition(sub_data, blocks, block_offsets_[p + k]);
+      partitions_[p + k] = {AllocateExtent(page_num), page_num,
+                            sub_data.size()};
+      if (k + 1 < split_num) {
+        partition_keys_[p + k] = sub_data.back().first;
+      }
+      StorePartition(p + k, sub_data, blocks);
+      TrainPartition(p + k, sub_data);
+    }
 #ifdef BREAKDOWN
     end = std::chrono::high_resolution_clock::now();
     if (merge_cnt >= 0) {
@@ -130,85 +983,388 @@ class StaticIndex {
     }
     merge_cnt++;
 #endif
+    return split_num - 1;
+  }
+
+  // append the next length records to out, starting from the pos-th record
+  // of the given partition. The pages of different partitions are not
+  // contiguous, they are fetched as a batch of independent reads.
+  inline void ScanPartitions(size_t partition_id, uint64_t pos,
+                             uint64_t length, DataVec_& out) {
+    if (compress_) {
+      ScanBlocks(partition_id, pos, length, out);
+      return;
+    }
+    size_t page_bytes = record_per_page_ * sizeof(Record_);
+    uint64_t gap_cnt = sizeof(Record_) / sizeof(K);
+    K* buf = GetBuffer();
+    std::vector<IORequest> reqs;
+    std::vector<std::pair<uint64_t, uint64_t>> records;  // {offset, num}
+    uint64_t buf_pages = 0;
+    for (size_t p = partition_id; p < partitions_.size() && length; p++) {
+      const Partition& part = partitions_[p];
+      if (pos >= part.data_num) {
+        pos = 0;
+        continue;
+      }
+      uint64_t num = std::min(length, part.data_num - pos);
+      uint64_t first_page = pos / record_per_page_;
+      uint64_t page_num = (pos + num - 1) / record_per_page_ - first_page + 1;
+      reqs.push_back({fd, buf + buf_pages * page_bytes / sizeof(K),
+                      page_num * page_bytes,
+                      (part.start_pid + first_page) * page_bytes});
+      records.push_back(
+          {buf_pages * record_per_page_ + pos % record_per_page_, num});
+      buf_pages += page_num;
+      length -= num;
+      pos = 0;
+    }
+    ReadBatch(reqs);
+
+    for (auto& r : records) {
+      for (uint64_t i = 0; i < r.second; i++) {
+        out.push_back({*(buf + (r.first + i) * gap_cnt),
+                       *(buf + (r.first + i) * gap_cnt + 1)});
+      }
+    }
+  }
+
+  // Append the first length records from the lower bound of key on to out.
+  // The pages of the predicted range are read together with the ones that
+  // the length records from it may take, so the search and the scan share
+  // one read, and only a scan past the end of the partition fetches more.
+  inline void ScanPages(const SearchRange& range, const K key,
+                        const uint64_t length, size_t partition_id,
+                        DataVec_& out) {
+    const Partition& part = partitions_[partition_id];
+    const uint64_t page_bytes = record_per_page_ * sizeof(Record_);
+    Record_* buf = reinterpret_cast<Record_*>(GetBuffer());
+    uint64_t first_page = range.start / record_per_page_;
+    uint64_t end =
+        std::min(part.data_num, std::min(range.stop, part.data_num) + length);
+    while (true) {
+      uint64_t page_num = (end - 1) / record_per_page_ - first_page + 1;
+      ReadPages<K>(fd, page_bytes, page_num,
+                   (part.start_pid + first_page) * page_bytes, GetBuffer(),
+                   pool_);
+      // the lower bound of a missing key may be just out of the predicted
+      // range, also read the page before or after it
+      if (first_page > 0 && buf[0].first > key) {
+        first_page--;
+      } else if (end < part.data_num &&
+                 buf[end - 1 - first_page * record_per_page_].first < key) {
+        end = std::min(part.data_num, end + record_per_page_);
+      } else {
+        break;
+      }
+    }
+    Record_* last = buf + end - first_page * record_per_page_;
+    Record_* it = std::lower_bound(
+        buf, last, key,
+        [](const auto& lhs, const K& key) { return lhs.first < key; });
+    uint64_t num = std::min<uint64_t>(length, last - it);
+    out.insert(out.end(), it, it + num);
+    if (num < length) {
+      ScanPartitions(partition_id, end, length - num, out);
+    }
+  }
 
+  // store the records, or their blocks if the partition is compressed
+  inline void StorePartition(size_t partition_id, const DataVec_& data,
+                             const std::vector<char>& blocks) {
+    const Partition& part = partitions_[partition_id];
+    size_t page_bytes = record_per_page_ * sizeof(Record_);
+    if (compress_) {
+      DirectIOWrite(fd, blocks, page_bytes, part.page_num, GetBuffer(),
+                    part.start_pid * page_bytes, buf_pages_);
+    } else {
+      DirectIOWrite(fd, data, page_bytes, part.page_num, GetBuffer(),
+                    part.start_pid * page_bytes, buf_pages_);
+    }
+    if (pool_ != nullptr) {
+      pool_->Invalidate(fd, part.start_pid, part.page_num);
+    }
 #ifdef CHECK_CORRECTION
-    DataVec_ stored;
-    GetDataVector(stored);
+    DataVec_ stored(part.data_num);
+    ReadPartition(partition_id, GetBuffer(), stored);
     for (size_t i = 0; i < stored.size(); i++) {
-      if (stored[i].first != stored_data[i].first) {
-        std::cout << "store " << i
+      if (stored[i].first != data[i].first) {
+        std::cout << "partition " << partition_id << " store " << i
                   << " wrong!\tstored[i].first:" << stored[i].first
-                  << ",\tstored_data[i].first:" << stored_data[i].first
-                  << std::endl;
+                  << ",\tdata[i].first:" << data[i].first << std::endl;
       }
     }
-    data_ = stored_data;
+    data_[partition_id] = stored;
 #endif
   }
 
-  virtual void Build(DataVec_& new_data) = 0;
+  // Encode the records of a partition into blocks of record_per_page_
+  // records and fill their byte offsets, the last one is the end of the
+  // blocks. Return the number of pages of the partition.
+  inline uint64_t EncodePartition(const DataVec_& data,
+                                  std::vector<char>& blocks,
+                                  std::vector<uint64_t>& offsets) const {
+    offsets.clear();
+    if (!compress_) {
+      return GetPageNum(data.size());
+    }
+    blocks.clear();
+    for (size_t i = 0; i < data.size(); i += record_per_page_) {
+      offsets.push_back(blocks.size());
+      CompressedBlock<K, V>::Encode(
+          &data[i], std::min<size_t>(record_per_page_, data.size() - i),
+          blocks);
+    }
+    offsets.push_back(blocks.size());
+    size_t page_bytes = record_per_page_ * sizeof(Record_);
+    return std::max<uint64_t>(1, (blocks.size() + page_bytes - 1) / page_bytes);
+  }
 
-  inline V FindData(const SearchRange& range, const K_ key) {
-    ResultInfo<K_, V_> res = LowerBound(range, key, 1);
-    return res.val;
+  // read the pages holding the blocks [first, last] of a compressed
+  // partition, through pool unless it is nullptr, return the start of the
+  // first block
+  inline const char* ReadBlocks(size_t partition_id, size_t first,
+                                size_t last, K* buf, BufferPool* pool) const {
+    const Partition& part = partitions_[partition_id];
+    const auto& offsets = block_offsets_[partition_id];
+    size_t page_bytes = record_per_page_ * sizeof(Record_);
+    uint64_t first_page = offsets[first] / page_bytes;
+    uint64_t page_num = (offsets[last + 1] - 1) / page_bytes - first_page + 1;
+    ReadPages<K>(fd, page_bytes, page_num,
+                 (part.start_pid + first_page) * page_bytes, buf, pool);
+    return reinterpret_cast<const char*>(buf) + offsets[first] % page_bytes;
   }
 
-  inline bool UpdateData(const SearchRange& range, const K_ key,
-                         const V_ value) {
-    ResultInfo<K_, V_> res = LowerBound(range, key, 1);
-    return Update1Page(res.fd, res.pid, res.idx, key, value,
-                       record_per_page_ * sizeof(Record_), read_buf_);
+  // the lower bound of key in the blocks covering range, pid and idx are the
+  // logical page and the position in it, as for the uncompressed pages
+  inline ResultInfo<K, V> BlockLowerBound(const SearchRange& range,
+                                          const K key, size_t partition_id) {
+    const auto& offsets = block_offsets_[partition_id];
+    size_t last = std::min<size_t>((range.stop - 1) / record_per_page_,
+                                   offsets.size() - 2);
+    size_t first = std::min<size_t>(range.start / record_per_page_, last);
+    const char* data =
+        ReadBlocks(partition_id, first, last, GetBuffer(), pool_);
+    ResultInfo<K, V> res;
+    res.fd = fd;
+    res.fetch_page_num = 1;
+    res.total_io = 1;
+    for (size_t b = first; b <= last; b++) {
+      CompressedBlock<K, V> block(data + offsets[b] - offsets[first]);
+      size_t idx = block.LowerBound(key);
+      if (idx == block.size() && b < last) {
+        continue;
+      }
+      // the last record if all are smaller
+      idx = std::min(idx, block.size() - 1);
+      std::vector<V> payloads;
+      block.DecodePayloads(payloads);
+      res.res = block.GetKey(idx);
+      res.val = payloads[idx];
+      res.pid = partitions_[partition_id].start_pid + b;
+      res.idx = idx;
+      break;
+    }
+    return res;
   }
 
-  inline V ScanData(const SearchRange& range, const K key, const int length) {
-    ResultInfo<K, V> res = LowerBound(range, key, length);
-    return res.val;
+  // ScanPartitions over compressed partitions, the blocks of a partition are
+  // read together and decoded one by one
+  inline void ScanBlocks(size_t partition_id, uint64_t pos, uint64_t length,
+                         DataVec_& out) {
+    for (size_t p = partition_id; p < partitions_.size() && length; p++) {
+      const Partition& part = partitions_[p];
+      if (pos >= part.data_num) {
+        pos = 0;
+        continue;
+      }
+      const auto& offsets = block_offsets_[p];
+      uint64_t num = std::min(length, part.data_num - pos);
+      size_t first = pos / record_per_page_;
+      size_t last = (pos + num - 1) / record_per_page_;
+      const char* data = ReadBlocks(p, first, last, GetBuffer(), pool_);
+      for (size_t b = first; b <= last; b++) {
+        CompressedBlock<K, V> block(data + offsets[b] - offsets[first]);
+        size_t init_size = out.size();
+        block.Decode(b == first ? pos % record_per_page_ : 0, num, out);
+        num -= out.size() - init_size;
+        length -= out.size() - init_size;
+      }
+      pos = 0;
+    }
   }
 
-#ifdef BREAKDOWN
-  inline void Breakdown() {
-    if (merge_cnt > 0) {
-      std::cout << "init_lat:" << init_lat / merge_cnt / 1e6 << " ms"
-                << std::endl;
-      std::cout << "get_static_data_lat:"
-                << get_static_data_lat / merge_cnt / 1e6 << " ms" << std::endl;
-      std::cout << "split_data_lat:" << split_data_lat / merge_cnt / 1e6
-                << " ms" << std::endl;
-      std::cout << "store_disk_lat:" << store_disk_lat / merge_cnt / 1e6
-                << " ms" << std::endl;
+  // read all the records of a partition into data, which holds at least
+  // data_num records
+  inline void ReadPartition(size_t partition_id, K* buf,
+                            DataVec_& data) const {
+    const Partition& part = partitions_[partition_id];
+    if (!compress_) {
+      GetAllData<K, V>(fd, part.start_pid, part.page_num, record_per_page_,
+                       part.data_num, buf, data, buf_pages_);
+      return;
     }
+    // a whole partition bypasses the buffer pool as GetAllData does, only the
+    // lookups and scans are cached. The blocks are read a buffer at a time,
+    // as a single partition may be the whole file.
+    const auto& offsets = block_offsets_[partition_id];
+    DataVec_ decoded;
+    decoded.reserve(part.data_num);
+    for (size_t first = 0; first + 1 < offsets.size();) {
+      size_t last = GetLastBlock(partition_id, first, buf_pages_);
+      const char* blocks = ReadBlocks(partition_id, first, last, buf, nullptr);
+      for (size_t b = first; b <= last; b++) {
+        CompressedBlock<K, V>(blocks + offsets[b] - offsets[first])
+            .Decode(0, record_per_page_, decoded);
+      }
+      first = last + 1;
+    }
+    std::copy(decoded.begin(), decoded.end(), data.begin());
   }
-#endif
 
-  inline size_t size() const { return data_number_; }
+  // the last block of a compressed partition from first on such that the
+  // blocks [first, last] take at most max_pages pages and hold at most
+  // max_pages logical pages of records, at least first itself
+  inline size_t GetLastBlock(size_t partition_id, size_t first,
+                             uint64_t max_pages) const {
+    const auto& offsets = block_offsets_[partition_id];
+    const size_t page_bytes = record_per_page_ * sizeof(Record_);
+    size_t last = first;
+    while (last + 2 < offsets.size() && last + 1 - first < max_pages &&
+           (offsets[last + 2] - 1) / page_bytes - offsets[first] / page_bytes +
+                   1 <=
+               max_pages) {
+      last++;
+    }
+    return last;
+  }
 
-  virtual size_t GetStaticInitSize(DataVec_& data) const = 0;
+  // independent page reads, through the buffer pool if there is one
+  inline void ReadBatch(const std::vector<IORequest>& reqs) {
+    if (pool_ == nullptr) {
+      BackendReadBatch(reqs);
+    } else {
+      pool_->ReadBatch(reqs);
+    }
+  }
 
-  virtual size_t GetNodeSize() const = 0;
-  virtual size_t GetTotalSize() const = 0;
+  // first-fit allocation over the freed extents, otherwise append
+  inline uint64_t AllocateExtent(uint64_t page_num) {
+    for (auto it = free_extents_.begin(); it != free_extents_.end(); it++) {
+      if (it->second >= page_num) {
+        uint64_t start_pid = it->first;
+        it->first += page_num;
+        it->second -= page_num;
+        if (it->second == 0) {
+          free_extents_.erase(it);
+        }
+        return start_pid;
+      }
+    }
+    uint64_t start_pid = file_pages_;
+    file_pages_ += page_num;
+    return start_pid;
+  }
 
-  virtual std::string GetIndexName() const { return name_; }
+  // With persist, the installed model file still describes the extent until
+  // the next SaveModel, so it is kept aside until then and the merge does not
+  // write over it.
+  inline void FreeExtent(uint64_t start_pid, uint64_t page_num) {
+    if (pool_ != nullptr) {
+      pool_->Invalidate(fd, start_pid, page_num);
+    }
+    if (persist_) {
+      pending_extents_.push_back({start_pid, page_num});
+      return;
+    }
+    InsertExtent(free_extents_, file_pages_, start_pid, page_num);
+  }
 
- private:
-  inline void GetDataVector(DataVec_& data) const {
-    if (size() > 0) {
-      GetAllData<K, V>(fd, 0, page_number_, record_per_page_, data_number_,
-                       read_buf_, data);
-    } else {
-      std::cout << "GetDataVector: no data" << std::endl;
+  // return the extents freed since the last SaveModel to the free list
+  inline void ReleaseExtents() {
+    for (auto& extent : pending_extents_) {
+      InsertExtent(free_extents_, file_pages_, extent.first, extent.second);
+    }
+    pending_extents_.clear();
+  }
+
+  static inline void InsertExtent(
+      std::vector<std::pair<uint64_t, uint64_t>>& free_extents,
+      uint64_t& file_pages, uint64_t start_pid, uint64_t page_num) {
+    auto it = std::lower_bound(
+        free_extents.begin(), free_extents.end(), start_pid,
+        [](const auto& lhs, uint64_t pid) { return lhs.first < pid; });
+    it = free_extents.insert(it, {start_pid, page_num});
+    // coalesce with the neighbours
+    if (it + 1 != free_extents.end() &&
+        it->first + it->second == (it + 1)->first) {
+      it->second += (it + 1)->second;
+      free_extents.erase(it + 1);
+    }
+    if (it != free_extents.begin() &&
+        (it - 1)->first + (it - 1)->second == it->first) {
+      (it - 1)->second += it->second;
+      free_extents.erase(it);
+    }
+    // give the tail of the file back, so that a single partition is always
+    // rewritten in place unless the models are persisted. The file itself is
+    // cut by ShrinkFile at the end of the merge, the tail is usually
+    // reallocated before that.
+    if (!free_extents.empty() &&
+        free_extents.back().first + free_extents.back().second ==
+            file_pages) {
+      file_pages = free_extents.back().first;
+      free_extents.pop_back();
+    }
+  }
+
+  // cut the data file to the pages that are still allocated
+  inline void ShrinkFile() {
+    size_t bytes = file_pages_ * record_per_page_ * sizeof(Record_);
+    if (DirectIOFileBytes(fd) > bytes) {
+      DirectIOTruncate(fd, bytes);
     }
   }
 
+  inline uint64_t GetPageNum(uint64_t data_num) const {
+    return std::max<uint64_t>(1, std::ceil(data_num * 1.0 / record_per_page_));
+  }
+
+  inline size_t GetSplitNum(uint64_t data_num) const {
+    if (partition_records_ == 0 || data_num <= 2 * partition_records_) {
+      return 1;
+    }
+    return std::ceil(data_num * 1.0 / partition_records_);
+  }
+
+  inline uint64_t GetTotalPages() const {
+    uint64_t pages = 0;
+    for (auto& part : partitions_) {
+      pages += part.page_num;
+    }
+    return pages;
+  }
+
+ protected:
+  inline K* GetBuffer() const {
+    return buf_ == nullptr ? reinterpret_cast<K*>(read_buf_) : buf_;
+  }
+
  private:
   std::string name_ = "DISK_STATIC_BASE";
 #ifdef CHECK_CORRECTION
-  DataVec_ data_;
+  std::vector<DataVec_> data_;
 #endif
 
  protected:
   std::string data_file_;
+  // the file of the models, which names data_file_
+  std::string model_file_;
   int fd;
   uint64_t record_per_page_;
+  K* buf_ = nullptr;  // nullptr: use the global read_buf_
+  uint64_t buf_pages_ = MAX_READ_PAGES;
+  BufferPool* pool_ = nullptr;
 
 #ifdef BREAKDOWN
   double init_lat = 0.0;
@@ -219,8 +1375,22 @@ class StaticIndex {
 #endif
 
   uint64_t data_number_;
-  int page_number_;
-  int last_page_id_;
+  uint64_t partition_records_;
+  bool persist_;
+  bool compress_;
+  uint64_t build_threads_;
+  std::vector<K_> partition_keys_;  // the upper bound of each partition
+  std::vector<Partition> partitions_;
+  // the byte offsets of the blocks in each compressed partition
+  std::vector<std::vector<uint64_t>> block_offsets_;
+  std::vector<std::pair<uint64_t, uint64_t>> free_extents_;  // {pid, num}
+  // the extents freed by the current merge, see FreeExtent
+  std::vector<std::pair<uint64_t, uint64_t>> pending_extents_;
+  uint64_t file_pages_ = 0;
+
+  size_t merge_num_ = 0;
+  uint64_t last_rewritten_pages_ = 0;
+  uint64_t total_rewritten_pages_ = 0;
 };
 
-#endif
\ No newline at end of file
+#endif
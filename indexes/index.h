@@ -30,6 +30,10 @@ class BaseIndex {
 
   virtual size_t GetInMemorySize() const { return 0; }
 
+  // the part of GetInMemorySize spent on the uncompressed key sample that
+  // accelerates the lookups over compressed model keys
+  virtual size_t GetSampleSize() const { return 0; }
+
   virtual size_t GetIndexSize() const { return disk_size_; }
 
   virtual size_t GetModelNum() const = 0;
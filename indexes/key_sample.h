@@ -0,0 +1,77 @@
+#ifndef INDEXES_KEY_SAMPLE_H_
+#define INDEXES_KEY_SAMPLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// An uncompressed sample of every stride-th key of a sorted sequence, e.g.,
+// the compressed model keys. The sample is stored in the Eytzinger (BFS)
+// layout: the first levels of the search share a few cache lines and the
+// deeper ones are prefetched several levels ahead. A search over the sample
+// narrows the range of the full sequence to stride keys before any of them is
+// decoded.
+template <typename K>
+class KeySample {
+ public:
+  KeySample() {}
+
+  // get(i) returns the i-th of the num sorted keys, stride 0: no sample
+  template <typename GetKey>
+  void Build(size_t num, size_t stride, GetKey get) {
+    num_ = num;
+    stride_ = stride;
+    size_t n = stride == 0 ? 0 : (num + stride - 1) / stride;
+    tree_.assign(n + 1, K());
+    rank_.assign(n + 1, n);
+    size_t i = 0;
+    Fill(1, n, stride, get, i);
+  }
+
+  inline bool empty() const { return tree_.size() <= 1; }
+
+  // The range [s, e) of the full sequence for a binary search of the first
+  // key not less than key (kUpper: greater than key), which is in [s, e].
+  template <bool kUpper>
+  inline std::pair<size_t, size_t> Narrow(const K key) const {
+    const size_t n = tree_.size() - 1;
+    size_t k = 1;
+    while (k <= n) {
+      __builtin_prefetch(tree_.data() + k * kKeysPerLine);
+      k = 2 * k + (kUpper ? tree_[k] <= key : tree_[k] < key);
+    }
+    // the last right turn leads to the first sampled key out of the bound
+    k >>= __builtin_ffsll(~k);
+    size_t rank = k == 0 ? n : rank_[k];
+    size_t s = rank == 0 ? 0 : (rank - 1) * stride_ + 1;
+    size_t e = std::min(rank * stride_, num_);
+    return {s, e};
+  }
+
+  inline size_t size() const {
+    return tree_.size() * sizeof(K) + rank_.size() * sizeof(uint32_t);
+  }
+
+ private:
+  // the in-order traversal of the implicit tree visits the sorted keys
+  template <typename GetKey>
+  void Fill(size_t k, size_t n, size_t stride, GetKey& get, size_t& i) {
+    if (k > n) {
+      return;
+    }
+    Fill(2 * k, n, stride, get, i);
+    tree_[k] = get(i * stride);
+    rank_[k] = i++;
+    Fill(2 * k + 1, n, stride, get, i);
+  }
+
+  static constexpr size_t kKeysPerLine = 64 / sizeof(K);
+
+  std::vector<K> tree_;         // 1-indexed
+  std::vector<uint32_t> rank_;  // the position of each key in the sample
+  size_t num_ = 0;
+  size_t stride_ = 0;
+};
+
+#endif  // INDEXES_KEY_SAMPLE_H_
@@ -10,6 +10,7 @@
 #include "../libraries/LeCo/headers/piecewise_fix_integer_template.h"
 #include "../libraries/LeCo/headers/piecewise_fix_integer_template_float.h"
 #include "./index.h"
+#include "./key_sample.h"
 using namespace Codecset;
 
 template <typename K, typename V>
@@ -19,12 +20,16 @@ class LecoZonemap : public BaseIndex<K, V> {
     size_t record_per_page_;
     size_t tolerance_;
     size_t block_num_;
+    // sample every sample_stride_-th compressed key to narrow the binary
+    // search before decoding, 0: no sample
+    size_t sample_stride_ = 0;
   };
 
   LecoZonemap(param_t p = param_t{256, 1, 1000})
       : tolerance_(p.tolerance_),
         record_per_page_(p.record_per_page_),
-        block_num_(p.block_num_) {}
+        block_num_(p.block_num_),
+        sample_stride_(p.sample_stride_) {}
 
   void Build(std::vector<std::pair<K, V>>& data) {
     std::vector<K> points;
@@ -66,6 +71,8 @@ class LecoZonemap : public BaseIndex<K, V> {
       block_start_vec_.push_back(descriptor);
       memory_size_ += segment_size;
     }
+    sample_.Build(point_num_, sample_stride_,
+                  [&](size_t i) { return points[i]; });
 
     disk_size_ = (sizeof(K) + sizeof(V)) * data.size();
   }
@@ -88,7 +95,13 @@ class LecoZonemap : public BaseIndex<K, V> {
 
   size_t GetModelNum() const override { return block_num_; }
 
-  size_t GetInMemorySize() const override { return memory_size_; }
+  size_t GetInMemorySize() const override {
+    return memory_size_ + GetSampleSize();
+  }
+
+  size_t GetSampleSize() const override {
+    return sample_.empty() ? 0 : sample_.size();
+  }
 
   size_t GetIndexSize() const override {
     return GetInMemorySize() + disk_size_;
@@ -97,6 +110,11 @@ class LecoZonemap : public BaseIndex<K, V> {
  private:
   size_t LecoBinarySearch(K key) {
     uint64_t s = 0, e = point_num_;
+    if (!sample_.empty()) {
+      auto range = sample_.template Narrow<false>(key);
+      s = range.first;
+      e = range.second;
+    }
     while (s < e) {
       uint64_t mid = (s + e) >> 1;
       K data_mid =
@@ -113,6 +131,7 @@ class LecoZonemap : public BaseIndex<K, V> {
  private:
   Leco_int<K> codec_;
   std::vector<uint8_t*> block_start_vec_;
+  KeySample<K> sample_;
 
   int block_width_;
   size_t block_num_;
@@ -122,6 +141,7 @@ class LecoZonemap : public BaseIndex<K, V> {
   size_t memory_size_ = 0;
   size_t tolerance_;
   size_t record_per_page_;
+  size_t sample_stride_;
 };
 
 #endif  // INDEXES_LECO_ZONEMAP_H_
@@ -9,6 +9,7 @@
 #include <utility>
 #include <vector>
 
+#include "../../tombstone.h"
 #include "./btree/BTreeOLC.h"
 #include "./dynamic_base.h"
 
@@ -48,9 +49,12 @@ class MultiThreadedBTreeIndex : public DynamicIndex<K, V> {
     return val;
   }
 
-  V Scan(const K key, const int range) {
-    // TODO: scan
-    return 0;
+  // append the first range records from key on to out
+  void Scan(const K key, const int range, DataVev_& out) {
+    typename btreeolc::BTree<K_, V_>::LeafIterator it(&btree_, key);
+    for (int i = 0; i < range && it.valid(); i++, it.next()) {
+      out.push_back({it.key(), it.value()});
+    }
   }
 
   bool Insert(const K key, const V value) {
@@ -58,9 +62,15 @@ class MultiThreadedBTreeIndex : public DynamicIndex<K, V> {
     return true;
   }
 
+  // update a stored key in place, a deleted key is not brought back
   bool Update(const K key, const V value) {
-    // TODO: update
-    return false;
+    return btree_.update(key, [&value](V& val) {
+      if (val == GetTombstone<V>()) {
+        return false;
+      }
+      val = value;
+      return true;
+    });
   }
 
   bool Delete(const K key) {
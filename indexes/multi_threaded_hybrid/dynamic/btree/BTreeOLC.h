@@ -3,6 +3,7 @@
 #include <immintrin.h>
 #include <sched.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstring>
@@ -120,14 +121,15 @@ struct BTreeLeaf : public BTreeLeafBase {
     return (*base < k) + base - keys;
   }
 
-  void insert(Key k, Payload p) {
+  // returns false if k was already in the leaf
+  bool insert(Key k, Payload p) {
     assert(count < maxEntries);
     if (count) {
       unsigned pos = lowerBound(k);
       if ((pos < count) && (keys[pos] == k)) {
         // Upsert
         payloads[pos] = p;
-        return;
+        return false;
       }
       memmove(keys + pos + 1, keys + pos, sizeof(Key) * (count - pos));
       memmove(payloads + pos + 1, payloads + pos,
@@ -139,6 +141,7 @@ struct BTreeLeaf : public BTreeLeafBase {
       payloads[0] = p;
     }
     count++;
+    return true;
   }
 
   BTreeLeaf* split(Key& sep) {
@@ -406,8 +409,10 @@ struct BTree {
           goto restart;
         }
       }
-      leaf->insert(k, v);
-      item_count.fetch_add(1, std::memory_order_relaxed);
+      if (leaf->insert(k, v)) {
+        // an upsert does not add a record
+        item_count.fetch_add(1, std::memory_order_relaxed);
+      }
       node->writeUnlock();
       return;  // success
     }
@@ -474,7 +479,10 @@ struct BTree {
     return success;
   }
 
-  uint64_t scan(Key k, int range, Value* output) {
+  // Apply fn to the payload of k under the write lock of its leaf. Return
+  // false if k is missing or fn rejects the payload.
+  template <typename Fn>
+  bool update(Key k, Fn fn) {
     int restartCount = 0;
   restart:
     if (restartCount++) yield(restartCount);
@@ -482,7 +490,9 @@ struct BTree {
 
     NodeBase* node = root;
     uint64_t versionNode = node->readLockOrRestart(needRestart);
-    if (needRestart || (node != root)) goto restart;
+    if (needRestart || (node != root)) {
+      goto restart;
+    }
 
     // Parent of current node
     BTreeInner<Key>* parent = nullptr;
@@ -493,7 +503,9 @@ struct BTree {
 
       if (parent) {
         parent->readUnlockOrRestart(versionParent, needRestart);
-        if (needRestart) goto restart;
+        if (needRestart) {
+          goto restart;
+        }
       }
 
       parent = inner;
@@ -501,26 +513,174 @@ struct BTree {
 
       node = inner->children[inner->lowerBound(k)];
       inner->checkOrRestart(versionNode, needRestart);
-      if (needRestart) goto restart;
+      if (needRestart) {
+        goto restart;
+      }
       versionNode = node->readLockOrRestart(needRestart);
-      if (needRestart) goto restart;
+      if (needRestart) {
+        goto restart;
+      }
     }
 
     BTreeLeaf<Key, Value>* leaf = static_cast<BTreeLeaf<Key, Value>*>(node);
     unsigned pos = leaf->lowerBound(k);
-    int count = 0;
-    for (unsigned i = pos; i < leaf->count; i++) {
-      if (count == range) break;
-      output[count++] = leaf->payloads[i];
+    if ((pos >= leaf->count) || (leaf->keys[pos] != k)) {
+      // a miss does not lock the leaf
+      if (parent) {
+        parent->readUnlockOrRestart(versionParent, needRestart);
+        if (needRestart) {
+          goto restart;
+        }
+      }
+      node->readUnlockOrRestart(versionNode, needRestart);
+      if (needRestart) {
+        goto restart;
+      }
+      return false;
+    }
+    node->upgradeToWriteLockOrRestart(versionNode, needRestart);
+    if (needRestart) {
+      goto restart;
+    }
+    if (parent) {
+      parent->readUnlockOrRestart(versionParent, needRestart);
+      if (needRestart) {
+        node->writeUnlock();
+        goto restart;
+      }
+    }
+    bool success = fn(leaf->payloads[pos]);
+    node->writeUnlock();
+    return success;
+  }
+
+  // Iterate over the records from a key on in key order, one leaf at a time.
+  // The entries of a leaf are copied together with its next pointer and
+  // then validated against the leaf version. If a writer got in between, or
+  // the next leaf is locked, the leaf holding the first key after the last
+  // returned one is searched again from the root.
+  class LeafIterator {
+   public:
+    LeafIterator(BTree* tree, Key k)
+        : tree_(tree), next_(nullptr), pos_(0), num_(0) {
+      Seek(k, false);
+    }
+
+    inline bool valid() const { return pos_ < num_; }
+    inline Key key() const { return keys_[pos_]; }
+    inline Value value() const { return payloads_[pos_]; }
+
+    void next() {
+      if (++pos_ < num_ || next_ == nullptr) {
+        return;
+      }
+      Seek(keys_[num_ - 1], true, next_);
+    }
+
+   private:
+    // position at the first key >= k, or > k if exclusive, starting from
+    // leaf if it is given
+    void Seek(Key k, bool exclusive, BTreeLeaf<Key, Value>* leaf = nullptr) {
+      int restartCount = 0;
+      while (true) {
+        if (restartCount++) tree_->yield(restartCount);
+        bool needRestart = false;
+        uint64_t version;
+        if (leaf == nullptr) {
+          leaf = tree_->findLeaf(k, version);
+        } else {
+          version = leaf->readLockOrRestart(needRestart);
+        }
+        if (needRestart || !Copy(leaf, version, k, exclusive)) {
+          leaf = nullptr;  // search again from the root
+          continue;
+        }
+        // an empty leaf, or one with only smaller keys, moves on to its next
+        if (pos_ < num_ || next_ == nullptr) {
+          return;
+        }
+        leaf = next_;
+        restartCount = 0;
+      }
+    }
+
+    bool Copy(BTreeLeaf<Key, Value>* leaf, uint64_t version, Key k,
+              bool exclusive) {
+      unsigned count = std::min<unsigned>(leaf->count,
+                                          BTreeLeaf<Key, Value>::maxEntries);
+      unsigned n = 0;
+      for (unsigned i = 0; i < count; i++) {
+        if (leaf->keys[i] > k || (!exclusive && leaf->keys[i] == k)) {
+          keys_[n] = leaf->keys[i];
+          payloads_[n++] = leaf->payloads[i];
+        }
+      }
+      BTreeLeaf<Key, Value>* next = leaf->next_leaf;
+      bool needRestart = false;
+      leaf->checkOrRestart(version, needRestart);
+      if (needRestart) {
+        return false;
+      }
+      next_ = next;
+      pos_ = 0;
+      num_ = n;
+      return true;
+    }
+
+    BTree* tree_;
+    BTreeLeaf<Key, Value>* next_;
+    unsigned pos_;
+    unsigned num_;
+    Key keys_[BTreeLeaf<Key, Value>::maxEntries];
+    Value payloads_[BTreeLeaf<Key, Value>::maxEntries];
+  };
+
+  // the leaf that may hold k, with its version read after the parent is
+  // validated
+  BTreeLeaf<Key, Value>* findLeaf(Key k, uint64_t& versionNode) {
+    int restartCount = 0;
+  restart:
+    if (restartCount++) yield(restartCount);
+    bool needRestart = false;
+
+    NodeBase* node = root;
+    versionNode = node->readLockOrRestart(needRestart);
+    if (needRestart || (node != root)) goto restart;
+
+    // Parent of current node
+    BTreeInner<Key>* parent = nullptr;
+    uint64_t versionParent;
+
+    while (node->type == PageType::BTreeInner) {
+      auto inner = static_cast<BTreeInner<Key>*>(node);
+
+      if (parent) {
+        parent->readUnlockOrRestart(versionParent, needRestart);
+        if (needRestart) goto restart;
+      }
+
+      parent = inner;
+      versionParent = versionNode;
+
+      node = inner->children[inner->lowerBound(k)];
+      inner->checkOrRestart(versionNode, needRestart);
+      if (needRestart) goto restart;
+      versionNode = node->readLockOrRestart(needRestart);
+      if (needRestart) goto restart;
     }
 
     if (parent) {
       parent->readUnlockOrRestart(versionParent, needRestart);
       if (needRestart) goto restart;
     }
-    node->readUnlockOrRestart(versionNode, needRestart);
-    if (needRestart) goto restart;
+    return static_cast<BTreeLeaf<Key, Value>*>(node);
+  }
 
+  uint64_t scan(Key k, int range, Value* output) {
+    int count = 0;
+    for (LeafIterator it(this, k); it.valid() && count < range; it.next()) {
+      output[count++] = it.value();
+    }
     return count;
   }
 };
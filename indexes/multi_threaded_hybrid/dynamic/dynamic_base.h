@@ -10,6 +10,7 @@ template <typename K, typename V>
 class DynamicIndex {
  public:
   DynamicIndex() {}
+  virtual ~DynamicIndex() {}
 
   typedef K K_;
   typedef V V_;
@@ -20,7 +21,7 @@ class DynamicIndex {
   virtual void Merge(DataVev_& merged_data) = 0;
 
   virtual V Find(const K key) = 0;
-  virtual V Scan(const K key, const int range) = 0;
+  virtual void Scan(const K key, const int range, DataVev_& out) = 0;
 
   virtual bool Insert(const K key, const V value) = 0;
   // virtual bool Update(const K key, const V value) = 0;
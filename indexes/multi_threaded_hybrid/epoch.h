@@ -0,0 +1,114 @@
+#ifndef INDEXES_MULTI_THREADED_HYBRID_EPOCH_H_
+#define INDEXES_MULTI_THREADED_HYBRID_EPOCH_H_
+
+#include <sched.h>
+
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <vector>
+
+// Epoch-based reclamation for the versions of the multi-threaded hybrid index.
+// A thread pins the global epoch before loading the current version and
+// unpins it when it is done, so readers never wait for writers. A writer
+// publishes a new version and retires the old objects together with the
+// epoch in which they were unlinked; they are freed once every thread pinned
+// at that epoch or earlier has unpinned.
+class EpochManager {
+ public:
+  explicit EpochManager(size_t thread_num) : slots_(thread_num) {}
+
+  ~EpochManager() {
+    for (auto& obj : retired_) {
+      obj.deleter();
+    }
+  }
+
+  EpochManager(const EpochManager&) = delete;
+  EpochManager& operator=(const EpochManager&) = delete;
+
+  inline void Pin(int thread_id) {
+    // seq_cst: the pin must be visible before the version is loaded
+    slots_[thread_id].epoch.store(global_epoch_.load());
+  }
+
+  inline void Unpin(int thread_id) {
+    slots_[thread_id].epoch.store(kIdle, std::memory_order_release);
+  }
+
+  // free deleter's objects once the threads that may hold them have unpinned
+  inline void Retire(std::function<void()> deleter) {
+    uint64_t epoch = global_epoch_.fetch_add(1);
+    std::lock_guard<std::mutex> lock(mutex_);
+    retired_.push_back({epoch, std::move(deleter)});
+  }
+
+  // run the deleters whose grace period has passed
+  inline void Reclaim() {
+    uint64_t min_epoch = GetMinEpoch(-1);
+    std::vector<RetiredObject> ready;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      size_t kept = 0;
+      for (size_t i = 0; i < retired_.size(); i++) {
+        if (retired_[i].epoch < min_epoch) {
+          ready.push_back(std::move(retired_[i]));
+        } else {
+          retired_[kept++] = std::move(retired_[i]);
+        }
+      }
+      retired_.resize(kept);
+    }
+    for (auto& obj : ready) {
+      obj.deleter();
+    }
+  }
+
+  // wait until the threads pinned before the last published version, except
+  // the caller, have unpinned
+  inline void Synchronize(int thread_id) {
+    uint64_t epoch = global_epoch_.fetch_add(1);
+    int cnt = 0;
+    while (GetMinEpoch(thread_id) <= epoch) {
+      if (cnt++ > 10) {
+        sched_yield();
+      }
+    }
+  }
+
+  inline size_t GetRetiredNum() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retired_.size();
+  }
+
+ private:
+  static constexpr uint64_t kIdle = std::numeric_limits<uint64_t>::max();
+
+  // one cache line per thread to avoid false sharing between the readers
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch{kIdle};
+  };
+
+  struct RetiredObject {
+    uint64_t epoch;
+    std::function<void()> deleter;
+  };
+
+  inline uint64_t GetMinEpoch(int skip_thread) const {
+    uint64_t min_epoch = kIdle;
+    for (size_t i = 0; i < slots_.size(); i++) {
+      if (static_cast<int>(i) != skip_thread) {
+        min_epoch = std::min(min_epoch, slots_[i].epoch.load());
+      }
+    }
+    return min_epoch;
+  }
+
+  std::atomic<uint64_t> global_epoch_{0};
+  std::vector<Slot> slots_;
+  std::mutex mutex_;
+  std::vector<RetiredObject> retired_;
+};
+
+#endif  // !INDEXES_MULTI_THREADED_HYBRID_EPOCH_H_
@@ -4,12 +4,15 @@
 #include <assert.h>
 
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
 
 #include "../base_index.h"
+#include "../tombstone.h"
+#include "./epoch.h"
 
 #define INIT_SIZE 100
-enum ModeType { NormalMode, PrepareToMerge, MergingMode, MergedMode };
 
 template <typename K, typename V, typename DynamicType, typename StaticType>
 class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
@@ -18,10 +21,15 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
     typename DynamicType::param_t d_params_;
     typename StaticType::param_t s_params_;
     size_t merge_ratio_;
+    // the number of background merge threads, 0 to merge in the threads
+    // whose inserts exceed the budget
+    size_t merge_pool_size_;
   };
 
   MultiThreadedHybridIndex(param_t params)
-      : index_params_(params),
+      : epoch_(params.s_params_.disk_params.thread_numbers +
+               params.merge_pool_size_),
+        index_params_(params),
         merge_cnt_(0),
         mem_find_cnt_(0),
         disk_find_cnt_(0),
@@ -33,31 +41,33 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
         max_memory_usage_(0),
         max_buffer_size_(0),
         merge_ratio_(params.merge_ratio_) {
-    merging_dynamic_index_ = NULL;
-    dynamic_index_ = new DynamicType(params.d_params_);
-    static_index_ = new StaticType(params.s_params_);
-    backup_static_index_ = NULL;
-    mode_.store(NormalMode);
-    threads_free_status_ = std::vector<std::atomic<int>>(
-        params.s_params_.disk_params.thread_numbers);
-    for (size_t i = 0; i < threads_free_status_.size(); i++) {
-      threads_free_status_[i].store(0);
-    }
+    // the merge threads follow the request threads in the thread ids, so
+    // that the static index gives them their own buffers and files
+    foreground_thread_num_ = params.s_params_.disk_params.thread_numbers;
+    merge_insert_cnt_ = std::vector<size_t>(foreground_thread_num_, 0);
+    index_params_.s_params_.disk_params.thread_numbers +=
+        params.merge_pool_size_;
+    version_.store(new Version{new DynamicType(params.d_params_), NULL,
+                               new StaticType(index_params_.s_params_)});
 #ifdef BREAKDOWN
-    assign_to_merge_lat = std::vector<double>(threads_free_status_.size(), 0);
-    update_version_lat = std::vector<double>(threads_free_status_.size(), 0);
-    wait_to_normal_lat = std::vector<double>(threads_free_status_.size(), 0);
-    update_all_version_lat =
-        std::vector<double>(threads_free_status_.size(), 0);
-    merge_lat = std::vector<double>(threads_free_status_.size(), 0);
-    merge_cnt = std::vector<double>(threads_free_status_.size(), 0);
-    merged_wait_lat = std::vector<double>(threads_free_status_.size(), 0);
-    merging_wait_lat = std::vector<double>(threads_free_status_.size(), 0);
-    prepare_wait_lat = std::vector<double>(threads_free_status_.size(), 0);
-    normal_wait_lat = std::vector<double>(threads_free_status_.size(), 0);
+    size_t thread_num = index_params_.s_params_.disk_params.thread_numbers;
+    assign_to_merge_lat = std::vector<double>(thread_num, 0);
+    drain_wait_lat = std::vector<double>(thread_num, 0);
+    merge_lat = std::vector<double>(thread_num, 0);
+    merge_cnt = std::vector<double>(thread_num, 0);
+    insert_wait_lat = std::vector<double>(thread_num, 0);
 #endif
   }
 
+  ~MultiThreadedHybridIndex() {
+    StopMergePool();
+    epoch_.Reclaim();
+    Version* v = version_.load();
+    delete v->dynamic_index;
+    delete v->static_index;
+    delete v;
+  }
+
   typedef typename MultiThreadedBaseIndex<K, V>::DataVec_ BaseVec;
 
   void Build(BaseVec& data) {
@@ -88,10 +98,10 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
               << std::endl;
 #endif
 
-    DynamicType* dy = dynamic_index_.load();
+    DynamicType* dy = version_.load()->dynamic_index;
     dy->Build(dynamic_data);
 
-    StaticType* sta = static_index_.load();
+    StaticType* sta = version_.load()->static_index;
     sta->Build(static_data, 0);
 
     // get the remaining memory budget for the dynamic index
@@ -119,332 +129,194 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
     }
     std::cout << "Check dynamic index over! " << std::endl;
 #endif
+    for (size_t i = 0; i < index_params_.merge_pool_size_; i++) {
+      merge_pool_.emplace_back(&MultiThreadedHybridIndex::MergeWorker, this,
+                               foreground_thread_num_ + i);
+    }
   }
 
+  // Readers only pin an epoch and load the current version, they never take
+  // part in a merge nor wait for it.
   V Find(const K key, int thread_id) {
-    threads_free_status_[thread_id].fetch_add(1);
-    V res = std::numeric_limits<V>::max();
-    switch (mode_.load()) {
-      case NormalMode:
-        break;
-      case PrepareToMerge:
-        break;
-      case MergingMode:
-        AssignedToMerge(thread_id);
-        break;
-      case MergedMode:
-        UpdateVersion(thread_id);
-        break;
-      default:
-        break;
-    }
+    epoch_.Pin(thread_id);
+    Version* v = version_.load();
 
     // lookup in the dynamic index
-    DynamicType* dy = dynamic_index_.load();
-    res = dy->Find(key);
+    V res = v->dynamic_index->Find(key);
     mem_find_cnt_++;
 
-    // lookup in the merging index when the mode is merging/merged mode
-    if (res == std::numeric_limits<V>::max()) {
-      switch (mode_.load()) {
-        case NormalMode:
-          break;
-        case PrepareToMerge:
-          break;
-        case MergingMode: {
-          DynamicType* merge_dy = merging_dynamic_index_.load();
-          if (merge_dy != NULL) {
-            ready_to_normal_.store(false);
-            ops_on_merge_dynamic_.fetch_add(1);
-            res = merge_dy->Find(key);
-            UpdateReadyNormalStatus();
-          }
-          break;
-        }
-        case MergedMode: {
-          if (ready_to_normal_.load()) {
-            break;
-          }
-          ready_to_normal_.store(false);
-          ops_on_merge_dynamic_.fetch_add(1);
-          DynamicType* merge_dy = merging_dynamic_index_.load();
-          res = merge_dy->Find(key);
-          UpdateReadyNormalStatus();
-          break;
-        }
-        default:
-          break;
-      }
+    // lookup in the frozen dynamic index under merging
+    if (res == std::numeric_limits<V>::max() && v->merging_index != NULL) {
+      res = v->merging_index->Find(key);
     }
 
     // lookup on static index (on disk)
     if (res == std::numeric_limits<V>::max()) {
-      switch (mode_.load()) {
-          // normal and merging modes lookup in the static index
-        case NormalMode:
-        case PrepareToMerge:
-        case MergingMode: {
-          StaticType* sta = static_index_.load();
-          res = sta->Find(key, thread_id);
-          break;
-        }
-          // merged mode lookup in the backup static index
-        case MergedMode: {
-          auto backup_static = backup_static_index_.load();
-          bool find_in_static = true;
-          if (backup_static && backup_static->GetUpdatedStatus()) {
-            UpdateVersion(thread_id);
-            find_in_static = false;
-          }
-          backup_static = backup_static_index_.load();
-          if (backup_static == NULL || find_in_static) {
-            StaticType* sta = static_index_.load();
-            res = sta->Find(key, thread_id);
-          } else {
-            res = backup_static->Find(key, thread_id);
-          }
-          break;
-        }
-        default:
-          break;
-      }
+      res = v->static_index->Find(key, thread_id);
       disk_find_cnt_++;
     }
-    threads_free_status_[thread_id].fetch_sub(1);
-    return res;
-  }
-
-  V Scan(const K key, const int range, int thread_id) {
-    // TODO: update the content
-    DynamicType* dy = dynamic_index_.load();
-    V res = dy->Scan(key, range);
-    mem_find_cnt_++;
-    disk_find_cnt_++;
-    UpdateVersion(thread_id);
-    StaticType* sta = static_index_.load();
-    if (res == std::numeric_limits<V>::max()) {
-      res = sta->Scan(key, range, thread_id);
-    } else {
-      res += sta->Scan(key, range, thread_id);
+    epoch_.Unpin(thread_id);
+    if (res == GetTombstone<V>()) {
+      return std::numeric_limits<V>::max();
     }
     return res;
   }
 
-  bool Insert(const K key, const V value, int thread_id) {
-    threads_free_status_[thread_id].fetch_add(1);
-    bool res = false;
-    DynamicType* dy = dynamic_index_.load();
-    switch (mode_.load()) {
-      case NormalMode: {
-        size_t curr_disk = GetTotalSize();
-        size_t curr_memory = GetCurrMemoryUsage();
-        if ((curr_disk - curr_memory) * 1.0 / curr_memory <= merge_ratio_) {
-          ModeType mode = NormalMode;
-          if (!mode_.compare_exchange_strong(mode, PrepareToMerge)) {
-            break;
-          }
-
-#ifdef PRINT_MULTI_THREAD_INFO
-          std::cout << "insert key " << key << " wait for merge!" << std::endl;
-#endif
-#ifdef BREAKDOWN
-          auto start = std::chrono::high_resolution_clock::now();
-#endif
-          int cnt = 0;
-          while (ready_to_merge_.load() == false) {
-            auto timeout = yield(cnt++);
-            if (timeout) {
-              break;
-            }
-          }
-#ifdef BREAKDOWN
-          auto end = std::chrono::high_resolution_clock::now();
-          normal_wait_lat[thread_id] +=
-              std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-                  .count();
-#endif
-
-#ifdef PRINT_MULTI_THREAD_INFO
-          StaticType* sta = static_index_.load();
-          auto static_size = sta->size();
-          std::cout << "insert key " << key
-                    << " need to merge! dynamic_size:" << dy->size()
-                    << ",\tstatic_size:" << static_size
-                    << ",\tmax_buffer_size_:" << max_buffer_size_
-                    << ",\ttotal size:" << PRINT_MIB(curr_disk)
-                    << ",\tmemory usage:" << PRINT_MIB(curr_memory)
-                    << std::endl;
-#endif
-          mode = PrepareToMerge;
-
-          if (mode_.compare_exchange_strong(mode, MergingMode)) {
-            dy = dynamic_index_.load();
-            max_memory_usage_ = std::max(max_memory_usage_, curr_memory);
-            max_dynamic_usage_ =
-                std::max(max_dynamic_usage_, dy->GetTotalSize());
-            max_dynamic_index_usage_ =
-                std::max(max_dynamic_index_usage_, dy->GetNodeSize());
-            max_buffer_size_ = std::max(max_buffer_size_, dy->size());
-            DynamicType* dynamic_null = NULL;
-            merging_dynamic_index_.compare_exchange_strong(
-                dynamic_null, dynamic_index_.load());
-            dy = new DynamicType(index_params_.d_params_);
-            dynamic_index_.store(dy);
-#ifdef PRINT_MULTI_THREAD_INFO
-            std::cout << "thread " << thread_id << ",\t call merge!"
-                      << std::endl;
-#endif
-            merge_cnt_++;
-            Merge(thread_id);
-          }
-#ifdef PRINT_MULTI_THREAD_INFO
-          else {
-            std::cout << "the dynamic index is under merging " << std::endl;
-          }
-#endif
-        }
-        break;
-      }
-      case PrepareToMerge: {
-#ifdef BREAKDOWN
-        auto start = std::chrono::high_resolution_clock::now();
-#endif
-        int cnt = 0;
-        while (mode_.load() == PrepareToMerge) {
-          auto timeout = yield(cnt++);
-          if (timeout) {
-            break;
-          }
-        }
-#ifdef BREAKDOWN
-        auto end = std::chrono::high_resolution_clock::now();
-        prepare_wait_lat[thread_id] +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-                .count();
-#endif
-        break;
-      }
-      case MergingMode: {
-        AssignedToMerge(thread_id);
-        size_t curr_disk = GetTotalSize();
-        size_t curr_memory = GetCurrMemoryUsage();
-#ifdef BREAKDOWN
-        auto start = std::chrono::high_resolution_clock::now();
-#endif
-        int cnt = 0;
-        while (mode_.load() == MergingMode &&
-               (curr_disk - curr_memory) * 1.0 / curr_memory <= merge_ratio_) {
-          auto timeout = yield(cnt++);
-          if (timeout) {
-            break;
-          }
-          curr_disk = GetTotalSize();
-          curr_memory = GetCurrMemoryUsage();
-          AssignedToMerge(thread_id);
-        }
-#ifdef BREAKDOWN
-        auto end = std::chrono::high_resolution_clock::now();
-        merging_wait_lat[thread_id] +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-                .count();
-#endif
-        break;
+  // Merge the first range live records from key of the dynamic index, the
+  // frozen one being merged and the static index. Each part is asked for
+  // range records at first; if the tombstones hide too many of them, the
+  // parts are read again for twice as many.
+  V Scan(const K key, const int range, int thread_id) {
+    V res = 0;
+    BaseVec parts[3];
+    for (size_t fetch_num = range;; fetch_num *= 2) {
+      for (auto& part : parts) {
+        part.clear();
       }
-      case MergedMode: {
-        UpdateVersion(thread_id);
-        size_t curr_disk = GetTotalSize();
-        size_t curr_memory = GetCurrMemoryUsage();
-#ifdef BREAKDOWN
-        auto start = std::chrono::high_resolution_clock::now();
-#endif
-        int cnt = 0;
-        while (mode_.load() == MergedMode &&
-               (curr_disk - curr_memory) * 1.0 / curr_memory <= merge_ratio_) {
-          auto timeout = yield(cnt++);
-          if (timeout) {
-            UpdateAllVersion();
-            break;
-          }
-          curr_disk = GetTotalSize();
-          curr_memory = GetCurrMemoryUsage();
-          UpdateVersion(thread_id);
-        }
-#ifdef BREAKDOWN
-        auto end = std::chrono::high_resolution_clock::now();
-        merged_wait_lat[thread_id] +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-                .count();
-#endif
-        break;
+      epoch_.Pin(thread_id);
+      Version* v = version_.load();
+      v->dynamic_index->Scan(key, fetch_num, parts[0]);
+      if (v->merging_index != NULL) {
+        v->merging_index->Scan(key, fetch_num, parts[1]);
       }
-      default: {
-        break;
+      v->static_index->Scan(key, fetch_num, parts[2], thread_id);
+      epoch_.Unpin(thread_id);
+      mem_find_cnt_++;
+      disk_find_cnt_++;
+      if (MergeScanParts(parts, 3, range, fetch_num, res)) {
+        return res;
       }
     }
-    mem_insert_cnt_++;
-
-    // insert into dynamic index
-    ready_to_merge_.store(false);
-    ops_on_dynamic_.fetch_add(1);
-    dy = dynamic_index_.load();
-    if (mode_.load() == PrepareToMerge) {
-      UpdateReadyMergeStatus();
-      threads_free_status_[thread_id].fetch_sub(1);
-      return Insert(key, value, thread_id);
-    }
-    res = dy->Insert(key, value);
-    UpdateReadyMergeStatus();
+  }
 
+  bool Insert(const K key, const V value, int thread_id) {
+    epoch_.Pin(thread_id);
+    Version* v = version_.load();
+    bool res = v->dynamic_index->Insert(key, value);
+    mem_insert_cnt_++;
 #ifdef CHECK_CORRECTION
-    if (ops_on_dynamic_ < 0) {
-      std::cout << "tid:" << thread_id << ",\tops on dy:" << ops_on_dynamic_
-                << std::endl;
-    }
-    V new_val = dy->Find(key);
+    V new_val = v->dynamic_index->Find(key);
     if (new_val != value) {
       std::cout << "insert wrong! key:" << key << ",\tval:" << value
                 << ",\tnew_val:" << new_val << std::endl;
-      dy->Find(key);
     }
 #endif
+    bool need_merge = NeedMerge(v);
+    epoch_.Unpin(thread_id);
+    if (!need_merge) {
+      return res;
+    }
 
-    threads_free_status_[thread_id].fetch_sub(1);
+    merge_insert_cnt_[thread_id]++;
+    bool merging = false;
+    if (merging_.compare_exchange_strong(merging, true)) {
+#ifdef PRINT_MULTI_THREAD_INFO
+      std::cout << "thread " << thread_id << ",\t call merge!" << std::endl;
+#endif
+      merge_cnt_++;
+      if (merge_pool_.empty()) {
+        Merge(thread_id);
+      } else {
+        // only hand the merge over to the pool
+        {
+          std::lock_guard<std::mutex> lock(pool_mutex_);
+          merge_requested_ = true;
+        }
+        pool_cv_.notify_one();
+      }
+    } else {
+      WaitForMerge(thread_id);
+    }
     return res;
   }
 
+  // A key of the dynamic index is updated in place under its leaf lock. The
+  // stored pages are patched in place only when no merge is running: the
+  // merge waits for the threads pinned before it froze the dynamic index, so
+  // it never copies a page while it is being patched. During a merge, the
+  // new value of an older key is inserted into the dynamic index instead,
+  // where it shadows the older versions until the next merge.
   bool Update(const K key, const V value, int thread_id) {
-    // TODO: update the code
-    return true;
+    epoch_.Pin(thread_id);
+    Version* v = version_.load();
+    if (v->dynamic_index->Update(key, value)) {
+      epoch_.Unpin(thread_id);
+      mem_update_cnt_++;
+      return true;
+    }
+    V res = v->dynamic_index->Find(key);
+    if (res == std::numeric_limits<V>::max() && v->merging_index != NULL) {
+      res = v->merging_index->Find(key);
+    }
+    if (res == GetTombstone<V>()) {
+      // a deleted key is not brought back by an update
+      epoch_.Unpin(thread_id);
+      return false;
+    }
+    if (res == std::numeric_limits<V>::max() && v->merging_index == NULL) {
+      bool success = v->static_index->Update(key, value, thread_id);
+      epoch_.Unpin(thread_id);
+      disk_update_cnt_++;
+      return success;
+    }
+    if (res == std::numeric_limits<V>::max()) {
+      res = v->static_index->Find(key, thread_id);
+      disk_find_cnt_++;
+    }
+    epoch_.Unpin(thread_id);
+    if (res == std::numeric_limits<V>::max() || res == GetTombstone<V>()) {
+      return false;
+    }
+    mem_update_cnt_++;
+    return Insert(key, value, thread_id);
   }
 
+  // The tombstone is inserted like a record, so it is charged against the
+  // memory budget and the merge drops it together with the deleted record.
   bool Delete(const K key, int thread_id) {
-    // TODO: update the code
-    return true;
+    delete_cnt_++;
+    return Insert(key, GetTombstone<V>(), thread_id);
   }
 
   inline size_t GetCurrMemoryUsage() const {
-    DynamicType* dy = dynamic_index_.load();
-    StaticType* sta = static_index_.load();
-    return dy->GetTotalSize() + sta->GetNodeSize();
+    Version* v = version_.load();
+    return v->dynamic_index->GetTotalSize() + v->static_index->GetNodeSize();
   }
   inline size_t GetNodeSize() const { return max_memory_usage_; }
+  // register the buffer of thread_id with the io_uring of the calling thread,
+  // the merged static indexes keep the same buffers
+  void RegisterBuffer(int thread_id) {
+    epoch_.Pin(thread_id);
+    version_.load()->static_index->RegisterBuffer(thread_id);
+    epoch_.Unpin(thread_id);
+  }
+
+  // the inserts of thread_id that have triggered or waited for a merge
+  inline size_t GetMergeInsertCnt(int thread_id) const {
+    return merge_insert_cnt_[thread_id];
+  }
   inline size_t GetTotalSize() const {
-    DynamicType* dy = dynamic_index_.load();
-    StaticType* sta = static_index_.load();
-    return dy->GetTotalSize() + sta->GetTotalSize();
+    Version* v = version_.load();
+    return v->dynamic_index->GetTotalSize() + v->static_index->GetTotalSize();
   }
   void PrintEachPartSize() {
-    DynamicType* dy = dynamic_index_.load();
-    StaticType* sta = static_index_.load();
+    Version* v = version_.load();
     std::cout << "-------------dynamic info-------------" << std::endl;
-    dy->PrintEachPartSize();
+    v->dynamic_index->PrintEachPartSize();
     std::cout << "-------------static info---------------" << std::endl;
-    sta->PrintEachPartSize();
+    v->static_index->PrintEachPartSize();
     std::cout << "-------------processing info-------------" << std::endl;
     std::cout << "\t\tmerge cnt:" << merge_cnt_
               << ",\tin-memory find cnt:" << mem_find_cnt_
               << ",\ton-disk find cnt:" << disk_find_cnt_
-              << ",\tin-memory insert:" << mem_insert_cnt_ << std::endl;
+              << ",\tin-memory insert:" << mem_insert_cnt_
+              << ",\tin-memory update:" << mem_update_cnt_
+              << ",\ton-disk update:" << disk_update_cnt_
+              << ",\tthrottled insert:" << throttled_insert_cnt_
+              << ",\tdelete cnt:" << delete_cnt_
+              << ",\tmerge threads:" << merge_pool_.size()
+              << ",\tunreclaimed versions:" << epoch_.GetRetiredNum()
+              << std::endl;
     std::cout << "-------------memory usage---------------" << std::endl;
     std::cout << "\tmerge_ratio:" << merge_ratio_
               << ",\tmax_buffer_size:" << max_buffer_size_
@@ -456,7 +328,8 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
               << PRINT_MIB(max_dynamic_index_usage_)
               << " MiB,\tmax_dynamic_data_node_usage:"
               << PRINT_MIB(max_dynamic_usage_ - max_dynamic_index_usage_)
-              << " MiB,\tmax_static_usage_:" << PRINT_MIB(sta->GetNodeSize())
+              << " MiB,\tmax_static_usage_:"
+              << PRINT_MIB(v->static_index->GetNodeSize())
               << " MiB,\tmax_memory_usage_:" << PRINT_MIB(max_memory_usage_)
               << " MiB" << std::endl;
     std::cout << "-------------print over---------------" << std::endl;
@@ -465,74 +338,132 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
     return GetDynamicName() + "_" + GetStaticName();
   }
   typename DynamicType::param_t GetDynamicParams() const {
-    DynamicType* dy = dynamic_index_.load();
-    return dy->GetIndexParams();
+    return version_.load()->dynamic_index->GetIndexParams();
   }
   typename StaticType::param_t GetStaticParams() const {
-    StaticType* sta = static_index_.load();
-    return sta->GetIndexParams();
+    return version_.load()->static_index->GetIndexParams();
   }
   size_t size() const {
-    DynamicType* dy = dynamic_index_.load();
-    size_t cnt = dy->size();
-    DynamicType* merging_dy = merging_dynamic_index_.load();
-    if (merging_dy != NULL) {
-      cnt += merging_dy->size();
+    Version* v = version_.load();
+    size_t cnt = v->dynamic_index->size();
+    if (v->merging_index != NULL) {
+      cnt += v->merging_index->size();
     }
-    StaticType* sta = static_index_.load();
-    cnt += sta->size();
+    cnt += v->static_index->size();
     return cnt;
   }
   void FreeBuffer() {
-    auto sta = static_index_.load();
-    sta->FreeBuffer();
+    // the merges in the background use the buffers too
+    StopMergePool();
+    version_.load()->static_index->FreeBuffer();
   }
 #ifdef BREAKDOWN
   void PrintBreakdown() {
     std::cout << "***********HYBRID BREAKDOWN***************" << std::endl;
     std::cout << "thread id"
               << ",\tassign_to_merge_lat/ms"
-              << ",\tupdate_version_lat/ms"
-              << ",\twait_to_normal_lat/ms"
-              << ",\tupdate_all_version_lat/ms"
+              << ",\tdrain_wait_lat/ms"
               << ",\tmerge_lat/ms"
               << ",\tmerge_cnt_"
-              << ",\tmerged_wait_lat/ms"
-              << ",\tmerging_wait_lat/ms"
-              << ",\tprepare_wait_lat/ms"
-              << ",\tnormal_wait_lat/ms" << std::endl;
+              << ",\tinsert_wait_lat/ms" << std::endl;
     for (int i = 0; i < assign_to_merge_lat.size(); i++) {
       std::cout << i << ",\t" << assign_to_merge_lat[i] / merge_cnt_ / 1e6
-                << ",\t" << update_version_lat[i] / merge_cnt_ / 1e6 << ",\t"
-                << wait_to_normal_lat[i] / merge_cnt_ / 1e6 << ",\t"
-                << update_all_version_lat[i] / merge_cnt_ / 1e6 << ",\t"
+                << ",\t" << drain_wait_lat[i] / merge_cnt_ / 1e6 << ",\t"
                 << merge_lat[i] / merge_cnt_ / 1e6 << ",\t" << merge_cnt[i]
-                << ",\t" << merged_wait_lat[i] / merge_cnt_ / 1e6 << ",\t"
-                << merging_wait_lat[i] / merge_cnt_ / 1e6 << ",\t"
-                << prepare_wait_lat[i] / merge_cnt_ / 1e6 << ",\t"
-                << normal_wait_lat[i] / merge_cnt_ / 1e6 << std::endl;
+                << ",\t" << insert_wait_lat[i] / merge_cnt_ / 1e6
+                << std::endl;
     }
-    auto sta = static_index_.load();
-    sta->PrintBreakdown();
+    version_.load()->static_index->PrintBreakdown();
   }
 #endif
 
  private:
+  // the indexes visible to the readers, replaced as a whole by the merges
+  struct Version {
+    DynamicType* dynamic_index;
+    DynamicType* merging_index;  // the frozen dynamic index, NULL if no merge
+    StaticType* static_index;
+  };
+
+  inline bool NeedMerge(Version* v) const {
+    size_t curr_disk =
+        v->dynamic_index->GetTotalSize() + v->static_index->GetTotalSize();
+    size_t curr_memory =
+        v->dynamic_index->GetTotalSize() + v->static_index->GetNodeSize();
+    return (curr_disk - curr_memory) * 1.0 / curr_memory <= merge_ratio_;
+  }
+
+  // Replace the current version, the old Version is freed by the epochs.
+  inline Version* Publish(Version* v) {
+    Version* old = version_.exchange(v);
+    epoch_.Retire([old] { delete old; });
+    return old;
+  }
+
+  // Only one thread merges at a time (merging_). It freezes the dynamic
+  // index, merges it into a copy of the static index with the help of the
+  // inserting threads, then publishes the merged version and retires the old
+  // static index and the frozen dynamic index.
   void Merge(int thread_id) {
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-    auto merging_dy = merging_dynamic_index_.load();
+    Version* curr = version_.load();
+    DynamicType* frozen_dy = curr->dynamic_index;
+    StaticType* old_sta = curr->static_index;
+    max_memory_usage_ = std::max(max_memory_usage_, GetCurrMemoryUsage());
+    max_dynamic_usage_ = std::max(max_dynamic_usage_, frozen_dy->GetTotalSize());
+    max_dynamic_index_usage_ =
+        std::max(max_dynamic_index_usage_, frozen_dy->GetNodeSize());
+    max_buffer_size_ = std::max(max_buffer_size_, frozen_dy->size());
+
+    // new inserts go to an empty dynamic index
+    Publish(new Version{new DynamicType(index_params_.d_params_), frozen_dy,
+                        old_sta});
+    DynamicType* new_dy = version_.load()->dynamic_index;
+#ifdef BREAKDOWN
+    auto start0 = std::chrono::high_resolution_clock::now();
+#endif
+    // wait for the inserts that still see the frozen index
+    epoch_.Synchronize(thread_id);
+#ifdef BREAKDOWN
+    auto end0 = std::chrono::high_resolution_clock::now();
+    drain_wait_lat[thread_id] +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end0 - start0)
+            .count();
+#endif
 
     // collect the data points in dynamic stage
     tmp_dynamic_data_ = BaseVec();
-    merging_dy = merging_dynamic_index_.load();
-    merging_dy->Merge(tmp_dynamic_data_);
+    frozen_dy->Merge(tmp_dynamic_data_);
     StaticType* backup_sta = new StaticType(index_params_.s_params_);
     // copy the current info into the backup static index
-    *backup_sta = *(static_index_.load());
-    backup_static_index_.store(backup_sta);
+    *backup_sta = *old_sta;
     backup_sta->Merge(tmp_dynamic_data_, thread_id);
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      backup_static_index_.store(backup_sta);
+      merge_round_++;
+    }
+    pool_cv_.notify_all();
+    // the partitions not taken by the other inserting threads
+    int cnt = 0;
+    while (!backup_sta->AllSubMergeFinished()) {
+      if (!AssignedToMerge(thread_id)) {
+        yield(cnt++);
+      }
+    }
+    backup_static_index_.store(NULL);
+    backup_sta->UpdateLatestVersion(thread_id);
+
+    Publish(new Version{new_dy, NULL, backup_sta});
+    epoch_.Retire([old_sta, frozen_dy] {
+      old_sta->DeleteFile();
+      delete old_sta;
+      delete frozen_dy;
+    });
+    epoch_.Reclaim();
+    merging_.store(false);
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
     merge_lat[thread_id] +=
@@ -542,53 +473,23 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
 #endif
   }
 
-  inline void AssignedToMerge(int thread_id) {
+  // take an unmerged partition of the running merge, if any
+  inline bool AssignedToMerge(int thread_id) {
     StaticType* backup_sta = backup_static_index_.load();
     if (backup_sta == NULL) {
-      return;
+      return false;
     }
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-
     auto partition_id = backup_sta->ObtainMergeTask(thread_id);
     if (partition_id >= 0) {
 #ifdef PRINT_MULTI_THREAD_INFO
-      DynamicType* dy = dynamic_index_.load();
       std::cout << "thread" << thread_id << ",\tobtain partition "
-                << partition_id
-                << " AssignedToMerge.1 tmp_dynamic_data_.size():"
-                << tmp_dynamic_data_.size() << ",\tdynamic size:" << dy->size()
-                << std::endl;
+                << partition_id << ",\ttmp_dynamic_data_.size():"
+                << tmp_dynamic_data_.size() << std::endl;
 #endif
       backup_sta->MergeSubData(tmp_dynamic_data_, thread_id, partition_id);
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread" << thread_id
-                << " AssignedToMerge.2 tmp_dynamic_data_.size():"
-                << tmp_dynamic_data_.size() << ",\tdynamic size:" << dy->size()
-                << std::endl;
-#endif
-    }
-    if (mode_.load() == MergingMode && backup_sta->AllSubMergeFinished()) {
-      ModeType now_mode = MergingMode;
-      bool change_mode = mode_.compare_exchange_strong(now_mode, MergedMode);
-      if (change_mode) {
-        backup_sta->UpdateLatestVersion(thread_id);
-#ifdef PRINT_MULTI_THREAD_INFO
-        std::cout << "thread " << thread_id
-                  << " AssignedToMerge.3 tmp_dynamic_data_.size():"
-                  << tmp_dynamic_data_.size()
-                  << ",\tdynamic size:" << dy->size() << std::endl;
-        std::cout << "tid:" << thread_id << ",\tchange mode to:" << mode_.load()
-                  << " success!" << std::endl;
-#endif
-      }
-#ifdef PRINT_MULTI_THREAD_INFO
-      else {
-        std::cout << "tid:" << thread_id << ",\tchange mode to:" << mode_.load()
-                  << " failed!" << std::endl;
-      }
-#endif
     }
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
@@ -596,107 +497,84 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
         std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
             .count();
 #endif
+    return partition_id >= 0;
   }
 
-  inline void UpdateVersion(int thread_id) {
-#ifdef BREAKDOWN
-    auto start = std::chrono::high_resolution_clock::now();
-#endif
-    auto backup_static = backup_static_index_.load();
-    if (backup_static && mode_.load() == MergedMode &&
-        backup_static->GetUpdatedStatus() &&
-        backup_static->CheckLatestVersion(thread_id)) {
-      // Compare And Swap
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread " << thread_id
-                << " try to update backup_static_index_!" << std::endl;
-#endif
-      auto now_static = static_index_.load();
-      auto success = false;
-      if (now_static != backup_static) {
-        success =
-            static_index_.compare_exchange_strong(now_static, backup_static);
-      }
-      auto succ2 =
-          backup_static_index_.compare_exchange_strong(backup_static, NULL);
-      if (!success) {
-#ifdef PRINT_MULTI_THREAD_INFO
-        std::cout << "thread " << thread_id
-                  << " try to update backup_static_index_ failed" << std::endl;
-#endif
-#ifdef BREAKDOWN
-        auto end = std::chrono::high_resolution_clock::now();
-        update_version_lat[thread_id] +=
-            std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
-                .count();
-#endif
-        return;
-      }
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread " << thread_id
-                << " try to delete file:" << std::endl;
-      std::cout << "res 1:" << success << ",\tres2:" << succ2 << std::endl;
-      std::cout << "static_index_:" << static_index_
-                << ",\tnow_static:" << now_static
-                << ",\tbackup_static:" << backup_static
-                << ",\tbackup_static_index_:" << backup_static_index_
-                << std::endl;
-#endif
-#ifdef BREAKDOWN
-      auto start0 = std::chrono::high_resolution_clock::now();
-#endif
-      now_static->DeleteFile();
+  // finish the requested merges and join the merge threads
+  inline void StopMergePool() {
+    {
+      std::lock_guard<std::mutex> lock(pool_mutex_);
+      stop_ = true;
+    }
+    pool_cv_.notify_all();
+    for (auto& t : merge_pool_) {
+      t.join();
+    }
+    merge_pool_.clear();
+  }
 
-      int spin_cnt = 0;
-      while (ready_to_normal_.load() == false) {
-        auto timeout = yield(spin_cnt++);
-        if (timeout) {
-          break;
+  // A merge thread of the pool either runs a requested merge or helps the
+  // running one with its partitions.
+  void MergeWorker(int thread_id) {
+    RegisterBuffer(thread_id);
+    uint64_t helped_round = 0;
+    std::unique_lock<std::mutex> lock(pool_mutex_);
+    while (true) {
+      pool_cv_.wait(lock, [&] {
+        return stop_ || merge_requested_ || merge_round_ != helped_round;
+      });
+      if (merge_requested_) {
+        merge_requested_ = false;
+        lock.unlock();
+        Merge(thread_id);
+        lock.lock();
+      } else if (merge_round_ != helped_round) {
+        helped_round = merge_round_;
+        lock.unlock();
+        epoch_.Pin(thread_id);
+        while (AssignedToMerge(thread_id)) {
         }
+        epoch_.Unpin(thread_id);
+        lock.lock();
+      } else {
+        return;
       }
-      merging_dynamic_index_.store(NULL);
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread " << thread_id
-                << " try to update backup_static_index_ successed" << std::endl;
-#endif
-      ModeType now_mode = MergedMode;
-      mode_.compare_exchange_strong(now_mode, NormalMode);
+    }
+  }
+
+  // An insert over the budget while another thread merges waits until the
+  // budget allows it to continue, i.e., the new dynamic index has filled up
+  // before the frozen one is drained. Without a merge pool, it helps to merge
+  // the partitions meanwhile.
+  inline void WaitForMerge(int thread_id) {
 #ifdef BREAKDOWN
-      auto end0 = std::chrono::high_resolution_clock::now();
-      wait_to_normal_lat[thread_id] +=
-          std::chrono::duration_cast<std::chrono::nanoseconds>(end0 - start0)
-              .count();
+    auto start = std::chrono::high_resolution_clock::now();
 #endif
+    bool throttled = false;
+    int cnt = 0;
+    while (merging_.load()) {
+      epoch_.Pin(thread_id);
+      bool worked = merge_pool_.empty() && AssignedToMerge(thread_id);
+      bool need_merge = NeedMerge(version_.load());
+      epoch_.Unpin(thread_id);
+      if (!need_merge) {
+        break;
+      }
+      throttled = true;
+      if (!worked && yield(cnt++)) {
+        break;
+      }
+    }
+    if (throttled) {
+      throttled_insert_cnt_++;
     }
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
-    update_version_lat[thread_id] +=
+    insert_wait_lat[thread_id] +=
         std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
             .count();
 #endif
   }
-  inline void UpdateReadyNormalStatus() {
-    auto prev = ops_on_merge_dynamic_.fetch_sub(1);
-    if (prev == 1) {
-      ready_to_normal_.store(true);
-    }
-  }
-
-  inline void UpdateReadyMergeStatus() {
-    auto prev = ops_on_dynamic_.fetch_sub(1);
-    if (prev == 1) {
-      ready_to_merge_.store(true);
-    }
-  }
-
-  inline void UpdateAllVersion() {
-    for (size_t i = 0; i < threads_free_status_.size(); i++) {
-      if (threads_free_status_[i].load() == 0 && mode_.load() == MergedMode) {
-        std::cout << "update all:" << i << std::endl;
-        UpdateVersion(i);
-      }
-    }
-  }
 
   bool yield(int count) {
     if (count > 100000000) {
@@ -712,38 +590,36 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
   }
 
   std::string GetDynamicName() const {
-    DynamicType* dy = dynamic_index_.load();
-    return dy->GetIndexName();
+    return version_.load()->dynamic_index->GetIndexName();
   }
 
   std::string GetStaticName() const {
-    StaticType* sta = static_index_.load();
-    return sta->GetIndexName();
+    return version_.load()->static_index->GetIndexName();
   }
 
 #ifdef BREAKDOWN
   std::vector<double> assign_to_merge_lat;
-  std::vector<double> update_version_lat;
-  std::vector<double> wait_to_normal_lat;
-  std::vector<double> update_all_version_lat;
+  std::vector<double> drain_wait_lat;
   std::vector<double> merge_lat;
   std::vector<double> merge_cnt;
-  std::vector<double> merged_wait_lat;
-  std::vector<double> merging_wait_lat;
-  std::vector<double> prepare_wait_lat;
-  std::vector<double> normal_wait_lat;
-#endif
-  std::atomic<DynamicType*> dynamic_index_;
-  std::atomic<DynamicType*> merging_dynamic_index_;
-  std::atomic<StaticType*> static_index_;
-  std::atomic<StaticType*> backup_static_index_;
-  std::atomic<ModeType> mode_;
-
-  std::atomic<int> ops_on_dynamic_{0};
-  std::atomic<int> ops_on_merge_dynamic_{0};
-  std::atomic<bool> ready_to_merge_{true};
-  std::atomic<bool> ready_to_normal_{true};
-  std::vector<std::atomic<int>> threads_free_status_;
+  std::vector<double> insert_wait_lat;
+#endif
+  std::atomic<Version*> version_;
+  // the static index under merging, for the threads helping the merge
+  std::atomic<StaticType*> backup_static_index_{NULL};
+  std::atomic<bool> merging_{false};
+  EpochManager epoch_;
+
+  size_t foreground_thread_num_;
+  std::vector<std::thread> merge_pool_;
+  std::mutex pool_mutex_;
+  std::condition_variable pool_cv_;
+  bool merge_requested_ = false;  // guarded by pool_mutex_
+  uint64_t merge_round_ = 0;      // guarded by pool_mutex_
+  bool stop_ = false;             // guarded by pool_mutex_
+  std::atomic<size_t> throttled_insert_cnt_{0};
+  std::atomic<size_t> delete_cnt_{0};
+  std::vector<size_t> merge_insert_cnt_;  // written by its own thread only
 
   BaseVec tmp_dynamic_data_;
   param_t index_params_;
@@ -763,4 +639,4 @@ class MultiThreadedHybridIndex : public MultiThreadedBaseIndex<K, V> {
   size_t merge_ratio_;
 };
 
-#endif  // !INDEXES_MULTI_THREADED_HYBRID_INDEX_H_
\ No newline at end of file
+#endif  // !INDEXES_MULTI_THREADED_HYBRID_INDEX_H_
@@ -92,9 +92,11 @@ class MultiThreadedStaticCprDI : public MultiThreadedStaticIndex<K, V> {
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-    // rebuild the static index
-    di_[partition_id] = IndexType(record_per_page_);
-    di_[partition_id].Build(train_data, lambda_);
+    // rebuild the static index, an unchanged partition keeps its model
+    if (Base::NeedRetrain(partition_id)) {
+      di_[partition_id] = IndexType(record_per_page_);
+      di_[partition_id].Build(train_data, lambda_);
+    }
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
     Base::model_training_lat[thread_id] +=
@@ -113,20 +115,30 @@ class MultiThreadedStaticCprDI : public MultiThreadedStaticIndex<K, V> {
 
   V Find(const K key, int thread_id) {
     auto pid = Base::GetPartitionID(key);
+    if (pid >= di_.size()) {
+      return std::numeric_limits<V>::max();
+    }
     auto range = di_[pid].GetSearchBound(key);
     SearchRange static_range = {range.begin, range.end};
     return Base::FindData(static_range, key, thread_id, pid);
   }
 
-  V Scan(const K key, const int length, int thread_id) {
+  void Scan(const K key, const int length, typename Base::DataVec_& out,
+            int thread_id) {
     auto pid = Base::GetPartitionID(key);
+    if (pid >= di_.size()) {
+      return;
+    }
     auto range = di_[pid].GetSearchBound(key);
     SearchRange static_range = {range.begin, range.end};
-    return Base::ScanData(static_range, key, length, thread_id, pid);
+    Base::ScanData(static_range, key, length, out, thread_id, pid);
   }
 
   bool Update(const K key, const V value, int thread_id) {
     auto pid = Base::GetPartitionID(key);
+    if (pid >= di_.size()) {
+      return false;
+    }
     auto range = di_[pid].GetSearchBound(key);
     SearchRange static_range = {range.begin, range.end};
     return Base::UpdateData(static_range, key, value, thread_id, pid);
@@ -233,9 +233,11 @@ class MultiThreadedStaticLecoPage : public MultiThreadedStaticIndex<K, V> {
 #ifdef BREAKDOWN
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-    // rebuild the static index
-    leco_[partition_id] = LeCoZonemap(params_);
-    leco_[partition_id].Build(train_data);
+    // rebuild the static index, an unchanged partition keeps its model
+    if (Base::NeedRetrain(partition_id)) {
+      leco_[partition_id] = LeCoZonemap(params_);
+      leco_[partition_id].Build(train_data);
+    }
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
     Base::model_training_lat[thread_id] +=
@@ -255,20 +257,30 @@ class MultiThreadedStaticLecoPage : public MultiThreadedStaticIndex<K, V> {
 
   V Find(const K key, int thread_id) {
     auto pid = Base::GetPartitionID(key);
+    if (pid >= leco_.size()) {
+      return std::numeric_limits<V>::max();
+    }
     auto range = leco_[pid].FindRange(key);
     return Base::FindData(range, key, thread_id, pid);
   }
 
   bool Update(const K key, const V value, int thread_id) {
     auto pid = Base::GetPartitionID(key);
-    auto range = leco_[pid].FindRange(key, thread_id);
+    if (pid >= leco_.size()) {
+      return false;
+    }
+    auto range = leco_[pid].FindRange(key);
     return Base::UpdateData(range, key, value, thread_id, pid);
   }
 
-  V Scan(const K key, const int length, int thread_id) {
+  void Scan(const K key, const int length, typename Base::DataVec_& out,
+            int thread_id) {
     auto pid = Base::GetPartitionID(key);
+    if (pid >= leco_.size()) {
+      return;
+    }
     auto range = leco_[pid].FindRange(key);
-    return Base::ScanData(range, key, length, thread_id, pid);
+    Base::ScanData(range, key, length, out, thread_id, pid);
   }
 
   inline size_t size() const { return Base::size(); }
@@ -3,15 +3,18 @@
 #include <algorithm>
 #include <atomic>
 #include <iostream>
+#include <mutex>
 #include <vector>
 
 #include "../../../ycsb_utils/structures.h"
 #include "../../../ycsb_utils/util_search.h"
+#include "../../tombstone.h"
 
 template <typename K, typename V>
 class MultiThreadedStaticIndex {
  public:
   MultiThreadedStaticIndex() {}
+  virtual ~MultiThreadedStaticIndex() {}
 
   typedef K K_;
   typedef V V_;
@@ -25,39 +28,43 @@ class MultiThreadedStaticIndex {
     uint64_t merge_thread_numbers;
   };
 
+  // The records merged into a partition: the stored records from the
+  // static_start_-th one on, counted over all the partitions of the current
+  // version, and the dynamic records in [dynamic_start_idx_,
+  // dynamic_end_idx_). A partition whose records are the same as before keeps
+  // its model, see NeedRetrain.
   class PartitionRange {
    public:
     PartitionRange() {
       thread_id = -1;
-      start_page_id_ = 0;
-      static_page_num_ = 0;
+      static_start_ = 0;
       static_data_num_ = 0;
       dynamic_start_idx_ = 0;
       dynamic_end_idx_ = 0;
       stored_start_pid_ = 0;
+      changed_ = true;
     }
-    void SetRange(uint64_t start_pid, uint64_t page_num, uint64_t data_num,
-                  int64_t dy_start, uint64_t dy_end,
-                  uint64_t stored_start_pid) {
+    void SetRange(uint64_t static_start, uint64_t data_num, int64_t dy_start,
+                  uint64_t dy_end, uint64_t stored_start_pid, bool changed) {
       thread_id = -1;
-      start_page_id_ = start_pid;
-      static_page_num_ = page_num;
+      static_start_ = static_start;
       static_data_num_ = data_num;
       dynamic_start_idx_ = dy_start;
       dynamic_end_idx_ = dy_end;
       stored_start_pid_ = stored_start_pid;
+      changed_ = changed;
     }
 
     void SetThreadID(int tid) { thread_id = tid; }
 
    public:
     int thread_id;
-    uint64_t start_page_id_;
-    uint64_t static_page_num_;
+    uint64_t static_start_;
     uint64_t static_data_num_;
     uint64_t dynamic_start_idx_;
     uint64_t dynamic_end_idx_;
     uint64_t stored_start_pid_;
+    bool changed_;
   };
 
   class ThreadParams {
@@ -111,11 +118,6 @@ class MultiThreadedStaticIndex {
         data_numbers_(std::vector<uint64_t>(p.merge_thread_numbers, 0)),
         page_start_ids_(std::vector<uint64_t>(p.merge_thread_numbers, 0)),
         page_last_ids_(std::vector<uint64_t>(p.merge_thread_numbers, 0)) {
-    consistent_version_cnt_.store(thread_numbers_);
-    old_version_ = 1;
-
-    std::string filename =
-        data_file_ + std::to_string(latest_version_.load() + 1);
     for (uint64_t i = 0; i < thread_numbers_; i++) {
       threads_[i].PrepareBuffer(p.page_bytes);
     }
@@ -173,13 +175,11 @@ class MultiThreadedStaticIndex {
 #endif
     }
     latest_version_.store(1);
-    consistent_version_cnt_.store(1);
 
     for (size_t i = 0; i < thread_numbers_; i++) {
       if (i != thread_id) {
         auto fd = DirectIOOpen(filename);
         threads_[i].UpdateFile(fd, latest_version_.load());
-        consistent_version_cnt_.fetch_add(1);
       }
     }
 
@@ -208,7 +208,7 @@ class MultiThreadedStaticIndex {
 #endif
   }
 
-  // only copy the current data info
+  // only copy the current data info, the buffers are shared with other
   MultiThreadedStaticIndex& operator=(const MultiThreadedStaticIndex& other) {
     name_ = other.name_;
     data_file_ = other.data_file_;
@@ -217,16 +217,14 @@ class MultiThreadedStaticIndex {
     thread_numbers_ = other.thread_numbers_;
     uint64_t ver = other.latest_version_.load();
     latest_version_.store(ver);
-    consistent_version_cnt_.store(thread_numbers_);
     for (uint64_t i = 0; i < thread_numbers_; i++) {
       std::string filename =
           data_file_ + std::to_string(latest_version_.load());
       int fd = DirectIOOpen(filename);
-      threads_[i].SetFD(fd);
-      threads_[i].SetVersion(other.threads_[i].GetVersion());
+      threads_[i].UpdateFile(fd, ver);
+      threads_[i].FreeBuffer();
       threads_[i].buf_ = other.threads_[i].buf_;
     }
-    old_version_ = other.old_version_;
     merge_thread_num_ = other.merge_thread_num_;
     partition_keys_ = other.partition_keys_;
 #ifdef CHECK_CORRECTION
@@ -248,7 +246,12 @@ class MultiThreadedStaticIndex {
 #ifdef PRINT_MULTI_THREAD_INFO
     std::cout << "deleting " << filename << std::endl;
 #endif
-    std::remove(filename.c_str());
+    DirectIORemove(filename);
+  }
+
+  inline void RegisterBuffer(int thread_id) {
+    RegisterIOBuffer(threads_[thread_id].buf_,
+                     record_per_page_ * sizeof(Record_) * ALLOCATED_BUF_SIZE);
   }
 
   inline void FreeBuffer() {
@@ -258,8 +261,7 @@ class MultiThreadedStaticIndex {
   }
 
   inline ResultInfo<K, V> LowerBound(const SearchRange& range, const K key,
-                                     uint64_t length, int thread_id,
-                                     int partition_id) {
+                                     int thread_id, int partition_id) {
 #ifdef CHECK_CORRECTION
     int page_cnt =
         page_last_ids_[partition_id] - page_start_ids_[partition_id] + 1;
@@ -292,7 +294,7 @@ class MultiThreadedStaticIndex {
     }
     return NormalCoreLookup<K_, V_>(
         threads_[thread_id].GetFD(), range, key, kWorstCase, record_per_page_,
-        length, page_last_ids_[partition_id], threads_[thread_id].buf_, last_id,
+        page_last_ids_[partition_id], threads_[thread_id].buf_, last_id,
         page_start_ids_[partition_id]);
   }
 
@@ -305,9 +307,7 @@ class MultiThreadedStaticIndex {
 #ifdef PRINT_MULTI_THREAD_INFO
     std::cout << "in staticbase::MergeData, size():" << size() << ",\tthread "
               << thread_id << ",\tpartition id:" << partition_id
-              << ",\tstart_pid:" << partitions_[partition_id].start_page_id_
-              << ",\tstatic_page_num:"
-              << partitions_[partition_id].static_page_num_
+              << ",\tstatic_start:" << partitions_[partition_id].static_start_
               << ",\tstatic_data_num:" << static_data_num << std::endl;
 #endif
     auto dy_size = partitions_[partition_id].dynamic_end_idx_ -
@@ -323,9 +323,9 @@ class MultiThreadedStaticIndex {
 #ifdef BREAKDOWN
       start = std::chrono::high_resolution_clock::now();
 #endif
-      GetSubData(merged_data, thread_id,
-                 partitions_[partition_id].start_page_id_,
-                 partitions_[partition_id].static_page_num_, static_data_num);
+      GetStoredRecords(merged_data, thread_id,
+                       partitions_[partition_id].static_start_,
+                       static_data_num);
 #ifdef BREAKDOWN
       end = std::chrono::high_resolution_clock::now();
       get_static_data_lat[thread_id] +=
@@ -335,8 +335,8 @@ class MultiThreadedStaticIndex {
     }
 #ifdef PRINT_MULTI_THREAD_INFO
     std::cout << ",\tthread " << thread_id << ",\tpartition id:" << partition_id
-              << ",\tpartitions_[partition_id].start_page_id_:"
-              << partitions_[partition_id].start_page_id_ << std::endl;
+              << ",\tpartitions_[partition_id].static_start_:"
+              << partitions_[partition_id].static_start_ << std::endl;
 
     std::cout << ",\tthread " << thread_id << ",\tpartition id:" << partition_id
               << ",\tfirst_dy_idx:"
@@ -378,10 +378,11 @@ class MultiThreadedStaticIndex {
 #ifdef BREAKDOWN
     start = std::chrono::high_resolution_clock::now();
 #endif
-    uint64_t old_ver = latest_version_.load();
-    std::string filename = data_file_ + std::to_string(old_ver + 1);
+    // the partitions are merged into the next version of the file, the
+    // threads keep reading the current one until UpdateLatestVersion
+    std::string filename =
+        data_file_ + std::to_string(latest_version_.load() + 1);
     int fd = DirectIOOpen(filename);
-    threads_[thread_id].UpdateFile(fd, old_ver + 1);
     size_t page_byte = record_per_page_ * sizeof(Record_);
 #ifdef BREAKDOWN
     end = std::chrono::high_resolution_clock::now();
@@ -416,8 +417,9 @@ class MultiThreadedStaticIndex {
 #ifdef CHECK_CORRECTION
     partition_min_keys_[partition_id] = merged_data[0].first;
     DataVec_ check_res(data_numbers_[partition_id]);
-    GetSubData(check_res, thread_id, page_start_ids_[partition_id],
-               merged_page_num, data_numbers_[partition_id]);
+    GetAllData<K, V>(fd, page_start_ids_[partition_id], merged_page_num,
+                     record_per_page_, data_numbers_[partition_id],
+                     threads_[thread_id].buf_, check_res);
     for (size_t i = 1; i < check_res.size(); i++) {
       if (check_res[i].first < check_res[i - 1].first) {
         std::cout << "partition " << partition_id << " store " << i
@@ -434,21 +436,7 @@ class MultiThreadedStaticIndex {
     }
     data_[partition_id] = check_res;
 #endif
-
-    // Compare And Swap
-    consistent_version_cnt_.fetch_add(1);
-#ifdef PRINT_MULTI_THREAD_INFO
-    std::cout << "in thread " << thread_id
-              << ", new consistent_version_cnt_:" << consistent_version_cnt_
-              << std::endl;
-    std::cout << "latest_version_:" << latest_version_ << std::endl;
-    std::cout << "now thread id:" << thread_id << std::endl;
-    for (uint64_t i = 0; i < thread_numbers_; i++) {
-      std::cout << " ------- " << thread_id << " ------- [" << i
-                << "]: fd:" << threads_[i].GetFD()
-                << ",\tver:" << threads_[i].GetVersion() << std::endl;
-    }
-#endif
+    DirectIOClose(fd);
   }
 
   inline void FinishMerge(int thread_id) {
@@ -466,80 +454,23 @@ class MultiThreadedStaticIndex {
 
   virtual void Build(DataVec_& new_data, int thread_id) = 0;
 
-  inline std::pair<int*, uint64_t*> GetCurrThreadInfo(int thread_id) {
-    return threads_[thread_id].GetInfo();
-  }
-
   inline bool AllSubMergeFinished() {
     return finished_thread_num_.load() == merge_thread_num_;
   }
 
-  inline bool GetUpdatedStatus() {
-    return old_version_ != latest_version_.load();
-  }
-
-  inline bool UpdateLatestVersion(int thread_id) {
-    bool updated = false;
-    bool success = updated_.compare_exchange_strong(updated, true);
-    if (success) {
-      uint64_t old_ver = latest_version_.load();
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "latest_version_:" << latest_version_ << std::endl;
-#endif
-      latest_version_.compare_exchange_strong(old_ver, old_ver + 1);
-
-      finished_thread_num_.store(0);
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread " << thread_id
-                << " updated latest_version_:" << latest_version_ << std::endl;
-      std::cout << "AllSubMergeFinished! tid:" << thread_id
-                << ",\tfinished_thread_num_:" << finished_thread_num_.load()
-                << ",\tmerge_thread_num_:" << merge_thread_num_ << std::endl;
-#endif
-    }
-    return success;
-  }
-
-  inline bool CheckLatestVersion(int thread_id) {
-    if (!GetUpdatedStatus()) {
-      return false;
+  // Switch every thread to the merged file once all the partitions are
+  // merged. It must be called before this index is published to the readers.
+  inline void UpdateLatestVersion(int thread_id) {
+    uint64_t ver = latest_version_.fetch_add(1) + 1;
+    std::string filename = data_file_ + std::to_string(ver);
+    for (uint64_t i = 0; i < thread_numbers_; i++) {
+      threads_[i].UpdateFile(DirectIOOpen(filename), ver);
     }
-    if (threads_[thread_id].GetVersion() <
-        static_cast<int>(latest_version_.load())) {
-#ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread " << thread_id << " update version, old fd"
-                << threads_[thread_id].GetFD()
-                << ",\tver:" << threads_[thread_id].GetVersion()
-                << ",\tlatest_version_.load():" << latest_version_.load()
-                << ",\tcpr:"
-                << (threads_[thread_id].GetVersion() ==
-                    static_cast<int>(latest_version_.load()))
-                << (threads_[thread_id].GetVersion() == latest_version_.load())
-                << std::endl;
-#endif
-      // the version of this thread is outdated, update fd
-      std::string filename =
-          data_file_ + std::to_string(latest_version_.load());
-      auto fd = DirectIOOpen(filename);
-      threads_[thread_id].UpdateFile(fd, latest_version_);
-      consistent_version_cnt_.fetch_add(1);
+    finished_thread_num_.store(0);
 #ifdef PRINT_MULTI_THREAD_INFO
-      std::cout << "thread " << thread_id << " update version, new fd"
-                << threads_[thread_id].GetFD()
-                << ",\tver:" << threads_[thread_id].GetVersion() << std::endl;
-      std::cout << "consistent_version_cnt_ " << consistent_version_cnt_
-                << std::endl;
-#endif
-#ifdef CHECK_CORRECTION
-      if (consistent_version_cnt_ > thread_numbers_) {
-        std::cout << "tid:" << thread_id
-                  << ",\tconsistent_version_cnt_:" << consistent_version_cnt_
-                  << ",\tthread_numbers_:" << thread_numbers_ << std::endl;
-      }
+    std::cout << "thread " << thread_id
+              << " updated latest_version_:" << latest_version_ << std::endl;
 #endif
-    }
-
-    return consistent_version_cnt_.load() == thread_numbers_;
   }
 
   inline int ObtainMergeTask(int thread_id) {
@@ -548,9 +479,8 @@ class MultiThreadedStaticIndex {
     try_to_obtain_task_cnt[thread_id]++;
 #endif
     int partition_id = processing_thread_num_.load();
-    if (partition_id >= 0 &&
-        partition_id < static_cast<int>(merge_thread_num_) &&
-        (threads_[thread_id].GetVersion() == latest_version_.load())) {
+    while (partition_id >= 0 &&
+           partition_id < static_cast<int>(merge_thread_num_)) {
 #ifdef PRINT_MULTI_THREAD_INFO
       std::cout << "thread" << thread_id
                 << ",\tver:" << threads_[thread_id].GetVersion()
@@ -581,16 +511,41 @@ class MultiThreadedStaticIndex {
     return -1;
   }
 
+  // Split the merge into merge_thread_num_ tasks. The partitions keep their
+  // boundaries unless the largest one would merge more than
+  // kMaxPartitionSkew times its share of the records, e.g., when the inserts
+  // come in key order and all land in the last partition, which leaves a
+  // single thread to merge them. The boundaries are then moved so that every
+  // partition merges about the same number of records: the hot partitions
+  // are split and the cold ones are coalesced.
   inline void PartitionData(DataVec_& dy_data, int thread_id) {
 #ifdef BREAKDOWN
     merge_cnt++;
     auto start = std::chrono::high_resolution_clock::now();
 #endif
-    updated_.store(false);
-    old_version_ = latest_version_.load();
+    // the stored records are read through the layout of the current version
+    // while the merged partitions overwrite data_numbers_ and page_start_ids_
+    prev_static_starts_ = std::vector<uint64_t>(merge_thread_num_ + 1, 0);
+    prev_page_start_ids_ = page_start_ids_;
+    std::vector<uint64_t> static_starts(merge_thread_num_ + 1, 0);
+    std::vector<uint64_t> dy_starts(merge_thread_num_ + 1, 0);
+    uint64_t total_num = 0, max_num = 0;
     for (size_t i = 0; i < merge_thread_num_; i++) {
       auto dy_range = GetDynamicRange(dy_data, i, thread_id);
+      prev_static_starts_[i + 1] = prev_static_starts_[i] + data_numbers_[i];
+      dy_starts[i + 1] = dy_range.second;
+      uint64_t num = data_numbers_[i] + dy_range.second - dy_range.first;
+      total_num += num;
+      max_num = std::max(max_num, num);
+    }
+    static_starts = prev_static_starts_;
+    if (merge_thread_num_ > 1 &&
+        total_num >= merge_thread_num_ * record_per_page_ &&
+        max_num > kMaxPartitionSkew * total_num / merge_thread_num_) {
+      Rebalance(dy_data, total_num, static_starts, dy_starts, thread_id);
+    }
 
+    for (size_t i = 0; i < merge_thread_num_; i++) {
       size_t stored_pid_start = 0;
       size_t last_page_cnt = 0;
       if (i > 0) {
@@ -600,30 +555,26 @@ class MultiThreadedStaticIndex {
                                   1.0 / record_per_page_);
         stored_pid_start = partitions_[i - 1].stored_start_pid_ + last_page_cnt;
       }
+      bool changed = dy_starts[i + 1] > dy_starts[i] ||
+                     static_starts[i] != prev_static_starts_[i] ||
+                     static_starts[i + 1] != prev_static_starts_[i + 1];
 
       partitions_[i].SetRange(
-          page_start_ids_[i], page_last_ids_[i] - page_start_ids_[i] + 1,
-          data_numbers_[i], dy_range.first, dy_range.second, stored_pid_start);
+          static_starts[i], static_starts[i + 1] - static_starts[i],
+          dy_starts[i], dy_starts[i + 1], stored_pid_start, changed);
 
 #ifdef PRINT_MULTI_THREAD_INFO
       std::cout << "----- partition " << i
-                << ", start_page_id_:" << partitions_[i].start_page_id_
-                << ",\tsta_page_num_:" << partitions_[i].static_page_num_
+                << ", static_start_:" << partitions_[i].static_start_
                 << ",\tsta_data_num_:" << partitions_[i].static_data_num_
                 << ",\tdy_start_idx_:" << partitions_[i].dynamic_start_idx_
                 << ",\tdy_end_idx_:" << partitions_[i].dynamic_end_idx_
                 << ",\tstored_pid_start:" << partitions_[i].stored_start_pid_
-                << ",\tprev_page_cnt:" << last_page_cnt << std::endl;
+                << ",\tprev_page_cnt:" << last_page_cnt
+                << ",\tchanged:" << changed << std::endl;
 #endif
     }
     processing_thread_num_.store(0);
-
-    int t_num = thread_numbers_;
-#ifdef PRINT_MULTI_THREAD_INFO
-    std::cout << ", consistent_version_cnt_:" << consistent_version_cnt_
-              << std::endl;
-#endif
-    consistent_version_cnt_.compare_exchange_strong(t_num, 0);
 #ifdef CHECK_CORRECTION
     data_ = std::vector<DataVec_>(merge_thread_num_);
 #endif
@@ -635,6 +586,12 @@ class MultiThreadedStaticIndex {
 #endif
   }
 
+  // the records of the partition differ from the ones its model was trained
+  // on, either it merges dynamic records or its boundaries have moved
+  inline bool NeedRetrain(int partition_id) const {
+    return partitions_[partition_id].changed_;
+  }
+
   inline int GetPartitionID(const K_ key) {
     auto it =
         std::lower_bound(partition_keys_.begin(), partition_keys_.end(), key);
@@ -643,27 +600,79 @@ class MultiThreadedStaticIndex {
 
   inline V FindData(const SearchRange& range, const K_ key, int thread_id,
                     int partition_id) {
-    ResultInfo<K_, V_> res = LowerBound(range, key, 1, thread_id, partition_id);
+    ResultInfo<K_, V_> res = LowerBound(range, key, thread_id, partition_id);
+    if (res.res != key) {
+      // a missing key, e.g., a deleted one
+      return std::numeric_limits<V_>::max();
+    }
     return res.val;
   }
 
   inline bool UpdateData(const SearchRange& range, const K_ key, const V_ value,
                          int thread_id, int partition_id) {
-    ResultInfo<K_, V_> res = LowerBound(range, key, 1, thread_id, partition_id);
+    ResultInfo<K_, V_> res = LowerBound(range, key, thread_id, partition_id);
+    if (res.res != key || res.val == GetTombstone<V_>()) {
+      // a missing or deleted key is not brought back by an update
+      return false;
+    }
+    // the read-modify-write of the page must not interleave with another
+    // update of the same page
+    std::lock_guard<std::mutex> lock(page_latches_[res.pid % kPageLatchNum]);
     return Update1Page(res.fd, res.pid, res.idx, key, value,
                        record_per_page_ * sizeof(Record_),
                        threads_[thread_id].buf_);
   }
 
-  inline V ScanData(const SearchRange& range, const K key, const int length,
-                    int thread_id, int partition_id) {
-    ResultInfo<K, V> res =
-        LowerBound(range, key, length, thread_id, partition_id);
-    return res.val;
+  // Append the first length records from key on to out. A stored key lies
+  // in range of partition_id, so the pages from range.start to the last one
+  // that may hold the length-th record are fetched by one read. A scan
+  // running past the end of a partition goes on in the next one.
+  inline void ScanData(const SearchRange& range, const K key, const int length,
+                       DataVec_& out, int thread_id, int partition_id) {
+    const uint64_t page_bytes = record_per_page_ * sizeof(Record_);
+    Record_* buf = reinterpret_cast<Record_*>(threads_[thread_id].buf_);
+    const size_t init_size = out.size();
+    const size_t target = init_size + length;
+    for (uint64_t p = partition_id; p < merge_thread_num_ && out.size() < target;
+         p++) {
+      uint64_t s = p == partition_id ? range.start : 0;
+      uint64_t e = p == partition_id ? range.stop : 0;
+      while (s < data_numbers_[p] && out.size() < target) {
+        uint64_t pid = s / record_per_page_;
+        uint64_t end = std::min<uint64_t>(data_numbers_[p],
+                                          std::max(s, e) + target - out.size());
+        uint64_t page_num = std::min<uint64_t>(
+            (end - 1) / record_per_page_ - pid + 1, ALLOCATED_BUF_SIZE);
+        end = std::min<uint64_t>(end, (pid + page_num) * record_per_page_);
+        DirectIORead<K>(threads_[thread_id].GetFD(), page_bytes, page_num,
+                        (page_start_ids_[p] + pid) * page_bytes,
+                        threads_[thread_id].buf_);
+        if (out.size() == init_size && pid > 0 && buf[0].first > key) {
+          // a key that is not stored may precede the range of the model
+          s = (pid - 1) * record_per_page_;
+          continue;
+        }
+        Record_* last = buf + end - pid * record_per_page_;
+        // once the scan has started, the records before s are already taken
+        Record_* first =
+            out.size() == init_size ? buf : buf + s - pid * record_per_page_;
+        Record_* it = std::lower_bound(
+            first, last, key,
+            [](const auto& lhs, const K& key) { return lhs.first < key; });
+        for (; it != last && out.size() < target; it++) {
+          out.push_back(*it);
+        }
+        s = e = end;
+      }
+    }
   }
 
   inline size_t GetDiskBytes() const { return sizeof(Record_) * size(); }
 
+  inline uint64_t GetPartitionSize(int partition_id) const {
+    return data_numbers_[partition_id];
+  }
+
   inline size_t size() const {
     size_t cnt = 0;
     for (size_t i = 0; i < merge_thread_num_; i++) {
@@ -687,7 +696,8 @@ class MultiThreadedStaticIndex {
               << ",\tstore_disk_lat/ms"
               << ",\tstore_page_num"
               << ",\tmodel_training_lat" << std::endl;
-    std::cout << "merge cnt:" << merge_cnt << std::endl;
+    std::cout << "merge cnt:" << merge_cnt
+              << ",\trebalance cnt:" << rebalance_cnt << std::endl;
     for (size_t i = 0; i < thread_numbers_; i++) {
       std::cout << i << ",\t" << partition_lat[i] / merge_cnt / 1e6 << ",\t"
                 << get_dynamic_range_lat[i] / merge_cnt / 1e6 << ",\t"
@@ -719,14 +729,20 @@ class MultiThreadedStaticIndex {
 #endif
     size_t first_dy_idx = 0, end_dy_idx = 0;
     if (idx > 0) {
-      auto it_l = std::lower_bound(
+      // a key equal to the last key of a partition belongs to it, as in
+      // GetPartitionID, so that it replaces the stored record
+      auto it_l = std::upper_bound(
           dy_data.begin(), dy_data.end(), partition_keys_[idx - 1],
-          [](const auto& lhs, const K& key) { return lhs.first < key; });
+          [](const K& key, const auto& rhs) { return key < rhs.first; });
       first_dy_idx = it_l - dy_data.begin();
     }
-    auto it_r = std::lower_bound(
-        dy_data.begin(), dy_data.end(), partition_keys_[idx],
-        [](const auto& lhs, const K& key) { return lhs.first < key; });
+    // the last partition also takes the keys beyond its current last key
+    auto it_r = dy_data.end();
+    if (idx + 1 < merge_thread_num_) {
+      it_r = std::upper_bound(
+          dy_data.begin(), dy_data.end(), partition_keys_[idx],
+          [](const K& key, const auto& rhs) { return key < rhs.first; });
+    }
     end_dy_idx = it_r - dy_data.begin();
 #ifdef BREAKDOWN
     auto end = std::chrono::high_resolution_clock::now();
@@ -737,6 +753,115 @@ class MultiThreadedStaticIndex {
     return {first_dy_idx, end_dy_idx};
   }
 
+  // Move the boundaries between the partitions to the ranks total_num * i /
+  // merge_thread_num_ of the merged records. static_starts and dy_starts hold
+  // the current boundaries and are set to the new ones. A boundary falling
+  // into a partition is found by a binary search over its stored records,
+  // read one page at a time, and its dynamic records.
+  inline void Rebalance(DataVec_& dy_data, uint64_t total_num,
+                        std::vector<uint64_t>& static_starts,
+                        std::vector<uint64_t>& dy_starts, int thread_id) {
+#ifdef BREAKDOWN
+    rebalance_cnt++;
+#endif
+    const std::vector<uint64_t> prev_dy_starts = dy_starts;
+    Record_* buf = reinterpret_cast<Record_*>(threads_[thread_id].buf_);
+    const uint64_t page_bytes = record_per_page_ * sizeof(Record_);
+    uint64_t cached_page = std::numeric_limits<uint64_t>::max();
+    auto stored_key = [&](size_t p, uint64_t idx) {
+      uint64_t page = prev_page_start_ids_[p] + idx / record_per_page_;
+      if (page != cached_page) {
+        DirectIORead<K>(threads_[thread_id].GetFD(), page_bytes, 1,
+                        page * page_bytes, threads_[thread_id].buf_);
+        cached_page = page;
+      }
+      return buf[idx % record_per_page_].first;
+    };
+
+    size_t p = 0;
+    uint64_t passed_num = 0;  // the merged records before partition p
+    for (size_t i = 1; i < merge_thread_num_; i++) {
+      uint64_t rank = total_num * i / merge_thread_num_;
+      uint64_t sta_num = prev_static_starts_[p + 1] - prev_static_starts_[p];
+      uint64_t dy_num = prev_dy_starts[p + 1] - prev_dy_starts[p];
+      while (passed_num + sta_num + dy_num <= rank) {
+        passed_num += sta_num + dy_num;
+        p++;
+        sta_num = prev_static_starts_[p + 1] - prev_static_starts_[p];
+        dy_num = prev_dy_starts[p + 1] - prev_dy_starts[p];
+      }
+      // take the first sta_cnt stored and rank - sta_cnt dynamic records
+      const uint64_t target = rank - passed_num;
+      const auto dy_it = dy_data.begin() + prev_dy_starts[p];
+      uint64_t lo = target > dy_num ? target - dy_num : 0;
+      uint64_t hi = std::min(target, sta_num);
+      while (lo < hi) {
+        uint64_t mid = (lo + hi) / 2;
+        if (stored_key(p, mid) < dy_it[target - mid - 1].first) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      uint64_t sta_cnt = lo, dy_cnt = target - lo;
+      // a stored key and its newer record go to the same partition
+      if (sta_cnt < sta_num && dy_cnt > 0 &&
+          stored_key(p, sta_cnt) == dy_it[dy_cnt - 1].first) {
+        sta_cnt++;
+      } else if (dy_cnt < dy_num && sta_cnt > 0 &&
+                 dy_it[dy_cnt].first == stored_key(p, sta_cnt - 1)) {
+        dy_cnt++;
+      }
+      static_starts[i] = prev_static_starts_[p] + sta_cnt;
+      dy_starts[i] = prev_dy_starts[p] + dy_cnt;
+#ifdef PRINT_MULTI_THREAD_INFO
+      std::cout << "rebalance boundary " << i << ",\tin partition " << p
+                << ",\tstatic_start:" << static_starts[i]
+                << ",\tdy_start:" << dy_starts[i] << std::endl;
+#endif
+    }
+  }
+
+  // read num stored records from the start-th one on, they may span several
+  // partitions of the current version
+  inline void GetStoredRecords(DataVec_& data, int thread_id, uint64_t start,
+                               uint64_t num) {
+    const uint64_t page_bytes = record_per_page_ * sizeof(Record_);
+    Record_* buf = reinterpret_cast<Record_*>(threads_[thread_id].buf_);
+    size_t p = std::upper_bound(prev_static_starts_.begin(),
+                                prev_static_starts_.end(), start) -
+               prev_static_starts_.begin() - 1;
+    uint64_t offset = 0;
+    while (offset < num) {
+      uint64_t idx = start + offset - prev_static_starts_[p];
+      uint64_t cnt = std::min(num - offset, prev_static_starts_[p + 1] -
+                                                prev_static_starts_[p] - idx);
+      if (cnt == 0) {
+        p++;
+        continue;
+      }
+      uint64_t pid = idx / record_per_page_;
+      uint64_t page_num = std::min<uint64_t>(
+          (idx + cnt - 1) / record_per_page_ - pid + 1, MAX_READ_PAGES);
+      cnt = std::min(cnt, (pid + page_num) * record_per_page_ - idx);
+      DirectIORead<K>(threads_[thread_id].GetFD(), page_bytes, page_num,
+                      (prev_page_start_ids_[p] + pid) * page_bytes,
+                      threads_[thread_id].buf_);
+      memcpy(&data[offset], buf + idx % record_per_page_,
+             cnt * sizeof(Record_));
+      offset += cnt;
+    }
+#ifdef CHECK_CORRECTION
+    for (uint64_t i = 1; i < num; i++) {
+      if (data[i].first <= data[i - 1].first) {
+        std::cout << "in GetStoredRecords store " << i
+                  << " wrong!\tstored[i].first:" << data[i].first
+                  << ",\tstored[i-1].first:" << data[i - 1].first << std::endl;
+      }
+    }
+#endif
+  }
+
   inline void GetSubData(DataVec_& data, int thread_id, int start_page_id,
                          int page_num, int length) {
 #ifdef PRINT_MULTI_THREAD_INFO
@@ -769,7 +894,13 @@ class MultiThreadedStaticIndex {
       if (dy_data[i].first > merged_data[j].first) {
         merged_data[cnt--] = dy_data[i--];
       } else {
-        merged_data[cnt--] = merged_data[j--];
+        if (dy_data[i].first == merged_data[j].first) {
+          // the newer record or tombstone replaces the stored one
+          merged_data[cnt--] = dy_data[i--];
+          j--;
+        } else {
+          merged_data[cnt--] = merged_data[j--];
+        }
       }
       tmp++;
     }
@@ -777,6 +908,11 @@ class MultiThreadedStaticIndex {
     while (i >= first_dy_idx) {
       merged_data[cnt--] = dy_data[i--];
     }
+    // the replaced records leave a gap between the stored records that are
+    // still in place and the merged ones
+    merged_data.erase(merged_data.begin() + j + 1,
+                      merged_data.begin() + cnt + 1);
+    DropTombstones(merged_data);
 
 #ifdef CHECK_CORRECTION
     for (i = 1; i < merged_data.size(); i++) {
@@ -802,9 +938,6 @@ class MultiThreadedStaticIndex {
 
   uint64_t thread_numbers_;
   std::atomic<uint64_t> latest_version_{0b000};
-  std::atomic<int> consistent_version_cnt_{-1};
-  uint64_t old_version_;
-  std::atomic<bool> updated_{false};
   std::vector<ThreadParams> threads_;
 
   uint64_t merge_thread_num_;
@@ -817,6 +950,14 @@ class MultiThreadedStaticIndex {
   std::vector<uint64_t> data_numbers_;
   std::vector<uint64_t> page_start_ids_;
   std::vector<uint64_t> page_last_ids_;
+  // the layout of the current version during a merge
+  std::vector<uint64_t> prev_static_starts_;
+  std::vector<uint64_t> prev_page_start_ids_;
+  static constexpr double kMaxPartitionSkew = 2;
+
+  // the latches of the pages patched by the updates, hashed by page id
+  static constexpr size_t kPageLatchNum = 1024;
+  std::mutex page_latches_[kPageLatchNum];
 
   std::atomic<int> processing_thread_num_{-1};
   std::atomic<uint64_t> finished_thread_num_{0};
@@ -834,6 +975,7 @@ class MultiThreadedStaticIndex {
   std::vector<double> store_page_num;
   std::vector<double> model_training_lat;
   int merge_cnt = -1;
+  int rebalance_cnt = 0;
 #endif
 };
 
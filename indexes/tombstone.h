@@ -0,0 +1,86 @@
+#ifndef INDEXES_TOMBSTONE_H_
+#define INDEXES_TOMBSTONE_H_
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// A deleted key is inserted into the dynamic index of a hybrid index with
+// this value. The tombstone hides the key in the older parts of the index
+// until a merge drops both of them. The max value stands for a missing key.
+template <typename V>
+inline constexpr V GetTombstone() {
+  return std::numeric_limits<V>::max() - 1;
+}
+
+// Remove the tombstones from the merged records of a partition. When all the
+// records have been deleted, the last tombstone is kept so that the
+// partition never becomes empty; it is read as a missing key.
+template <typename K, typename V>
+inline void DropTombstones(std::vector<std::pair<K, V>>& data) {
+  if (data.empty()) {
+    return;
+  }
+  auto last = data.back();
+  data.erase(std::remove_if(data.begin(), data.end(),
+                            [](const std::pair<K, V>& r) {
+                              return r.second == GetTombstone<V>();
+                            }),
+             data.end());
+  if (data.empty()) {
+    data.push_back(last);
+  }
+}
+
+// Sum the values of the first range live records of the sorted parts, which
+// are ordered from the newest to the oldest. A key of a newer part hides the
+// same key in the older ones. A part that holds all the fetch_num records it
+// was asked for may go on past its last key, so the sum is only complete up
+// to the smallest of those keys. Return false if that bound cuts the range
+// short, the parts must then be fetched again with more records.
+template <typename K, typename V>
+inline bool MergeScanParts(const std::vector<std::pair<K, V>>* parts,
+                           int part_num, int range, size_t fetch_num, V& res) {
+  bool bounded = false;
+  K bound = std::numeric_limits<K>::max();
+  for (int i = 0; i < part_num; i++) {
+    if (parts[i].size() >= fetch_num && !parts[i].empty()) {
+      bounded = true;
+      bound = std::min(bound, parts[i].back().first);
+    }
+  }
+  res = 0;
+  std::vector<size_t> pos(part_num, 0);
+  int cnt = 0;
+  while (cnt < range) {
+    int newest = -1;
+    for (int i = 0; i < part_num; i++) {
+      if (pos[i] < parts[i].size() &&
+          (newest == -1 ||
+           parts[i][pos[i]].first < parts[newest][pos[newest]].first)) {
+        newest = i;
+      }
+    }
+    if (newest == -1) {
+      // a part that was cut by fetch_num may hold more records
+      return !bounded;
+    }
+    K min_key = parts[newest][pos[newest]].first;
+    if (bounded && min_key > bound) {
+      return false;
+    }
+    if (parts[newest][pos[newest]].second != GetTombstone<V>()) {
+      res += parts[newest][pos[newest]].second;
+      cnt++;
+    }
+    for (int i = 0; i < part_num; i++) {
+      if (pos[i] < parts[i].size() && parts[i][pos[i]].first == min_key) {
+        pos[i]++;
+      }
+    }
+  }
+  return true;
+}
+
+#endif  // !INDEXES_TOMBSTONE_H_
@@ -0,0 +1,459 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+// linux/io_uring.h pulls in linux/fs.h, whose BLOCK_SIZE clashes with the
+// constants of the baseline indexes
+#undef BLOCK_SIZE
+#undef BLOCK_SIZE_BITS
+
+// The backend used by all the page reads/writes of the on-disk indexes.
+// kPread issues one synchronous pread/pwrite at a time, kIOUring keeps up to
+// IO_URING_QUEUE_DEPTH requests in flight through a per-thread io_uring.
+enum IOBackend { kPread, kIOUring };
+
+#define IO_URING_QUEUE_DEPTH 64
+#define IO_URING_REGISTERED_BYTES 268435456  // 256 MiB
+// the length of an SQE is 32 bits, larger requests are issued in pieces
+#define IO_URING_MAX_REQUEST_BYTES 1073741824  // 1 GiB
+
+inline IOBackend io_backend_ = kPread;
+
+struct IORequest {
+  int fd;
+  void* buf;
+  size_t bytes;
+  size_t offset;
+};
+
+// A minimal io_uring without liburing, only for the reads/writes of aligned
+// pages. The buffers registered by RegisterBuffer are read through
+// IORING_OP_READ_FIXED, the others through IORING_OP_READ.
+class IOUring {
+ public:
+  explicit IOUring(unsigned queue_depth = IO_URING_QUEUE_DEPTH) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    ring_fd_ = syscall(__NR_io_uring_setup, queue_depth, &p);
+    if (ring_fd_ < 0) {
+      throw std::runtime_error("io_uring_setup error in IOUring");
+    }
+    sq_ring_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_ring_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    single_mmap_ = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap_) {
+      sq_ring_bytes_ = cq_ring_bytes_ =
+          std::max(sq_ring_bytes_, cq_ring_bytes_);
+    }
+    sq_ring_ = Map(sq_ring_bytes_, IORING_OFF_SQ_RING);
+    cq_ring_ =
+        single_mmap_ ? sq_ring_ : Map(cq_ring_bytes_, IORING_OFF_CQ_RING);
+    sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = reinterpret_cast<io_uring_sqe*>(Map(sqes_bytes_, IORING_OFF_SQES));
+
+    sq_head_ = reinterpret_cast<unsigned*>(sq_ring_ + p.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq_ring_ + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring_ + p.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq_ring_ + p.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned*>(cq_ring_ + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq_ring_ + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring_ + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring_ + p.cq_off.cqes);
+    queue_depth_ = p.sq_entries;
+  }
+
+  ~IOUring() {
+    munmap(sqes_, sqes_bytes_);
+    if (!single_mmap_) {
+      munmap(cq_ring_, cq_ring_bytes_);
+    }
+    munmap(sq_ring_, sq_ring_bytes_);
+    close(ring_fd_);
+  }
+
+  IOUring(const IOUring&) = delete;
+  IOUring& operator=(const IOUring&) = delete;
+
+  // Register an aligned buffer (at most IO_URING_REGISTERED_BYTES of it) to
+  // avoid pinning its pages on every request. The buffer must outlive the
+  // ring. Return false if the kernel refuses, e.g., due to RLIMIT_MEMLOCK,
+  // the buffer is then read without registration. Registering a buffer again
+  // does nothing.
+  bool RegisterBuffer(void* buf, size_t bytes) {
+    bytes = std::min<size_t>(bytes, IO_URING_REGISTERED_BYTES);
+    if (GetBufferIndex(buf, bytes) >= 0) {
+      return true;
+    }
+    if (!buffers_.empty()) {
+      syscall(__NR_io_uring_register, ring_fd_, IORING_UNREGISTER_BUFFERS,
+              NULL, 0);
+    }
+    buffers_.push_back({buf, bytes});
+    int ret = syscall(__NR_io_uring_register, ring_fd_,
+                      IORING_REGISTER_BUFFERS, buffers_.data(),
+                      buffers_.size());
+    if (ret < 0) {
+      buffers_.pop_back();
+      if (!buffers_.empty()) {
+        syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_BUFFERS,
+                buffers_.data(), buffers_.size());
+      }
+#ifdef PRINT_PROCESSING_INFO
+      std::cout << "io_uring fails to register " << bytes
+                << " bytes, use unregistered buffers" << std::endl;
+#endif
+      return false;
+    }
+    return true;
+  }
+
+  inline void Read(int fd, void* buf, size_t bytes, size_t offset) {
+    Batch(IORING_OP_READ, {{fd, buf, bytes, offset}}, "read error in IOUring");
+  }
+
+  inline void Write(int fd, void* buf, size_t bytes, size_t offset) {
+    Batch(IORING_OP_WRITE, {{fd, buf, bytes, offset}},
+          "write error in IOUring");
+  }
+
+  // keep up to queue_depth_ reads in flight until all of them are done
+  inline void ReadBatch(const std::vector<IORequest>& reqs) {
+    Batch(IORING_OP_READ, reqs, "read error in IOUring");
+  }
+
+  inline void WriteBatch(const std::vector<IORequest>& reqs) {
+    Batch(IORING_OP_WRITE, reqs, "write error in IOUring");
+  }
+
+  inline unsigned GetQueueDepth() const { return queue_depth_; }
+
+ private:
+  // A request larger than IO_URING_MAX_REQUEST_BYTES is split into pieces.
+  // After a failed or short request nothing more is submitted, but the ones
+  // in flight are reaped before throwing, since they still write into the
+  // buffers of the caller and their completions must not be left on the ring.
+  inline void Batch(uint8_t opcode, const std::vector<IORequest>& reqs,
+                    const char* error) {
+    size_t next = 0, done_bytes = 0, inflight = 0;
+    // prepared in the ring but not consumed by the kernel yet
+    unsigned unsubmitted = 0;
+    bool failed = false;
+    while ((!failed && next < reqs.size()) || inflight) {
+      while (!failed && inflight < queue_depth_ && next < reqs.size()) {
+        const IORequest& req = reqs[next];
+        size_t bytes = std::min<size_t>(req.bytes - done_bytes,
+                                        IO_URING_MAX_REQUEST_BYTES);
+        Prepare(opcode, {req.fd, reinterpret_cast<char*>(req.buf) + done_bytes,
+                         bytes, req.offset + done_bytes});
+        done_bytes += bytes;
+        if (done_bytes == req.bytes) {
+          next++;
+          done_bytes = 0;
+        }
+        inflight++;
+        unsubmitted++;
+      }
+      inflight -= Reap(unsubmitted, 1, failed);
+    }
+    if (failed) {
+      throw std::runtime_error(error);
+    }
+  }
+
+  inline uint8_t* Map(size_t bytes, off_t offset) {
+    void* ptr = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_fd_, offset);
+    if (ptr == MAP_FAILED) {
+      throw std::runtime_error("mmap error in IOUring");
+    }
+    return reinterpret_cast<uint8_t*>(ptr);
+  }
+
+  inline void Prepare(uint8_t opcode, const IORequest& req) {
+    unsigned tail = *sq_tail_;
+    unsigned idx = tail & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = req.fd;
+    sqe->addr = reinterpret_cast<uint64_t>(req.buf);
+    sqe->len = req.bytes;
+    sqe->off = req.offset;
+    // the expected length, to detect short reads/writes
+    sqe->user_data = req.bytes;
+    int buf_idx = GetBufferIndex(req.buf, req.bytes);
+    if (buf_idx >= 0) {
+      sqe->opcode = opcode == IORING_OP_READ ? IORING_OP_READ_FIXED
+                                             : IORING_OP_WRITE_FIXED;
+      sqe->buf_index = buf_idx;
+    }
+    sq_array_[idx] = idx;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  // Submit the unsubmitted requests, wait for at least min_complete of them
+  // and return the number of completed requests, failed is set if any of
+  // them did not transfer all its bytes. The kernel may consume only some
+  // of the requests, the rest stay counted in unsubmitted for the next call.
+  inline unsigned Reap(unsigned& unsubmitted, unsigned min_complete,
+                       bool& failed) {
+    while (true) {
+      int ret = syscall(__NR_io_uring_enter, ring_fd_, unsubmitted,
+                        min_complete, IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret >= 0) {
+        unsubmitted -= ret;
+        break;
+      }
+      if (errno == EAGAIN || errno == EBUSY) {
+        // nothing has been submitted, the completions are reaped to make
+        // room and the requests are submitted again by the next call
+        break;
+      }
+      if (errno != EINTR) {
+        throw std::runtime_error("io_uring_enter error in IOUring");
+      }
+    }
+    unsigned head = *cq_head_, done = 0;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      if (cqe.res < 0 || static_cast<uint64_t>(cqe.res) != cqe.user_data) {
+        failed = true;
+      }
+      head++;
+      done++;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return done;
+  }
+
+  inline int GetBufferIndex(const void* buf, size_t bytes) const {
+    auto addr = reinterpret_cast<const uint8_t*>(buf);
+    for (size_t i = 0; i < buffers_.size(); i++) {
+      auto start = reinterpret_cast<const uint8_t*>(buffers_[i].iov_base);
+      if (addr >= start && addr + bytes <= start + buffers_[i].iov_len) {
+        return i;
+      }
+    }
+    return -1;
+  }
+
+ private:
+  int ring_fd_;
+  bool single_mmap_;
+  unsigned queue_depth_;
+
+  uint8_t* sq_ring_;
+  uint8_t* cq_ring_;
+  io_uring_sqe* sqes_;
+  size_t sq_ring_bytes_;
+  size_t cq_ring_bytes_;
+  size_t sqes_bytes_;
+
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_array_;
+  unsigned sq_mask_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+
+  std::vector<iovec> buffers_;
+};
+
+// each thread submits through its own ring
+inline IOUring& GetIOUring() {
+  thread_local IOUring ring;
+  return ring;
+}
+
+// Register the buffer of the calling thread with its ring, nothing with
+// pread. The buffer stays registered until the thread exits.
+inline void RegisterIOBuffer(void* buf, size_t bytes) {
+  if (io_backend_ == kIOUring) {
+    GetIOUring().RegisterBuffer(buf, bytes);
+  }
+}
+
+// Striping of a file over several devices, e.g., the NVMe drives of a box. A
+// striped file has one part per device and its pages are laid out round-robin
+// in units of stripe_bytes_: the u-th unit is at (u / N) * stripe_bytes_ of
+// part u % N. The fd of the first part stands for the whole file, so the
+// reads and writes above the backend are unchanged, and a request that spans
+// several units is split into one request per unit, which are in flight at
+// the same time with io_uring.
+#define IO_MAX_STRIPED_FD 4096
+
+inline size_t stripe_bytes_ = 0;
+// the fds of the parts of each striped file, by the fd of its first part
+inline std::vector<int> striped_fds_[IO_MAX_STRIPED_FD];
+
+inline void RegisterStripedFile(const std::vector<int>& fds) {
+  if (fds[0] >= IO_MAX_STRIPED_FD || stripe_bytes_ == 0) {
+    throw std::runtime_error("invalid striped file in RegisterStripedFile");
+  }
+  striped_fds_[fds[0]] = fds;
+}
+
+// return the fds of the parts of fd, only fd itself if it is not striped
+inline std::vector<int> UnregisterStripedFile(int fd) {
+  if (fd < 0 || fd >= IO_MAX_STRIPED_FD || striped_fds_[fd].empty()) {
+    return {fd};
+  }
+  std::vector<int> fds;
+  fds.swap(striped_fds_[fd]);
+  return fds;
+}
+
+static inline bool IsStriped(int fd) {
+  return fd >= 0 && fd < IO_MAX_STRIPED_FD && !striped_fds_[fd].empty();
+}
+
+// append the requests to the parts of a striped file that cover req
+static inline void SplitStriped(const IORequest& req,
+                                std::vector<IORequest>& out) {
+  const std::vector<int>& fds = striped_fds_[req.fd];
+  char* buf = reinterpret_cast<char*>(req.buf);
+  size_t offset = req.offset, bytes = req.bytes;
+  while (bytes > 0) {
+    size_t unit = offset / stripe_bytes_, in_unit = offset % stripe_bytes_;
+    size_t len = std::min(bytes, stripe_bytes_ - in_unit);
+    out.push_back({fds[unit % fds.size()], buf, len,
+                   (unit / fds.size()) * stripe_bytes_ + in_unit});
+    buf += len;
+    offset += len;
+    bytes -= len;
+  }
+}
+
+static inline void BackendReadBatch(const std::vector<IORequest>& reqs);
+static inline void BackendWriteBatch(const std::vector<IORequest>& reqs);
+
+// pread until all the bytes are read, a short read is retried from where it
+// stopped, false on an error or the end of the file
+static inline bool PreadAll(int fd, void* buf, size_t bytes, size_t offset) {
+  char* p = reinterpret_cast<char*>(buf);
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t n = pread(fd, p + done, bytes - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+static inline bool PwriteAll(int fd, const void* buf, size_t bytes,
+                             size_t offset) {
+  const char* p = reinterpret_cast<const char*>(buf);
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t n = pwrite(fd, p + done, bytes - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    done += n;
+  }
+  return true;
+}
+
+static inline void BackendRead(int fd, void* buf, size_t bytes,
+                               size_t offset) {
+  if (IsStriped(fd)) {
+    BackendReadBatch({{fd, buf, bytes, offset}});
+    return;
+  }
+  if (io_backend_ == kIOUring) {
+    GetIOUring().Read(fd, buf, bytes, offset);
+    return;
+  }
+  if (!PreadAll(fd, buf, bytes, offset)) {
+    throw std::runtime_error("read error in BackendRead");
+  }
+}
+
+static inline void BackendWrite(int fd, void* buf, size_t bytes,
+                                size_t offset) {
+  if (IsStriped(fd)) {
+    BackendWriteBatch({{fd, buf, bytes, offset}});
+    return;
+  }
+  if (io_backend_ == kIOUring) {
+    GetIOUring().Write(fd, buf, bytes, offset);
+    return;
+  }
+  if (!PwriteAll(fd, buf, bytes, offset)) {
+    throw std::runtime_error("write error in BackendWrite");
+  }
+}
+
+// the requests to the parts of the striped files among reqs, NULL if there
+// are none
+static inline const std::vector<IORequest>* SplitBatch(
+    const std::vector<IORequest>& reqs, std::vector<IORequest>& split) {
+  if (std::none_of(reqs.begin(), reqs.end(),
+                   [](const IORequest& req) { return IsStriped(req.fd); })) {
+    return NULL;
+  }
+  for (auto& req : reqs) {
+    if (IsStriped(req.fd)) {
+      SplitStriped(req, split);
+    } else {
+      split.push_back(req);
+    }
+  }
+  return &split;
+}
+
+// issue independent reads, which are in flight at the same time with
+// io_uring and one by one with pread
+static inline void BackendReadBatch(const std::vector<IORequest>& reqs) {
+  std::vector<IORequest> split;
+  const std::vector<IORequest>& all =
+      SplitBatch(reqs, split) == NULL ? reqs : split;
+  if (io_backend_ == kIOUring) {
+    GetIOUring().ReadBatch(all);
+    return;
+  }
+  for (auto& req : all) {
+    if (!PreadAll(req.fd, req.buf, req.bytes, req.offset)) {
+      throw std::runtime_error("read error in BackendReadBatch");
+    }
+  }
+}
+
+static inline void BackendWriteBatch(const std::vector<IORequest>& reqs) {
+  std::vector<IORequest> split;
+  const std::vector<IORequest>& all =
+      SplitBatch(reqs, split) == NULL ? reqs : split;
+  if (io_backend_ == kIOUring) {
+    GetIOUring().WriteBatch(all);
+    return;
+  }
+  for (auto& req : all) {
+    if (!PwriteAll(req.fd, req.buf, req.bytes, req.offset)) {
+      throw std::runtime_error("write error in BackendWriteBatch");
+    }
+  }
+}
+
+#endif  // !IO_BACKEND_H
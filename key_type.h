@@ -17,6 +17,8 @@ typedef std::vector<std::pair<Key, Value>> DataVec;
 #define RANGE_LEN_SUFFIX "_RANGE_LEN"
 
 #define ALLOCATED_BUF_SIZE 4194304  // 4 GiB
+#define MAX_READ_PAGES 500000       // the pages read at once in a bulk read
+#define MERGE_CHUNK_PAGES 1024      // the pages streamed at once by a merge
 Key* read_buf_;                     // for single-threaded benchmark
 
 #endif  // !KEY_TYPE_H
\ No newline at end of file
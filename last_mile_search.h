@@ -0,0 +1,164 @@
+#ifndef LAST_MILE_SEARCH_H
+#define LAST_MILE_SEARCH_H
+
+#include <cstdint>
+#include <type_traits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LAST_MILE_SIMD
+#endif
+
+// The last-mile search over the records of the fetched pages, whose keys are
+// gap_cnt K apart. The binary search is branchless until at most
+// LAST_MILE_SIMD_TAIL records are left, which are then compared and counted
+// with AVX2 or AVX-512, so only the keys of 64-bit records are vectorized.
+// The kernels are compiled for their targets and chosen at runtime from the
+// CPU features, kScalar keeps the plain binary search and linear scan.
+enum SimdLevel { kScalar, kAVX2, kAVX512 };
+
+#define LAST_MILE_SIMD_TAIL 32
+
+inline SimdLevel DetectSimdLevel() {
+#ifdef LAST_MILE_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return kAVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return kAVX2;
+  }
+#endif
+  return kScalar;
+}
+
+inline const char* GetSimdLevelName(SimdLevel level) {
+  switch (level) {
+    case kAVX2:
+      return "avx2";
+    case kAVX512:
+      return "avx512";
+    default:
+      return "scalar";
+  }
+}
+
+// the kernels in use, shared by all the translation units; may be lowered,
+// e.g., to compare the kernels in a microbenchmark
+inline SimdLevel last_mile_simd_level = DetectSimdLevel();
+
+#ifdef LAST_MILE_SIMD
+// the number of keys less than key in the first num records, which are
+// sorted, so the count stops at the first vector with a larger key
+__attribute__((target("avx2"))) static inline uint64_t CountLessAVX2(
+    const uint64_t* data, uint64_t num, uint64_t gap_cnt, uint64_t key) {
+  // the unsigned comparison is a signed one with the sign bits flipped
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i target = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<int64_t>(key)), sign);
+  const int key_lanes = gap_cnt == 1 ? 0xf : 0x5;
+  const uint64_t step = 4 / gap_cnt;
+  uint64_t cnt = 0, i = 0;
+  for (; i + step <= num; i += step) {
+    const __m256i* addr = reinterpret_cast<const __m256i*>(data + i * gap_cnt);
+    __m256i keys = _mm256_xor_si256(_mm256_loadu_si256(addr), sign);
+    int less = _mm256_movemask_pd(
+                   _mm256_castsi256_pd(_mm256_cmpgt_epi64(target, keys))) &
+               key_lanes;
+    cnt += __builtin_popcount(less);
+    if (less != key_lanes) {
+      // the keys are sorted, the following ones are not less
+      return cnt;
+    }
+  }
+  for (; i < num; i++) {
+    cnt += data[i * gap_cnt] < key;
+  }
+  return cnt;
+}
+
+__attribute__((target("avx512f"))) static inline uint64_t CountLessAVX512(
+    const uint64_t* data, uint64_t num, uint64_t gap_cnt, uint64_t key) {
+  const __m512i target = _mm512_set1_epi64(static_cast<int64_t>(key));
+  const __mmask8 key_lanes = gap_cnt == 1 ? 0xff : 0x55;
+  const uint64_t step = 8 / gap_cnt;
+  uint64_t cnt = 0, i = 0;
+  for (; i + step <= num; i += step) {
+    __m512i keys = _mm512_loadu_si512(data + i * gap_cnt);
+    __mmask8 less = _mm512_mask_cmplt_epu64_mask(key_lanes, keys, target);
+    cnt += __builtin_popcount(less);
+    if (less != key_lanes) {
+      return cnt;
+    }
+  }
+  for (; i < num; i++) {
+    cnt += data[i * gap_cnt] < key;
+  }
+  return cnt;
+}
+#endif
+
+// whether the keys of the records can be compared with the SIMD kernels
+template <typename K>
+inline bool UseSimdSearch(uint64_t gap_cnt) {
+#ifdef LAST_MILE_SIMD
+  return std::is_same<K, uint64_t>::value &&
+         last_mile_simd_level != kScalar && (gap_cnt == 1 || gap_cnt == 2);
+#else
+  return false;
+#endif
+}
+
+// the position of the first key not less than key in the first num records,
+// num if none, by a linear scan
+template <typename K>
+inline uint64_t LinearLowerBound(const K* data, uint64_t num, uint64_t gap_cnt,
+                                 K key) {
+#ifdef LAST_MILE_SIMD
+  if constexpr (std::is_same<K, uint64_t>::value) {
+    if (UseSimdSearch<K>(gap_cnt)) {
+      // the keys are sorted, so the count of the smaller keys is the position
+      return last_mile_simd_level == kAVX512
+                 ? CountLessAVX512(data, num, gap_cnt, key)
+                 : CountLessAVX2(data, num, gap_cnt, key);
+    }
+  }
+#endif
+  uint64_t s = 0;
+  while (s < num && *(data + s * gap_cnt) < key) {
+    s++;
+  }
+  return s;
+}
+
+// the position of the first key not less than key in the first num records,
+// num if none, by a binary search
+template <typename K>
+inline uint64_t BinaryLowerBound(const K* data, uint64_t num, uint64_t gap_cnt,
+                                 K key) {
+  if (!UseSimdSearch<K>(gap_cnt)) {
+    uint64_t s = 0, e = num;
+    while (s < e) {
+      uint64_t mid = (s + e) >> 1;
+      if (*(data + mid * gap_cnt) < key)
+        s = mid + 1;
+      else
+        e = mid;
+    }
+    return s;
+  }
+  // the lower bound stays in [base, base + num]
+  const K* base = data;
+  while (num > LAST_MILE_SIMD_TAIL) {
+    uint64_t half = num >> 1;
+    // there is no branch to predict, so fetch both possible next probes
+    __builtin_prefetch(base + (half >> 1) * gap_cnt);
+    __builtin_prefetch(base + (half + (half >> 1)) * gap_cnt);
+    base = *(base + half * gap_cnt) < key ? base + half * gap_cnt : base;
+    num -= half;
+  }
+  return (base - data) / gap_cnt + LinearLowerBound(base, num, gap_cnt, key);
+}
+
+#endif  // !LAST_MILE_SEARCH_H
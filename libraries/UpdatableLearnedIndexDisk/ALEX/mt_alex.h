@@ -0,0 +1,716 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../../../indexes/multi_threaded_hybrid/epoch.h"
+#include "../B+Tree/mt_storage.h"
+
+// A concurrent disk-resident ALEX. The model nodes are in memory and are
+// traversed with optimistic version locks: a reader validates the version of
+// a node after reading one of its children and restarts if a writer changed
+// the node in between. A data node is a run of disk blocks with a linear model
+// that predicts the block of a key, and a latch in memory. When the block of
+// an insert is full, the data node is expanded and retrained under its own
+// latch; a data node that is too large is split sideways over the parent slots
+// that point to it, or downwards into a new model node, which locks only its
+// parent in addition. A split data node is freed through epoch-based
+// reclamation once no thread can be waiting on its latch anymore.
+template <class Key, class Value>
+class ThreadSafeAlexDisk {
+ private:
+  using Record = std::pair<Key, Value>;
+
+  struct LinearModel {
+    Key base = 0;  // the smallest key, for the precision of large keys
+    double slope = 0;
+    double intercept = 0;
+
+    // least squares of y(i) over the n sorted keys key(i)
+    template <class GetKey, class GetY>
+    void train(std::size_t n, GetKey key, GetY y) {
+      slope = intercept = 0;
+      if (n == 0) return;
+      base = key(0);
+      double mx = 0, my = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        mx += static_cast<double>(key(i) - base);
+        my += y(i);
+      }
+      mx /= n;
+      my /= n;
+      double cov = 0, var = 0;
+      for (std::size_t i = 0; i < n; ++i) {
+        double dx = static_cast<double>(key(i) - base) - mx;
+        cov += dx * (y(i) - my);
+        var += dx * dx;
+      }
+      slope = var > 0 ? std::max(cov / var, 0.0) : 0;
+      intercept = my - slope * mx;
+    }
+
+    std::size_t predict(Key k, std::size_t size) const {
+      double p = k < base ? intercept
+                          : slope * static_cast<double>(k - base) + intercept;
+      if (p <= 0) return 0;
+      if (p >= size - 1) return size - 1;
+      return static_cast<std::size_t>(p);
+    }
+  };
+
+  // a version lock, odd while a writer holds it
+  struct OptLock {
+    std::atomic<uint64_t> version{0};
+
+    uint64_t read_lock() const {
+      uint64_t v;
+      for (int cnt = 0; (v = version.load(std::memory_order_acquire)) & 1;) {
+        if (++cnt > 10) std::this_thread::yield();
+      }
+      return v;
+    }
+
+    bool validate(uint64_t v) const {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return version.load(std::memory_order_relaxed) == v;
+    }
+
+    // fails if the node has changed since v was read
+    bool upgrade(uint64_t v) {
+      return version.compare_exchange_strong(v, v + 1,
+                                             std::memory_order_acquire);
+    }
+
+    void write_unlock() { version.fetch_add(1, std::memory_order_release); }
+  };
+
+  struct Node {
+    const bool is_leaf;
+    explicit Node(bool leaf) : is_leaf(leaf) {}
+  };
+
+  struct ModelNode : public Node {
+    OptLock lock;
+    LinearModel model;
+    const std::size_t num_children;
+    std::unique_ptr<std::atomic<Node*>[]> children;
+
+    explicit ModelNode(std::size_t n)
+        : Node(false), num_children(n), children(new std::atomic<Node*>[n]) {}
+
+    std::size_t which_child(const Key& k) const {
+      return model.predict(k, num_children);
+    }
+  };
+
+  struct DataNode : public Node {
+    std::shared_mutex latch;
+    LinearModel model;  // predicts the block of a key
+    std::size_t first_block = 0;
+    std::size_t num_blocks = 0;
+    std::size_t num_keys = 0;
+    // the parent slots [first_slot, first_slot + dup) point to this node
+    std::size_t first_slot = 0;
+    std::size_t dup = 1;
+    bool obsolete = false;  // replaced by a split, the readers restart
+
+    DataNode() : Node(true) {}
+  };
+
+  struct DataBlock {
+    std::size_t count = 0;
+    static constexpr auto num_entries =
+        (BlockSize - sizeof(std::size_t)) / (sizeof(Key) + sizeof(Value));
+    Key keys[num_entries];
+    Value values[num_entries];
+
+    std::size_t which_child(const Key& k) const {
+      return std::lower_bound(keys, keys + count, k) - keys;
+    }
+
+    bool is_full() const { return count == num_entries; }
+  };
+  static_assert(sizeof(DataBlock) <= BlockSize);
+
+  struct AlignedDelete {
+    void operator()(void* ptr) const { std::free(ptr); }
+  };
+  using BlockPtr = std::unique_ptr<DataBlock, AlignedDelete>;
+
+  // a laid out block keeps 30% of its entries free for the inserts
+  static constexpr std::size_t block_fill = DataBlock::num_entries * 7 / 10;
+  static constexpr std::size_t max_data_blocks = 16;
+  static constexpr std::size_t max_data_keys = max_data_blocks * block_fill;
+  // the keys of a data node built by a bulk load or a split
+  static constexpr std::size_t target_data_keys = max_data_keys / 2;
+  static constexpr std::size_t max_fan_out = 1 << 12;
+
+  ThreadSafeStorageManager sm;
+  std::atomic<std::size_t> block_cnt{0};
+  ModelNode* root = nullptr;
+
+  std::atomic<std::size_t> model_node_cnt{0};
+  std::atomic<std::size_t> data_node_cnt{0};
+  std::atomic<std::size_t> model_slot_cnt{0};
+  std::atomic<std::size_t> expand_cnt{0};
+  std::atomic<std::size_t> sideways_split_cnt{0};
+  std::atomic<std::size_t> downward_split_cnt{0};
+
+  // the split data nodes, which readers may still be waiting on
+  EpochManager epoch;
+
+  // the blocks of the expanded, split and abandoned data nodes, sorted and
+  // coalesced, reused first-fit by the layouts
+  std::mutex free_mtx;
+  std::vector<std::pair<std::size_t, std::size_t>> free_extents;  // {block, num}
+
+  static BlockPtr block_alloc() {
+    return BlockPtr(static_cast<DataBlock*>(decltype(sm)::alloc()));
+  }
+
+  void read_block(const DataNode* dn, std::size_t b, DataBlock* blk) const {
+    sm.read_block(dn->first_block + b, blk);
+  }
+
+  void write_block(const DataNode* dn, std::size_t b, DataBlock* blk) {
+    sm.write_block(dn->first_block + b, blk);
+  }
+
+  std::size_t allocate_blocks(std::size_t nb) {
+    {
+      std::lock_guard<std::mutex> guard(free_mtx);
+      for (auto it = free_extents.begin(); it != free_extents.end(); ++it) {
+        if (it->second >= nb) {
+          std::size_t first = it->first;
+          it->first += nb;
+          it->second -= nb;
+          if (it->second == 0) free_extents.erase(it);
+          return first;
+        }
+      }
+    }
+    return block_cnt.fetch_add(nb);
+  }
+
+  // no reader is left on the blocks: the latch of their data node is held
+  // exclusively, or the node has never been published
+  void free_blocks(std::size_t first, std::size_t nb) {
+    std::lock_guard<std::mutex> guard(free_mtx);
+    auto it = std::lower_bound(
+        free_extents.begin(), free_extents.end(), first,
+        [](const auto& lhs, std::size_t b) { return lhs.first < b; });
+    it = free_extents.insert(it, {first, nb});
+    // coalesce with the neighbours
+    if (it + 1 != free_extents.end() &&
+        it->first + it->second == (it + 1)->first) {
+      it->second += (it + 1)->second;
+      free_extents.erase(it + 1);
+    }
+    if (it != free_extents.begin() &&
+        (it - 1)->first + (it - 1)->second == it->first) {
+      (it - 1)->second += it->second;
+      free_extents.erase(it);
+    }
+  }
+
+  // lay the sorted records out over fresh blocks, block_fill per block, in the
+  // blocks predicted by a model of their ranks
+  void layout(DataNode* dn, const Record* recs, std::size_t n) {
+    const std::size_t nb =
+        std::max<std::size_t>(1, (n + block_fill - 1) / block_fill);
+    LinearModel rank_model;
+    rank_model.train(
+        n, [&](std::size_t i) { return recs[i].first; },
+        [&](std::size_t i) { return (i + 0.5) * nb / n; });
+
+    std::vector<std::size_t> block_of(n);
+    std::vector<std::size_t> count(nb, 0);
+    std::size_t cur = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+      std::size_t b = std::max(cur, rank_model.predict(recs[i].first, nb));
+      // the blocks from b on must hold the remaining records
+      while (b > cur && (nb - b) * block_fill < n - i) --b;
+      if (count[b] == block_fill) ++b;
+      block_of[i] = cur = b;
+      ++count[b];
+    }
+
+    dn->model.train(
+        n, [&](std::size_t i) { return recs[i].first; },
+        [&](std::size_t i) { return block_of[i] + 0.5; });
+    dn->first_block = allocate_blocks(nb);
+    dn->num_blocks = nb;
+    dn->num_keys = n;
+
+    // the blocks of a data node in one sequential write
+    std::unique_ptr<char, AlignedDelete> buf(
+        static_cast<char*>(decltype(sm)::alloc(nb)));
+    for (std::size_t b = 0, i = 0; b < nb; ++b) {
+      auto blk = reinterpret_cast<DataBlock*>(buf.get() + b * BlockSize);
+      blk->count = 0;
+      for (; i < n && block_of[i] == b; ++i) {
+        blk->keys[blk->count] = recs[i].first;
+        blk->values[blk->count] = recs[i].second;
+        ++blk->count;
+      }
+    }
+    sm.write_blocks(dn->first_block, buf.get(), nb);
+  }
+
+  DataNode* new_data_node(const Record* recs, std::size_t n,
+                          std::size_t first_slot, std::size_t dup) {
+    auto dn = new DataNode();
+    dn->first_slot = first_slot;
+    dn->dup = dup;
+    layout(dn, recs, n);
+    data_node_cnt.fetch_add(1);
+    return dn;
+  }
+
+  // a new subtree over the sorted records
+  ModelNode* new_model_node(const Record* recs, std::size_t n) {
+    std::size_t fan_out = 2;
+    while (fan_out < max_fan_out && fan_out * target_data_keys < n) {
+      fan_out *= 2;
+    }
+    auto node = new ModelNode(fan_out);
+    node->model.train(
+        n, [&](std::size_t i) { return recs[i].first; },
+        [&](std::size_t i) { return (i + 0.5) * fan_out / n; });
+    // a skewed model may route every key into one slot, which would recurse
+    // forever, whereas the first and the last key are always apart
+    if (n >= 2 && node->which_child(recs[0].first) ==
+                      node->which_child(recs[n - 1].first)) {
+      node->model.base = recs[0].first;
+      Key range = recs[n - 1].first - recs[0].first;
+      node->model.slope = (fan_out - 0.5) / static_cast<double>(range);
+      node->model.intercept = 0;
+    }
+    build_children(node, 0, fan_out, recs, recs + n);
+    model_node_cnt.fetch_add(1);
+    model_slot_cnt.fetch_add(fan_out);
+    return node;
+  }
+
+  // as in ALEX, a data node that gets few keys spans several aligned slots,
+  // which a sideways split divides later
+  void build_children(ModelNode* node, std::size_t lo, std::size_t hi,
+                      const Record* first, const Record* last) {
+    std::size_t n = last - first;
+    if (n <= target_data_keys || hi - lo == 1) {
+      Node* child = n > max_data_keys
+                        ? static_cast<Node*>(new_model_node(first, n))
+                        : new_data_node(first, n, lo, hi - lo);
+      for (std::size_t s = lo; s < hi; ++s) {
+        node->children[s].store(child, std::memory_order_relaxed);
+      }
+      return;
+    }
+    std::size_t mid = (lo + hi) / 2;
+    auto split = std::partition_point(first, last, [&](const Record& r) {
+      return node->which_child(r.first) < mid;
+    });
+    build_children(node, lo, mid, first, split);
+    build_children(node, mid, hi, split, last);
+  }
+
+  // lower *upper to the smallest key that node routes to the slot end or past
+  // it, if it is above k, which is routed before end. The model of a model
+  // node never changes and is monotonic, hence a binary search
+  static void bound_slots(const ModelNode* node, std::size_t end, Key k,
+                          Key* upper, bool* has_upper) {
+    if (end >= node->num_children) return;
+    Key lo = k;
+    Key hi = *has_upper ? *upper : std::numeric_limits<Key>::max();
+    if (node->which_child(hi) < end) return;
+    while (hi - lo > 1) {
+      Key mid = lo + (hi - lo) / 2;
+      if (node->which_child(mid) < end) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+    *upper = hi;
+    *has_upper = true;
+  }
+
+  // the data node of k, latched, and its parent with the version it was read
+  // at; upper, if given, gets the smallest key after the range of the node
+  template <bool kExclusive>
+  DataNode* traverse(Key k, ModelNode** parent, uint64_t* parent_version,
+                     Key* upper = nullptr, bool* has_upper = nullptr) {
+    while (true) {
+      ModelNode* node = root;
+      uint64_t v = node->lock.read_lock();
+      if (upper != nullptr) *has_upper = false;
+      while (true) {
+        std::size_t slot = node->which_child(k);
+        Node* child = node->children[slot].load(std::memory_order_acquire);
+        if (!child->is_leaf) {
+          auto model_node = static_cast<ModelNode*>(child);
+          uint64_t child_v = model_node->lock.read_lock();
+          if (!node->lock.validate(v)) break;
+          // a model node child takes a single slot
+          if (upper != nullptr) {
+            bound_slots(node, slot + 1, k, upper, has_upper);
+          }
+          node = model_node;
+          v = child_v;
+          continue;
+        }
+        auto dn = static_cast<DataNode*>(child);
+        if (kExclusive) {
+          dn->latch.lock();
+        } else {
+          dn->latch.lock_shared();
+        }
+        if (!node->lock.validate(v) || dn->obsolete) {
+          if (kExclusive) {
+            dn->latch.unlock();
+          } else {
+            dn->latch.unlock_shared();
+          }
+          break;
+        }
+        if (upper != nullptr) {
+          bound_slots(node, dn->first_slot + dn->dup, k, upper, has_upper);
+        }
+        *parent = node;
+        *parent_version = v;
+        return dn;
+      }
+    }
+  }
+
+  // from block c, which is not empty and whose keys are all on the other side
+  // of k than the direction dir (-1 or 1), move block by block towards k
+  std::size_t walk(const DataNode* dn, Key k, int dir, std::size_t c,
+                   BlockPtr& blk, BlockPtr& tmp, int* block_cnt) const {
+    std::size_t cand = c;  // k fits in order into the block in blk
+    for (std::size_t j = c + dir; j < dn->num_blocks; j += dir) {
+      read_block(dn, j, tmp.get());
+      ++*block_cnt;
+      if (tmp->count == 0) {
+        cand = j;
+        std::swap(blk, tmp);
+        continue;
+      }
+      bool past = dir < 0 ? k > tmp->keys[tmp->count - 1] : k < tmp->keys[0];
+      if (!past) {
+        std::swap(blk, tmp);
+        cand = j;
+        if (k >= blk->keys[0] && k <= blk->keys[blk->count - 1]) return j;
+        continue;
+      }
+      // k is between the blocks j and cand, fill j if cand has no room
+      if (blk->count != 0 && blk->is_full() && !tmp->is_full()) {
+        std::swap(blk, tmp);
+        return j;
+      }
+      return cand;
+    }
+    return cand;
+  }
+
+  // the block of a data node that holds k or, if k is absent, that k can be
+  // inserted into in order, read into blk
+  std::size_t locate(const DataNode* dn, Key k, BlockPtr& blk,
+                     int* block_cnt) const {
+    auto tmp = block_alloc();
+    std::size_t b = dn->model.predict(k, dn->num_blocks);
+    read_block(dn, b, blk.get());
+    ++*block_cnt;
+    if (blk->count > 0) {
+      if (k < blk->keys[0]) return walk(dn, k, -1, b, blk, tmp, block_cnt);
+      if (k > blk->keys[blk->count - 1]) {
+        return walk(dn, k, 1, b, blk, tmp, block_cnt);
+      }
+      return b;
+    }
+    // an empty block: look for the nearest keys on both sides
+    for (std::size_t j = b - 1; j < dn->num_blocks; --j) {
+      read_block(dn, j, tmp.get());
+      ++*block_cnt;
+      if (tmp->count == 0) continue;
+      if (k > tmp->keys[tmp->count - 1]) break;
+      std::swap(blk, tmp);
+      if (k >= blk->keys[0]) return j;
+      return walk(dn, k, -1, j, blk, tmp, block_cnt);
+    }
+    for (std::size_t j = b + 1; j < dn->num_blocks; ++j) {
+      read_block(dn, j, tmp.get());
+      ++*block_cnt;
+      if (tmp->count == 0) continue;
+      if (k < tmp->keys[0]) break;
+      std::swap(blk, tmp);
+      if (k <= blk->keys[blk->count - 1]) return j;
+      return walk(dn, k, 1, j, blk, tmp, block_cnt);
+    }
+    blk->count = 0;
+    return b;
+  }
+
+  // every record of a data node and the new one, in order
+  std::vector<Record> collect(const DataNode* dn, Key k, Value v) const {
+    std::vector<Record> recs;
+    recs.reserve(dn->num_keys + 1);
+    auto blk = block_alloc();
+    for (std::size_t b = 0; b < dn->num_blocks; ++b) {
+      read_block(dn, b, blk.get());
+      for (std::size_t i = 0; i < blk->count; ++i) {
+        recs.emplace_back(blk->keys[i], blk->values[i]);
+      }
+    }
+    auto it = std::lower_bound(
+        recs.begin(), recs.end(), k,
+        [](const Record& r, const Key& key) { return r.first < key; });
+    recs.insert(it, {k, v});
+    return recs;
+  }
+
+  // an unpublished or retired data node, its blocks are reused
+  void free_data_node(DataNode* dn) {
+    free_blocks(dn->first_block, dn->num_blocks);
+    data_node_cnt.fetch_sub(1);
+    delete dn;
+  }
+
+  // the nodes of a subtree are subtracted from the stats, and the blocks of
+  // its data nodes are reused
+  void free_subtree(ModelNode* node) {
+    Node* prev = nullptr;
+    for (std::size_t s = 0; s < node->num_children; ++s) {
+      Node* child = node->children[s].load(std::memory_order_relaxed);
+      if (child == prev) continue;
+      prev = child;
+      if (child->is_leaf) {
+        free_data_node(static_cast<DataNode*>(child));
+      } else {
+        free_subtree(static_cast<ModelNode*>(child));
+      }
+    }
+    model_node_cnt.fetch_sub(1);
+    model_slot_cnt.fetch_sub(node->num_children);
+    delete node;
+  }
+
+  // inserts k or updates its value, returns whether a data node has been
+  // split and retired
+  bool insert_pinned(Key k, Value v) {
+    while (true) {
+      ModelNode* parent;
+      uint64_t parent_version;
+      DataNode* dn = traverse<true>(k, &parent, &parent_version);
+      std::unique_lock<std::shared_mutex> lock(dn->latch, std::adopt_lock);
+      auto blk = block_alloc();
+      int cnt = 0;
+      std::size_t b = locate(dn, k, blk, &cnt);
+      auto idx = blk->which_child(k);
+      if (idx < blk->count && blk->keys[idx] == k) {
+        if (blk->values[idx] == v) return false;
+        blk->values[idx] = v;
+        write_block(dn, b, blk.get());
+        return false;
+      }
+      if (!blk->is_full()) {
+        std::copy_backward(blk->keys + idx, blk->keys + blk->count,
+                           blk->keys + blk->count + 1);
+        std::copy_backward(blk->values + idx, blk->values + blk->count,
+                           blk->values + blk->count + 1);
+        blk->keys[idx] = k;
+        blk->values[idx] = v;
+        ++blk->count;
+        write_block(dn, b, blk.get());
+        ++dn->num_keys;
+        return false;
+      }
+
+      auto recs = collect(dn, k, v);
+      if (recs.size() <= max_data_keys) {
+        // expand and retrain, the readers wait on the latch only
+        std::size_t old_first = dn->first_block, old_num = dn->num_blocks;
+        layout(dn, recs.data(), recs.size());
+        free_blocks(old_first, old_num);
+        expand_cnt.fetch_add(1);
+        return false;
+      }
+
+      // build the new nodes before the parent is locked
+      DataNode* left = nullptr;
+      DataNode* right = nullptr;
+      ModelNode* down = nullptr;
+      if (dn->dup >= 2) {
+        std::size_t half = dn->dup / 2;
+        std::size_t mid = dn->first_slot + half;
+        auto split = std::partition_point(
+            recs.begin(), recs.end(),
+            [&](const Record& r) {
+              return parent->which_child(r.first) < mid;
+            });
+        std::size_t n1 = split - recs.begin();
+        left = new_data_node(recs.data(), n1, dn->first_slot, half);
+        right = new_data_node(recs.data() + n1, recs.size() - n1, mid, half);
+      } else {
+        down = new_model_node(recs.data(), recs.size());
+      }
+
+      if (!parent->lock.upgrade(parent_version)) {
+        // the parent has changed, its slots of dn may have too
+        if (down != nullptr) {
+          free_subtree(down);
+        } else {
+          free_data_node(left);
+          free_data_node(right);
+        }
+        continue;
+      }
+      if (down != nullptr) {
+        parent->children[dn->first_slot].store(down, std::memory_order_release);
+        downward_split_cnt.fetch_add(1);
+      } else {
+        for (std::size_t s = left->first_slot; s < right->first_slot; ++s) {
+          parent->children[s].store(left, std::memory_order_release);
+        }
+        std::size_t end_slot = right->first_slot + right->dup;
+        for (std::size_t s = right->first_slot; s < end_slot; ++s) {
+          parent->children[s].store(right, std::memory_order_release);
+        }
+        sideways_split_cnt.fetch_add(1);
+      }
+      dn->obsolete = true;
+      parent->lock.write_unlock();
+      data_node_cnt.fetch_sub(1);
+      free_blocks(dn->first_block, dn->num_blocks);
+      epoch.Retire([dn] { delete dn; });
+      return true;
+    }
+  }
+
+ public:
+  // the thread ids passed to the operations are below thread_num
+  ThreadSafeAlexDisk(std::string filename, std::size_t thread_num)
+      : sm(filename), epoch(thread_num) {}
+
+  ~ThreadSafeAlexDisk() {
+    if (root != nullptr) free_subtree(root);
+    sm.close_file();
+  }
+
+  ThreadSafeAlexDisk(const ThreadSafeAlexDisk&) = delete;
+  ThreadSafeAlexDisk& operator=(const ThreadSafeAlexDisk&) = delete;
+
+  void direct_open(std::string filename) { sm.direct_open(filename); }
+  void no_direct_open(std::string filename) { sm.no_direct_open(filename); }
+
+  // the records are sorted by key, the root is always a model node
+  void bulk_load(const Record* recs, std::size_t n) {
+    if (root != nullptr) {
+      throw std::runtime_error("ALEX has been built!");
+    }
+    root = new_model_node(recs, n);
+  }
+
+  Value lookup(Key k, int thread_id) {
+    epoch.Pin(thread_id);
+    Value res = 0;
+    {
+      ModelNode* parent;
+      uint64_t parent_version;
+      DataNode* dn = traverse<false>(k, &parent, &parent_version);
+      std::shared_lock<std::shared_mutex> lock(dn->latch, std::adopt_lock);
+      auto blk = block_alloc();
+      int cnt = 0;
+      locate(dn, k, blk, &cnt);
+      auto idx = blk->which_child(k);
+      if (idx < blk->count && blk->keys[idx] == k) {
+        res = blk->values[idx];
+      }
+    }
+    epoch.Unpin(thread_id);
+    return res;
+  }
+
+  // the first len records from the lower bound of k on, in key order; each
+  // data node is read under its latch and the scan goes on from the smallest
+  // key after its range
+  std::size_t scan(Key k, std::size_t len, Record* out, int thread_id) {
+    epoch.Pin(thread_id);
+    std::size_t cnt = 0;
+    auto blk = block_alloc();
+    while (cnt < len) {
+      ModelNode* parent;
+      uint64_t parent_version;
+      Key upper;
+      bool has_upper;
+      DataNode* dn =
+          traverse<false>(k, &parent, &parent_version, &upper, &has_upper);
+      {
+        std::shared_lock<std::shared_mutex> lock(dn->latch, std::adopt_lock);
+        int block_cnt = 0;
+        std::size_t b = locate(dn, k, blk, &block_cnt);
+        while (true) {
+          for (auto i = blk->which_child(k); i < blk->count && cnt < len;
+               ++i) {
+            out[cnt++] = {blk->keys[i], blk->values[i]};
+          }
+          if (cnt == len || ++b == dn->num_blocks) break;
+          read_block(dn, b, blk.get());
+        }
+      }
+      if (!has_upper) break;
+      k = upper;
+    }
+    epoch.Unpin(thread_id);
+    return cnt;
+  }
+
+  // inserts k or updates its value
+  void insert(Key k, Value v, int thread_id) {
+    epoch.Pin(thread_id);
+    bool split = insert_pinned(k, v);
+    epoch.Unpin(thread_id);
+    if (split) {
+      // free the data nodes split in the earlier epochs
+      epoch.Reclaim();
+    }
+  }
+
+  std::size_t get_memory_size() const {
+    return model_node_cnt.load() * sizeof(ModelNode) +
+           model_slot_cnt.load() * sizeof(std::atomic<Node*>) +
+           data_node_cnt.load() * sizeof(DataNode);
+  }
+
+  std::size_t get_file_size() const { return block_cnt.load() * BlockSize; }
+
+  std::size_t get_sideways_split_cnt() const {
+    return sideways_split_cnt.load();
+  }
+
+  std::size_t get_downward_split_cnt() const {
+    return downward_split_cnt.load();
+  }
+
+  // the split data nodes that are not freed yet
+  std::size_t get_unreclaimed_cnt() { return epoch.GetRetiredNum(); }
+
+  void print_stats() {
+    std::cout << "\t\tmodel nodes:" << model_node_cnt.load()
+              << ",\tdata nodes:" << data_node_cnt.load()
+              << ",\texpands:" << expand_cnt.load()
+              << ",\tsideways splits:" << sideways_split_cnt.load()
+              << ",\tdownward splits:" << downward_split_cnt.load()
+              << ",\tunreclaimed data nodes:" << epoch.GetRetiredNum()
+              << std::endl;
+  }
+};
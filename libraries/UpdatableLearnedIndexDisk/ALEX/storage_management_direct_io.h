@@ -14,8 +14,9 @@
 #include <cstring>
 #include <iostream>
 #include <map>
+
+#include "../block_cache.h"
 namespace alex_disk {
-#define Caching 0
 const long AlexBlockSize = 8192L;
 typedef struct {
   int next_block;
@@ -46,20 +47,45 @@ class StorageManager {
   std::string filename;
   //   FILE *fp = nullptr;
   int fd;
+  AlignedBufferPool buffers{AlexBlockSize};
 
   void _write_block(void *data, int block_id) {
+    _write_blocks(data, block_id, 1);
+  }
+
+  // write block_num blocks from buf, copied to an aligned buffer if needed
+  void _write_blocks(void *buf, int block_id, int block_num) {
     if (lseek(fd, block_id * AlexBlockSize, SEEK_SET) == -1) {
       throw std::runtime_error("lseek file error in _write_block");
     }
-    void *buf = aligned_alloc(AlexBlockSize, AlexBlockSize);
-    memcpy(buf, data, AlexBlockSize);
-    int ret = write(fd, buf, AlexBlockSize);
+    char *aligned = static_cast<char *>(buf);
+    if (reinterpret_cast<uintptr_t>(buf) % AlexBlockSize != 0) {
+      aligned = buffers.Acquire(block_num * AlexBlockSize);
+      memcpy(aligned, buf, block_num * AlexBlockSize);
+    }
+    int ret = write(fd, aligned, block_num * AlexBlockSize);
     if (ret == -1) {
       throw std::runtime_error("write error in DirectIOWrite");
     }
+    if (aligned != buf) {
+      buffers.Release(aligned, block_num * AlexBlockSize);
+    }
     return;
   }
 
+  // read the blocks [block_id, block_id + block_num) into the aligned buf
+  void _read_blocks(char *buf, int block_id, int block_num) {
+    // the blocks past the end of the file are read as zeros
+    memset(buf, 0, block_num * AlexBlockSize);
+    if (lseek(fd, block_id * AlexBlockSize, SEEK_SET) == -1) {
+      throw std::runtime_error("lseek file error in _read_block");
+    }
+    int ret = read(fd, buf, block_num * AlexBlockSize);
+    if (ret == -1) {
+      throw std::runtime_error("read error in DirectIORead");
+    }
+  }
+
   char *_allocate_new_block() {
     char *ptr = nullptr;
     ptr = (char *)malloc(AlexBlockSize * sizeof(char));
@@ -82,10 +108,8 @@ class StorageManager {
 
   void _create_file() {
     fd = open(filename.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644);
-    void *empty_block = aligned_alloc(AlexBlockSize, AlexBlockSize);
-    for (int i = 0; i < AlexBlockSize; i++) {
-      *(static_cast<char *>(empty_block) + i) = 0;
-    }
+    char *empty_block = buffers.Acquire(AlexBlockSize);
+    memset(empty_block, 0, AlexBlockSize);
     MetaNode mn;
     mn.next_block = 1;
     mn.next_offset = 0;
@@ -96,6 +120,7 @@ class StorageManager {
     // mn.level = 1;
     memcpy(empty_block, &mn, MetaNodeSize);
     _write_block(empty_block, 0);
+    buffers.Release(empty_block, AlexBlockSize);
     _close_file_handle();
     _get_file_handle();
   }
@@ -128,16 +153,7 @@ class StorageManager {
   }
 
   void _read_block(void *data, int block_id) {
-    if (lseek(fd, block_id * AlexBlockSize, SEEK_SET) == -1) {
-      throw std::runtime_error("lseek file error in _read_block");
-    }
-    void *buf = aligned_alloc(AlexBlockSize, AlexBlockSize);
-    int ret = read(fd, buf, AlexBlockSize);
-    if (ret == -1) {
-      throw std::runtime_error("read error in DirectIORead");
-    }
-    memcpy(data, buf, AlexBlockSize);
-    return;
+    read_arbitrary(data, block_id * AlexBlockSize, AlexBlockSize);
   }
 
   Block get_block(int block_id) {
@@ -155,40 +171,46 @@ class StorageManager {
   }
 
   void write_with_size(int block_id, void *data, long size) {
-    if (lseek(fd, block_id * AlexBlockSize, SEEK_SET) == -1) {
-      throw std::runtime_error("lseek file error in write_with_size");
-    }
-    write(fd, data, size);
-    return;
+    write_arbitrary(block_id * AlexBlockSize, data, size);
   }
 
+  // O_DIRECT only writes whole aligned blocks, so the partially written
+  // blocks are read, modified and written back
   void write_arbitrary(long offset, void *data, long size) {
-    // fseek(fp, offset, SEEK_SET);
-    // fwrite(data, size, 1, fp);
-    if (lseek(fd, offset, SEEK_SET) == -1) {
-      throw std::runtime_error("lseek file error in write_arbitrary");
+    if (size <= 0) {
+      return;
+    }
+    int first = offset / AlexBlockSize;
+    int num = (offset + size - 1) / AlexBlockSize - first + 1;
+    long head = offset - first * AlexBlockSize;
+    char *buf = buffers.Acquire(num * AlexBlockSize);
+    if (head != 0) {
+      _read_blocks(buf, first, 1);
+    }
+    if ((offset + size) % AlexBlockSize != 0 && (num > 1 || head == 0)) {
+      _read_blocks(buf + (num - 1) * AlexBlockSize, first + num - 1, 1);
     }
-    write(fd, data, size);
+    memcpy(buf + head, data, size);
+    _write_blocks(buf, first, num);
+    buffers.Release(buf, num * AlexBlockSize);
     return;
   }
 
   void read_block_arbitrary(void *data, long offset) {
-    if (lseek(fd, offset, SEEK_SET) == -1) {
-      throw std::runtime_error("lseek file error in read_block_arbitrary");
-    }
-    void *buf = aligned_alloc(AlexBlockSize, AlexBlockSize);
-    read(fd, buf, AlexBlockSize);
-    return;
+    read_arbitrary(data, offset, AlexBlockSize);
   }
 
   void read_arbitrary(void *data, long offset, long len) {
-    if (lseek(fd, offset, SEEK_SET) == -1) {
-      throw std::runtime_error("lseek file error in read_arbitrary");
+    if (len <= 0) {
+      return;
     }
-    size_t num = std::ceil(len * 1.0 / AlexBlockSize);
-    void *buf = aligned_alloc(AlexBlockSize, AlexBlockSize * num);
-    read(fd, buf, AlexBlockSize * num);
+    int first = offset / AlexBlockSize;
+    int num = (offset + len - 1) / AlexBlockSize - first + 1;
+    char *buf = buffers.Acquire(num * AlexBlockSize);
+    _read_blocks(buf, first, num);
+    memcpy(data, buf + (offset - first * AlexBlockSize), len);
+    buffers.Release(buf, num * AlexBlockSize);
     return;
-   }
+  }
 };
 }  // namespace alex_disk
\ No newline at end of file
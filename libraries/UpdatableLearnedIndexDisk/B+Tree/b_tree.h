@@ -88,6 +88,7 @@ class BTree {
   }
 
   size_t get_file_size() { return sm->get_file_size(); }
+  void set_block_cache(BlockCache *cache) { sm->set_block_cache(cache); }
   void sync_metanode() {
     Block block;
     memcpy(block.data, &metanode, MetaNodeSize);
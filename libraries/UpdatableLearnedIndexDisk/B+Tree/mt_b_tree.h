@@ -3,7 +3,9 @@
 #include <atomic>
 #include <cassert>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <utility>
 #include <vector>
 
 #include "mt_storage.h"
@@ -137,6 +139,35 @@ class ThreadSafeBTreeDisk {
         static_cast<LeafNode*>(decltype(sm)::alloc()));
   }
 
+  // the parents of num nodes whose first keys are first_keys, per_node
+  // children each, built in parallel; first_keys becomes theirs
+  template <class NodeT, class SetChild>
+  static std::vector<void*> build_level(std::size_t num,
+                                        std::vector<Key>& first_keys,
+                                        std::size_t per_node,
+                                        SetChild set_child) {
+    const std::size_t num_nodes = (num + per_node - 1) / per_node;
+    std::vector<void*> nodes(num_nodes);
+    std::vector<Key> node_keys(num_nodes);
+#pragma omp parallel for
+    for (std::size_t j = 0; j < num_nodes; ++j) {
+      auto node = new NodeT();
+      std::size_t begin = j * per_node;
+      std::size_t end = std::min(num, begin + per_node);
+      node->count = end - begin;
+      for (std::size_t i = begin; i < end; ++i) {
+        set_child(node, i - begin, i);
+        if (i > begin) {
+          node->keys[i - begin - 1] = first_keys[i];
+        }
+      }
+      nodes[j] = node;
+      node_keys[j] = first_keys[begin];
+    }
+    first_keys.swap(node_keys);
+    return nodes;
+  }
+
  public:
   ThreadSafeBTreeDisk(std::string filename) : sm(filename) {
     auto to_disk = new ToDiskNode();
@@ -153,6 +184,76 @@ class ThreadSafeBTreeDisk {
   void direct_open(std::string filename) { sm.direct_open(filename); }
   void no_direct_open(std::string filename) { sm.no_direct_open(filename); }
 
+  // build a new tree over the n records sorted by key, the leaves and the
+  // inner nodes are filled up to fill: the leaves are written sequentially in
+  // batches of blocks and the inner levels are built bottom-up
+  void bulk_load(const std::pair<Key, Value>* data, std::size_t n,
+                 double fill = 0.7) {
+    if (root.height != 2 || block_cnt.load() != 1) {
+      throw std::runtime_error("bulk_load needs a new tree!");
+    }
+    delete static_cast<ToDiskNode*>(root.child);
+
+    const std::size_t per_leaf = std::clamp<std::size_t>(
+        LeafNode::num_entries * fill, 1, LeafNode::num_entries);
+    const std::size_t num_leaves =
+        std::max<std::size_t>(1, (n + per_leaf - 1) / per_leaf);
+    block_cnt = num_leaves;
+    std::vector<Key> first_keys(num_leaves, Key());
+
+    // 1 MiB per write
+    constexpr std::size_t batch_leaves = (1 << 20) / BlockSize;
+    const std::size_t num_batches =
+        (num_leaves + batch_leaves - 1) / batch_leaves;
+#pragma omp parallel for schedule(static)
+    for (std::size_t b = 0; b < num_batches; ++b) {
+      std::unique_ptr<char, void (*)(void*)> buf(
+          static_cast<char*>(decltype(sm)::alloc(batch_leaves)), std::free);
+      std::size_t begin = b * batch_leaves;
+      std::size_t end = std::min(num_leaves, begin + batch_leaves);
+      for (std::size_t i = begin; i < end; ++i) {
+        auto leaf = reinterpret_cast<LeafNode*>(buf.get() +
+                                                (i - begin) * BlockSize);
+        std::size_t start = std::min(n, i * per_leaf);
+        leaf->count = std::min(per_leaf, n - start);
+        for (std::size_t j = 0; j < leaf->count; ++j) {
+          leaf->keys[j] = data[start + j].first;
+          leaf->values[j] = data[start + j].second;
+        }
+        if (leaf->count > 0) {
+          first_keys[i] = leaf->keys[0];
+        }
+      }
+      sm.write_blocks(begin, buf.get(), end - begin);
+    }
+
+    const std::size_t per_to_disk = std::clamp<std::size_t>(
+        ToDiskNode::fan_out * fill, 2, ToDiskNode::fan_out);
+    auto nodes = build_level<ToDiskNode>(
+        num_leaves, first_keys, per_to_disk,
+        [&](ToDiskNode* node, std::size_t idx, std::size_t i) {
+          node->children[idx] = i;
+          if (std::min(per_leaf, n - std::min(n, i * per_leaf)) ==
+              LeafNode::num_entries) {
+            node->bitmap.set(idx);
+          }
+        });
+    std::size_t height = 2;
+    const std::size_t per_fan = std::clamp<std::size_t>(
+        FanNode::fan_out * fill, 2, FanNode::fan_out);
+    while (nodes.size() > 1) {
+      auto children = std::move(nodes);
+      nodes = build_level<FanNode>(
+          children.size(), first_keys, per_fan,
+          [&](FanNode* node, std::size_t idx, std::size_t i) {
+            node->children[idx] = children[i];
+          });
+      ++height;
+    }
+    root.child = nodes[0];
+    root.height = height;
+  }
+
   void insert(Key k, Value v) {
     { // optimistic lookup
       std::shared_lock<std::shared_mutex> lock(root.mtx);
@@ -327,12 +428,15 @@ class ThreadSafeBTreeDisk {
     auto leaf_node = leaf_alloc();
     sm.read_block(block_id, leaf_node.get());
     auto key_idx = leaf_node->which_child(k);
-    if (leaf_node->keys[key_idx] == k) {
+    if (key_idx < leaf_node->count && leaf_node->keys[key_idx] == k) {
       return leaf_node->values[key_idx];
     }
-    assert(false);
+    // not inserted yet, e.g., by another thread
+    return 0;
   }
 
+  std::size_t get_height() const { return root.height; }
+
   static void is_valid(LeafNode* node, Key &min_key, Key &max_key) {
     for (std::size_t i = 0; i < node->count; i++) {
       if (i > 0) {
@@ -8,6 +8,9 @@
 
 #include "utility.h"
 
+// Blocks of a file read and written with pread/pwrite only, so that the
+// threads share the file descriptor without any lock. The file is opened with
+// O_DIRECT, hence the buffers must come from alloc().
 class ThreadSafeStorageManager {
  public:
   int fd;
@@ -15,7 +18,7 @@ class ThreadSafeStorageManager {
  public:
   ThreadSafeStorageManager() : fd(-1) {}
   ThreadSafeStorageManager(std::string filename)
-      : fd(open(filename.c_str(), O_RDWR | O_CREAT /*| O_DIRECT*/, 0644)) {
+      : fd(open(filename.c_str(), O_RDWR | O_CREAT | O_DIRECT, 0644)) {
     if (fd == -1) {
       throw std::runtime_error("open error");
     }
@@ -40,7 +43,9 @@ class ThreadSafeStorageManager {
     fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
   }
 
-  static void *alloc() { return std::aligned_alloc(BlockSize, BlockSize); }
+  static void *alloc(std::size_t num = 1) {
+    return std::aligned_alloc(BlockSize, num * BlockSize);
+  }
 
   void write_block(std::size_t block_id, void *data) {
     auto n = pwrite(fd, data, BlockSize, block_id * BlockSize);
@@ -49,6 +54,19 @@ class ThreadSafeStorageManager {
     }
   }
 
+  // the blocks [block_id, block_id + num) in one sequential write
+  void write_blocks(std::size_t block_id, void *data, std::size_t num) {
+    auto buf = static_cast<char *>(data);
+    std::size_t done = 0, bytes = num * BlockSize;
+    while (done < bytes) {
+      auto n = pwrite(fd, buf + done, bytes - done, block_id * BlockSize + done);
+      if (n <= 0) {
+        throw std::runtime_error("write_blocks error");
+      }
+      done += n;
+    }
+  }
+
   void read_block(std::size_t block_id, void *data) const {
     auto n = pread(fd, data, BlockSize, block_id * BlockSize);
     if (n != BlockSize) {
@@ -14,10 +14,9 @@
 #include <iostream>
 #include <map>
 
+#include "../block_cache.h"
 #include "utility.h"
 
-#define Caching 0
-
 class StorageManager {
  private:
   //   char *file_name = nullptr;
@@ -25,9 +24,8 @@ class StorageManager {
   //   FILE *fp = nullptr;
   int fd;
   void *buf = aligned_alloc(BlockSize, 4 * BlockSize);
-#if Caching
-  std::map<int, Block> block_cache;  // LRU setting?
-#endif
+  // shared with other storage managers, nullptr: every access goes to disk
+  BlockCache *cache = nullptr;
 
   void _write_block(void *data, int block_id) {
     if (lseek(fd, block_id * BlockSize, SEEK_SET) == -1) {
@@ -38,10 +36,16 @@ class StorageManager {
     if (ret == -1) {
       throw std::runtime_error("write error in DirectIOWrite");
     }
+    if (cache != nullptr) {
+      cache->Write(fd, block_id, buf);
+    }
     return;
   }
 
   void _read_block(void *data, int block_id) {
+    if (cache != nullptr && cache->Read(fd, block_id, data)) {
+      return;
+    }
     if (lseek(fd, block_id * BlockSize, SEEK_SET) == -1) {
       throw std::runtime_error("lseek file error in _read_block");
     }
@@ -50,6 +54,12 @@ class StorageManager {
       throw std::runtime_error("read error in DirectIORead");
     }
     memcpy(data, buf, BlockSize);
+    if (cache != nullptr) {
+      // pin the inner nodes, the block 0 is the meta node
+      cache->Insert(
+          fd, block_id, buf,
+          block_id > 0 && static_cast<char *>(buf)[0] == InnerNodeType);
+    }
     return;
   }
 
@@ -131,6 +141,8 @@ class StorageManager {
     if (fd != -1) _close_file_handle();
   }
 
+  void set_block_cache(BlockCache *c) { cache = c; }
+
   Block get_block(int block_id) {
     Block block;
     // char data[BlockSize];
@@ -153,6 +165,9 @@ class StorageManager {
       throw std::runtime_error("lseek file error in write_with_size");
     }
     write(fd, data, size);
+    if (cache != nullptr) {
+      cache->Invalidate(fd, block_id, (size + BlockSize - 1) / BlockSize);
+    }
     return;
   }
 
@@ -172,6 +187,10 @@ class StorageManager {
       throw std::runtime_error("lseek file error in write_arbitrary");
     }
     write(fd, data, size);
+    if (cache != nullptr) {
+      long first = offset / BlockSize;
+      cache->Invalidate(fd, first, (offset + size - 1) / BlockSize - first + 1);
+    }
     return;
   }
 };
\ No newline at end of file
@@ -3916,7 +3916,8 @@ public:
     }
 
     size_t get_tree_size() {
-        return _get_tree_size(m_root);
+        // empty when all the inner levels are on disk
+        return m_root ? _get_tree_size(m_root) : 0;
     }
     size_t _get_tree_size(const node* n) {
         size_t ts = 0;
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pgm_baseline_disk {
+
+/**
+ * A blocked Bloom filter over the keys of a level of @ref DynamicPGMIndex.
+ *
+ * All the bits of a key are set in one block of 512 bits, i.e., a cache line, so a query costs a single cache miss.
+ * An empty filter, i.e., one that was never reset, may contain any key.
+ * @tparam K the type of a key
+ */
+template<typename K>
+class BlockedBloomFilter {
+    static constexpr size_t words_per_block = 8;
+    static constexpr size_t bits_per_block = words_per_block * 64;
+
+    std::vector<uint64_t> words; ///< The bits, words_per_block words per block.
+    size_t num_blocks = 0;       ///< The number of blocks.
+    uint8_t num_probes = 0;      ///< The number of bits set for each key.
+
+    static uint64_t hash(const K &key) {
+        // the finalizer of MurmurHash3
+        uint64_t h = static_cast<uint64_t>(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    uint64_t *block(uint64_t h) {
+        return words.data() + ((h >> 32) * num_blocks >> 32) * words_per_block;
+    }
+
+    const uint64_t *block(uint64_t h) const {
+        return words.data() + ((h >> 32) * num_blocks >> 32) * words_per_block;
+    }
+
+public:
+
+    BlockedBloomFilter() = default;
+
+    /**
+     * Clears the filter and sizes it for @p n keys.
+     * @param n the expected number of keys
+     * @param bits_per_key the bits of the filter per key, 0 leaves the filter empty
+     */
+    void reset(size_t n, size_t bits_per_key) {
+        if (bits_per_key == 0) {
+            words.clear();
+            num_blocks = 0;
+            return;
+        }
+        num_blocks = std::max<size_t>(1, (n * bits_per_key + bits_per_block - 1) / bits_per_block);
+        num_probes = std::clamp<int>(std::round(bits_per_key * std::log(2)), 1, 16);
+        words.assign(num_blocks * words_per_block, 0);
+    }
+
+    void insert(const K &key) {
+        if (num_blocks == 0)
+            return;
+        auto h = hash(key);
+        auto b = block(h);
+        uint32_t delta = (h >> 17) | 1;
+        for (uint32_t i = 0, bit = h; i < num_probes; ++i, bit += delta)
+            b[(bit % bits_per_block) / 64] |= uint64_t(1) << (bit % 64);
+    }
+
+    /**
+     * Returns false only if @p key was not inserted since the last reset.
+     */
+    bool may_contain(const K &key) const {
+        if (num_blocks == 0)
+            return true;
+        auto h = hash(key);
+        auto b = block(h);
+        uint32_t delta = (h >> 17) | 1;
+        for (uint32_t i = 0, bit = h; i < num_probes; ++i, bit += delta)
+            if (!(b[(bit % bits_per_block) / 64] & (uint64_t(1) << (bit % 64))))
+                return false;
+        return true;
+    }
+
+    /**
+     * Returns the size of the filter in bytes.
+     */
+    size_t size_in_bytes() const { return words.size() * sizeof(uint64_t); }
+};
+
+}
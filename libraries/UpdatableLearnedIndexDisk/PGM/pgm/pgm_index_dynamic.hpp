@@ -16,6 +16,7 @@
 #pragma once
 
 #include "pgm_index_dynamic_origin.hpp"
+#include "blocked_bloom_filter.hpp"
 #include <cstddef>
 #include <cstdint>
 #include <algorithm>
@@ -59,6 +60,7 @@ class DynamicPGMIndex {
     uint8_t used_levels;           ///< Equal to 1 + last level whose size is greater than 0, or = min_level if no data.
     std::vector<Level> levels;     ///< (i-min_level)th element is the data array at the ith level.
     std::vector<PGMType> pgms;     ///< (i-min_index_level)th element is the index at the ith level.
+    std::vector<BlockedBloomFilter<K>> filters; ///< (i-min_level)th element is the filter of the keys at the ith level.
 
     /// ***** for disk version *****///
     std::string suffix = "test";
@@ -81,6 +83,8 @@ public:
         V value;
     } ItemOnDisk;
     bool inner_disk = false;
+    int epsilon_value = 64;
+    size_t filter_bits_per_key = 10; ///< 0 disables the filters, then every level is searched on disk.
 private:
     const int32_t ItemOnDiskSize = sizeof(ItemOnDisk);
     const int32_t ItemCountPerBlock = int32_t(BLOCK_SIZE/ItemOnDiskSize);
@@ -101,6 +105,8 @@ private:
     // supported internal operation
     int32_t ACCESSED_BLOCK_COUNT_Data = 0;
     void ADD_BLOCK_COUNT_Data() {ACCESSED_BLOCK_COUNT_Data += 1;}
+    // the data blocks that the levels skipped by their filters would have read
+    int32_t AVOIDED_BLOCK_COUNT_Data = 0;
     #define BLOCK_RECORDING 1
 
     void initial_metadata() {
@@ -264,6 +270,54 @@ private:
         return index_file_handlers[level-min_index_level];
     }
 
+    BlockedBloomFilter<K> &filter(uint8_t level) {
+        return filters[level-min_level];
+    }
+
+    void init_filters() {
+        filters.resize(12 - min_level);
+        // the items are inserted into the buffer level one by one
+        filter(min_level).reset(buffer_max_size, filter_bits_per_key);
+    }
+
+    void build_filter(uint8_t level, size_t capacity, const ItemOnDisk *items, size_t item_count) {
+        filter(level).reset(capacity, filter_bits_per_key);
+        for (size_t i = 0; i < item_count; i++) {
+            filter(level).insert(items[i].key);
+        }
+    }
+
+    // rebuild the filter of a level from its data file, e.g., after a restart
+    void load_filter(uint8_t level) {
+        size_t item_count = get_item_count(level);
+        filter(level).reset(level == min_level ? buffer_max_size : item_count, filter_bits_per_key);
+        for (size_t i = 0; i < item_count; i += ItemCountPerBlock) {
+            read_block<ItemOnDisk>(get_data_file_handler(level), buf, i / ItemCountPerBlock, metadata.data_in_memory[level-min_level], &(memory_data[level-min_level][0]));
+            size_t end = std::min<size_t>(item_count - i, ItemCountPerBlock);
+            for (size_t j = 0; j < end; j++) {
+                filter(level).insert(((ItemOnDisk *)buf)[j].key);
+            }
+        }
+    }
+
+    // the data blocks that the search of key at a level would read, which its filter saves if the key is absent
+    int32_t searched_block_count(uint8_t level, const K &key, size_t item_count) {
+        size_t first = 0;
+        size_t last = item_count;
+        if (has_pgm(level) && !inner_disk) {
+            auto range = pgm(level).search(key);
+            first = range.lo;
+            last = range.hi;
+        } else if (has_pgm(level)) {
+            // the range is only known after reading the index, so assume the size of a range
+            last = std::min<size_t>(item_count, 2 * epsilon_value + 2);
+        }
+        if (first >= last) return 0;
+        int32_t blocks = (last - 1) / ItemCountPerBlock - first / ItemCountPerBlock + 1;
+        // without an index, the binary search over the whole level reads a block per step
+        return has_pgm(level) ? blocks : ceil_log2(blocks) + 1;
+    }
+
     void read_block_or_not(int file_handler, int32_t *last_block, int32_t block_to_fetch, void *block_data, bool in_memory, ItemOnDisk* level_memory_data) {
             if (block_to_fetch != *last_block) {
                 read_block<ItemOnDisk>(file_handler, block_data, block_to_fetch, in_memory, level_memory_data);
@@ -414,6 +468,7 @@ private:
 
             // clear item count
             set_item_count(i, 0);
+            filter(i) = BlockedBloomFilter<K>();
             // todo: do we need to truncate the file
         }
         set_item_count(min_level, 0);
@@ -436,6 +491,8 @@ private:
         }
         // delete []block_data;
         set_item_count(target, tmp_size);
+        filter(min_level).reset(buffer_max_size, filter_bits_per_key);
+        build_filter(target, tmp_size, final, tmp_size);
 
         // build index if needed
         if (has_pgm(target)) {
@@ -449,7 +506,7 @@ private:
 //            auto item_vec = alternate ? std::vector<ItemOnDisk> (tmp_a, tmp_a + sizeof(tmp_a))
 //                                      :  std::vector<ItemOnDisk> (tmp_b, tmp_b + sizeof(tmp_b));
             // flush index as needed
-            pgm(target) = PGMType(item_vec.begin(), item_vec.end(), inner_disk, get_index_file_handler(target));
+            pgm(target) = PGMType(item_vec.begin(), item_vec.end(), inner_disk, get_index_file_handler(target), epsilon_value);
         }
 
         delete []tmp_a;
@@ -588,6 +645,7 @@ private:
 #endif
 //            std::cout<<"insert into the data file" << std::endl;
             insert_item_on_file(min_level, insertion_point, new_item);
+            filter(min_level).insert(new_item.key);
             used_levels = used_levels == min_level ? min_level + 1 : used_levels;
             set_item_count(min_level, item_count + 1);
             // todo: update the metadata
@@ -616,7 +674,7 @@ private:
             if (need_new_level) {
                 ++used_levels;
                 if (i - min_index_level >= int(pgms.size()))
-                    pgms.emplace_back();
+                    pgms.emplace_back(epsilon_value);
                 // we suppose we have allocated these files.
             }
 //        std::cout<<"merge..." << std::endl;
@@ -656,8 +714,17 @@ public:
         return total_size;
     }
 
-    size_t report_main_memory_size() {
+    size_t report_filter_size() {
         size_t total_size = 0;
+        for (auto &f : filters) {
+            total_size += f.size_in_bytes();
+        }
+        return total_size;
+    }
+
+    size_t report_main_memory_size() {
+        // the filters are always kept in main memory
+        size_t total_size = report_filter_size();
         if (inner_disk) return total_size;
         for (auto i = min_level; i < used_levels; ++i) {
             if (metadata.data_in_memory[i-min_level]){
@@ -672,12 +739,18 @@ public:
         return total_size;
     }
 
-    V find_on_disk(const K &key, int *c, int *ic, int *lc) {
+    V find_on_disk(const K &key, int *c, int *ic, int *lc, int *ac = nullptr) {
         ACCESSED_BLOCK_COUNT_Data = 0;
+        AVOIDED_BLOCK_COUNT_Data = 0;
         ItemOnDisk item;
             for (auto i = min_level; i < used_levels; ++i) {
                 auto item_count = get_item_count(i);
                 if (item_count == 0) continue;
+                if (!filter(i).may_contain(key)) {
+                    AVOIDED_BLOCK_COUNT_Data += searched_block_count(i, key, item_count);
+                    if (ac) *ac = AVOIDED_BLOCK_COUNT_Data;
+                    continue;
+                }
 
                 size_t first = 0;
                 size_t last = item_count;
@@ -689,6 +762,7 @@ public:
                 }
                 // binary search on data file
                 *ic = *c;
+                ACCESSED_BLOCK_COUNT_Data = 0;
                 auto pos = lower_bound_bl_disk(get_data_file_handler(i), first, last, key, item_count, &item, metadata.data_in_memory[i-min_level], &(memory_data[i-min_level][0]));
                 *c += ACCESSED_BLOCK_COUNT_Data;
                 if (pos != item_count && item.key == key) {
@@ -698,12 +772,18 @@ public:
             return 0;
         }
 
-    bool update_on_disk(const K &key, const V &value, int *c, int *ic, int *lc) {
+    bool update_on_disk(const K &key, const V &value, int *c, int *ic, int *lc, int *ac = nullptr) {
         ACCESSED_BLOCK_COUNT_Data = 0;
+        AVOIDED_BLOCK_COUNT_Data = 0;
         ItemOnDisk item;
             for (auto i = min_level; i < used_levels; ++i) {
                 auto item_count = get_item_count(i);
                 if (item_count == 0) continue;
+                if (!filter(i).may_contain(key)) {
+                    AVOIDED_BLOCK_COUNT_Data += searched_block_count(i, key, item_count);
+                    if (ac) *ac = AVOIDED_BLOCK_COUNT_Data;
+                    continue;
+                }
 
                 size_t first = 0;
                 size_t last = item_count;
@@ -715,6 +795,7 @@ public:
                 }
                 // binary search on data file
                 *ic = *c;
+                ACCESSED_BLOCK_COUNT_Data = 0;
                 auto pos = lower_bound_bl_disk(get_data_file_handler(i), first, last, key, item_count, &item, metadata.data_in_memory[i-min_level], &(memory_data[i-min_level][0]));
                 *c += ACCESSED_BLOCK_COUNT_Data;
                 if (pos != item_count && item.key == key) {
@@ -909,7 +990,7 @@ private:
             if (i >= max_fully_allocated_level())
                 level(i).shrink_to_fit();
             if (has_pgm(i))
-                pgm(i) = PGMType();
+                pgm(i) = PGMType(epsilon_value);
         }
 
         // todo: truncate file or set item count with 0
@@ -920,7 +1001,7 @@ private:
         // Rebuild index, if needed
         // todo: build index file if needed
         if (has_pgm(target))
-            pgm(target) = PGMType(level(target).begin(), level(target).end());
+            pgm(target) = PGMType(level(target).begin(), level(target).end(), epsilon_value);
     }
 
     void insert(const Item &new_item) {
@@ -950,7 +1031,7 @@ private:
             ++used_levels;
             levels.emplace_back();
             if (i - min_index_level >= int(pgms.size()))
-                pgms.emplace_back();
+                pgms.emplace_back(epsilon_value);
         }
 
         pairwise_merge(new_item, i, slots_required, insertion_point);
@@ -1024,7 +1105,7 @@ public:
 
         if (has_pgm(used_levels - 1)) {
             pgms = decltype(pgms)(used_levels - min_index_level);
-            pgm(used_levels - 1) = PGMType(target.begin(), target.end());
+            pgm(used_levels - 1) = PGMType(target.begin(), target.end(), epsilon_value);
         }
     }
 
@@ -1054,6 +1135,7 @@ public:
         // we can flush the metadata at last instead of each operation
         if (is_first_time) initial_metadata();
         else load_metadata();
+        init_filters();
         // if is_first_time is false, we suppose `first' and `last' are null, we
         // do not need them
         if (!is_first_time) {
@@ -1061,8 +1143,9 @@ public:
             pgms = decltype(pgms)(12);
             for (auto i  = min_level; i < 12; i++) {
                 if (get_item_count(i) > 0 && has_pgm(i)){
-                    pgm(i - min_index_level) = PGMType(get_index_file_handler(i), inner_disk);
+                    pgm(i - min_index_level) = PGMType(get_index_file_handler(i), inner_disk, epsilon_value);
                 }
+                if (get_item_count(i) > 0) load_filter(i);
             }
             return;
         }
@@ -1108,11 +1191,13 @@ public:
         // update the metadata
         // todo: delete the data in level
         set_item_count(used_levels - 1, target.size());
+        filter(used_levels - 1).reset(target.size(), filter_bits_per_key);
+        for (auto &item : target) filter(used_levels - 1).insert(item.first);
 
         if (has_pgm(used_levels - 1)) {
             pgms = decltype(pgms)(used_levels - min_index_level);
             // flush the index into index file as needed
-            pgm(used_levels - 1) = PGMType(target.begin(), target.end(), inner_disk, get_index_file_handler(used_levels - 1));
+            pgm(used_levels - 1) = PGMType(target.begin(), target.end(), inner_disk, get_index_file_handler(used_levels - 1), epsilon_value);
         }
     }
 
@@ -1135,6 +1220,7 @@ public:
         // we can flush the metadata at last instead of each operation
         if (is_first_time) initial_metadata();
         else load_metadata();
+        init_filters();
         // if is_first_time is false, we suppose `first' and `last' are null, we
         // do not need them
         if (!is_first_time) {
@@ -1142,8 +1228,9 @@ public:
             pgms = decltype(pgms)(12);
             for (auto i  = min_level; i < 12; i++) {
                 if (get_item_count(i) > 0 && has_pgm(i)){
-                    pgm(i - min_index_level) = PGMType(get_index_file_handler(i), inner_disk);
+                    pgm(i - min_index_level) = PGMType(get_index_file_handler(i), inner_disk, epsilon_value);
                 }
+                if (get_item_count(i) > 0) load_filter(i);
             }
             return;
         }
@@ -1191,12 +1278,17 @@ public:
         // update the metadata
         // todo: delete the data in level
         set_item_count(used_levels - 1, target.size());
+        filter(used_levels - 1).reset(target.size(), filter_bits_per_key);
+        for (auto &item : target) filter(used_levels - 1).insert(item.first);
 
         if (has_pgm(used_levels - 1)) {
             pgms = decltype(pgms)(used_levels - min_index_level);
             // flush the index into index file as needed
-            pgm(used_levels - 1) = PGMType(target.begin(), target.end(), inner_disk, get_index_file_handler(used_levels - 1));
+            pgm(used_levels - 1) = PGMType(target.begin(), target.end(), inner_disk, get_index_file_handler(used_levels - 1), epsilon_value);
         }
+        // the models and the filters are kept in main memory, the rest of the budget holds the upper levels
+        if (mem_budget <= report_main_memory_size())
+            throw std::runtime_error("Need more memory budget!");
         metadata.memory_budget = mem_budget - report_main_memory_size();
         init_memory_buffer();
     }
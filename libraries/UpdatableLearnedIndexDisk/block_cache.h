@@ -0,0 +1,224 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Aligned buffers for the direct I/O of one or more blocks. A released buffer
+// is kept and handed out again to the next request of the same block count,
+// instead of allocating a buffer on every read or write.
+class AlignedBufferPool {
+ public:
+  explicit AlignedBufferPool(size_t block_bytes) : block_bytes_(block_bytes) {}
+
+  ~AlignedBufferPool() {
+    for (auto &list : free_) {
+      for (auto buf : list.second) {
+        free(buf);
+      }
+    }
+  }
+
+  AlignedBufferPool(const AlignedBufferPool &) = delete;
+  AlignedBufferPool &operator=(const AlignedBufferPool &) = delete;
+
+  // a buffer of at least bytes, rounded up to whole blocks
+  char *Acquire(size_t bytes) {
+    size_t blocks = GetBlockNum(bytes);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto &list = free_[blocks];
+    if (list.empty()) {
+      return reinterpret_cast<char *>(
+          aligned_alloc(block_bytes_, blocks * block_bytes_));
+    }
+    char *buf = list.back();
+    list.pop_back();
+    return buf;
+  }
+
+  void Release(char *buf, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_[GetBlockNum(bytes)].push_back(buf);
+  }
+
+ private:
+  inline size_t GetBlockNum(size_t bytes) const {
+    return std::max<size_t>(1, (bytes + block_bytes_ - 1) / block_bytes_);
+  }
+
+  size_t block_bytes_;
+  std::unordered_map<size_t, std::vector<char *>> free_;
+  std::mutex mutex_;
+};
+
+// A cache of on-disk blocks keyed by (fd, block id) with a fixed byte budget,
+// used by the storage manager of the disk B+-tree; the ALEX and FITing-tree
+// baselines read every block from disk. The blocks are evicted by CLOCK,
+// except for the pinned ones, e.g., the inner nodes, which stay until they
+// are invalidated. The writes go through to disk and refresh the cached
+// copies.
+class BlockCache {
+ public:
+  BlockCache(size_t capacity_bytes, size_t block_bytes)
+      : block_bytes_(block_bytes),
+        frame_num_(capacity_bytes / block_bytes),
+        frames_(frame_num_),
+        hand_(0),
+        pinned_num_(0),
+        hit_cnt_(0),
+        miss_cnt_(0),
+        evict_cnt_(0) {
+    data_ = reinterpret_cast<char *>(aligned_alloc(
+        block_bytes_, std::max<size_t>(1, frame_num_) * block_bytes_));
+    block_map_.reserve(frame_num_);
+  }
+
+  ~BlockCache() { free(data_); }
+
+  BlockCache(const BlockCache &) = delete;
+  BlockCache &operator=(const BlockCache &) = delete;
+
+  // copy the cached block to data, false if it is not cached
+  bool Read(int fd, int block_id, void *data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = block_map_.find(GetKey(fd, block_id));
+    if (it == block_map_.end()) {
+      miss_cnt_++;
+      return false;
+    }
+    hit_cnt_++;
+    frames_[it->second].ref = true;
+    memcpy(data, GetFrame(it->second), block_bytes_);
+    return true;
+  }
+
+  // cache a block read from disk, the block is not cached if every frame is
+  // pinned
+  void Insert(int fd, int block_id, const void *data, bool pinned) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = block_map_.find(GetKey(fd, block_id));
+    if (it != block_map_.end()) {
+      memcpy(GetFrame(it->second), data, block_bytes_);
+      SetPinned(it->second, pinned);
+      return;
+    }
+    if (pinned_num_ == frame_num_) {
+      return;
+    }
+    // CLOCK: clear the reference bits until an unpinned frame can be reused
+    while (frames_[hand_].valid &&
+           (frames_[hand_].pinned || frames_[hand_].ref)) {
+      frames_[hand_].ref = false;
+      hand_ = (hand_ + 1) % frame_num_;
+    }
+    if (frames_[hand_].valid) {
+      Evict(hand_);
+      evict_cnt_++;
+    }
+    frames_[hand_] = {fd, block_id, false, false, true};
+    SetPinned(hand_, pinned);
+    memcpy(GetFrame(hand_), data, block_bytes_);
+    block_map_[GetKey(fd, block_id)] = hand_;
+    hand_ = (hand_ + 1) % frame_num_;
+  }
+
+  // refresh the cached copy of a block that has been written back
+  void Write(int fd, int block_id, const void *data) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = block_map_.find(GetKey(fd, block_id));
+    if (it != block_map_.end()) {
+      memcpy(GetFrame(it->second), data, block_bytes_);
+    }
+  }
+
+  // drop the blocks [block_id, block_id + block_num) that are partially
+  // rewritten on disk
+  void Invalidate(int fd, int block_id, int block_num) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = block_id; i < block_id + block_num; i++) {
+      auto it = block_map_.find(GetKey(fd, i));
+      if (it != block_map_.end()) {
+        Evict(it->second);
+      }
+    }
+  }
+
+  // the largest capacity whose cache, with its metadata, fits in budget bytes
+  static size_t GetCapacityFor(size_t budget, size_t block_bytes) {
+    size_t frame_bytes = block_bytes + sizeof(Frame) + sizeof(uint64_t) +
+                         sizeof(size_t) + 2 * sizeof(void *);
+    return budget / frame_bytes * block_bytes;
+  }
+
+  inline size_t GetBlockBytes() const { return block_bytes_; }
+
+  inline size_t GetCapacity() const { return frame_num_ * block_bytes_; }
+
+  // the frames and the metadata of a full cache, allocated up front
+  inline size_t GetNodeSize() const {
+    return GetCapacity() + block_map_.bucket_count() * sizeof(void *) +
+           frame_num_ * (sizeof(Frame) + sizeof(uint64_t) + sizeof(size_t));
+  }
+
+  void PrintBlockCacheInfo() const {
+    uint64_t total = hit_cnt_ + miss_cnt_;
+    std::cout << "\t\tblock cache:" << GetCapacity() / 1024.0 / 1024.0
+              << " MiB,\tframes:" << frame_num_
+              << ",\tcached blocks:" << block_map_.size()
+              << ",\tpinned blocks:" << pinned_num_ << ",\thit cnt:" << hit_cnt_
+              << ",\tmiss cnt:" << miss_cnt_
+              << ",\thit ratio:" << (total ? hit_cnt_ * 1.0 / total : 0)
+              << ",\tevict cnt:" << evict_cnt_ << std::endl;
+  }
+
+ private:
+  struct Frame {
+    int fd = -1;
+    int block_id = 0;
+    bool ref = false;
+    bool pinned = false;
+    bool valid = false;
+  };
+
+  // the block ids are far below 2^40, the fds far below 2^24
+  static inline uint64_t GetKey(int fd, int block_id) {
+    return (static_cast<uint64_t>(fd) << 40) | static_cast<uint32_t>(block_id);
+  }
+
+  inline char *GetFrame(size_t frame_id) const {
+    return data_ + frame_id * block_bytes_;
+  }
+
+  inline void SetPinned(size_t frame_id, bool pinned) {
+    if (frames_[frame_id].pinned != pinned) {
+      pinned ? pinned_num_++ : pinned_num_--;
+      frames_[frame_id].pinned = pinned;
+    }
+  }
+
+  inline void Evict(size_t frame_id) {
+    block_map_.erase(GetKey(frames_[frame_id].fd, frames_[frame_id].block_id));
+    SetPinned(frame_id, false);
+    frames_[frame_id].valid = false;
+    frames_[frame_id].ref = false;
+  }
+
+  size_t block_bytes_;
+  size_t frame_num_;
+  char *data_;
+  std::vector<Frame> frames_;
+  std::unordered_map<uint64_t, size_t> block_map_;
+  size_t hand_;
+  size_t pinned_num_;
+  std::mutex mutex_;
+
+  uint64_t hit_cnt_;
+  uint64_t miss_cnt_;
+  uint64_t evict_cnt_;
+};
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "./key_type.h"
+#include "./last_mile_search.h"
+
+// Compare the last-mile search kernels over fetched pages of records: the
+// scalar binary search and linear scan, and their AVX2/AVX-512 versions that
+// are supported by this CPU. Each lookup searches a range of fetch_pages
+// pages that holds its key, as after the I/O of a lookup on disk.
+int main(int argc, char* argv[]) {
+  char* endptr;
+  if (argc < 2) {
+    std::cout << " Usage: " << argv[0] << std::endl
+              << "  1. page_bytes" << std::endl
+              << "  2. max_fetch_pages, the fetched pages are 1, 2, 4, ... up "
+                 "to it (default: 8)"
+              << std::endl
+              << "  3. lookup_num (default: 1000000)" << std::endl;
+    return -1;
+  }
+  const uint64_t kPageBytes = strtoul(argv[1], &endptr, 10);
+  const uint64_t kMaxFetchPages = argc >= 3 ? strtoul(argv[2], &endptr, 10) : 8;
+  const uint64_t kLookupNum =
+      argc >= 4 ? strtoul(argv[3], &endptr, 10) : 1000000;
+  const uint64_t kRecordPerPage = kPageBytes / sizeof(Record);
+  const uint64_t kGapCnt = sizeof(Record) / sizeof(Key);
+  // many ranges, so that the searched pages are not always in the L1 cache
+  const uint64_t kPageNum = std::max<uint64_t>(1024, kMaxFetchPages);
+
+  std::mt19937_64 gen(42);
+  std::vector<Key> keys(kPageNum * kRecordPerPage);
+  for (auto& k : keys) {
+    k = gen() >> 1;
+  }
+  std::sort(keys.begin(), keys.end());
+  std::vector<Record> data(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    data[i] = {keys[i], i};
+  }
+  const Key* pages = reinterpret_cast<const Key*>(data.data());
+
+  const SimdLevel kDetected = last_mile_simd_level;
+  std::cout << "page_bytes:" << kPageBytes << ",\trecords per page:"
+            << kRecordPerPage << ",\tdetected:" << GetSimdLevelName(kDetected)
+            << std::endl;
+  for (uint64_t fetch_pages = 1; fetch_pages <= kMaxFetchPages;
+       fetch_pages *= 2) {
+    uint64_t num = fetch_pages * kRecordPerPage;
+    std::vector<uint64_t> starts(kLookupNum), lookups(kLookupNum);
+    std::uniform_int_distribution<uint64_t> start_dist(0, kPageNum -
+                                                              fetch_pages);
+    std::uniform_int_distribution<uint64_t> pos_dist(0, num - 1);
+    for (uint64_t i = 0; i < kLookupNum; i++) {
+      starts[i] = start_dist(gen) * kRecordPerPage;
+      lookups[i] = keys[starts[i] + pos_dist(gen)];
+    }
+
+    // the average ns per lookup, the first round warms up the caches
+    auto run = [&](bool linear, uint64_t& sum) {
+      double ns = 0;
+      for (int round = 0; round < 2; round++) {
+        sum = 0;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (uint64_t i = 0; i < kLookupNum; i++) {
+          const Key* first = pages + starts[i] * kGapCnt;
+          sum += linear ? LinearLowerBound(first, num, kGapCnt, lookups[i])
+                        : BinaryLowerBound(first, num, kGapCnt, lookups[i]);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                 .count() *
+             1.0 / kLookupNum;
+      }
+      return ns;
+    };
+
+    for (int linear = 0; linear <= 1; linear++) {
+      // the linear scan of large ranges is too slow to be worth comparing
+      if (linear && fetch_pages > 2) {
+        continue;
+      }
+      uint64_t expected = 0;
+      for (int level = kScalar; level <= kDetected; level++) {
+        last_mile_simd_level = static_cast<SimdLevel>(level);
+        uint64_t sum = 0;
+        double ns = run(linear, sum);
+        if (level == kScalar) {
+          expected = sum;
+        } else if (sum != expected) {
+          std::cout << "wrong positions of "
+                    << GetSimdLevelName(last_mile_simd_level)
+                    << "!\tsum:" << sum << ",\texpected:" << expected
+                    << std::endl;
+        }
+        std::cout << "fetch pages:" << fetch_pages
+                  << ",\tsearch:" << (linear ? "linear" : "binary")
+                  << ",\tkernel:" << GetSimdLevelName(last_mile_simd_level)
+                  << ",\tns per lookup:" << ns
+                  << ",\tns per page:" << ns / fetch_pages << std::endl;
+      }
+    }
+  }
+  last_mile_simd_level = kDetected;
+  return 0;
+}
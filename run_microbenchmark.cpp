@@ -20,7 +20,7 @@
 
 int main(int argc, char* argv[]) {
   char* endptr;
-  if ((argc != 9 && argc != 14 && argc != 15) ||
+  if ((argc != 9 && argc != 14 && argc != 15 && argc != 16) ||
       strtoul(argv[1], &endptr, 10) > 1) {
     for (auto i = 0; i < argc; i++) {
       std::cout << i << ": " << argv[i] << std::endl;
@@ -47,7 +47,8 @@ int main(int argc, char* argv[]) {
            "worst case from the middle position, (a) mid, [mid+1, end), or (b) "
            "mid, [start, mid), \n\t3: one by one from the middle "
            "position, (a) "
-           "mid, mid+1, ... or (b) mid, mid-1, ...)>"
+           "mid, mid+1, ... or (b) mid, mid-1, ...)> [<dataset_name> "
+           "[<io_backend (0: pread, 1: io_uring)>]]"
         << std::endl;
     std::cout << "\tExample: ./build/LID 1 ./datasets/dataset 0 1 1000 "
                  "PGM-Index 64 1 ./datasets/data/ 1024 0 4 1 1"
@@ -72,6 +73,11 @@ int main(int argc, char* argv[]) {
   }
 
   Params<Key> params(argv, keys.size());
+  if (argc == 16) {
+    io_backend_ = static_cast<IOBackend>(strtoul(argv[15], &endptr, 10));
+    std::cout << "io backend:"
+              << (io_backend_ == kIOUring ? "io_uring" : "pread") << std::endl;
+  }
   // params.PrintParams();
   PrintCurrentTime();
   std::cout << "# of lookup keys:, " << kLookupNum << std::endl;
@@ -199,16 +205,18 @@ int main(int argc, char* argv[]) {
     }
     case kDIV4: {
       float lambda = strtof(argv[7], &endptr);
-      Evaluate<DI_V4<Key, Value>>(data, lookups, lookup_info, params,
-                                  {lambda, params.record_num_per_page_});
+      Evaluate<DI_V4<Key, Value>>(
+          data, lookups, lookup_info, params,
+          {lambda, params.record_num_per_page_, MODEL_KEY_SAMPLE_STRIDE});
       break;
     }
     case kLecoZonemap: {
       int total_pages = kIndexParams / params.record_num_per_page_;
-      if (argc == 15) {
+      if (argc >= 15) {
         std::string dataname = argv[14];
         auto p = GetLecoParams<LecoZonemap<Key, Value>>(
             total_pages, params.record_num_per_page_, dataname);
+        p.sample_stride_ = MODEL_KEY_SAMPLE_STRIDE;
         std::cout << "\n\nnow test leco on: block_num:" << p.block_num_
                   << std::endl;
         Evaluate<LecoZonemap<Key, Value>>(data, lookups, lookup_info, params,
@@ -226,7 +234,8 @@ int main(int argc, char* argv[]) {
           std::cout << "\n\nnow test leco on: block_num:" << b << std::endl;
           auto res = Evaluate<LecoZonemap<Key, Value>>(
               data, lookups, lookup_info, params,
-              {params.record_num_per_page_, total_pages, b});
+              {params.record_num_per_page_, total_pages, b,
+               MODEL_KEY_SAMPLE_STRIDE});
           if (res < min_size) {
             min_size = res;
             min_block = b;
@@ -239,7 +248,7 @@ int main(int argc, char* argv[]) {
     }
     case KLecoPage: {
       int total_pages = kIndexParams / params.record_num_per_page_;
-      if (argc == 15) {
+      if (argc >= 15) {
         std::string dataname = argv[14];
         auto p = GetLecoPageParams<LecoPage<Key, Value>>(
             total_pages, params.record_num_per_page_, dataname);
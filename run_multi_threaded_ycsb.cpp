@@ -6,6 +6,7 @@
 
 #include "./key_type.h"
 #include "./ycsb_utils/multi_threaded_benchmark.h"
+#include "indexes/baseline/alex-mt-disk.h"
 #include "indexes/baseline/btree-mt-disk.h"
 #include "indexes/multi_threaded_hybrid/dynamic/btree.h"
 #include "indexes/multi_threaded_hybrid/hybrid_index.h"
@@ -28,7 +29,16 @@ int main(int argc, char* argv[]) {
               << "  7. page_bytes" << std::endl
               << "  8. threads_number" << std::endl
               << "  9. memory_budget/ratio (only for hybrid learned indexes)\n"
-              << "  10. merging_threads_number" << std::endl;
+              << "  10. merging_threads_number" << std::endl
+              << "  11. io_backend (0: pread, 1: io_uring)" << std::endl
+              << "  12. merge_pool_threads, the background merge threads (0: "
+                 "merge in the request threads)"
+              << std::endl
+              << "  13. stripe_dirs, the comma-separated directories, e.g., "
+                 "on different devices, to stripe the data files over"
+              << std::endl
+              << "  14. stripe_pages, the pages of a stripe unit (default: 1)"
+              << std::endl;
     return -1;
   }
   const std::string kWorkloadPath = argv[1];
@@ -54,12 +64,13 @@ int main(int argc, char* argv[]) {
 
   std::cout << "The data in the static index is stored on disk." << std::endl;
 
-  enum IndexName { HYBRID_BTREE_DI, HYBRID_BTREE_LECO, BTREE };
+  enum IndexName { HYBRID_BTREE_DI, HYBRID_BTREE_LECO, BTREE, ALEX };
 
   std::map<std::string, int> index_name = {
       {"HYBRID_BTREE_DI", HYBRID_BTREE_DI},
       {"HYBRID_BTREE_LECO", HYBRID_BTREE_LECO},
-      {"BTREE", BTREE}};
+      {"BTREE", BTREE},
+      {"ALEX", ALEX}};
   typedef MultiThreadedBTreeIndex<Key, Value> Dy_BTree;
   typedef MultiThreadedStaticCprDI<Key, Value> Sta_DI;
   typedef MultiThreadedStaticLecoPage<Key, Value> Sta_Leco;
@@ -93,6 +104,26 @@ int main(int argc, char* argv[]) {
         << memory_budget << ",\tmerge thread num:" << kMergeThreadNum
         << std::endl;
   }
+  if (argc >= 12) {
+    io_backend_ = static_cast<IOBackend>(strtoul(argv[11], &endptr, 10));
+    std::cout << "io backend:"
+              << (io_backend_ == kIOUring ? "io_uring" : "pread") << std::endl;
+  }
+  uint64_t kMergePoolNum = 0;
+  if (argc >= 13) {
+    kMergePoolNum = strtoul(argv[12], &endptr, 10);
+    std::cout << "merge pool threads:" << kMergePoolNum << std::endl;
+  }
+  if (argc >= 14) {
+    std::stringstream dirs(argv[13]);
+    for (std::string dir; std::getline(dirs, dir, ',');) {
+      stripe_dirs_.push_back(dir);
+    }
+    uint64_t stripe_pages = argc >= 15 ? strtoul(argv[14], &endptr, 10) : 1;
+    stripe_bytes_ = stripe_pages * kPageBytes;
+    std::cout << "stripe over " << stripe_dirs_.size()
+              << " directories,\tstripe pages:" << stripe_pages << std::endl;
+  }
 
   leco_para = MultiThreadedStaticLecoPage<Key, Value>::param_t{
       kPageBytes / sizeof(Record),
@@ -112,14 +143,15 @@ int main(int argc, char* argv[]) {
            {kIndexParams2,
             kPageBytes / sizeof(Record),
             {kFilepath, kPageBytes, kThreadNum, kMergeThreadNum}},
-           memory_budget});
+           memory_budget,
+           kMergePoolNum});
       break;
     }
     case HYBRID_BTREE_LECO: {
       RunMultiYCSBBenchmark<
           MultiThreadedHybridIndex<Key, Value, Dy_BTree, Sta_Leco>>(
           init_data, ops, ops_key, len, kThreadNum,
-          {{}, leco_para, memory_budget});
+          {{}, leco_para, memory_budget, kMergePoolNum});
       break;
     }
     case BTREE: {
@@ -127,6 +159,11 @@ int main(int argc, char* argv[]) {
           init_data, ops, ops_key, len, kThreadNum, {kFilepath});
       break;
     }
+    case ALEX: {
+      RunMultiYCSBBenchmark<BaselineAlexMTDisk<Key, Value>>(
+          init_data, ops, ops_key, len, kThreadNum, {kFilepath, kThreadNum});
+      break;
+    }
     default:
       throw std::runtime_error("The index is invalid!");
   }
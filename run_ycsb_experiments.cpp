@@ -9,6 +9,7 @@
 #include "indexes/baseline/btree-disk.h"
 #include "indexes/baseline/film.h"
 #include "indexes/baseline/pgm-disk-origin.h"
+#include "indexes/baseline/pgm-disk.h"
 #include "indexes/hybrid/dynamic/alex.h"
 #include "indexes/hybrid/dynamic/btree.h"
 #include "indexes/hybrid/dynamic/pgm.h"
@@ -32,8 +33,37 @@ int main(int argc, char* argv[]) {
               << "  5. index_params_2" << std::endl
               << "  6. stored_path (on-disk mode)" << std::endl
               << "  7. page_bytes (on-disk mode)" << std::endl
-              << "  8. memory_budget (only for hybrid learned indexes)"
-              << "  9. buffer_ratio (only for hybrid learned indexes)"
+              << "  8. memory_budget (for hybrid learned indexes and the "
+                 "disk B+-tree, whose block cache gets the rest of it)"
+              << std::endl
+              << "  9. buffer_ratio, the fraction of memory_budget used to "
+                 "cache the on-disk pages (only for hybrid learned indexes)"
+              << std::endl
+              << "  10. background_merge (only for hybrid learned indexes)"
+              << std::endl
+              << "  11. partition_pages (only for hybrid learned indexes)"
+              << std::endl
+              << "  12. io_backend (0: pread, 1: io_uring)" << std::endl
+              << "  13. auto_tune, choose the static model and buffer_ratio "
+                 "for the workload (only for hybrid learned indexes)"
+              << std::endl
+              << "  14. persist, store the static models next to stored_path "
+                 "and restart from them (only for hybrid learned indexes)"
+              << std::endl
+              << "  15. compress, store the on-disk records as compressed "
+                 "blocks (only for hybrid learned indexes)"
+              << std::endl
+              << "  16. build_threads, train the partitions of the static "
+                 "index in parallel while streaming the records into it "
+                 "(only for hybrid learned indexes, default: 1)"
+              << std::endl
+              << "  17. stripe_dirs, the comma-separated directories, e.g., "
+                 "on different devices, to stripe the data files over"
+              << std::endl
+              << "  18. stripe_pages, the pages of a stripe unit (default: 1)"
+              << std::endl
+              << "  19. lookup_batch, the consecutive reads looked up as one "
+                 "batch, whose on-disk pages are read together (default: 1)"
               << std::endl;
     return -1;
   }
@@ -47,6 +77,12 @@ int main(int argc, char* argv[]) {
   const uint64_t kPageBytes = strtoul(argv[7], &endptr, 10);
   read_buf_ = reinterpret_cast<Key*>(
       aligned_alloc(kPageBytes, kPageBytes * ALLOCATED_BUF_SIZE));
+  if (argc >= 13) {
+    io_backend_ = static_cast<IOBackend>(strtoul(argv[12], &endptr, 10));
+    std::cout << "io backend:"
+              << (io_backend_ == kIOUring ? "io_uring" : "pread") << std::endl;
+    RegisterIOBuffer(read_buf_, kPageBytes * ALLOCATED_BUF_SIZE);
+  }
 
   // has been sorted during prepare stage
   std::cout << "\n\n--------------- LOADING ----------------" << std::endl;
@@ -107,6 +143,40 @@ int main(int argc, char* argv[]) {
   typedef StaticPGMIndex<Key, Value> Sta_PGM;
   typedef StaticCprDI<Key, Value> Sta_DI;
   typedef StaticLecoPage<Key, Value> Sta_Leco;
+  uint64_t kPartitionPages = 0;
+  if (argc >= 12) {
+    kPartitionPages = strtoul(argv[11], &endptr, 10);
+    std::cout << "partition pages:" << kPartitionPages << std::endl;
+  }
+  bool kPersist = false;
+  if (argc >= 15) {
+    kPersist = strtoul(argv[14], &endptr, 10);
+    std::cout << "persist:" << kPersist << std::endl;
+  }
+  bool kCompress = false;
+  if (argc >= 16) {
+    kCompress = strtoul(argv[15], &endptr, 10);
+    std::cout << "compress:" << kCompress << std::endl;
+  }
+  uint64_t kBuildThreads = 1;
+  if (argc >= 17) {
+    kBuildThreads = strtoul(argv[16], &endptr, 10);
+    std::cout << "build threads:" << kBuildThreads << std::endl;
+  }
+  if (argc >= 18) {
+    std::stringstream dirs(argv[17]);
+    for (std::string dir; std::getline(dirs, dir, ',');) {
+      stripe_dirs_.push_back(dir);
+    }
+    uint64_t stripe_pages = argc >= 19 ? strtoul(argv[18], &endptr, 10) : 1;
+    stripe_bytes_ = stripe_pages * kPageBytes;
+    std::cout << "stripe over " << stripe_dirs_.size()
+              << " directories,\tstripe pages:" << stripe_pages << std::endl;
+  }
+  if (argc >= 20) {
+    lookup_batch_ = std::max<size_t>(1, strtoul(argv[19], &endptr, 10));
+    std::cout << "lookup batch:" << lookup_batch_ << std::endl;
+  }
   StaticLecoPage<Key, Value>::param_t leco_para;
   uint64_t fix = kIndexParams2, slide = 0;
   switch (static_cast<int>(kIndexParams2)) {
@@ -128,7 +198,12 @@ int main(int argc, char* argv[]) {
       break;
   }
   leco_para = StaticLecoPage<Key, Value>::param_t{
-      kPageBytes / sizeof(Record), fix, slide, 1000, {kFilepath, kPageBytes}};
+      kPageBytes / sizeof(Record),
+      fix,
+      slide,
+      1000,
+      {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+       kBuildThreads}};
 
   size_t memory_budget = 100;
   if (argc >= 9) {
@@ -136,106 +211,154 @@ int main(int argc, char* argv[]) {
     std::cout << "the memory budget is:" << memory_budget << " bytes, "
               << PRINT_MIB(memory_budget) << " MiB" << std::endl;
   }
+  double kBufferRatio = 0;
+  if (argc >= 10) {
+    kBufferRatio = strtof(argv[9], &endptr);
+    std::cout << "buffer pool ratio:" << kBufferRatio << std::endl;
+  }
+  bool kBackgroundMerge = false;
+  if (argc >= 11) {
+    kBackgroundMerge = strtoul(argv[10], &endptr, 10);
+    std::cout << "background merge:" << kBackgroundMerge << std::endl;
+  }
+  bool kAutoTune = false;
+  if (argc >= 14) {
+    kAutoTune = strtoul(argv[13], &endptr, 10);
+    std::cout << "auto tune:" << kAutoTune << std::endl;
+  }
   PrintCurrentTime();
 
   switch (index_name[kIndexName]) {
     case HYBRID_ALEX_RS: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_ALEX, Sta_RS>>(
+      RunHybridBenchmark<Dy_ALEX, Sta_RS>(
           init_data, ops, ops_key, len,
           {{},
-           {12, static_cast<uint64_t>(kIndexParams2), {kFilepath, kPageBytes}},
-           memory_budget});
+           {12,
+            static_cast<uint64_t>(kIndexParams2),
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_BTREE_RS: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_BTree, Sta_RS>>(
+      RunHybridBenchmark<Dy_BTree, Sta_RS>(
           init_data, ops, ops_key, len,
           {{},
-           {12, static_cast<uint64_t>(kIndexParams2), {kFilepath, kPageBytes}},
-           memory_budget});
+           {12,
+            static_cast<uint64_t>(kIndexParams2),
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_PGM_RS: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_PGM, Sta_RS>>(
+      RunHybridBenchmark<Dy_PGM, Sta_RS>(
           init_data, ops, ops_key, len,
           {{},
-           {12, static_cast<uint64_t>(kIndexParams2), {kFilepath, kPageBytes}},
-           memory_budget});
+           {12,
+            static_cast<uint64_t>(kIndexParams2),
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_ALEX_PGM: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_ALEX, Sta_PGM>>(
+      RunHybridBenchmark<Dy_ALEX, Sta_PGM>(
           init_data, ops, ops_key, len,
           {{},
-           {static_cast<uint64_t>(kIndexParams2), {kFilepath, kPageBytes}},
-           memory_budget});
+           {static_cast<uint64_t>(kIndexParams2),
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_BTREE_PGM: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_BTree, Sta_PGM>>(
+      RunHybridBenchmark<Dy_BTree, Sta_PGM>(
           init_data, ops, ops_key, len,
           {{},
-           {static_cast<uint64_t>(kIndexParams2), {kFilepath, kPageBytes}},
-           memory_budget});
+           {static_cast<uint64_t>(kIndexParams2),
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_PGM_PGM: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_PGM, Sta_PGM>>(
+      RunHybridBenchmark<Dy_PGM, Sta_PGM>(
           init_data, ops, ops_key, len,
           {{},
-           {static_cast<uint64_t>(kIndexParams2), {kFilepath, kPageBytes}},
-           memory_budget});
+           {static_cast<uint64_t>(kIndexParams2),
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_ALEX_DI: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_ALEX, Sta_DI>>(
+      RunHybridBenchmark<Dy_ALEX, Sta_DI>(
           init_data, ops, ops_key, len,
           {{},
            {kIndexParams2,
             kPageBytes / sizeof(Record),
-            {kFilepath, kPageBytes}},
-           memory_budget});
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_BTREE_DI: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_BTree, Sta_DI>>(
+      RunHybridBenchmark<Dy_BTree, Sta_DI>(
           init_data, ops, ops_key, len,
           {{},
            {kIndexParams2,
             kPageBytes / sizeof(Record),
-            {kFilepath, kPageBytes}},
-           memory_budget});
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_PGM_DI: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_PGM, Sta_DI>>(
+      RunHybridBenchmark<Dy_PGM, Sta_DI>(
           init_data, ops, ops_key, len,
           {{},
            {kIndexParams2,
             kPageBytes / sizeof(Record),
-            {kFilepath, kPageBytes}},
-           memory_budget});
+            {kFilepath, kPageBytes, kPartitionPages, kPersist, kCompress,
+             kBuildThreads}},
+           memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_ALEX_LECO: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_ALEX, Sta_Leco>>(
-          init_data, ops, ops_key, len, {{}, leco_para, memory_budget});
+      RunHybridBenchmark<Dy_ALEX, Sta_Leco>(
+          init_data, ops, ops_key, len,
+          {{}, leco_para, memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_BTREE_LECO: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_BTree, Sta_Leco>>(
-          init_data, ops, ops_key, len, {{}, leco_para, memory_budget});
+      RunHybridBenchmark<Dy_BTree, Sta_Leco>(
+          init_data, ops, ops_key, len,
+          {{}, leco_para, memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case HYBRID_PGM_LECO: {
-      RunYCSBBenchmark<HybridIndex<Key, Value, Dy_PGM, Sta_Leco>>(
-          init_data, ops, ops_key, len, {{}, leco_para, memory_budget});
+      RunHybridBenchmark<Dy_PGM, Sta_Leco>(
+          init_data, ops, ops_key, len,
+          {{}, leco_para, memory_budget, kBackgroundMerge, kBufferRatio},
+          kAutoTune);
       break;
     }
     case BTREE: {
       RunYCSBBenchmark<BaselineBTreeDisk<Key, Value>>(
           init_data, ops, ops_key, len,
-          {static_cast<size_t>(kIndexParams1), kFilepath});
+          {static_cast<size_t>(kIndexParams1), kFilepath, memory_budget});
       break;
     }
     case FILM: {
@@ -251,6 +374,12 @@ int main(int argc, char* argv[]) {
           {static_cast<size_t>(kIndexParams1), kFilepath});
       break;
     }
+    case PGM: {
+      RunYCSBBenchmark<BaselinePGMDisk<Key, Value>>(
+          init_data, ops, ops_key, len,
+          {kFilepath, memory_budget, static_cast<size_t>(kIndexParams1)});
+      break;
+    }
     default:
       throw std::runtime_error("The index is invalid!");
   }
@@ -0,0 +1,134 @@
+// The block cache evicts by CLOCK: a block read since the hand last passed
+// it gets a second chance, a pinned block is never evicted until it is
+// invalidated or unpinned, and a block is not cached at all once every frame
+// is pinned. The disk B+-tree must return the same results through a cache
+// far smaller than its file.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../ycsb_utils/macro.h"
+#include "../indexes/baseline/btree-disk.h"
+#include "../libraries/UpdatableLearnedIndexDisk/block_cache.h"
+
+static const size_t kBlockBytes = 4096;
+static const int kFd = 3;
+
+static std::vector<char> BlockData(int block_id) {
+  return std::vector<char>(kBlockBytes, static_cast<char>(block_id));
+}
+
+static bool Cached(BlockCache& cache, int block_id) {
+  std::vector<char> data(kBlockBytes);
+  return cache.Read(kFd, block_id, data.data()) && data == BlockData(block_id);
+}
+
+static size_t RunCache() {
+  size_t wrong = 0;
+  auto expect = [&](bool cond, const char* what) {
+    if (!cond) {
+      std::cout << "wrong: " << what << std::endl;
+      wrong++;
+    }
+  };
+  BlockCache cache(4 * kBlockBytes, kBlockBytes);
+  for (int i = 0; i < 4; i++) {
+    cache.Insert(kFd, i, BlockData(i).data(), false);
+  }
+  // the hand is back at block 0, which is referenced by the read
+  expect(Cached(cache, 0), "read a cached block");
+  cache.Insert(kFd, 4, BlockData(4).data(), false);
+  expect(Cached(cache, 0) && !Cached(cache, 1) && Cached(cache, 4),
+         "evict the first unreferenced block");
+
+  cache.Insert(kFd, 10, BlockData(10).data(), true);
+  for (int i = 20; i < 40; i++) {
+    cache.Insert(kFd, i, BlockData(i).data(), false);
+  }
+  expect(Cached(cache, 10), "keep a pinned block");
+
+  // the write refreshes a cached block and does not cache a new one
+  std::vector<char> data = BlockData(11);
+  cache.Write(kFd, 10, data.data());
+  cache.Write(kFd, 50, data.data());
+  std::vector<char> out(kBlockBytes);
+  expect(cache.Read(kFd, 10, out.data()) && out == data, "refresh a block");
+  expect(!Cached(cache, 50), "write an uncached block");
+  cache.Write(kFd, 10, BlockData(10).data());
+
+  for (int i = 11; i < 14; i++) {
+    cache.Insert(kFd, i, BlockData(i).data(), true);
+  }
+  cache.Insert(kFd, 60, BlockData(60).data(), false);
+  expect(!Cached(cache, 60), "cache a block with every frame pinned");
+  for (int i = 10; i < 14; i++) {
+    expect(Cached(cache, i), "keep the pinned blocks");
+  }
+
+  // an invalidated or unpinned block frees its frame
+  cache.Invalidate(kFd, 10, 1);
+  expect(!Cached(cache, 10), "invalidate a pinned block");
+  cache.Insert(kFd, 11, BlockData(11).data(), false);
+  cache.Insert(kFd, 61, BlockData(61).data(), false);
+  cache.Insert(kFd, 62, BlockData(62).data(), false);
+  expect(Cached(cache, 61) && Cached(cache, 62) && !Cached(cache, 11) &&
+             Cached(cache, 12) && Cached(cache, 13),
+         "evict an unpinned block");
+
+  BlockCache empty(0, kBlockBytes);
+  empty.Insert(kFd, 0, BlockData(0).data(), false);
+  expect(!Cached(empty, 0), "cache without frames");
+
+  AlignedBufferPool pool(kBlockBytes);
+  char* buf = pool.Acquire(kBlockBytes + 1);
+  expect(reinterpret_cast<uintptr_t>(buf) % kBlockBytes == 0,
+         "align a buffer");
+  pool.Release(buf, kBlockBytes + 1);
+  expect(pool.Acquire(2 * kBlockBytes) == buf, "reuse a released buffer");
+  pool.Release(buf, 2 * kBlockBytes);
+  return wrong;
+}
+
+static size_t RunBTree(const std::string& filename) {
+  const size_t kDataNum = 50000;
+  DataVec data;
+  for (size_t i = 0; i < kDataNum; i++) {
+    data.push_back({(i + 1) * 10, i});
+  }
+  // the leaves are on disk and a cache of 64 blocks has to evict them
+  BaselineBTreeDisk<Key, Value> index({0, filename, 64 * (kBlockBytes + 64)});
+  index.Build(data);
+  size_t wrong = 0;
+  for (size_t i = 0; i < kDataNum; i += 10) {
+    if (!index.Update(data[i].first, i + 1)) {
+      wrong++;
+    }
+    data[i].second = i + 1;
+  }
+  for (size_t i = 0; i < 1000; i++) {
+    index.Insert((i + 1) * 10 + 5, i);
+  }
+  for (auto& r : data) {
+    if (index.Find(r.first) != r.second) {
+      wrong++;
+    }
+  }
+  for (size_t i = 0; i < 1000; i++) {
+    if (index.Find((i + 1) * 10 + 5) != i) {
+      wrong++;
+    }
+  }
+  index.PrintEachPartSize();
+  return wrong;
+}
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  size_t cache = RunCache();
+  size_t btree = RunBTree(dir + "/block_cache_test_btree");
+  std::cout << "wrong cache:" << cache << ",\twrong btree:" << btree
+            << std::endl;
+  return cache + btree == 0 ? 0 : 1;
+}
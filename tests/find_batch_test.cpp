@@ -0,0 +1,119 @@
+// A batch of lookups must answer every key as Find does, whatever the order
+// of the keys, the duplicates and the absent keys in it, and wherever the
+// key lives: in the dynamic index, in the buffer pool, in a page of the
+// static index, or deleted by a tombstone that has been merged.
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../indexes/hybrid/dynamic/btree.h"
+#include "../indexes/hybrid/hybrid_index.h"
+#include "../indexes/hybrid/static/cpr_di.h"
+#include "../indexes/hybrid/static/rs.h"
+
+typedef HybridIndex<Key, Value, BTreeIndex<Key, Value>, RSIndex<Key, Value>>
+    HybridRS;
+typedef HybridIndex<Key, Value, BTreeIndex<Key, Value>,
+                    StaticCprDI<Key, Value>>
+    HybridDI;
+
+static const uint64_t kPageBytes = 4096;
+static const size_t kDataNum = 100000;
+
+template <typename IndexType>
+static size_t RunCase(const std::string& name,
+                      typename IndexType::param_t params) {
+  DataVec data;
+  for (size_t i = 0; i < kDataNum; i++) {
+    data.push_back({(i + 1) * 10, i + 1});
+  }
+  IndexType index(params);
+  index.Build(data);
+  // merge tombstones and inserts into the static index, then keep some
+  // deletes, updates and inserts in the dynamic index
+  for (size_t i = 0; i < kDataNum; i += 7) {
+    index.Delete(data[i].first);
+  }
+  size_t merge_cnt = index.GetMergeInsertCnt();
+  Key next = 5;
+  for (; index.GetMergeInsertCnt() == merge_cnt; next += 10) {
+    index.Insert(next, next);
+  }
+  for (size_t i = 3; i < kDataNum; i += 11) {
+    index.Update(data[i].first, 1);
+  }
+  for (size_t i = 5; i < kDataNum; i += 13) {
+    index.Delete(data[i].first);
+  }
+
+  std::mt19937_64 gen(7);
+  std::uniform_int_distribution<Key> dist(0, (kDataNum + 1) * 10);
+  std::vector<size_t> batch_sizes = {1, 2, 16, 64, 512};
+  size_t wrong = 0, checked = 0;
+  for (size_t round = 0; round < 200; round++) {
+    size_t n = batch_sizes[round % batch_sizes.size()];
+    KeyVec keys(n);
+    for (auto& key : keys) {
+      key = dist(gen);
+      // most keys are present, the others fall between them
+      if (gen() % 4 != 0) {
+        key -= key % 5;
+      }
+    }
+    if (round % 3 == 0) {
+      std::sort(keys.begin(), keys.end());
+    }
+    if (n > 1) {
+      keys[n - 1] = keys[0];
+    }
+    std::vector<Value> vals;
+    index.FindBatch(keys, vals);
+    if (vals.size() != n) {
+      wrong++;
+      continue;
+    }
+    for (size_t i = 0; i < n; i++) {
+      if (vals[i] != index.Find(keys[i])) {
+        wrong++;
+      }
+    }
+    checked += n;
+  }
+  std::cout << name << ":\tchecked:" << checked << ",\twrong:" << wrong
+            << std::endl;
+  return wrong;
+}
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  read_buf_ = reinterpret_cast<Key*>(
+      aligned_alloc(kPageBytes, kPageBytes * ALLOCATED_BUF_SIZE));
+  const size_t kBudget = 1 << 20;
+  size_t wrong = 0;
+  wrong += RunCase<HybridRS>(
+      "rs", {{}, {12, 16, {dir + "/batch_test_rs", kPageBytes, 4}}, kBudget});
+  // the buffer pool caches a part of the pages
+  wrong += RunCase<HybridRS>(
+      "rs+buffer pool",
+      {{},
+       {12, 16, {dir + "/batch_test_rs_bp", kPageBytes, 4}},
+       3 * kBudget,
+       false,
+       0.6});
+  wrong += RunCase<HybridRS>(
+      "rs+compress",
+      {{},
+       {12, 16, {dir + "/batch_test_rs_cpr", kPageBytes, 4, false, true}},
+       kBudget});
+  wrong += RunCase<HybridDI>(
+      "di",
+      {{},
+       {16, kPageBytes / sizeof(Record), {dir + "/batch_test_di", kPageBytes}},
+       kBudget});
+  free(read_buf_);
+  return wrong == 0 ? 0 : 1;
+}
@@ -0,0 +1,72 @@
+// Deleting every key of a partition leaves the last tombstone in the static
+// file, see DropTombstones. An update of a deleted key must neither rewrite
+// that tombstone in place nor buffer the key in the dynamic index.
+
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../indexes/hybrid/dynamic/btree.h"
+#include "../indexes/hybrid/hybrid_index.h"
+#include "../indexes/hybrid/static/rs.h"
+
+typedef HybridIndex<Key, Value, BTreeIndex<Key, Value>, RSIndex<Key, Value>>
+    HybridRS;
+
+static bool RunCase(const std::string& filename, bool compress) {
+  const uint64_t kPageBytes = 4096;
+  const uint64_t kPartitionPages = 4;
+  const size_t kDataNum = 100000;
+  DataVec data;
+  for (size_t i = 0; i < kDataNum; i++) {
+    data.push_back({(i + 1) * 10, i});
+  }
+  // the in-place update is used unless the partitions are compressed
+  HybridRS::param_t params{
+      {},
+      {12, 16, {filename, kPageBytes, kPartitionPages, false, compress}},
+      1 << 20};
+  HybridRS index(params);
+  index.Build(data);
+
+  // the deleted range spans several partitions, so at least one of them
+  // loses all its records
+  size_t first = kDataNum / 2;
+  size_t last = first + kPartitionPages * kPageBytes / sizeof(Record) * 3;
+  for (size_t i = first; i < last; i++) {
+    index.Delete(data[i].first);
+  }
+  // merge the tombstones into the static index
+  size_t merge_cnt = index.GetMergeInsertCnt();
+  for (Key key = 5; index.GetMergeInsertCnt() == merge_cnt; key += 10) {
+    index.Insert(key, 1);
+  }
+
+  size_t wrong = 0;
+  for (size_t i = first; i < last; i++) {
+    if (index.Update(data[i].first, 1) ||
+        index.Find(data[i].first) != std::numeric_limits<Value>::max()) {
+      wrong++;
+    }
+  }
+  for (size_t i = last; i < last + 100; i++) {
+    if (!index.Update(data[i].first, 1) || index.Find(data[i].first) != 1) {
+      wrong++;
+    }
+  }
+  std::cout << "compress:" << compress << ",\twrong updates:" << wrong
+            << std::endl;
+  return wrong == 0;
+}
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  read_buf_ = reinterpret_cast<Key*>(
+      aligned_alloc(4096, 4096ULL * ALLOCATED_BUF_SIZE));
+  bool ok = RunCase(dir + "/tombstone_test_data", false);
+  ok = RunCase(dir + "/tombstone_test_compressed_data", true) && ok;
+  free(read_buf_);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,138 @@
+// Several threads insert into the same few data nodes of the thread-safe disk
+// ALEX while the others look up and scan the bulk-loaded keys. The sparse half
+// of the loaded keys leaves data nodes that span several slots, so the inserts
+// split them sideways first and downwards later. A reader that meets a split
+// data node restarts, hence no lookup may miss a key, no scan may skip one and
+// no insert may be lost. The split data nodes are freed once no reader can
+// hold them anymore.
+
+#include <omp.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../libraries/UpdatableLearnedIndexDisk/ALEX/mt_alex.h"
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  const int kThreadNum = 4;
+  const size_t kDenseNum = 20000;
+  const size_t kSparseNum = 200;
+  const Key kSparseStep = 100000;
+  const size_t kInsertNum = 40000;
+  const size_t kScanLen = 500;
+  // the dense keys first, then the sparse ones far apart
+  DataVec data;
+  for (size_t i = 0; i < kDenseNum; i++) {
+    data.push_back({(i + 1) * 10, i + 1});
+  }
+  const Key kSparseBase = (kDenseNum + 1) * 10;
+  for (size_t i = 0; i < kSparseNum; i++) {
+    data.push_back({kSparseBase + i * kSparseStep, kDenseNum + i + 1});
+  }
+  // the inserts fill the gaps of the first sparse keys
+  auto InsertKey = [&](size_t i) { return kSparseBase + 1 + i * 7; };
+
+  ThreadSafeAlexDisk<Key, Value> alex(dir + "/alex_split_test_data",
+                                      kThreadNum);
+  alex.bulk_load(data.data(), data.size());
+
+  // the loaded keys of a scan must all be there, in order
+  auto CheckScan = [&](const std::vector<Record>& res, size_t cnt) {
+    size_t wrong = 0;
+    for (size_t i = 1; i < cnt; i++) {
+      if (res[i - 1].first >= res[i].first) {
+        wrong++;
+      }
+    }
+    if (cnt == 0) {
+      return wrong;
+    }
+    auto first = std::lower_bound(
+        data.begin(), data.end(), res[0].first,
+        [](const Record& lhs, const Key& key) { return lhs.first < key; });
+    auto last = std::upper_bound(
+        data.begin(), data.end(), res[cnt - 1].first,
+        [](const Key& key, const Record& rhs) { return key < rhs.first; });
+    size_t loaded = 0;
+    for (size_t i = 0; i < cnt; i++) {
+      loaded += std::binary_search(
+          first, last, res[i],
+          [](const Record& lhs, const Record& rhs) {
+            return lhs.first < rhs.first;
+          });
+    }
+    return wrong + (loaded == static_cast<size_t>(last - first) ? 0 : 1);
+  };
+
+  std::vector<size_t> failed(kThreadNum, 0);
+#pragma omp parallel num_threads(kThreadNum)
+  {
+    int t = omp_get_thread_num();
+    if (t < kThreadNum / 2) {
+      for (size_t i = t; i < kInsertNum; i += kThreadNum / 2) {
+        alex.insert(InsertKey(i), i + 1, t);
+      }
+    } else {
+      std::vector<Record> res(kScanLen);
+      for (size_t r = 0; r < 4; r++) {
+        for (size_t i = t; i < data.size(); i += kThreadNum / 2) {
+          if (alex.lookup(data[i].first, t) != data[i].second) {
+            failed[t]++;
+          }
+          if (i % 256 < kThreadNum) {
+            size_t cnt = alex.scan(data[i].first, kScanLen, res.data(), t);
+            failed[t] += CheckScan(res, cnt);
+          }
+        }
+      }
+    }
+  }
+
+  size_t wrong = 0;
+  for (int t = 0; t < kThreadNum; t++) {
+    wrong += failed[t];
+  }
+  for (auto& r : data) {
+    if (alex.lookup(r.first, 0) != r.second) {
+      wrong++;
+    }
+  }
+  for (size_t i = 0; i < kInsertNum; i++) {
+    if (alex.lookup(InsertKey(i), 0) != i + 1) {
+      wrong++;
+    }
+  }
+  // a full scan from below the first key returns every record
+  DataVec expected = data;
+  for (size_t i = 0; i < kInsertNum; i++) {
+    expected.push_back({InsertKey(i), i + 1});
+  }
+  std::sort(expected.begin(), expected.end());
+  std::vector<Record> res(expected.size() + 1);
+  size_t cnt = alex.scan(0, res.size(), res.data(), 0);
+  if (cnt != expected.size() ||
+      !std::equal(expected.begin(), expected.end(), res.begin())) {
+    std::cout << "full scan: " << cnt << " of " << expected.size()
+              << " records" << std::endl;
+    wrong++;
+  }
+  // a scan from an absent key starts at its lower bound
+  cnt = alex.scan(InsertKey(100) + 1, 3, res.data(), 0);
+  if (cnt != 3 || res[0].first != InsertKey(101)) {
+    wrong++;
+  }
+
+  size_t sideways = alex.get_sideways_split_cnt();
+  size_t downward = alex.get_downward_split_cnt();
+  size_t unreclaimed = alex.get_unreclaimed_cnt();
+  alex.print_stats();
+  std::cout << "wrong:" << wrong << std::endl;
+  return wrong == 0 && sideways > 0 && downward > 0 &&
+                 unreclaimed < sideways + downward
+             ? 0
+             : 1;
+}
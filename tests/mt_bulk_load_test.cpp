@@ -0,0 +1,89 @@
+// The multi-threaded disk B+-tree bulk-loads its leaves in parallel batches
+// and its inner levels in parallel bottom-up. A low fill builds many batches
+// and several fan levels from a small dataset, and a full fill leaves every
+// leaf full, so that the inserts after the load split them. Every key must be
+// found, also by threads looking up while the others insert.
+
+#include <omp.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../libraries/UpdatableLearnedIndexDisk/B+Tree/mt_b_tree.h"
+
+static const int kThreadNum = 4;
+
+static size_t Run(const std::string& filename, const DataVec& data,
+                  double fill, size_t min_height) {
+  ThreadSafeBTreeDisk<Key, Value> btree(filename);
+  btree.bulk_load(data.data(), data.size(), fill);
+  size_t wrong = 0;
+  if (btree.get_height() < min_height) {
+    std::cout << "fill " << fill << ": height " << btree.get_height()
+              << " < " << min_height << std::endl;
+    wrong++;
+  }
+  try {
+    btree.bulk_load(data.data(), data.size(), fill);
+    wrong++;
+  } catch (std::runtime_error&) {
+  }
+
+  // the keys between the loaded ones are absent until the inserts
+  std::vector<size_t> failed(kThreadNum, 0);
+#pragma omp parallel num_threads(kThreadNum)
+  {
+    int t = omp_get_thread_num();
+    for (size_t i = t; i < data.size(); i += kThreadNum) {
+      if (btree.lookup(data[i].first) != data[i].second) {
+        failed[t]++;
+      }
+      if (btree.lookup(data[i].first + 5) != 0) {
+        failed[t]++;
+      }
+    }
+#pragma omp barrier
+    if (t < kThreadNum / 2) {
+      for (size_t i = t; i < data.size(); i += 16) {
+        btree.insert(data[i].first + 5, i + 1);
+      }
+    } else {
+      for (size_t i = t; i < data.size(); i += kThreadNum / 2) {
+        if (btree.lookup(data[i].first) != data[i].second) {
+          failed[t]++;
+        }
+      }
+    }
+  }
+  for (int t = 0; t < kThreadNum; t++) {
+    wrong += failed[t];
+  }
+  for (size_t i = 0; i < data.size(); i++) {
+    Value inserted = i % 16 < kThreadNum / 2 ? i + 1 : 0;
+    if (btree.lookup(data[i].first) != data[i].second ||
+        btree.lookup(data[i].first + 5) != inserted) {
+      wrong++;
+    }
+  }
+  btree.is_valid();
+  std::cout << "fill " << fill << ": height " << btree.get_height()
+            << ",\twrong:" << wrong << std::endl;
+  return wrong;
+}
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  const size_t kDataNum = 200000;
+  DataVec data;
+  for (size_t i = 0; i < kDataNum; i++) {
+    data.push_back({(i + 1) * 10, i + 1});
+  }
+  size_t wrong = 0;
+  // 12 entries per node: 16667 leaves in 66 batches, and 3 fan levels
+  wrong += Run(dir + "/bulk_load_test_sparse", data, 0.05, 5);
+  wrong += Run(dir + "/bulk_load_test_full", data, 1.0, 3);
+  return wrong == 0 ? 0 : 1;
+}
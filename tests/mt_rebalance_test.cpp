@@ -0,0 +1,115 @@
+// Key-ordered inserts all land in the last partition of the multi-threaded
+// static index. The merge must move the partition boundaries so that every
+// partition holds about the same number of records, keep a stored key
+// together with its newer record, and leave the unchanged partitions of a
+// later merge readable.
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../indexes/multi_threaded_hybrid/static/cpr_di.h"
+
+typedef MultiThreadedStaticCprDI<Key, Value> StaticDI;
+
+static const uint64_t kPageBytes = 4096;
+static const uint64_t kPartitionNum = 4;
+
+// merge dy_data into a copy of index, as the multi-threaded hybrid index does
+static StaticDI* Merge(StaticDI* index, DataVec& dy_data,
+                       const StaticDI::param_t& params) {
+  StaticDI* merged = new StaticDI(params);
+  *merged = *index;
+  merged->Merge(dy_data, 0);
+  while (!merged->AllSubMergeFinished()) {
+    int pid = merged->ObtainMergeTask(0);
+    if (pid >= 0) {
+      merged->MergeSubData(dy_data, 0, pid);
+    }
+  }
+  merged->UpdateLatestVersion(0);
+  index->DeleteFile();
+  delete index;
+  return merged;
+}
+
+static size_t Check(StaticDI* index, const DataVec& expected) {
+  size_t wrong = 0;
+  for (auto& r : expected) {
+    if (index->Find(r.first, 0) != r.second) {
+      wrong++;
+    }
+  }
+  // scans cross the partition boundaries
+  for (size_t i = 0; i < expected.size(); i += expected.size() / 97) {
+    DataVec out;
+    index->Scan(expected[i].first, 500, out, 0);
+    size_t len = std::min<size_t>(500, expected.size() - i);
+    if (out.size() != len ||
+        !std::equal(out.begin(), out.end(), expected.begin() + i)) {
+      wrong++;
+    }
+  }
+  return wrong;
+}
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  StaticDI::param_t params{
+      16,
+      kPageBytes / sizeof(Record),
+      {dir + "/rebalance_test_data", kPageBytes, 1, kPartitionNum}};
+  const size_t kInitNum = 40000;
+  DataVec data;
+  for (size_t i = 0; i < kInitNum; i++) {
+    data.push_back({(i + 1) * 10, i});
+  }
+  StaticDI* index = new StaticDI(params);
+  index->Build(data, 0);
+
+  // the inserts come after the last key, a few stored keys get newer values
+  DataVec dy_data;
+  for (size_t i = 0; i < kInitNum; i += 1000) {
+    dy_data.push_back({data[i].first, i + 1});
+    data[i].second = i + 1;
+  }
+  for (size_t i = kInitNum; i < 4 * kInitNum; i++) {
+    dy_data.push_back({(i + 1) * 10, i});
+    data.push_back({(i + 1) * 10, i});
+  }
+  index = Merge(index, dy_data, params);
+
+  size_t wrong = 0;
+  for (size_t p = 0; p < kPartitionNum; p++) {
+    uint64_t share = data.size() / kPartitionNum;
+    uint64_t num = index->GetPartitionSize(p);
+    std::cout << "partition " << p << ",\trecords:" << num << std::endl;
+    // the ranks of the boundaries also count the replaced stored records
+    if (num * 100 < share * 99 || num * 100 > share * 101) {
+      wrong++;
+    }
+  }
+  wrong += Check(index, data);
+
+  // a merge into one partition leaves the boundaries and the other
+  // partitions, whose models are kept, as they are
+  dy_data.clear();
+  for (size_t i = kInitNum + 5; i < kInitNum + 50; i++) {
+    dy_data.push_back({data[i].first + 5, i});
+  }
+  for (auto& r : dy_data) {
+    data.push_back(r);
+  }
+  std::sort(data.begin(), data.end());
+  index = Merge(index, dy_data, params);
+  wrong += Check(index, data);
+
+  std::cout << "wrong:" << wrong << std::endl;
+  index->DeleteFile();
+  index->FreeBuffer();
+  delete index;
+  return wrong == 0 ? 0 : 1;
+}
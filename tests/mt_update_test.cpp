@@ -0,0 +1,86 @@
+// Several threads update the keys of the same static pages at once while
+// inserts trigger merges in the background. Every update patches its page
+// under the page latch or goes to the dynamic index during a merge, so no
+// update may be lost.
+
+#include <omp.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../indexes/multi_threaded_hybrid/dynamic/btree.h"
+#include "../indexes/multi_threaded_hybrid/hybrid_index.h"
+#include "../indexes/multi_threaded_hybrid/static/cpr_di.h"
+
+typedef MultiThreadedHybridIndex<Key, Value,
+                                 MultiThreadedBTreeIndex<Key, Value>,
+                                 MultiThreadedStaticCprDI<Key, Value>>
+    HybridDI;
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  const uint64_t kPageBytes = 4096;
+  const int kThreadNum = 4;
+  const size_t kDataNum = 200000;
+  // the updated keys fill the first pages, each page is updated by all the
+  // threads
+  const size_t kUpdateNum = 64 * kPageBytes / sizeof(Record);
+  const size_t kRoundNum = 3;
+  const size_t kInsertNum = 40000;
+  DataVec data;
+  for (size_t i = 0; i < kDataNum; i++) {
+    data.push_back({(i + 1) * 10, i});
+  }
+  HybridDI index({{},
+                  {16,
+                   kPageBytes / sizeof(Record),
+                   {dir + "/update_test_data", kPageBytes, kThreadNum, 2}},
+                  20,
+                  1});
+  index.Build(data);
+
+  std::vector<size_t> failed(kThreadNum, 0), merge_inserts(kThreadNum, 0);
+#pragma omp parallel num_threads(kThreadNum)
+  {
+    int t = omp_get_thread_num();
+    size_t next_insert = t;
+    for (size_t r = 0; r < kRoundNum; r++) {
+      for (size_t i = t; i < kUpdateNum; i += kThreadNum) {
+        if (!index.Update(data[i].first, (r + 1) * kDataNum + i, t)) {
+          failed[t]++;
+        }
+        if (i % 4 == t && next_insert < kInsertNum) {
+          index.Insert((next_insert + 1) * 10 + 5, next_insert, t);
+          next_insert += kThreadNum;
+        }
+      }
+    }
+    for (; next_insert < kInsertNum; next_insert += kThreadNum) {
+      index.Insert((next_insert + 1) * 10 + 5, next_insert, t);
+    }
+    merge_inserts[t] = index.GetMergeInsertCnt(t);
+  }
+
+  size_t wrong = 0, merges = 0;
+  for (int t = 0; t < kThreadNum; t++) {
+    wrong += failed[t];
+    merges += merge_inserts[t];
+  }
+  for (size_t i = 0; i < kDataNum; i++) {
+    Value expected = i < kUpdateNum ? kRoundNum * kDataNum + i : i;
+    if (index.Find(data[i].first, 0) != expected) {
+      wrong++;
+    }
+  }
+  for (size_t i = 0; i < kInsertNum; i++) {
+    if (index.Find((i + 1) * 10 + 5, 0) != i) {
+      wrong++;
+    }
+  }
+  std::cout << "inserts over the budget:" << merges << ",\twrong:" << wrong
+            << std::endl;
+  index.FreeBuffer();
+  return wrong == 0 && merges > 0 ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+// A striped data file is laid out round-robin over its parts in units of
+// stripe_bytes_. Reads and writes spanning several units must land on the
+// right parts with both io backends, and a hybrid index must run on top of
+// the striped files unchanged.
+
+#include <sys/stat.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../key_type.h"
+#include "../indexes/hybrid/dynamic/btree.h"
+#include "../indexes/hybrid/hybrid_index.h"
+#include "../indexes/hybrid/static/rs.h"
+
+typedef HybridIndex<Key, Value, BTreeIndex<Key, Value>, RSIndex<Key, Value>>
+    HybridRS;
+
+static const uint64_t kPageBytes = 4096;
+static const uint64_t kStripePages = 2;
+static const size_t kPageNum = 37;
+
+// the first key of every page is its page id
+static bool CheckPages(const Key* buf, size_t first, size_t num) {
+  for (size_t i = 0; i < num; i++) {
+    if (buf[i * kPageBytes / sizeof(Key)] != first + i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static size_t RunLayout(const std::string& filename, Key* buf) {
+  size_t wrong = 0;
+  std::vector<Key> pages(kPageNum * kPageBytes / sizeof(Key));
+  for (size_t i = 0; i < kPageNum; i++) {
+    pages[i * kPageBytes / sizeof(Key)] = i;
+  }
+  int fd = DirectIOOpen(filename);
+  DirectIOWrite(fd, pages, kPageBytes, kPageNum, buf);
+  if (DirectIOFileBytes(fd) != kPageNum * kPageBytes) {
+    wrong++;
+  }
+
+  // the u-th unit is at (u / N) * stripe_bytes_ of part u % N
+  const size_t part_num = stripe_dirs_.size();
+  for (size_t page = 0; page < kPageNum; page++) {
+    size_t unit = page / kStripePages;
+    size_t offset =
+        (unit / part_num * kStripePages + page % kStripePages) * kPageBytes;
+    int part_fd = open(GetStripePath(filename, unit % part_num).c_str(),
+                       O_RDONLY);
+    Key first_key = 0;
+    if (part_fd == -1 ||
+        pread(part_fd, &first_key, sizeof(Key), offset) != sizeof(Key) ||
+        first_key != page) {
+      wrong++;
+    }
+    close(part_fd);
+  }
+
+  // the reads start and end in the middle of the units
+  for (size_t first : {0, 1, 3, 8}) {
+    size_t num = kPageNum - first - 1;
+    memset(buf, 0xff, num * kPageBytes);
+    DirectIORead<Key>(fd, kPageBytes, num, first * kPageBytes, buf);
+    if (!CheckPages(buf, first, num)) {
+      wrong++;
+    }
+  }
+  std::vector<IORequest> reqs;
+  for (size_t first = 1; first + 3 <= kPageNum; first += 5) {
+    reqs.push_back({fd, reinterpret_cast<char*>(buf) + first * kPageBytes,
+                    3 * kPageBytes, first * kPageBytes});
+  }
+  memset(buf, 0xff, kPageNum * kPageBytes);
+  BackendReadBatch(reqs);
+  for (auto& req : reqs) {
+    if (!CheckPages(reinterpret_cast<Key*>(req.buf), req.offset / kPageBytes,
+                    3)) {
+      wrong++;
+    }
+  }
+
+  DirectIOTruncate(fd, 11 * kPageBytes);
+  if (DirectIOFileBytes(fd) != 11 * kPageBytes) {
+    wrong++;
+  }
+  DirectIOClose(fd);
+  DirectIORemove(filename);
+  for (size_t i = 0; i < part_num; i++) {
+    struct stat st;
+    if (stat(GetStripePath(filename, i).c_str(), &st) == 0) {
+      wrong++;
+    }
+  }
+  return wrong;
+}
+
+static size_t RunHybrid(const std::string& filename) {
+  const size_t kDataNum = 100000;
+  DataVec data;
+  for (size_t i = 0; i < kDataNum; i++) {
+    data.push_back({(i + 1) * 10, i});
+  }
+  HybridRS index({{}, {12, 16, {filename, kPageBytes, 4}}, 1 << 20});
+  index.Build(data);
+  size_t wrong = 0;
+  for (size_t i = 0; i < kDataNum; i += 7) {
+    if (!index.Update(data[i].first, i + 1)) {
+      wrong++;
+    }
+    data[i].second = i + 1;
+  }
+  for (auto& r : data) {
+    if (index.Find(r.first) != r.second) {
+      wrong++;
+    }
+  }
+  return wrong;
+}
+
+int main(int argc, char* argv[]) {
+  std::string dir = argc > 1 ? argv[1] : ".";
+  read_buf_ = reinterpret_cast<Key*>(
+      aligned_alloc(kPageBytes, kPageBytes * ALLOCATED_BUF_SIZE));
+  for (size_t i = 0; i < 3; i++) {
+    stripe_dirs_.push_back(dir + "/stripe_test_part" + std::to_string(i));
+    mkdir(stripe_dirs_.back().c_str(), 0755);
+  }
+  stripe_bytes_ = kStripePages * kPageBytes;
+
+  size_t wrong = 0;
+  for (IOBackend backend : {kPread, kIOUring}) {
+    io_backend_ = backend;
+    size_t layout = RunLayout(dir + "/stripe_test_file", read_buf_);
+    size_t hybrid = RunHybrid(dir + "/stripe_test_data");
+    std::cout << "backend:" << (backend == kIOUring ? "io_uring" : "pread")
+              << ",\twrong layout:" << layout << ",\twrong hybrid:" << hybrid
+              << std::endl;
+    wrong += layout + hybrid;
+  }
+  free(read_buf_);
+  return wrong == 0 ? 0 : 1;
+}
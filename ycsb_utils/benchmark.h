@@ -1,7 +1,12 @@
 #ifndef UTILS_BENCHMARK_H
 #define UTILS_BENCHMARK_H
 
+#include "../indexes/hybrid/auto_tuner.h"
 #include "../indexes/hybrid/hybrid_index.h"
+#include "latency_histogram.h"
+
+// the maximal number of consecutive reads that are looked up as one batch
+inline size_t lookup_batch_ = 1;
 
 template <typename IndexType>
 inline void RunYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
@@ -22,10 +27,40 @@ inline void RunYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
   index.PrintEachPartSize();
   Value res = 0;
   auto ops_size = ops.size();
+  LatencyRecorder latency;
+  size_t merge_insert_cnt = GetMergeInsertCnt(index, 0);
+  KeyVec batch_keys;
+  std::vector<Value> batch_vals;
   uint64_t ns = GetNsTime([&] {
     for (uint64_t i = 0; i < ops_size; i++) {
+      const auto start = std::chrono::high_resolution_clock::now();
       switch (ops[i]) {
         case READ: {
+          if (lookup_batch_ > 1) {
+            size_t n = 1;
+            while (n < lookup_batch_ && i + n < ops_size &&
+                   ops[i + n] == READ) {
+              n++;
+            }
+            batch_keys.assign(ops_key.begin() + i, ops_key.begin() + i + n);
+            index.FindBatch(batch_keys, batch_vals);
+            for (size_t j = 0; j < n; j++) {
+              res += batch_vals[j];
+#ifdef CHECK_CORRECTION
+              if (batch_vals[j] != index.Find(batch_keys[j])) {
+                std::cout << "batch lookup wrong! i:" << i + j
+                          << ",\tkey:" << batch_keys[j] << std::endl;
+              }
+#endif
+            }
+            // each read of the batch is charged an equal share of it
+            uint64_t batch_ns = GetElapsedNs(start) / n;
+            for (size_t j = 0; j < n; j++) {
+              latency.Record(READ, batch_ns);
+            }
+            i += n - 1;
+            continue;
+          }
           res += index.Find(ops_key[i]);
 #ifdef CHECK_CORRECTION
           auto tmp = index.Find(ops_key[i]);
@@ -65,6 +100,7 @@ inline void RunYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
         }
         case SCAN: {
           res += index.Scan(ops_key[i], len[i]);
+          latency.RecordScanLength(len[i]);
           break;
         }
         case INSERT: {
@@ -84,6 +120,15 @@ inline void RunYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
         default:
           break;
       }
+      int op_type = ops[i];
+      if (op_type == INSERT) {
+        size_t cnt = GetMergeInsertCnt(index, 0);
+        if (cnt != merge_insert_cnt) {
+          op_type = LatencyRecorder::kMergeInsert;
+          merge_insert_cnt = cnt;
+        }
+      }
+      latency.Record(op_type, GetElapsedNs(start));
     }
   });
   PrintCurrentTime();
@@ -97,6 +142,25 @@ inline void RunYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
             << ops_size * 1.0 / ns * 1e9 / 1e3 << ", K ops/s";
   std::cout << std::endl;
   std::cout << "\tres:" << res << std::endl;
+  latency.PrintLatency();
+}
+
+// run a hybrid index, whose static model and buffer pool are first tuned for
+// the workload under the memory budget if auto_tune is set
+template <typename DynamicType, typename StaticType>
+inline void RunHybridBenchmark(
+    DataVec& init_data, std::vector<int>& ops, KeyVec& ops_key,
+    std::vector<int>& len,
+    typename HybridIndex<Key, Value, DynamicType, StaticType>::param_t
+        index_params,
+    bool auto_tune) {
+  if (auto_tune) {
+    HybridTuner<Key, Value, DynamicType, StaticType> tuner(init_data, ops,
+                                                           ops_key, len);
+    index_params = tuner.Tune(index_params);
+  }
+  RunYCSBBenchmark<HybridIndex<Key, Value, DynamicType, StaticType>>(
+      init_data, ops, ops_key, len, index_params);
 }
 
 #endif  // !UTILS_BENCHMARK_H
\ No newline at end of file
@@ -0,0 +1,263 @@
+#ifndef UTILS_BUFFER_POOL_H
+#define UTILS_BUFFER_POOL_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "../io_backend.h"
+#include "macro.h"
+
+// A size-bounded cache of on-disk pages keyed by (fd, page id) with CLOCK
+// eviction. The pages are cached on read and refreshed on single-page
+// updates. The pages rewritten by a merge must be invalidated by the caller.
+class BufferPool {
+ public:
+  BufferPool(size_t capacity_bytes, size_t page_bytes)
+      : page_bytes_(page_bytes),
+        frame_num_(capacity_bytes / page_bytes),
+        frames_(frame_num_),
+        hand_(0),
+        hit_cnt_(0),
+        miss_cnt_(0),
+        evict_cnt_(0) {
+    data_ = reinterpret_cast<uint8_t*>(aligned_alloc(
+        page_bytes_, std::max<size_t>(1, frame_num_) * page_bytes_));
+    page_map_.reserve(frame_num_);
+  }
+
+  ~BufferPool() { free(data_); }
+
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Read page_num pages at offset into buf.
+  void ReadPages(int fd, size_t page_num, size_t offset, void* buf) {
+    ReadBatch({{fd, buf, page_num * page_bytes_, offset}});
+  }
+
+  // Read the pages of a batch of requests. The cached pages are copied, the
+  // runs of missed pages of all the requests are fetched from disk in one
+  // batch and then cached. The pool is not locked during the I/O, so the
+  // lookups of other threads, e.g., of a background merge sharing the pool,
+  // are not blocked by it.
+  void ReadBatch(const std::vector<IORequest>& reqs) {
+    std::vector<IORequest> miss_reqs;
+    // (fd, page id, the page in the output buffer)
+    std::vector<std::pair<uint64_t, uint8_t*>> miss_pages;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& req : reqs) {
+        auto out = reinterpret_cast<uint8_t*>(req.buf);
+        uint64_t first_pid = req.offset / page_bytes_;
+        size_t page_num = req.bytes / page_bytes_;
+        bool in_run = false;
+        for (size_t i = 0; i < page_num; i++) {
+          uint64_t key = GetKey(req.fd, first_pid + i);
+          if (trace_ != nullptr) {
+            trace_->push_back(key);
+          }
+          auto it = page_map_.find(key);
+          if (it != page_map_.end()) {
+            frames_[it->second].ref = true;
+            memcpy(out + i * page_bytes_, GetFrame(it->second), page_bytes_);
+            hit_cnt_++;
+            in_run = false;
+            continue;
+          }
+          miss_cnt_++;
+          miss_pages.push_back({key, out + i * page_bytes_});
+          in_flight_[key].readers++;
+          if (in_run) {
+            miss_reqs.back().bytes += page_bytes_;
+          } else {
+            miss_reqs.push_back({req.fd, out + i * page_bytes_, page_bytes_,
+                                 req.offset + i * page_bytes_});
+            in_run = true;
+          }
+        }
+      }
+    }
+    if (miss_reqs.empty()) {
+      return;
+    }
+    BackendReadBatch(miss_reqs);
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& page : miss_pages) {
+      auto it = in_flight_.find(page.first);
+      // a page rewritten during the read may be stale, and a page missed by
+      // several threads at once, or by several requests of the batch, is
+      // cached by the first one
+      if (!it->second.stale && page_map_.find(page.first) == page_map_.end()) {
+        Insert(page.first, page.second);
+      }
+      if (--it->second.readers == 0) {
+        in_flight_.erase(it);
+      }
+    }
+  }
+
+  // append the key of every page read from now on to trace, nullptr: stop,
+  // e.g., to replay the page accesses of a workload on other cache sizes
+  void TraceReads(std::vector<uint64_t>* trace) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    trace_ = trace;
+  }
+
+  // refresh the cached copy of a page that has been written back
+  void WritePage(int fd, uint64_t pid, const void* page) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = page_map_.find(GetKey(fd, pid));
+    if (it != page_map_.end()) {
+      memcpy(GetFrame(it->second), page, page_bytes_);
+    }
+    MarkStale(fd, pid, 1);
+  }
+
+  void Invalidate(int fd, uint64_t pid_start, uint64_t page_num) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MarkStale(fd, pid_start, page_num);
+    if (page_num > page_map_.size()) {
+      // cheaper to scan the frames than to probe every page
+      for (size_t i = 0; i < frame_num_; i++) {
+        if (frames_[i].valid && frames_[i].fd == fd &&
+            frames_[i].pid >= pid_start &&
+            frames_[i].pid < pid_start + page_num) {
+          Evict(i);
+        }
+      }
+      return;
+    }
+    for (uint64_t pid = pid_start; pid < pid_start + page_num; pid++) {
+      auto it = page_map_.find(GetKey(fd, pid));
+      if (it != page_map_.end()) {
+        Evict(it->second);
+      }
+    }
+  }
+
+  void InvalidateFile(int fd) {
+    Invalidate(fd, 0, std::numeric_limits<uint64_t>::max() >> 24);
+  }
+
+  inline size_t GetCapacity() const { return frame_num_ * page_bytes_; }
+
+  // the frames and the metadata of a full pool, allocated up front
+  inline size_t GetNodeSize() const {
+    return GetCapacity() + page_map_.bucket_count() * sizeof(void*) +
+           frame_num_ * (sizeof(Frame) + sizeof(uint64_t) + sizeof(size_t));
+  }
+
+  // the size of a full pool of capacity_bytes without allocating it
+  static inline size_t EstimateNodeSize(size_t capacity_bytes,
+                                        size_t page_bytes) {
+    size_t frame_num = capacity_bytes / page_bytes;
+    return frame_num * page_bytes +
+           frame_num * (sizeof(Frame) + sizeof(uint64_t) + sizeof(size_t) +
+                        sizeof(void*));
+  }
+
+  void PrintBufferPoolInfo() const {
+    uint64_t total = hit_cnt_ + miss_cnt_;
+    std::cout << "\t\tbuffer pool:" << PRINT_MIB(GetCapacity())
+              << " MiB,\tframes:" << frame_num_
+              << ",\tcached pages:" << page_map_.size()
+              << ",\thit cnt:" << hit_cnt_ << ",\tmiss cnt:" << miss_cnt_
+              << ",\thit ratio:" << (total ? hit_cnt_ * 1.0 / total : 0)
+              << ",\tevict cnt:" << evict_cnt_ << std::endl;
+  }
+
+ private:
+  struct Frame {
+    int fd = -1;
+    uint64_t pid = 0;
+    bool ref = false;
+    bool valid = false;
+  };
+
+  // a page that is being read from disk by some threads
+  struct InFlight {
+    uint32_t readers = 0;
+    bool stale = false;
+  };
+
+  // the page ids are far below 2^40, the fds far below 2^24
+  static inline uint64_t GetKey(int fd, uint64_t pid) {
+    return (static_cast<uint64_t>(fd) << 40) | pid;
+  }
+
+  inline uint8_t* GetFrame(size_t frame_id) const {
+    return data_ + frame_id * page_bytes_;
+  }
+
+  inline void Insert(uint64_t key, const uint8_t* page) {
+    if (frame_num_ == 0) {
+      return;
+    }
+    // CLOCK: clear the reference bits until a frame can be reused
+    while (frames_[hand_].valid && frames_[hand_].ref) {
+      frames_[hand_].ref = false;
+      hand_ = (hand_ + 1) % frame_num_;
+    }
+    if (frames_[hand_].valid) {
+      Evict(hand_);
+      evict_cnt_++;
+    }
+    frames_[hand_] = {static_cast<int>(key >> 40),
+                      key & ((uint64_t(1) << 40) - 1), false, true};
+    memcpy(GetFrame(hand_), page, page_bytes_);
+    page_map_[key] = hand_;
+    hand_ = (hand_ + 1) % frame_num_;
+  }
+
+  // the pages of [pid_start, pid_start + page_num) that are being read are
+  // not cached when the reads complete
+  inline void MarkStale(int fd, uint64_t pid_start, uint64_t page_num) {
+    if (in_flight_.empty()) {
+      return;
+    }
+    if (page_num > in_flight_.size()) {
+      for (auto& page : in_flight_) {
+        uint64_t pid = page.first & ((uint64_t(1) << 40) - 1);
+        if (static_cast<int>(page.first >> 40) == fd && pid >= pid_start &&
+            pid < pid_start + page_num) {
+          page.second.stale = true;
+        }
+      }
+      return;
+    }
+    for (uint64_t pid = pid_start; pid < pid_start + page_num; pid++) {
+      auto it = in_flight_.find(GetKey(fd, pid));
+      if (it != in_flight_.end()) {
+        it->second.stale = true;
+      }
+    }
+  }
+
+  inline void Evict(size_t frame_id) {
+    page_map_.erase(GetKey(frames_[frame_id].fd, frames_[frame_id].pid));
+    frames_[frame_id].valid = false;
+    frames_[frame_id].ref = false;
+  }
+
+  size_t page_bytes_;
+  size_t frame_num_;
+  uint8_t* data_;
+  std::vector<Frame> frames_;
+  std::unordered_map<uint64_t, size_t> page_map_;
+  std::unordered_map<uint64_t, InFlight> in_flight_;
+  size_t hand_;
+  std::mutex mutex_;
+
+  uint64_t hit_cnt_;
+  uint64_t miss_cnt_;
+  uint64_t evict_cnt_;
+  std::vector<uint64_t>* trace_ = nullptr;
+};
+
+#endif  // !UTILS_BUFFER_POOL_H
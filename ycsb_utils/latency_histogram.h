@@ -0,0 +1,174 @@
+#ifndef UTILS_LATENCY_HISTOGRAM_H
+#define UTILS_LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "structures.h"
+
+// 2^LATENCY_SUB_BITS linear sub-buckets per power of two, i.e., the recorded
+// latencies are kept within 1 / 2^LATENCY_SUB_BITS of their values
+#define LATENCY_SUB_BITS 7
+
+// A log-linear histogram of latencies in ns, in the style of HdrHistogram.
+// The values below 2^LATENCY_SUB_BITS have their own buckets, every larger
+// power of two is split into 2^LATENCY_SUB_BITS buckets of equal width, so
+// the relative error is bounded over the whole range of uint64_t.
+class LatencyHistogram {
+ public:
+  LatencyHistogram()
+      : buckets_((64 - LATENCY_SUB_BITS + 1) << LATENCY_SUB_BITS, 0),
+        cnt_(0),
+        sum_(0),
+        max_(0) {}
+
+  inline void Record(uint64_t ns) {
+    buckets_[GetBucket(ns)]++;
+    cnt_++;
+    sum_ += ns;
+    max_ = std::max(max_, ns);
+  }
+
+  void Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      buckets_[i] += other.buckets_[i];
+    }
+    cnt_ += other.cnt_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  // the highest latency in the bucket holding the p-th percentile
+  uint64_t GetPercentile(double p) const {
+    if (cnt_ == 0) {
+      return 0;
+    }
+    uint64_t rank = std::max<uint64_t>(1, std::ceil(cnt_ * p / 100.0));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < buckets_.size(); i++) {
+      seen += buckets_[i];
+      if (seen >= rank) {
+        return std::min(GetBucketEnd(i), max_);
+      }
+    }
+    return max_;
+  }
+
+  inline uint64_t GetCount() const { return cnt_; }
+  inline double GetAvg() const { return cnt_ ? sum_ * 1.0 / cnt_ : 0; }
+  inline uint64_t GetSum() const { return sum_; }
+  inline uint64_t GetMax() const { return max_; }
+
+ private:
+  static inline size_t GetBucket(uint64_t ns) {
+    if (ns < (1ULL << LATENCY_SUB_BITS)) {
+      return ns;
+    }
+    int shift = 63 - __builtin_clzll(ns) - LATENCY_SUB_BITS;
+    // (ns >> shift) is in [2^LATENCY_SUB_BITS, 2^(LATENCY_SUB_BITS + 1))
+    return (static_cast<size_t>(shift + 1) << LATENCY_SUB_BITS) +
+           (ns >> shift) - (1ULL << LATENCY_SUB_BITS);
+  }
+
+  static inline uint64_t GetBucketEnd(size_t bucket) {
+    if (bucket < (1ULL << LATENCY_SUB_BITS)) {
+      return bucket;
+    }
+    int shift = (bucket >> LATENCY_SUB_BITS) - 1;
+    uint64_t top = (bucket & ((1ULL << LATENCY_SUB_BITS) - 1)) +
+                   (1ULL << LATENCY_SUB_BITS);
+    return ((top + 1) << shift) - 1;
+  }
+
+  std::vector<uint64_t> buckets_;
+  uint64_t cnt_;
+  uint64_t sum_;
+  uint64_t max_;
+};
+
+// The latency histograms of one thread, one per op type. The inserts that
+// triggered a merge, or waited for one, are kept apart from the others since
+// they carry the merge stalls.
+class LatencyRecorder {
+ public:
+  enum { kMergeInsert = INSERT + 1, kTypeNum };
+
+  inline void Record(int op_type, uint64_t ns) {
+    histograms_[op_type].Record(ns);
+  }
+
+  // the records requested by a scan, for the scan bandwidth
+  inline void RecordScanLength(uint64_t length) { scan_records_ += length; }
+
+  void Merge(const LatencyRecorder& other) {
+    for (int i = 0; i < kTypeNum; i++) {
+      histograms_[i].Merge(other.histograms_[i]);
+    }
+    scan_records_ += other.scan_records_;
+  }
+
+  void PrintLatency() const {
+    static const char* names[kTypeNum] = {"READ", "UPDATE", "SCAN", "INSERT",
+                                          "MERGE_INSERT"};
+    std::cout << "-------------latency (ns)---------------" << std::endl;
+    for (int i = 0; i < kTypeNum; i++) {
+      auto& h = histograms_[i];
+      if (h.GetCount() == 0) {
+        continue;
+      }
+      std::cout << "\t" << names[i] << ", cnt:," << h.GetCount() << ", avg:,"
+                << h.GetAvg() << ", p50:," << h.GetPercentile(50)
+                << ", p99:," << h.GetPercentile(99) << ", p99.9:,"
+                << h.GetPercentile(99.9) << ", max:," << h.GetMax()
+                << std::endl;
+    }
+    auto& scan = histograms_[SCAN];
+    if (scan.GetCount() > 0 && scan_records_ > 0) {
+      // the bytes of the requested records over the time spent in scans
+      std::cout << "\tSCAN avg length:,"
+                << scan_records_ * 1.0 / scan.GetCount() << ", bandwidth:,"
+                << PRINT_MIB(scan_records_ * sizeof(::Record)) /
+                       (scan.GetSum() / 1e9)
+                << ", MiB/s" << std::endl;
+    }
+  }
+
+ private:
+  LatencyHistogram histograms_[kTypeNum];
+  uint64_t scan_records_ = 0;
+};
+
+static inline uint64_t GetElapsedNs(
+    const std::chrono::high_resolution_clock::time_point& start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::high_resolution_clock::now() - start)
+      .count();
+}
+
+// the number of inserts that have triggered or waited for a merge, for the
+// indexes that merge; the others never stall on a merge
+template <typename IndexType>
+inline auto GetMergeInsertCnt(IndexType& index, int)
+    -> decltype(index.GetMergeInsertCnt()) {
+  return index.GetMergeInsertCnt();
+}
+template <typename IndexType>
+inline size_t GetMergeInsertCnt(IndexType& index, long) {
+  return 0;
+}
+
+template <typename IndexType>
+inline auto GetMergeInsertCnt(IndexType& index, int thread_id, int)
+    -> decltype(index.GetMergeInsertCnt(thread_id)) {
+  return index.GetMergeInsertCnt(thread_id);
+}
+template <typename IndexType>
+inline size_t GetMergeInsertCnt(IndexType& index, int thread_id, long) {
+  return 0;
+}
+
+#endif  // !UTILS_LATENCY_HISTOGRAM_H
@@ -4,8 +4,19 @@
 #include <chrono>
 
 #include "../indexes/multi_threaded_hybrid/hybrid_index.h"
+#include "latency_histogram.h"
 #include "omp.h"
 
+// register the buffer of each thread with its io_uring, for the indexes that
+// read through the io backend
+template <typename IndexType>
+inline auto RegisterBuffer(IndexType& index, int thread_id, int)
+    -> decltype(index.RegisterBuffer(thread_id)) {
+  index.RegisterBuffer(thread_id);
+}
+template <typename IndexType>
+inline void RegisterBuffer(IndexType& index, int thread_id, long) {}
+
 template <typename IndexType>
 inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
                                   KeyVec& ops_key, std::vector<int>& len,
@@ -30,6 +41,8 @@ inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
     res[i] = 0;
   }
   std::vector<int> insert_cnt(thread_num, 0);
+  // recorded by each thread, merged once all of them have joined
+  std::vector<LatencyRecorder> latency(thread_num);
   uint64_t latency_ns = 1;
   Value final_res = 0;
   auto start = std::chrono::high_resolution_clock::now();
@@ -37,6 +50,8 @@ inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
 #pragma omp parallel num_threads(thread_num)
   {
     auto thread_id = omp_get_thread_num();
+    RegisterBuffer(index, thread_id, 0);
+    size_t merge_insert_cnt = GetMergeInsertCnt(index, thread_id, 0);
 #pragma omp barrier
 #pragma omp master
     start = std::chrono::high_resolution_clock::now();
@@ -44,6 +59,7 @@ inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
 // running benchmark
 #pragma omp for schedule(dynamic, 100)
     for (uint64_t i = 0; i < ops_size; i++) {
+      const auto op_start = std::chrono::high_resolution_clock::now();
       switch (ops[i]) {
         case READ: {
           res[thread_id] += index.Find(ops_key[i], thread_id);
@@ -86,6 +102,7 @@ inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
         }
         case SCAN: {
           res[thread_id] += index.Scan(ops_key[i], len[i], thread_id);
+          latency[thread_id].RecordScanLength(len[i]);
           break;
         }
         case INSERT: {
@@ -116,6 +133,15 @@ inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
         default:
           break;
       }
+      int op_type = ops[i];
+      if (op_type == INSERT) {
+        size_t cnt = GetMergeInsertCnt(index, thread_id, 0);
+        if (cnt != merge_insert_cnt) {
+          op_type = LatencyRecorder::kMergeInsert;
+          merge_insert_cnt = cnt;
+        }
+      }
+      latency[thread_id].Record(op_type, GetElapsedNs(op_start));
     }  // omp for loop
 
 #pragma omp master
@@ -146,6 +172,10 @@ inline void RunMultiYCSBBenchmark(DataVec& init_data, std::vector<int>& ops,
             << ops_size * 1.0 / latency_ns * 1e9 / 1e3 << ", K ops/s";
   std::cout << std::endl;
   std::cout << "\tfinal res:" << final_res << std::endl;
+  for (uint64_t i = 1; i < thread_num; i++) {
+    latency[0].Merge(latency[i]);
+  }
+  latency[0].PrintLatency();
 }
 
 #endif  // !UTILS_MULTI_THREADED_BENCHMARK_H
\ No newline at end of file
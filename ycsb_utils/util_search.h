@@ -10,9 +10,21 @@
 
 #include <iostream>
 
+#include "../io_backend.h"
+#include "../last_mile_search.h"
+#include "./buffer_pool.h"
 #include "./structures.h"
 
-int DirectIOOpen(const std::string& filename) {
+// the directories, e.g., on different devices, that the data files are striped
+// over, see striped_fds_. The parts of a file are named after its base name.
+inline std::vector<std::string> stripe_dirs_;
+
+static inline std::string GetStripePath(const std::string& filename,
+                                        size_t i) {
+  return stripe_dirs_[i] + "/" + filename.substr(filename.rfind('/') + 1);
+}
+
+inline int DirectIOOpenFile(const std::string& filename) {
 #ifdef __APPLE__
   // Reference:
   // https://github.com/facebook/rocksdb/wiki/Direct-IO
@@ -30,59 +42,134 @@ int DirectIOOpen(const std::string& filename) {
   return fd;
 }
 
+// open the file, or all its parts if the data files are striped
+int DirectIOOpen(const std::string& filename) {
+  if (stripe_dirs_.size() <= 1) {
+    return DirectIOOpenFile(stripe_dirs_.empty() ? filename
+                                                 : GetStripePath(filename, 0));
+  }
+  std::vector<int> fds;
+  for (size_t i = 0; i < stripe_dirs_.size(); i++) {
+    fds.push_back(DirectIOOpenFile(GetStripePath(filename, i)));
+  }
+  RegisterStripedFile(fds);
+  return fds[0];
+}
+
 void DirectIOClose(int fd) {
 #ifdef PRINT_PROCESSING_INFO
   std::cout << "DirectIOClose file:" << fd << std::endl;
 #endif
-  close(fd);
+  for (int part_fd : UnregisterStripedFile(fd)) {
+    close(part_fd);
+  }
+}
+
+inline void DirectIORemove(const std::string& filename) {
+  if (stripe_dirs_.empty()) {
+    std::remove(filename.c_str());
+  }
+  for (size_t i = 0; i < stripe_dirs_.size(); i++) {
+    std::remove(GetStripePath(filename, i).c_str());
+  }
+}
+
+// the bytes of the file, or of all its parts if it is striped
+inline size_t DirectIOFileBytes(int fd) {
+  std::vector<int> fds =
+      IsStriped(fd) ? striped_fds_[fd] : std::vector<int>{fd};
+  size_t bytes = 0;
+  for (int part_fd : fds) {
+    struct stat st;
+    if (fstat(part_fd, &st) != 0) {
+      throw std::runtime_error("fstat error in DirectIOFileBytes");
+    }
+    bytes += st.st_size;
+  }
+  return bytes;
+}
+
+// flush the file, or all its parts if it is striped
+inline void DirectIOSync(int fd) {
+  std::vector<int> fds =
+      IsStriped(fd) ? striped_fds_[fd] : std::vector<int>{fd};
+  for (int part_fd : fds) {
+    if (fsync(part_fd) != 0) {
+      throw std::runtime_error("fsync error in DirectIOSync");
+    }
+  }
+}
+
+// cut the file to bytes, each part of a striped file keeps the units of the
+// first bytes that are laid out on it
+inline void DirectIOTruncate(int fd, size_t bytes) {
+  if (!IsStriped(fd)) {
+    if (ftruncate(fd, bytes) != 0) {
+      throw std::runtime_error("ftruncate error in DirectIOTruncate");
+    }
+    return;
+  }
+  const std::vector<int>& fds = striped_fds_[fd];
+  size_t units = bytes / stripe_bytes_, rest = bytes % stripe_bytes_;
+  for (size_t i = 0; i < fds.size(); i++) {
+    size_t part_bytes = (units / fds.size() + (i < units % fds.size())) *
+                            stripe_bytes_ +
+                        (i == units % fds.size() ? rest : 0);
+    if (ftruncate(fds[i], part_bytes) != 0) {
+      throw std::runtime_error("ftruncate error in DirectIOTruncate");
+    }
+  }
 }
 
 template <typename K>
 static void DirectIORead(int fd, size_t page_bytes, size_t page_num,
                          size_t offset, K* read_buf) {
-  int ret = pread(fd, read_buf, page_bytes * page_num, offset);
-  if (ret == -1) {
-    throw std::runtime_error("read error in DirectIORead");
+  BackendRead(fd, read_buf, page_bytes * page_num, offset);
+}
+
+// read through the buffer pool if there is one
+template <typename K>
+static inline void ReadPages(int fd, size_t page_bytes, size_t page_num,
+                             size_t offset, K* read_buf, BufferPool* pool) {
+  if (pool != nullptr) {
+    pool->ReadPages(fd, page_num, offset, read_buf);
+  } else {
+    DirectIORead<K>(fd, page_bytes, page_num, offset, read_buf);
   }
 }
 
 template <typename ElementType>
 static void DirectIOWrite(int fd, const std::vector<ElementType>& data,
                           size_t page_bytes, size_t page_num, void* write_buf,
-                          size_t seek_offset = 0) {
+                          size_t seek_offset = 0,
+                          size_t max_pages = MAX_READ_PAGES) {
   int total_num = page_num;
   while (total_num > 0) {
     int tmp_num = total_num;
-    if (tmp_num > 500000) {
-      tmp_num = 500000;
+    if (tmp_num > static_cast<int>(max_pages)) {
+      tmp_num = max_pages;
     }
     size_t offset = page_bytes * (page_num - total_num);
     size_t cpy_size = std::min(tmp_num * page_bytes,
                                data.size() * sizeof(ElementType) - offset);
     memcpy(write_buf, &data[offset / sizeof(ElementType)], cpy_size);
-    auto ret =
-        pwrite(fd, write_buf, page_bytes * tmp_num, seek_offset + offset);
-
-    if (ret == -1) {
-      throw std::runtime_error("write error in DirectIOWrite");
-    }
+    BackendWrite(fd, write_buf, page_bytes * tmp_num, seek_offset + offset);
     total_num -= tmp_num;
   }
 }
 
 template <typename K, typename V>
 static bool Update1Page(int fd, size_t pid, size_t idx, K key, V value,
-                        size_t page_bytes, K* buf) {
-  DirectIORead<K>(fd, page_bytes, 1, page_bytes * pid, buf);
+                        size_t page_bytes, K* buf,
+                        BufferPool* pool = nullptr) {
+  ReadPages<K>(fd, page_bytes, 1, page_bytes * pid, buf, pool);
   int gap_cnt = (sizeof(V) + sizeof(K)) / sizeof(K);
   K find_k = *(buf + idx * gap_cnt);
   if (find_k == key) {
     *(buf + idx * gap_cnt + 1) = value;
-    size_t offset = page_bytes * pid;
-    lseek(fd, offset, SEEK_SET);
-    int ret = write(fd, buf, page_bytes);
-    if (ret == -1) {
-      throw std::runtime_error("write error in Update1Page");
+    BackendWrite(fd, buf, page_bytes, page_bytes * pid);
+    if (pool != nullptr) {
+      pool->WritePage(fd, pid, buf);
     }
   } else {
     return false;
@@ -93,19 +180,11 @@ static bool Update1Page(int fd, size_t pid, size_t idx, K key, V value,
 template <typename K>
 inline uint64_t LastMileSearch(const K* data, uint64_t record_num,
                                uint64_t gap_cnt, K key) {
-  uint64_t s = 0, e = record_num;
+  uint64_t e = record_num;
   if (*(data + (e - 1) * gap_cnt) < key) {
     return e - 1;
   }
-
-  while (s < e) {
-    uint64_t mid = (s + e) >> 1;
-    if (*(data + mid * gap_cnt) < key)
-      s = mid + 1;
-    else
-      e = mid;
-  }
-  return s;
+  return BinaryLowerBound(data, e, gap_cnt, key);
 }
 
 template <typename K, typename V>
@@ -113,15 +192,16 @@ static inline void GetAllData(int fd, const size_t start_page_id,
                               const size_t page_num,
                               const size_t record_per_page,
                               const uint64_t length, K* read_buf,
-                              std::vector<std::pair<K, V>>& data) {
+                              std::vector<std::pair<K, V>>& data,
+                              size_t max_pages = MAX_READ_PAGES) {
   uint64_t bytes_per_page = record_per_page * (sizeof(V) + sizeof(K));
   uint64_t gap_cnt = (sizeof(V) + sizeof(K)) / sizeof(K);
   size_t idx = 0, item_offset = 0;
   int total_num = page_num;
   while (total_num > 0) {
     int tmp_num = total_num;
-    if (tmp_num > 500000) {
-      tmp_num = 500000;
+    if (tmp_num > static_cast<int>(max_pages)) {
+      tmp_num = max_pages;
     }
     DirectIORead<K>(fd, bytes_per_page, tmp_num,
                     bytes_per_page * (start_page_id + page_num - total_num),
@@ -135,70 +215,33 @@ static inline void GetAllData(int fd, const size_t start_page_id,
   }
 }
 
-template <typename K, typename V>
-static inline ResultInfo<K, V> RangeScan(int fd, const size_t pid,
-                                         const size_t page_num,
-                                         const size_t record_per_page,
-                                         const uint64_t length, K* read_buf) {
-  ResultInfo<K, V> res_info;
-  uint64_t bytes_per_page = record_per_page * sizeof(Record);
-  uint64_t fetch_bytes = bytes_per_page * page_num;
-  uint64_t gap_cnt = (sizeof(V) + sizeof(K)) / sizeof(K);
-
-  DirectIORead<K>(fd, bytes_per_page, page_num, pid * bytes_per_page, read_buf);
-  res_info.total_search_range += fetch_bytes;
-  res_info.fetch_page_num += page_num;
-  res_info.total_io++;
-
-  for (size_t idx = 0; idx < length; idx++) {
-    res_info.res += *(read_buf + idx * gap_cnt);
-    res_info.val += *(read_buf + idx * gap_cnt + 1);
-  }
-  return res_info;
-}
-
+// Read the page_num pages from pid and find the lower bound of lookupkey, the
+// records of the last page end at last_id.
 template <typename K, typename V>
 static inline std::pair<FindStatus, ResultInfo<K, V>> FetchPages(
     int fd, const K& lookupkey, const size_t page_num,
-    const size_t record_per_page, const size_t pid, const size_t last_pid,
-    const uint64_t length, K* read_buf, int last_id) {
+    const size_t record_per_page, const size_t pid, K* read_buf, int last_id,
+    BufferPool* pool = nullptr) {
   ResultInfo<K, V> res_info;
   uint64_t bytes_per_page = record_per_page * sizeof(Record);
-  uint64_t fetch_bytes = bytes_per_page * page_num;
   uint64_t gap_cnt = (sizeof(V) + sizeof(K)) / sizeof(K);
 
-  DirectIORead<K>(fd, bytes_per_page, page_num, pid * bytes_per_page, read_buf);
+  ReadPages<K>(fd, bytes_per_page, page_num, pid * bytes_per_page, read_buf,
+               pool);
 
   uint64_t idx = LastMileSearch(
       read_buf, record_per_page * (page_num - 1) + last_id, gap_cnt, lookupkey);
-  res_info.total_search_range += fetch_bytes;
+  res_info.total_search_range += bytes_per_page * page_num;
   res_info.fetch_page_num += page_num;
   res_info.res = *(read_buf + idx * gap_cnt);
   res_info.val = *(read_buf + idx * gap_cnt + 1);
   res_info.total_io++;
+  // the position of the lower bound, or of the last record if all are smaller
+  res_info.fd = fd;
+  res_info.pid = (idx / record_per_page) + pid;
+  res_info.idx = idx % record_per_page;
 
   if (res_info.res == lookupkey) {
-    res_info.fd = fd;
-    res_info.pid = (idx / record_per_page) + pid;
-    res_info.idx = idx % record_per_page;
-    // for range scan
-    auto len = length - 1;
-    while (len && (++idx) < record_per_page * page_num) {
-      res_info.res += *(read_buf + idx * gap_cnt);
-      res_info.val += *(read_buf + idx * gap_cnt + 1);
-      len--;
-    }
-    if (len && pid <= last_pid) {
-      size_t remain_page = std::ceil(len / record_per_page);
-      remain_page = std::min(remain_page, last_pid - pid);
-      auto remain_res = RangeScan<K, V>(fd, pid + 1, remain_page,
-                                        record_per_page, len, read_buf);
-      res_info.total_search_range += remain_res.total_search_range;
-      res_info.fetch_page_num += remain_res.fetch_page_num;
-      res_info.res += remain_res.res;
-      res_info.val += remain_res.val;
-      res_info.total_io += remain_res.total_io;
-    }
     return {kEqualToKey, res_info};
   } else if (res_info.res < lookupkey) {
     return {kLessThanKey, res_info};
@@ -210,13 +253,13 @@ template <typename K, typename V>
 static inline ResultInfo<K, V> WorstCaseFetch(const FetchRange range,
                                               const K lookupkey, int fd,
                                               const size_t record_per_page,
-                                              const uint64_t length,
-                                              K* read_buf, int last_id) {
+                                              K* read_buf, int last_id,
+                                              BufferPool* pool = nullptr) {
   ResultInfo<K, V> res_info;
   uint64_t fetch_page_num = range.pid_end - range.pid_start + 1;
-  auto fetch_res = FetchPages<K, V>(fd, lookupkey, fetch_page_num,
-                                    record_per_page, range.pid_start,
-                                    range.last_pid, length, read_buf, last_id);
+  auto fetch_res =
+      FetchPages<K, V>(fd, lookupkey, fetch_page_num, record_per_page,
+                       range.pid_start, read_buf, last_id, pool);
 
   res_info = fetch_res.second;
   return res_info;
@@ -226,14 +269,13 @@ template <typename K, typename V>
 static inline ResultInfo<K, V> OneByOneFetch(const FetchRange range,
                                              const K lookupkey, int fd,
                                              const size_t record_per_page,
-                                             const uint64_t length, K* read_buf,
-                                             int last_id) {
+                                             K* read_buf, int last_id,
+                                             BufferPool* pool = nullptr) {
   ResultInfo<K, V> res_info;
   uint64_t pid = range.pid_start;
   while (pid <= range.pid_end) {
-    auto fetch_res =
-        FetchPages<K, V>(fd, lookupkey, 1, record_per_page, pid, range.last_pid,
-                         length, read_buf, last_id);
+    auto fetch_res = FetchPages<K, V>(fd, lookupkey, 1, record_per_page, pid,
+                                      read_buf, last_id, pool);
     res_info.total_search_range += fetch_res.second.total_search_range;
     res_info.fetch_page_num += fetch_res.second.fetch_page_num;
     res_info.res = fetch_res.second.res;
@@ -265,8 +307,8 @@ template <typename K, typename V>
 static inline ResultInfo<K, V> NormalCoreLookup(
     int fd, const SearchRange& range, const K& lookupkey,
     const FetchStrategy& fetch_strategy, uint64_t record_per_page,
-    uint64_t length, uint64_t last_pid, K* read_buf, int last_id,
-    size_t pid_offset = 0) {
+    uint64_t last_pid, K* read_buf, int last_id, size_t pid_offset = 0,
+    BufferPool* pool = nullptr) {
   ResultInfo<K, V> res_info;
   FetchRange fetch_range = GetFetchRange(range, record_per_page, last_pid);
   fetch_range.pid_start += pid_offset;
@@ -275,13 +317,13 @@ static inline ResultInfo<K, V> NormalCoreLookup(
     case kWorstCase: {
       res_info =
           WorstCaseFetch<K, V>(fetch_range, lookupkey, fd, record_per_page,
-                               length, read_buf, last_id);
+                               read_buf, last_id, pool);
       break;
     }
     case kOneByOne: {
       res_info =
           OneByOneFetch<K, V>(fetch_range, lookupkey, fd, record_per_page,
-                              length, read_buf, last_id);
+                              read_buf, last_id, pool);
       break;
     }
   }